@@ -0,0 +1,97 @@
+/* ------------------------------------------------------------------------- *\
+   benchmarks for cache
+     - a read-through workload, skewed as real traffic is: a get for each
+       request, and a put on a miss. Hit rate and time per request, for
+       LRU and CLOCK, at a few cache sizes.
+   -------------------------------------------------------------------------
+   LICENSE: This program is free software. You can modify it and/or re-
+   distribute it under the terms of the Apache 2.0 License. You should have
+   received a copy of the Apache 2.0 License along with this program. If
+   not, please see: http://www.apache.org/licenses/LICENSE-2.0.txt
+
+   DISCLAIMER: This program is distributed in the hope that it will be
+   useful, but without any warrantee; without even the implied warantee
+   of fitness for any particular purpose. See the License for more details.
+\* ------------------------------------------------------------------------- */
+#include <stdbool.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "cache.h"
+#include "b-ocic.h"
+
+#define KEY_LEN  16
+#define KEYS     (1 << 20)
+#define REQUESTS 4000000
+
+/* helper declarations */
+static uint32_t *_skewed(size_t n, uint32_t keys);
+static void _bench_read_through(const char *keys, const uint32_t *req,
+                                uint32_t entries);
+
+/*
+ * Request i asks for key req[i]: keys times the cube of a uniform draw,
+ * so the first k keys take (k / keys)^(1/3) of the requests. Low keys are
+ * far more popular than high ones, with a long tail.
+ */
+static uint32_t *_skewed(size_t n, uint32_t keys)
+{
+  uint32_t *req = malloc(n * sizeof(uint32_t));
+  uint64_t r = 88172645463325252ULL;
+  double u;
+  for (size_t i = 0; i < n; i++) {
+    r ^= r << 13; r ^= r >> 7; r ^= r << 17;   /* xorshift */
+    u = (double)(r >> 11) / (double)(1ULL << 53);
+    req[i] = (uint32_t)(keys * u * u * u);
+  }
+  return req;
+}
+
+static void _bench_read_through(const char *keys, const uint32_t *req,
+                                uint32_t entries)
+{
+  static const char *names[] = { "lru", "clock" };
+  oc_cache_policy policies[] = { OC_CACHE_LRU, OC_CACHE_CLOCK };
+  oc_cache_stats st;
+  const char *k;
+  double t;
+
+  for (int p = 0; p < 2; p++) {
+    oc_cache_opts opts = { .policy = policies[p], .max_entries = entries,
+                           .map = { .engine = HMAP_SWISS } };
+    oc_cache *c = oc_cache_create(NULL, &opts);
+    t = bench_now();
+    for (size_t i = 0; i < REQUESTS; i++) {
+      k = keys + (size_t)req[i] * KEY_LEN;
+      if (!(bench_sink = oc_cache_get(c, k))) {
+        oc_cache_put(c, (char*)(uintptr_t)k, (void*)(uintptr_t)k, 1);
+      }
+    }
+    t = bench_now() - t;
+    oc_cache_get_stats(c, &st);
+    printf("  %-8u %-6s %8.1f%% %9.1f %10llu\n", entries, names[p],
+           100.0 * st.hits / (st.hits + st.misses), t / REQUESTS * 1e9,
+           (unsigned long long)st.evictions);
+    oc_cache_free(c);
+  }
+}
+
+void bench_cache(void)
+{
+  char *keys = malloc((size_t)KEYS * KEY_LEN);
+  uint32_t *req = _skewed(REQUESTS, KEYS);
+
+  for (size_t i = 0; i < KEYS; i++) {
+    snprintf(keys + i * KEY_LEN, KEY_LEN, "ckey%zu", i);
+  }
+  printf("cache: %d skewed requests over %d keys, get then put on a miss\n",
+         REQUESTS, KEYS);
+  printf("  %-8s %-6s %9s %9s %10s\n", "entries", "policy", "hits",
+         "ns/req", "evictions");
+  _bench_read_through(keys, req, 1 << 12);
+  _bench_read_through(keys, req, 1 << 15);
+  _bench_read_through(keys, req, 1 << 18);
+  free(req);
+  free(keys);
+}
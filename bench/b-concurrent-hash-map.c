@@ -0,0 +1,167 @@
+/* ------------------------------------------------------------------------- *\
+   benchmarks for concurrent hash map
+     - throughput from 1 thread up to twice the online cores, for a read
+       heavy (90/10) and a write heavy (50/50) mix, against one hmap
+       behind a reader-writer lock.
+     - writes alternate put (replacing) and remove, so the table holds
+       about the preloaded key count throughout.
+   -------------------------------------------------------------------------
+   LICENSE: This program is free software. You can modify it and/or re-
+   distribute it under the terms of the Apache 2.0 License. You should have
+   received a copy of the Apache 2.0 License along with this program. If
+   not, please see: http://www.apache.org/licenses/LICENSE-2.0.txt
+
+   DISCLAIMER: This program is distributed in the hope that it will be
+   useful, but without any warrantee; without even the implied warantee
+   of fitness for any particular purpose. See the License for more details.
+\* ------------------------------------------------------------------------- */
+#define _POSIX_C_SOURCE 200809L
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#include "concurrent-hash-map.h"
+#include "hash-map.h"
+#include "b-ocic.h"
+
+#define KEY_LEN  16
+#define KEYS     (1 << 16)
+#define OPS      (1 << 20)    /* per thread */
+
+typedef struct worker {
+  int      write_pct;
+  uint64_t rng;
+  pthread_t thread;
+} worker;
+
+static char            *_keys;
+static chmap           *_chmap;
+static hmap            *_hmap;
+static pthread_rwlock_t _hmap_lock;
+
+/* helper declarations */
+static inline uint64_t _next(uint64_t *state);
+static void *_run_chmap(void*);
+static void *_run_hmap(void*);
+static double _run(void *(*fn)(void*), int threads, int write_pct);
+static void  _bench_scaling(int write_pct);
+
+/* xorshift: cheap enough not to show up in the timing. */
+static inline uint64_t
+_next(uint64_t *state)
+{
+  uint64_t x = *state;
+  x ^= x << 13;
+  x ^= x >> 7;
+  x ^= x << 17;
+  return *state = x;
+}
+
+static void *
+_run_chmap(void *arg)
+{
+  worker *w = arg;
+  uint64_t r;
+  char *k;
+
+  for (int i = 0; i < OPS; i++) {
+    r = _next(&w->rng);
+    k = _keys + (r % KEYS) * KEY_LEN;
+    if ((int)((r >> 32) % 100) >= w->write_pct) {
+      bench_sink = chmap_get(_chmap, k);
+    } else if (r & (1ULL << 31)) {
+      chmap_put(_chmap, k, k);
+    } else {
+      chmap_remove(_chmap, k);
+    }
+  }
+  return NULL;
+}
+
+static void *
+_run_hmap(void *arg)
+{
+  worker *w = arg;
+  uint64_t r;
+  char *k;
+
+  for (int i = 0; i < OPS; i++) {
+    r = _next(&w->rng);
+    k = _keys + (r % KEYS) * KEY_LEN;
+    if ((int)((r >> 32) % 100) >= w->write_pct) {
+      pthread_rwlock_rdlock(&_hmap_lock);
+      bench_sink = hmap_get(_hmap, k);
+      pthread_rwlock_unlock(&_hmap_lock);
+    } else if (r & (1ULL << 31)) {
+      pthread_rwlock_wrlock(&_hmap_lock);
+      hmap_put(_hmap, k, k);
+      pthread_rwlock_unlock(&_hmap_lock);
+    } else {
+      pthread_rwlock_wrlock(&_hmap_lock);
+      hmap_remove(_hmap, k);
+      pthread_rwlock_unlock(&_hmap_lock);
+    }
+  }
+  return NULL;
+}
+
+/* Millions of operations per second, across all threads. */
+static double
+_run(void *(*fn)(void*), int threads, int write_pct)
+{
+  worker *w = calloc(threads, sizeof(worker));
+  double t;
+
+  for (int i = 0; i < threads; i++) {
+    w[i].write_pct = write_pct;
+    w[i].rng = 0x9E3779B97F4A7C15ULL * (uint64_t)(i + 1);
+  }
+  t = bench_now();
+  for (int i = 0; i < threads; i++) pthread_create(&w[i].thread, NULL, fn, &w[i]);
+  for (int i = 0; i < threads; i++) pthread_join(w[i].thread, NULL);
+  t = bench_now() - t;
+  free(w);
+  return (double)threads * OPS / t / 1e6;
+}
+
+static void
+_bench_scaling(int write_pct)
+{
+  long cores = sysconf(_SC_NPROCESSORS_ONLN);
+  int max = cores > 1 ? (int)cores * 2 : 4;
+  /* Upsert semantics for the baseline, to match chmap_put. */
+  hmap_opts opts = { .engine = HMAP_SWISS };
+
+  printf("concurrent-hash-map: %d/%d read/write, %d keys, %d ops/thread, "
+         "%ld cores (Mops/s)\n", 100 - write_pct, write_pct, KEYS, OPS, cores);
+  printf("  %-8s %10s %12s\n", "threads", "chmap", "rwlock+hmap");
+  for (int n = 1; n <= max; n *= 2) {
+    _chmap = chmap_create(NULL);
+    _hmap  = hmap_create_opts(NULL, &opts);
+    for (int i = 0; i < KEYS; i++) {
+      chmap_put(_chmap, _keys + i * KEY_LEN, _keys);
+      hmap_put(_hmap, _keys + i * KEY_LEN, _keys);
+    }
+    printf("  %-8d %10.2f %12.2f\n", n,
+           _run(_run_chmap, n, write_pct), _run(_run_hmap, n, write_pct));
+    chmap_free(_chmap);
+    hmap_free(_hmap);
+  }
+}
+
+void bench_concurrent_hash_map(void)
+{
+  _keys = malloc((size_t)KEYS * KEY_LEN);
+  for (int i = 0; i < KEYS; i++) snprintf(_keys + i * KEY_LEN, KEY_LEN, "ckey%d", i);
+  pthread_rwlock_init(&_hmap_lock, NULL);
+
+  _bench_scaling(10);
+  _bench_scaling(50);
+
+  pthread_rwlock_destroy(&_hmap_lock);
+  free(_keys);
+}
@@ -0,0 +1,201 @@
+/* ------------------------------------------------------------------------- *\
+   benchmarks for filter
+     - each filter on its own: bytes per hash, time per add and per probe,
+       and the false-positive rate measured against the rate asked for.
+     - a filter in front of an hmap and a splay tree, on lookups that
+       mostly miss: time per lookup with no filter, a Bloom filter and a
+       cuckoo filter, at several miss rates.
+   -------------------------------------------------------------------------
+   LICENSE: This program is free software. You can modify it and/or re-
+   distribute it under the terms of the Apache 2.0 License. You should have
+   received a copy of the Apache 2.0 License along with this program. If
+   not, please see: http://www.apache.org/licenses/LICENSE-2.0.txt
+
+   DISCLAIMER: This program is distributed in the hope that it will be
+   useful, but without any warrantee; without even the implied warantee
+   of fitness for any particular purpose. See the License for more details.
+\* ------------------------------------------------------------------------- */
+#include <stdbool.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "filter.h"
+#include "hash-map.h"
+#include "splay-tree.h"
+#include "b-ocic.h"
+
+#define KEY_LEN   16
+#define HASHES    (1 << 20)
+#define MAP_KEYS  (1 << 20)
+#define LOOKUPS   4000000
+#define TREE_KEYS (1 << 17)
+#define TREE_LOOKUPS 1000000
+
+/* helper declarations */
+static uint64_t _next(uint64_t *r);
+static int _str_cmp(void*, void*);
+static uint64_t _str_hash(void*);
+static uint32_t *_requests(size_t n, uint32_t keys, int miss_pct);
+static void _bench_standalone(oc_filter_kind, double rate, const char*);
+static void _bench_hmap(const char *keys, hmap_engine, const char*,
+                        int miss_pct);
+static void _bench_splay(const char *keys, int miss_pct);
+
+static uint64_t _next(uint64_t *r)
+{
+  *r ^= *r << 13; *r ^= *r >> 7; *r ^= *r << 17;   /* xorshift */
+  return *r * 0x2545F4914F6CDD1DULL;
+}
+
+static int _str_cmp(void *a, void *b)
+{
+  return strcmp(a, b);
+}
+
+static uint64_t _str_hash(void *key)
+{
+  return oc_filter_hash(key, strlen(key));
+}
+
+/* Keys below keys are held; miss_pct of the requests are for keys above,
+   never put. */
+static uint32_t *_requests(size_t n, uint32_t keys, int miss_pct)
+{
+  uint32_t *req = malloc(n * sizeof(uint32_t));
+  uint64_t r = 88172645463325252ULL, x;
+  for (size_t i = 0; i < n; i++) {
+    x = _next(&r);
+    req[i] = (uint32_t)((x >> 32) % keys);
+    if ((x & 0xffff) % 100 < (uint64_t)miss_pct) req[i] += keys;
+  }
+  return req;
+}
+
+static void _bench_standalone(oc_filter_kind kind, double rate,
+                              const char *name)
+{
+  oc_filter *f = oc_filter_create(kind, HASHES, rate);
+  uint64_t r = 88172645463325252ULL, keep = r;
+  uint32_t fp = 0, found = 0;
+  double add, probe;
+
+  add = bench_now();
+  for (int i = 0; i < HASHES; i++) oc_filter_add(f, _next(&r));
+  add = bench_now() - add;
+  r = keep;
+  probe = bench_now();
+  for (int i = 0; i < HASHES; i++) {
+    found += oc_filter_may_contain(f, _next(&r));
+  }
+  for (int i = 0; i < HASHES; i++) fp += oc_filter_may_contain(f, _next(&r));
+  probe = bench_now() - probe;
+  bench_sink = (void*)(uintptr_t)found;
+  printf("  %-7s %8.4f%% %8.4f%% %9.2f %8.1f %8.1f\n", name, 100.0 * rate,
+         100.0 * fp / HASHES, 8.0 * oc_filter_bytes(f) / HASHES,
+         add / HASHES * 1e9, probe / (2.0 * HASHES) * 1e9);
+  oc_filter_free(f);
+}
+
+static void _bench_hmap(const char *keys, hmap_engine engine,
+                        const char *name, int miss_pct)
+{
+  static const char *fnames[] = { "none", "bloom", "cuckoo" };
+  hmap_opts opts = { .engine = engine, .capacity = MAP_KEYS };
+  uint32_t *req = _requests(LOOKUPS, MAP_KEYS, miss_pct);
+  double t[3];
+
+  for (int k = 0; k < 3; k++) {
+    hmap *h = hmap_create_opts(NULL, &opts);
+    oc_filter *f = NULL;
+    for (size_t i = 0; i < MAP_KEYS; i++) {
+      hmap_put(h, (char*)(uintptr_t)(keys + i * KEY_LEN), NULL);
+    }
+    if (k) {
+      f = oc_filter_create(k == 1 ? OC_FILTER_BLOOM : OC_FILTER_CUCKOO,
+                           MAP_KEYS, 0.01);
+      hmap_attach_filter(h, f);
+    }
+    t[k] = bench_now();
+    for (size_t i = 0; i < LOOKUPS; i++) {
+      bench_sink = hmap_get(h, (char*)(uintptr_t)(keys +
+                                                  (size_t)req[i] * KEY_LEN));
+    }
+    t[k] = bench_now() - t[k];
+    hmap_free(h);
+    if (f) oc_filter_free(f);
+  }
+  printf("  %-10s %4d%%", name, miss_pct);
+  for (int k = 0; k < 3; k++) {
+    printf("  %s %6.1f", fnames[k], t[k] / LOOKUPS * 1e9);
+  }
+  printf("\n");
+  free(req);
+}
+
+static void _bench_splay(const char *keys, int miss_pct)
+{
+  static const char *fnames[] = { "none", "bloom", "cuckoo" };
+  uint32_t *req = _requests(TREE_LOOKUPS, TREE_KEYS, miss_pct);
+  double t[3];
+
+  for (int k = 0; k < 3; k++) {
+    splay *s = splay_create(&_str_cmp, NULL);
+    oc_filter *f = NULL;
+    uint64_t r = 88172645463325252ULL;
+    /* In random order, so the tree starts out bushy. */
+    for (size_t i = 0; i < TREE_KEYS; i++) {
+      size_t j = (size_t)(_next(&r) >> 40) % TREE_KEYS;
+      splay_put(s, (void*)(uintptr_t)(keys + j * KEY_LEN), NULL);
+    }
+    if (k) {
+      f = oc_filter_create(k == 1 ? OC_FILTER_BLOOM : OC_FILTER_CUCKOO,
+                           TREE_KEYS, 0.01);
+      splay_attach_filter(s, f, &_str_hash);
+    }
+    t[k] = bench_now();
+    for (size_t i = 0; i < TREE_LOOKUPS; i++) {
+      bench_sink = splay_get(s, (void*)(uintptr_t)(keys +
+                                                   (size_t)req[i] * KEY_LEN));
+    }
+    t[k] = bench_now() - t[k];
+    splay_free(s);
+    if (f) oc_filter_free(f);
+  }
+  printf("  %-10s %4d%%", "splay", miss_pct);
+  for (int k = 0; k < 3; k++) {
+    printf("  %s %6.1f", fnames[k], t[k] / TREE_LOOKUPS * 1e9);
+  }
+  printf("\n");
+  free(req);
+}
+
+void bench_filter(void)
+{
+  char *keys = malloc((size_t)2 * MAP_KEYS * KEY_LEN);
+
+  for (size_t i = 0; i < 2 * MAP_KEYS; i++) {
+    snprintf(keys + i * KEY_LEN, KEY_LEN, "fkey%zu", i);
+  }
+  printf("filter: %d hashes, each filter on its own\n", HASHES);
+  printf("  %-7s %9s %9s %9s %8s %8s\n", "kind", "asked", "measured",
+         "bits/hash", "ns/add", "ns/probe");
+  _bench_standalone(OC_FILTER_BLOOM, 0.01, "bloom");
+  _bench_standalone(OC_FILTER_BLOOM, 0.001, "bloom");
+  _bench_standalone(OC_FILTER_CUCKOO, 0.03125, "cuckoo");
+  _bench_standalone(OC_FILTER_CUCKOO, 0.001, "cuckoo");
+
+  printf("filter: ns per get, %d keys held (splay %d), filters at 1%%\n",
+         MAP_KEYS, TREE_KEYS);
+  _bench_hmap(keys, HMAP_CHAINED, "chained", 50);
+  _bench_hmap(keys, HMAP_CHAINED, "chained", 80);
+  _bench_hmap(keys, HMAP_CHAINED, "chained", 95);
+  _bench_hmap(keys, HMAP_SWISS, "swiss", 50);
+  _bench_hmap(keys, HMAP_SWISS, "swiss", 80);
+  _bench_hmap(keys, HMAP_SWISS, "swiss", 95);
+  _bench_splay(keys, 50);
+  _bench_splay(keys, 80);
+  _bench_splay(keys, 95);
+  free(keys);
+}
@@ -0,0 +1,646 @@
+/* ------------------------------------------------------------------------- *\
+   benchmarks for hash map
+     - the key families are those of the collision data set in
+       test/t-hash-map.c ("nkey%d", "%dkey", "abc%defg"), scaled up.
+   -------------------------------------------------------------------------
+   LICENSE: This program is free software. You can modify it and/or re-
+   distribute it under the terms of the Apache 2.0 License. You should have
+   received a copy of the Apache 2.0 License along with this program. If
+   not, please see: http://www.apache.org/licenses/LICENSE-2.0.txt
+
+   DISCLAIMER: This program is distributed in the hope that it will be
+   useful, but without any warrantee; without even the implied warantee
+   of fitness for any particular purpose. See the License for more details.
+\* ------------------------------------------------------------------------- */
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+
+#include "hash-map.h"
+#include "b-ocic.h"
+
+#define KEY_LEN 16
+
+/* declarations of hash-map internals */
+uint32_t _hmap_size(hmap*);
+
+static const struct {
+  const char *name;
+  hmap_engine engine;
+} engines[] = {
+  { "chained",    HMAP_CHAINED },
+  { "robin-hood", HMAP_ROBIN_HOOD },
+  { "swiss",      HMAP_SWISS },
+  { "compact",    HMAP_COMPACT },
+};
+
+/* helper declarations */
+static char *_collision_keys(size_t n, const char *miss_fmt);
+static char *_copy(const char *p, size_t len);
+static void  _free_entry(void *key, void *item);
+static void  _bench_collision_set(size_t n, int rounds);
+static void  _bench_put_pause(size_t n);
+static void  _bench_load_factors(void);
+static void  _bench_key_api(size_t n);
+static void  _bench_hash_fns(void);
+static void  _bench_get_batch(size_t n, size_t batch);
+static void  _bench_freeze(size_t n);
+static void  _bench_word_count(size_t words, size_t distinct);
+static size_t _heap_in_use(void);
+static void  _bench_iterate(size_t n);
+static void  _bench_inline_keys(size_t n);
+static void  _bench_bulk_load(size_t n);
+static long  _max_rss_kb(void);
+static void  _bench_hashed(size_t n, size_t key_len);
+static void  _bench_stats(size_t n);
+
+/* A loader's copy of len bytes, NUL-terminated. */
+static char *_copy(const char *p, size_t len)
+{
+  char *c = malloc(len + 1);
+  memcpy(c, p, len);
+  c[len] = '\0';
+  return c;
+}
+
+static void _free_entry(void *key, void *item)
+{
+  free(key);
+  free(item);
+}
+
+/* n keys, one family per third, KEY_LEN apart. A miss_fmt yields keys of
+   the same shape that are never inserted. */
+static char *_collision_keys(size_t n, const char *miss_fmt)
+{
+  char *keys = malloc(n * KEY_LEN);
+  for (size_t i = 0; i < n; i++) {
+    char *k = keys + i * KEY_LEN;
+    if (miss_fmt)            snprintf(k, KEY_LEN, miss_fmt, i);
+    else if (i < n / 3)      snprintf(k, KEY_LEN, "nkey%zu", i);
+    else if (i < 2 * n / 3)  snprintf(k, KEY_LEN, "%zukey", i);
+    else                     snprintf(k, KEY_LEN, "abc%zuefg", i);
+  }
+  return keys;
+}
+
+static void _bench_collision_set(size_t n, int rounds)
+{
+  char *keys = _collision_keys(n, NULL);
+  char *miss = _collision_keys(n, "mkey%zu");
+  int count = sizeof(engines) / sizeof(engines[0]);
+
+  printf("hash-map: collision data set, %zu keys x %d rounds (ns/op)\n",
+         n, rounds);
+  printf("  %-12s %9s %9s %9s %9s\n",
+         "engine", "put", "get-hit", "get-miss", "remove");
+  for (int e = 0; e < count; e++) {
+    hmap_opts opts = { .engine = engines[e].engine };
+    double put = 0, hit = 0, mis = 0, rem = 0, t;
+    for (int r = 0; r < rounds; r++) {
+      hmap *h = hmap_create_opts(NULL, &opts);
+      t = bench_now();
+      for (size_t i = 0; i < n; i++) hmap_put(h, keys + i * KEY_LEN, keys);
+      put += bench_now() - t;
+      t = bench_now();
+      for (size_t i = 0; i < n; i++) bench_sink = hmap_get(h, keys + i * KEY_LEN);
+      hit += bench_now() - t;
+      t = bench_now();
+      for (size_t i = 0; i < n; i++) bench_sink = hmap_get(h, miss + i * KEY_LEN);
+      mis += bench_now() - t;
+      t = bench_now();
+      for (size_t i = 0; i < n; i++) hmap_remove(h, keys + i * KEY_LEN);
+      rem += bench_now() - t;
+      hmap_free(h);
+    }
+    double ops = (double)n * rounds / 1e9;
+    printf("  %-12s %9.1f %9.1f %9.1f %9.1f\n", engines[e].name,
+           put / ops, hit / ops, mis / ops, rem / ops);
+  }
+  free(keys);
+  free(miss);
+}
+
+/* The slowest single put while growing from empty to n keys. */
+static void _bench_put_pause(size_t n)
+{
+  char *keys = _collision_keys(n, NULL);
+  int count = sizeof(engines) / sizeof(engines[0]);
+
+  printf("hash-map: growing to %zu keys (slowest single put, us)\n", n);
+  for (int e = 0; e < count; e++) {
+    hmap_opts opts = { .engine = engines[e].engine };
+    hmap *h = hmap_create_opts(NULL, &opts);
+    double worst = 0, t, d;
+    for (size_t i = 0; i < n; i++) {
+      t = bench_now();
+      hmap_put(h, keys + i * KEY_LEN, keys);
+      d = bench_now() - t;
+      if (d > worst) worst = d;
+    }
+    printf("  %-12s %9.1f\n", engines[e].name, worst * 1e6);
+    hmap_free(h);
+  }
+  free(keys);
+}
+
+/*
+ * Hit and miss throughput with the table at a given fill. Every engine
+ * settles on 2^20 buckets or slots for these key counts; the load column
+ * is what each one actually reached.
+ */
+static void _bench_load_factors(void)
+{
+  const double loads[] = { 0.5, 0.625, 0.75, 0.875 };
+  const size_t slots = 1 << 20;
+  int count = sizeof(engines) / sizeof(engines[0]);
+  char *keys = _collision_keys(slots, NULL);
+  char *miss = _collision_keys(slots, "mkey%zu");
+
+  printf("hash-map: lookups by load factor, 2^20 slots (M lookups/s)\n");
+  printf("  %-6s %-12s %6s %9s %9s\n", "target", "engine", "load", "hit",
+         "miss");
+  for (size_t l = 0; l < sizeof(loads) / sizeof(loads[0]); l++) {
+    /* one past the fill, so the chained engine has doubled, but no more
+       than the swiss engine holds before it doubles. */
+    size_t n = (size_t)(loads[l] * slots) + 1;
+    if (n > slots - slots / 8) n = slots - slots / 8;
+    for (int e = 0; e < count; e++) {
+      hmap_opts opts = { .engine = engines[e].engine };
+      hmap *h = hmap_create_opts(NULL, &opts);
+      double hit, mis, t, items, size;
+      for (size_t i = 0; i < n; i++) hmap_put(h, keys + i * KEY_LEN, keys);
+      /* let the chained engine finish any resize before timing. */
+      for (size_t i = 0; i < n; i++) bench_sink = hmap_get(h, keys + i * KEY_LEN);
+      t = bench_now();
+      for (size_t i = 0; i < n; i++) bench_sink = hmap_get(h, keys + i * KEY_LEN);
+      hit = bench_now() - t;
+      t = bench_now();
+      for (size_t i = 0; i < n; i++) bench_sink = hmap_get(h, miss + i * KEY_LEN);
+      mis = bench_now() - t;
+      items = hmap_count(h);
+      size  = _hmap_size(h);
+      printf("  %-6.3f %-12s %6.3f %9.1f %9.1f\n", loads[l], engines[e].name,
+             items / size,
+             n / hit / 1e6, n / mis / 1e6);
+      hmap_free(h);
+    }
+  }
+  free(keys);
+  free(miss);
+}
+
+/* String keys pay a strlen per call; the _n calls take a known length. */
+static void _bench_key_api(size_t n)
+{
+  const size_t klen = 48;
+  char *keys = malloc(n * klen);
+  size_t *lens = malloc(n * sizeof(size_t));
+  hmap *h = hmap_create(NULL);
+  double str, len, t;
+
+  for (size_t i = 0; i < n; i++) {
+    lens[i] = snprintf(keys + i * klen, klen,
+                       "protocol.field.%zu.attribute.name", i);
+    hmap_put_n(h, keys + i * klen, lens[i], keys);
+  }
+  t = bench_now();
+  for (size_t i = 0; i < n; i++) bench_sink = hmap_get(h, keys + i * klen);
+  str = bench_now() - t;
+  t = bench_now();
+  for (size_t i = 0; i < n; i++) {
+    bench_sink = hmap_get_n(h, keys + i * klen, lens[i]);
+  }
+  len = bench_now() - t;
+  printf("hash-map: %zu keys of ~36 bytes, get (ns/op)\n", n);
+  printf("  %-12s %9.1f\n  %-12s %9.1f\n", "string", str / n * 1e9,
+         "length-aware", len / n * 1e9);
+  hmap_free(h);
+  free(keys);
+  free(lens);
+}
+
+/* Raw hash throughput by key length, over a buffer that stays in cache. */
+static void _bench_hash_fns(void)
+{
+  const size_t lens[] = { 8, 16, 24, 40, 64, 100, 200, 1000 };
+  const struct { const char *name; hmap_hash_fn fn; } fns[] = {
+    { "djb", hmap_hash_djb },
+    { "wy",  hmap_hash_wy },
+  };
+  char buf[4096];
+  uint64_t acc = 0;
+
+  for (size_t i = 0; i < sizeof(buf); i++) buf[i] = (char)(i * 131 + 7);
+  printf("hash-map: hash functions by key length (ns/hash, GB/s)\n");
+  printf("  %-6s", "len");
+  for (size_t f = 0; f < sizeof(fns) / sizeof(fns[0]); f++) {
+    printf(" %9s %6s", fns[f].name, "GB/s");
+  }
+  printf("\n");
+  for (size_t l = 0; l < sizeof(lens) / sizeof(lens[0]); l++) {
+    size_t reps = 20000000 / (lens[l] / 8 + 1);
+    printf("  %-6zu", lens[l]);
+    for (size_t f = 0; f < sizeof(fns) / sizeof(fns[0]); f++) {
+      double t = bench_now();
+      for (size_t r = 0; r < reps; r++) {
+        acc += fns[f].fn(buf + (r & 1023), lens[l], acc);
+      }
+      t = bench_now() - t;
+      printf(" %9.1f %6.2f", t / reps * 1e9, lens[l] * reps / t / 1e9);
+    }
+    printf("\n");
+  }
+  bench_sink = (void*)(uintptr_t)acc;
+}
+
+/*
+ * Random-order lookups on a table far past the last level cache: a loop
+ * of hmap_get against hmap_get_batch, the same keys in the same order.
+ */
+static void _bench_get_batch(size_t n, size_t batch)
+{
+  char *keys = _collision_keys(n, NULL);
+  char **seek = malloc(n * sizeof(char*));
+  void **out = malloc(batch * sizeof(void*));
+  int count = sizeof(engines) / sizeof(engines[0]);
+  uint64_t r = 88172645463325252ULL;
+
+  for (size_t i = 0; i < n; i++) {
+    r ^= r << 13; r ^= r >> 7; r ^= r << 17;   /* xorshift */
+    seek[i] = keys + (r % n) * KEY_LEN;
+  }
+  printf("hash-map: %zu keys, random hits, batches of %zu (ns/lookup)\n",
+         n, batch);
+  printf("  %-12s %9s %9s %9s\n", "engine", "get", "batch", "speedup");
+  for (int e = 0; e < count; e++) {
+    hmap_opts opts = { .engine = engines[e].engine };
+    hmap *h = hmap_create_opts(NULL, &opts);
+    double one, many, t;
+    for (size_t i = 0; i < n; i++) hmap_put(h, keys + i * KEY_LEN, keys);
+    for (size_t i = 0; i < n; i++) bench_sink = hmap_get(h, seek[i]);
+    t = bench_now();
+    for (size_t i = 0; i < n; i++) bench_sink = hmap_get(h, seek[i]);
+    one = bench_now() - t;
+    t = bench_now();
+    for (size_t i = 0; i + batch <= n; i += batch) {
+      hmap_get_batch(h, seek + i, batch, out);
+      bench_sink = out[batch - 1];
+    }
+    many = bench_now() - t;
+    printf("  %-12s %9.1f %9.1f %8.2fx\n", engines[e].name,
+           one / n * 1e9, many / n * 1e9, one / many);
+    hmap_free(h);
+  }
+  free(keys);
+  free(seek);
+  free(out);
+}
+
+/*
+ * Startup: building a map from "key value" text lines (copying each key
+ * and value, as a loader must) against mapping a frozen snapshot of it;
+ * then a pass of lookups over each.
+ */
+static void _bench_freeze(size_t n)
+{
+  const char *path = "b-hash-map.frozen";
+  char *keys = _collision_keys(n, NULL);
+  char *text = malloc(n * 2 * KEY_LEN), *p, *tab, *nl;
+  hmap_opts opts = { .engine = HMAP_SWISS };
+  hmap *h, *f;
+  double build, freeze, open, get_h, get_f, t;
+  size_t len = 0;
+
+  for (size_t i = 0; i < n; i++) {
+    len += sprintf(text + len, "%s\tv%zu\n", keys + i * KEY_LEN, i);
+  }
+  t = bench_now();
+  h = hmap_create_opts(&_free_entry, &opts);
+  for (p = text; p < text + len; p = nl + 1) {
+    tab = strchr(p, '\t');
+    nl  = strchr(tab, '\n');
+    hmap_put_n(h, _copy(p, tab - p), tab - p, _copy(tab + 1, nl - tab - 1));
+  }
+  build = bench_now() - t;
+  t = bench_now();
+  hmap_freeze(h, path);
+  freeze = bench_now() - t;
+  t = bench_now();
+  f = hmap_open_mmap(path);
+  open = bench_now() - t;
+
+  t = bench_now();
+  for (size_t i = 0; i < n; i++) bench_sink = hmap_get(h, keys + i * KEY_LEN);
+  get_h = bench_now() - t;
+  t = bench_now();
+  for (size_t i = 0; i < n; i++) bench_sink = hmap_get(f, keys + i * KEY_LEN);
+  get_f = bench_now() - t;
+
+  printf("hash-map: %zu entry snapshot\n", n);
+  printf("  build from text %9.1f ms   freeze %9.1f ms   open %9.3f ms\n",
+         build * 1e3, freeze * 1e3, open * 1e3);
+  printf("  get, built      %9.1f ns   get, frozen (first touch) %9.1f ns\n",
+         get_h / n * 1e9, get_f / n * 1e9);
+  hmap_free(f);
+  hmap_free(h);
+  remove(path);
+  free(text);
+  free(keys);
+}
+
+/*
+ * Counting words: get then put, which hashes and probes twice, against
+ * one hmap_slot per word.
+ */
+static void _bench_word_count(size_t words, size_t distinct)
+{
+  char *keys = _collision_keys(distinct, NULL);
+  char **text = malloc(words * sizeof(char*));
+  int count = sizeof(engines) / sizeof(engines[0]);
+  uint64_t r = 88172645463325252ULL;
+  void **slot, *v;
+
+  for (size_t i = 0; i < words; i++) {
+    r ^= r << 13; r ^= r >> 7; r ^= r << 17;   /* xorshift */
+    text[i] = keys + (r % distinct) * KEY_LEN;
+  }
+  printf("hash-map: word count, %zu words, %zu distinct (ns/word)\n",
+         words, distinct);
+  printf("  %-12s %9s %9s\n", "engine", "get+put", "slot");
+  for (int e = 0; e < count; e++) {
+    hmap_opts opts = { .engine = engines[e].engine };
+    hmap *h = hmap_create_opts(NULL, &opts);
+    double two, one, t;
+    t = bench_now();
+    for (size_t i = 0; i < words; i++) {
+      v = hmap_get(h, text[i]);
+      hmap_put(h, text[i], (void*)((uintptr_t)v + 1));
+    }
+    two = bench_now() - t;
+    hmap_free(h);
+    h = hmap_create_opts(NULL, &opts);
+    t = bench_now();
+    for (size_t i = 0; i < words; i++) {
+      slot = hmap_slot(h, text[i], NULL);
+      *slot = (void*)((uintptr_t)*slot + 1);
+    }
+    one = bench_now() - t;
+    printf("  %-12s %9.1f %9.1f\n", engines[e].name,
+           two / words * 1e9, one / words * 1e9);
+    hmap_free(h);
+  }
+  free(text);
+  free(keys);
+}
+
+/* Bytes the allocator has handed out; 0 where there is no way to ask. */
+static size_t _heap_in_use(void)
+{
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || __GLIBC_MINOR__ >= 33)
+  return mallinfo2().uordblks;
+#else
+  return 0;
+#endif
+}
+
+/*
+ * What a table costs per entry, keys aside, and one full pass over it
+ * with hmap_iter, summing the items so the pass can't be skipped.
+ */
+static void _bench_iterate(size_t n)
+{
+  char *keys = _collision_keys(n, NULL);
+  int count = sizeof(engines) / sizeof(engines[0]);
+  uintptr_t sum;
+  hmap_iter it;
+  void *item;
+
+  printf("hash-map: %zu entries, bytes per entry and full iteration\n", n);
+  printf("  %-12s %9s %9s\n", "engine", "bytes", "ns/entry");
+  for (int e = 0; e < count; e++) {
+    hmap_opts opts = { .engine = engines[e].engine };
+    size_t before = _heap_in_use(), bytes;
+    hmap *h = hmap_create_opts(NULL, &opts);
+    double t;
+    for (size_t i = 0; i < n; i++) {
+      hmap_put(h, keys + i * KEY_LEN, (void*)(uintptr_t)(i + 1));
+    }
+    bytes = _heap_in_use() - before;
+    /* a first pass finishes the chained engine's resize, untimed. */
+    hmap_iter_init(h, &it);
+    t = bench_now();
+    sum = 0;
+    hmap_iter_init(h, &it);
+    while (hmap_iter_next(&it, NULL, NULL, &item)) sum += (uintptr_t)item;
+    t = bench_now() - t;
+    bench_sink = (void*)sum;
+    printf("  %-12s %9.1f %9.2f\n", engines[e].name, (double)bytes / n,
+           t / n * 1e9);
+    hmap_free(h);
+  }
+  free(keys);
+}
+
+/*
+ * Random-order hits, looked up through a second copy of each key so that
+ * comparing keys reads the stored key's memory, as a real caller's would.
+ * Chained only: inline_keys makes any map chained.
+ */
+static void _bench_inline_keys(size_t n)
+{
+  char *keys = _collision_keys(n, NULL);
+  char *copy = malloc(n * KEY_LEN);
+  char **seek = malloc(n * sizeof(char*));
+  uint64_t r = 88172645463325252ULL;
+  double t, get[2];
+  hmap_iter it;
+
+  memcpy(copy, keys, n * KEY_LEN);
+  for (size_t i = 0; i < n; i++) {
+    r ^= r << 13; r ^= r >> 7; r ^= r << 17;   /* xorshift */
+    seek[i] = copy + (r % n) * KEY_LEN;
+  }
+  printf("hash-map: %zu keys, random hits, keys by pointer or inline "
+         "(ns/op)\n", n);
+  printf("  %-12s %9s %9s\n", "engine", "pointer", "inline");
+  for (int in = 0; in < 2; in++) {
+    hmap_opts opts = { .engine = HMAP_CHAINED, .inline_keys = in };
+    hmap *h = hmap_create_opts(NULL, &opts);
+    for (size_t i = 0; i < n; i++) hmap_put(h, keys + i * KEY_LEN, keys);
+    hmap_iter_init(h, &it);   /* finishes any resize under way. */
+    t = bench_now();
+    for (size_t i = 0; i < n; i++) bench_sink = hmap_get(h, seek[i]);
+    get[in] = bench_now() - t;
+    hmap_free(h);
+  }
+  printf("  %-12s %9.1f %9.1f\n", "chained", get[0] / n * 1e9,
+         get[1] / n * 1e9);
+  free(seek);
+  free(copy);
+  free(keys);
+}
+
+static long _max_rss_kb(void)
+{
+  struct rusage ru;
+  getrusage(RUSAGE_SELF, &ru);
+  return ru.ru_maxrss;
+}
+
+/*
+ * Three ways to load n keys into a fresh map: n puts into a default map,
+ * n puts into one created with capacity n, and one hmap_put_bulk. Each
+ * runs in a child of its own, so its peak resident set is its alone: the
+ * figure is the child's peak less what it started with, the keys.
+ */
+static void _bench_bulk_load(size_t n)
+{
+  char *keys = _collision_keys(n, NULL);
+  char **ptrs = malloc(n * sizeof(char*));
+  void **vals = malloc(n * sizeof(void*));
+  int count = sizeof(engines) / sizeof(engines[0]);
+  static const char *ways[] = { "put", "capacity", "bulk" };
+
+  for (size_t i = 0; i < n; i++) {
+    ptrs[i] = keys + i * KEY_LEN;
+    vals[i] = ptrs[i];
+  }
+  printf("hash-map: loading %zu keys (ms, peak RSS growth MB)\n", n);
+  printf("  %-12s %-9s %9s %9s\n", "engine", "way", "ms", "MB");
+  fflush(stdout);
+  for (int e = 0; e < count; e++) {
+    for (int w = 0; w < 3; w++) {
+      pid_t pid = fork();
+      if (pid == 0) {
+        hmap_opts opts = { .engine = engines[e].engine };
+        long base = _max_rss_kb();
+        double t;
+        hmap *h;
+        if (w == 1) opts.capacity = (uint32_t)n;
+        t = bench_now();
+        h = hmap_create_opts(NULL, &opts);
+        if (w == 2) {
+          hmap_put_bulk(h, ptrs, vals, n);
+        } else {
+          for (size_t i = 0; i < n; i++) hmap_put(h, ptrs[i], vals[i]);
+        }
+        t = bench_now() - t;
+        printf("  %-12s %-9s %9.1f %9.1f\n", engines[e].name, ways[w],
+               t * 1e3, (_max_rss_kb() - base) / 1024.0);
+        fflush(stdout);
+        _exit(0);
+      }
+      waitpid(pid, NULL, 0);
+    }
+  }
+  free(vals);
+  free(ptrs);
+  free(keys);
+}
+
+/*
+ * Each key looked up in four maps seeded alike, as a pipeline would: four
+ * hmap_gets, each hashing the key, against one hmap_hash and four
+ * hmap_get_hashed.
+ */
+static void _bench_hashed(size_t n, size_t key_len)
+{
+  char *keys = malloc(n * key_len);
+  hmap_opts opts = { .engine = HMAP_SWISS, .seed = 0x5eed };
+  hmap *h[4];
+  double t, plain, hashed;
+  uint64_t hash;
+  char *k;
+
+  for (size_t i = 0; i < n; i++) {
+    k = keys + i * key_len;
+    memset(k, 'p', key_len - 1);
+    snprintf(k, key_len, "pipeline/stage/%zu", i);
+    k[strlen(k)] = 'p';
+    k[key_len - 1] = '\0';
+  }
+  for (int m = 0; m < 4; m++) {
+    h[m] = hmap_create_opts(NULL, &opts);
+    for (size_t i = 0; i < n; i++) hmap_put(h[m], keys + i * key_len, keys);
+  }
+  t = bench_now();
+  for (size_t i = 0; i < n; i++) {
+    k = keys + i * key_len;
+    for (int m = 0; m < 4; m++) bench_sink = hmap_get(h[m], k);
+  }
+  plain = bench_now() - t;
+  t = bench_now();
+  for (size_t i = 0; i < n; i++) {
+    k = keys + i * key_len;
+    hash = hmap_hash(h[0], k);
+    for (int m = 0; m < 4; m++) bench_sink = hmap_get_hashed(h[m], hash, k);
+  }
+  hashed = bench_now() - t;
+  printf("hash-map: %zu keys of %zu bytes, each looked up in 4 maps "
+         "(ns/key): %.1f hashing each time, %.1f hashed once\n",
+         n, key_len - 1, plain / n * 1e9, hashed / n * 1e9);
+  for (int m = 0; m < 4; m++) hmap_free(h[m]);
+  free(keys);
+}
+
+/* What a metrics exporter pays per poll, and what the walk finds on the
+   collision data set. */
+static void _bench_stats(size_t n)
+{
+  char *keys = _collision_keys(n, NULL);
+  int count = sizeof(engines) / sizeof(engines[0]);
+  hmap_stats s;
+  double cheap, walk;
+
+  printf("hash-map: stats of %zu collision keys (ns/poll, ms/walk)\n", n);
+  printf("  %-12s %9s %9s %6s %6s %6s %6s %9s\n", "engine", "poll", "walk",
+         "load", "mean", "max", "disp", "MB");
+  for (int e = 0; e < count; e++) {
+    hmap_opts opts = { .engine = engines[e].engine };
+    hmap *h = hmap_create_opts(NULL, &opts);
+    for (size_t i = 0; i < n; i++) hmap_put(h, keys + i * KEY_LEN, keys);
+    cheap = bench_now();
+    for (int r = 0; r < 1000000; r++) hmap_get_stats(h, &s, false);
+    cheap = (bench_now() - cheap) / 1000000;
+    walk = bench_now();
+    hmap_get_stats(h, &s, true);
+    walk = bench_now() - walk;
+    printf("  %-12s %9.1f %9.1f %6.3f %6.3f %6u %6.3f %9.1f\n",
+           engines[e].name, cheap * 1e9, walk * 1e3, s.load, s.mean_probe,
+           s.max_probe, s.dispersion, s.bytes / 1048576.0);
+    hmap_free(h);
+  }
+  free(keys);
+}
+
+void bench_hash_map(void)
+{
+  _bench_collision_set(1000, 1000);
+  _bench_collision_set(100000, 5);
+  _bench_put_pause(2000000);
+  _bench_load_factors();
+  _bench_key_api(100000);
+  _bench_hash_fns();
+  _bench_get_batch(1 << 23, 128);
+  _bench_freeze(2000000);
+  _bench_word_count(4000000, 50000);
+  _bench_iterate(1000000);
+  _bench_iterate(1500000);
+  _bench_inline_keys(100000);
+  _bench_inline_keys(4000000);
+  _bench_bulk_load(5000000);
+  _bench_hashed(100000, 24);
+  _bench_hashed(100000, 80);
+  _bench_stats(1000000);
+}
@@ -0,0 +1,110 @@
+/* ------------------------------------------------------------------------- *\
+   benchmarks for integer hash map
+     - 64 bit IDs against the same IDs as decimal strings in hmap, both
+       with the strings made up front and with each call formatting its
+       own, as a caller converting IDs would.
+   -------------------------------------------------------------------------
+   LICENSE: This program is free software. You can modify it and/or re-
+   distribute it under the terms of the Apache 2.0 License. You should have
+   received a copy of the Apache 2.0 License along with this program. If
+   not, please see: http://www.apache.org/licenses/LICENSE-2.0.txt
+
+   DISCLAIMER: This program is distributed in the hope that it will be
+   useful, but without any warrantee; without even the implied warantee
+   of fitness for any particular purpose. See the License for more details.
+\* ------------------------------------------------------------------------- */
+#include <stdbool.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "int-hash-map.h"
+#include "hash-map.h"
+#include "b-ocic.h"
+
+#define KEY_LEN 24
+
+/* helper declarations */
+static void _bench_ids(size_t n);
+
+/* Random 64 bit IDs, looked up in random order. */
+static void _bench_ids(size_t n)
+{
+  uint64_t *ids = malloc(n * sizeof(uint64_t));
+  uint64_t *seek = malloc(n * sizeof(uint64_t));
+  char *buf = malloc(n * KEY_LEN), *sbuf = malloc(n * KEY_LEN);
+  char tmp[KEY_LEN];
+  uint64_t r = 88172645463325252ULL;
+  double t, put[2], hit[3], miss[3];
+  hmap64 *h64 = hmap64_create(NULL);
+  hmap *h = hmap_create(NULL);
+
+  for (size_t i = 0; i < n; i++) {
+    r ^= r << 13; r ^= r >> 7; r ^= r << 17;   /* xorshift */
+    ids[i] = r;
+    snprintf(buf + i * KEY_LEN, KEY_LEN, "%llu", (unsigned long long)r);
+  }
+  for (size_t i = 0; i < n; i++) {
+    r ^= r << 13; r ^= r >> 7; r ^= r << 17;
+    seek[i] = ids[r % n];
+    snprintf(sbuf + i * KEY_LEN, KEY_LEN, "%llu", (unsigned long long)seek[i]);
+  }
+
+  t = bench_now();
+  for (size_t i = 0; i < n; i++) hmap64_put(h64, ids[i], buf + i * KEY_LEN);
+  put[0] = bench_now() - t;
+  t = bench_now();
+  for (size_t i = 0; i < n; i++) hmap_put(h, buf + i * KEY_LEN, buf + i * KEY_LEN);
+  put[1] = bench_now() - t;
+
+  t = bench_now();
+  for (size_t i = 0; i < n; i++) bench_sink = hmap64_get(h64, seek[i]);
+  hit[0] = bench_now() - t;
+  t = bench_now();
+  for (size_t i = 0; i < n; i++) bench_sink = hmap_get(h, sbuf + i * KEY_LEN);
+  hit[1] = bench_now() - t;
+  t = bench_now();
+  for (size_t i = 0; i < n; i++) {
+    snprintf(tmp, KEY_LEN, "%llu", (unsigned long long)seek[i]);
+    bench_sink = hmap_get(h, tmp);
+  }
+  hit[2] = bench_now() - t;
+
+  t = bench_now();
+  for (size_t i = 0; i < n; i++) bench_sink = hmap64_get(h64, seek[i] + 1);
+  miss[0] = bench_now() - t;
+  for (size_t i = 0; i < n; i++) {
+    snprintf(sbuf + i * KEY_LEN, KEY_LEN, "%llu",
+             (unsigned long long)(seek[i] + 1));
+  }
+  t = bench_now();
+  for (size_t i = 0; i < n; i++) bench_sink = hmap_get(h, sbuf + i * KEY_LEN);
+  miss[1] = bench_now() - t;
+  t = bench_now();
+  for (size_t i = 0; i < n; i++) {
+    snprintf(tmp, KEY_LEN, "%llu", (unsigned long long)(seek[i] + 1));
+    bench_sink = hmap_get(h, tmp);
+  }
+  miss[2] = bench_now() - t;
+
+  printf("int-hash-map: %zu random 64 bit IDs, random order (ns/op)\n", n);
+  printf("  %-20s %9s %9s %9s\n", "", "put", "get-hit", "get-miss");
+  printf("  %-20s %9.1f %9.1f %9.1f\n", "hmap64", put[0] / n * 1e9,
+         hit[0] / n * 1e9, miss[0] / n * 1e9);
+  printf("  %-20s %9.1f %9.1f %9.1f\n", "hmap, strings made", put[1] / n * 1e9,
+         hit[1] / n * 1e9, miss[1] / n * 1e9);
+  printf("  %-20s %9s %9.1f %9.1f\n", "hmap, snprintf each", "",
+         hit[2] / n * 1e9, miss[2] / n * 1e9);
+  hmap64_free(h64);
+  hmap_free(h);
+  free(ids);
+  free(seek);
+  free(buf);
+  free(sbuf);
+}
+
+void bench_int_hash_map(void)
+{
+  _bench_ids(100000);
+  _bench_ids(4000000);
+}
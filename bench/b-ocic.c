@@ -0,0 +1,72 @@
+/* ------------------------------------------------------------------------- *\
+   benchmark driver for ocic
+     - with no arguments, runs every benchmark.
+     - otherwise runs the benchmarks named on the command line.
+   -------------------------------------------------------------------------
+   LICENSE: This program is free software. You can modify it and/or re-
+   distribute it under the terms of the Apache 2.0 License. You should have
+   received a copy of the Apache 2.0 License along with this program. If
+   not, please see: http://www.apache.org/licenses/LICENSE-2.0.txt
+
+   DISCLAIMER: This program is distributed in the hope that it will be
+   useful, but without any warrantee; without even the implied warantee
+   of fitness for any particular purpose. See the License for more details.
+\* ------------------------------------------------------------------------- */
+#define _POSIX_C_SOURCE 199309L
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "b-ocic.h"
+
+volatile void *bench_sink;
+
+static const struct {
+  const char *name;
+  void (*run)(void);
+} benches[] = {
+  { "hash-map", bench_hash_map },
+  { "int-hash-map", bench_int_hash_map },
+  { "concurrent-hash-map", bench_concurrent_hash_map },
+  { "sharded-hash-map", bench_sharded_hash_map },
+  { "cache", bench_cache },
+  { "filter", bench_filter },
+  { "perfect-hash", bench_perfect_hash },
+  { "typed-hash-map", bench_typed_hash_map },
+  { "typed-splay-tree", bench_typed_splay_tree },
+  { "splay-tree", bench_splay_tree },
+};
+
+double bench_now(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+int main(int c, char ** argv) {
+
+  int count = sizeof(benches) / sizeof(benches[0]);
+  int ran = 0;
+
+  for (int b = 0; b < count; b++) {
+    bool run = (c < 2);
+    for (int a = 1; a < c; a++) {
+      if (!strcmp(argv[a], benches[b].name)) run = true;
+    }
+    if (run) {
+      benches[b].run();
+      ran++;
+    }
+  }
+
+  if (!ran) {
+    printf("No such benchmark. Choose from:");
+    for (int b = 0; b < count; b++) printf(" %s", benches[b].name);
+    printf("\n");
+    return 1;
+  }
+  return 0;
+}
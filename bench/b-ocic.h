@@ -0,0 +1,33 @@
+#ifndef _B_OCIC_H
+#define _B_OCIC_H
+/* ------------------------------------------------------------------------- *\
+   benchmarks for ocic
+   -------------------------------------------------------------------------
+   LICENSE: This program is free software. You can modify it and/or re-
+   distribute it under the terms of the Apache 2.0 License. You should have
+   received a copy of the Apache 2.0 License along with this program. If
+   not, please see: http://www.apache.org/licenses/LICENSE-2.0.txt
+
+   DISCLAIMER: This program is distributed in the hope that it will be
+   useful, but without any warrantee; without even the implied warantee
+   of fitness for any particular purpose. See the License for more details.
+\* ------------------------------------------------------------------------- */
+
+/* wall clock, in seconds, for timing a run. */
+double bench_now( void );
+
+/* keeps the optimizer from discarding a benchmarked result. */
+extern volatile void *bench_sink;
+
+void bench_hash_map( void );
+void bench_int_hash_map( void );
+void bench_concurrent_hash_map( void );
+void bench_sharded_hash_map( void );
+void bench_cache( void );
+void bench_filter( void );
+void bench_perfect_hash( void );
+void bench_typed_hash_map( void );
+void bench_typed_splay_tree( void );
+void bench_splay_tree( void );
+
+#endif
@@ -0,0 +1,112 @@
+/* ------------------------------------------------------------------------- *\
+   benchmarks for minimal perfect hash
+     - lookups against the chained hmap over the same keys, hits and
+       misses, in random order; build time by thread count.
+   -------------------------------------------------------------------------
+   LICENSE: This program is free software. You can modify it and/or re-
+   distribute it under the terms of the Apache 2.0 License. You should have
+   received a copy of the Apache 2.0 License along with this program. If
+   not, please see: http://www.apache.org/licenses/LICENSE-2.0.txt
+
+   DISCLAIMER: This program is distributed in the hope that it will be
+   useful, but without any warrantee; without even the implied warantee
+   of fitness for any particular purpose. See the License for more details.
+\* ------------------------------------------------------------------------- */
+#include <stdbool.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "perfect-hash.h"
+#include "b-ocic.h"
+
+#define KEY_LEN 16
+
+/* helper declarations */
+static char **_keys(char *buf, size_t n, const char *fmt);
+static void   _bench_lookup(size_t n);
+static void   _bench_build(size_t n);
+
+static char **_keys(char *buf, size_t n, const char *fmt)
+{
+  char **keys = malloc(n * sizeof(char*));
+  for (size_t i = 0; i < n; i++) {
+    keys[i] = buf + i * KEY_LEN;
+    snprintf(keys[i], KEY_LEN, fmt, i);
+  }
+  return keys;
+}
+
+static void _bench_lookup(size_t n)
+{
+  char *buf = malloc(n * KEY_LEN), *mbuf = malloc(n * KEY_LEN);
+  char **keys = _keys(buf, n, "pkey%zu"), **miss = _keys(mbuf, n, "miss%zu");
+  char **seek = malloc(n * sizeof(char*)), **mseek = malloc(n * sizeof(char*));
+  hmap_opts opts = { .engine = HMAP_CHAINED };
+  hmap *h = hmap_create_opts(NULL, &opts);
+  uint64_t r = 88172645463325252ULL;
+  double hit_h, hit_m, mis_h, mis_m, t;
+  mph *m;
+
+  for (size_t i = 0; i < n; i++) {
+    r ^= r << 13; r ^= r >> 7; r ^= r << 17;   /* xorshift */
+    seek[i]  = keys[r % n];
+    mseek[i] = miss[r % n];
+    hmap_put(h, keys[i], keys[i]);
+  }
+  m = mph_create(keys, (void**)keys, n, 0);
+
+  t = bench_now();
+  for (size_t i = 0; i < n; i++) bench_sink = hmap_get(h, seek[i]);
+  hit_h = bench_now() - t;
+  t = bench_now();
+  for (size_t i = 0; i < n; i++) bench_sink = mph_get(m, seek[i]);
+  hit_m = bench_now() - t;
+  t = bench_now();
+  for (size_t i = 0; i < n; i++) bench_sink = hmap_get(h, mseek[i]);
+  mis_h = bench_now() - t;
+  t = bench_now();
+  for (size_t i = 0; i < n; i++) bench_sink = mph_get(m, mseek[i]);
+  mis_m = bench_now() - t;
+
+  printf("perfect-hash: %zu keys, random order (ns/op), %.2f bits/key\n",
+         n, mph_bits_per_key(m));
+  printf("  %-12s %9s %9s\n", "", "get-hit", "get-miss");
+  printf("  %-12s %9.1f %9.1f\n", "chained", hit_h / n * 1e9, mis_h / n * 1e9);
+  printf("  %-12s %9.1f %9.1f\n", "mph", hit_m / n * 1e9, mis_m / n * 1e9);
+  mph_free(m);
+  hmap_free(h);
+  free(seek);
+  free(mseek);
+  free(keys);
+  free(miss);
+  free(buf);
+  free(mbuf);
+}
+
+static void _bench_build(size_t n)
+{
+  char *buf = malloc(n * KEY_LEN);
+  char **keys = _keys(buf, n, "pkey%zu");
+  double t;
+  mph *m;
+
+  printf("perfect-hash: build of %zu keys\n", n);
+  for (int threads = 1; threads <= 4; threads *= 2) {
+    t = bench_now();
+    m = mph_create(keys, NULL, n, threads);
+    t = bench_now() - t;
+    printf("  %d thread%s %9.1f ms\n", threads, threads > 1 ? "s" : " ",
+           t * 1e3);
+    mph_free(m);
+  }
+  free(keys);
+  free(buf);
+}
+
+void bench_perfect_hash(void)
+{
+  _bench_lookup(100000);
+  _bench_lookup(4000000);
+  _bench_build(4000000);
+}
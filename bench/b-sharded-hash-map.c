@@ -0,0 +1,130 @@
+/* ------------------------------------------------------------------------- *\
+   benchmarks for sharded hash map
+     - insert throughput from 1 to 32 threads, each thread putting its
+       own keys into one fresh, shared map that grows as it goes, against
+       one hmap behind a mutex and against chmap.
+     - scale is shmap's throughput over its one-thread throughput: near
+       the thread count while each thread has a core of its own. Rows
+       with more threads than online cores are marked with a *: their
+       threads only take turns, and show what the locking costs, not
+       how it scales.
+   -------------------------------------------------------------------------
+   LICENSE: This program is free software. You can modify it and/or re-
+   distribute it under the terms of the Apache 2.0 License. You should have
+   received a copy of the Apache 2.0 License along with this program. If
+   not, please see: http://www.apache.org/licenses/LICENSE-2.0.txt
+
+   DISCLAIMER: This program is distributed in the hope that it will be
+   useful, but without any warrantee; without even the implied warantee
+   of fitness for any particular purpose. See the License for more details.
+\* ------------------------------------------------------------------------- */
+#define _POSIX_C_SOURCE 200809L
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#include "sharded-hash-map.h"
+#include "concurrent-hash-map.h"
+#include "b-ocic.h"
+
+#define KEY_LEN     16
+#define PER_THREAD  (1 << 18)
+#define MAX_THREADS 32
+
+typedef struct worker {
+  char     *keys;
+  pthread_t thread;
+} worker;
+
+static shmap          *_shmap;
+static chmap          *_chmap;
+static hmap           *_hmap;
+static pthread_mutex_t _hmap_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* helper declarations */
+static void *_put_shmap(void*);
+static void *_put_chmap(void*);
+static void *_put_hmap(void*);
+static double _run(void *(*fn)(void*), int threads, char *keys);
+
+static void *
+_put_shmap(void *arg)
+{
+  worker *w = arg;
+  for (int i = 0; i < PER_THREAD; i++) {
+    shmap_put(_shmap, w->keys + (size_t)i * KEY_LEN, w->keys);
+  }
+  return NULL;
+}
+
+static void *
+_put_chmap(void *arg)
+{
+  worker *w = arg;
+  for (int i = 0; i < PER_THREAD; i++) {
+    chmap_put(_chmap, w->keys + (size_t)i * KEY_LEN, w->keys);
+  }
+  return NULL;
+}
+
+static void *
+_put_hmap(void *arg)
+{
+  worker *w = arg;
+  for (int i = 0; i < PER_THREAD; i++) {
+    pthread_mutex_lock(&_hmap_lock);
+    hmap_put(_hmap, w->keys + (size_t)i * KEY_LEN, w->keys);
+    pthread_mutex_unlock(&_hmap_lock);
+  }
+  return NULL;
+}
+
+/* Millions of puts per second, all threads together. */
+static double
+_run(void *(*fn)(void*), int threads, char *keys)
+{
+  worker w[MAX_THREADS];
+  double t = bench_now();
+  for (int i = 0; i < threads; i++) {
+    w[i].keys = keys + (size_t)i * PER_THREAD * KEY_LEN;
+    pthread_create(&w[i].thread, NULL, fn, &w[i]);
+  }
+  for (int i = 0; i < threads; i++) pthread_join(w[i].thread, NULL);
+  t = bench_now() - t;
+  return (double)threads * PER_THREAD / t / 1e6;
+}
+
+void bench_sharded_hash_map(void)
+{
+  char *keys = malloc((size_t)MAX_THREADS * PER_THREAD * KEY_LEN);
+  hmap_opts opts = { .engine = HMAP_SWISS };
+  long cores = sysconf(_SC_NPROCESSORS_ONLN);
+  double s, c, h, one = 0;
+
+  for (size_t i = 0; i < (size_t)MAX_THREADS * PER_THREAD; i++) {
+    snprintf(keys + i * KEY_LEN, KEY_LEN, "skey%zu", i);
+  }
+  printf("sharded-hash-map: %d fresh keys per thread, into one shared map, "
+         "%ld online cores (M puts/s)\n", PER_THREAD, cores);
+  printf("  %-8s %12s %8s %12s %12s\n", "threads", "shmap", "scale",
+         "chmap", "hmap+mutex");
+  for (int threads = 1; threads <= MAX_THREADS; threads *= 2) {
+    _shmap = shmap_create_opts(NULL, &opts, 0);
+    s = _run(_put_shmap, threads, keys);
+    shmap_free(_shmap);
+    _chmap = chmap_create(NULL);
+    c = _run(_put_chmap, threads, keys);
+    chmap_free(_chmap);
+    _hmap = hmap_create_opts(NULL, &opts);
+    h = _run(_put_hmap, threads, keys);
+    hmap_free(_hmap);
+    if (threads == 1) one = s;
+    printf("  %-7d%c %12.2f %8.2f %12.2f %12.2f\n", threads,
+           threads > cores ? '*' : ' ', s, s / one, c, h);
+  }
+  free(keys);
+}
@@ -0,0 +1,352 @@
+/* ------------------------------------------------------------------------- *\
+   benchmarks for splay tree
+     - int keys, boxed, through the comparator: inserts in sorted and in
+       random order, then lookups in sorted order, skewed to a few hot
+       keys, and uniform, and removes in reverse order.
+     - range scans of a few entries from random starting keys, against a
+       full splay_iter.
+     - loading sorted keys: put one at a time against splay_build_sorted,
+       and uniform gets on the tree each leaves; merging two halves.
+     - splitting at a random key and joining the halves back, and moving
+       a range a thousandth of the keys wide from one tree to another.
+     - rank, select and count_range at random: O(log n) each in a build
+       with -D SPLAY_ORDER_STATS, a walk in key order without it, so the
+       walks are timed on fewer calls.
+   -------------------------------------------------------------------------
+   LICENSE: This program is free software. You can modify it and/or re-
+   distribute it under the terms of the Apache 2.0 License. You should have
+   received a copy of the Apache 2.0 License along with this program. If
+   not, please see: http://www.apache.org/licenses/LICENSE-2.0.txt
+
+   DISCLAIMER: This program is distributed in the hope that it will be
+   useful, but without any warrantee; without even the implied warantee
+   of fitness for any particular purpose. See the License for more details.
+\* ------------------------------------------------------------------------- */
+#include <stdbool.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "splay-tree.h"
+#include "b-ocic.h"
+
+/* helper declarations */
+static uint64_t _next(uint64_t *r);
+static int  _int_cmp(void*, void*);
+static void _bench_order(size_t n, bool sorted);
+static bool _count_entry(void*, void*, void*);
+static void _visit_entry(void*, void*);
+static void _bench_range(size_t n, int width, size_t scans);
+static void _bench_build(size_t n);
+static void _bench_split(size_t n, size_t rounds);
+static void _bench_rank(size_t n, size_t calls);
+
+static uint64_t _next(uint64_t *r)
+{
+  *r ^= *r << 13; *r ^= *r >> 7; *r ^= *r << 17;   /* xorshift */
+  return *r * 0x2545F4914F6CDD1DULL;
+}
+
+static int _int_cmp(void *a, void *b)
+{
+  int x = *(int*)a, y = *(int*)b;
+  return (x > y) - (x < y);
+}
+
+/* Keys 0 .. n-1, put in order or shuffled; lookups hit every time. */
+static void _bench_order(size_t n, bool sorted)
+{
+  int *keys = malloc(n * sizeof(int));
+  int *order = malloc(n * sizeof(int));
+  int *hot = malloc(n * sizeof(int));
+  int *any = malloc(n * sizeof(int));
+  uint64_t r = 88172645463325252ULL, x, sum = 0;
+  splay *s = splay_create(_int_cmp, NULL);
+  double t, put, seq, skew, uni, rem;
+  size_t j;
+  int tmp;
+
+  for (size_t i = 0; i < n; i++) keys[i] = order[i] = (int)i;
+  for (size_t i = n - 1; !sorted && i > 0; i--) {
+    j = (size_t)(_next(&r) % (i + 1));
+    tmp = order[i]; order[i] = order[j]; order[j] = tmp;
+  }
+  for (size_t i = 0; i < n; i++) {
+    x = _next(&r);
+    hot[i] = (int)((x & 7) ? (x >> 32) % 64 * (n / 64) : (x >> 32) % n);
+    any[i] = (int)((x >> 32) % n);
+  }
+
+  t = bench_now();
+  for (size_t i = 0; i < n; i++) splay_put(s, &keys[order[i]], &keys[i]);
+  put = bench_now() - t;
+  t = bench_now();
+  for (size_t i = 0; i < n; i++) {
+    sum += (uint64_t)*(int*)splay_get(s, &keys[i]);
+  }
+  seq = bench_now() - t;
+  t = bench_now();
+  for (size_t i = 0; i < n; i++) {
+    sum += (uint64_t)*(int*)splay_get(s, &keys[hot[i]]);
+  }
+  skew = bench_now() - t;
+  t = bench_now();
+  for (size_t i = 0; i < n; i++) {
+    sum += (uint64_t)*(int*)splay_get(s, &keys[any[i]]);
+  }
+  uni = bench_now() - t;
+  t = bench_now();
+  for (size_t i = n; i > 0; i--) splay_remove(s, &keys[i - 1]);
+  rem = bench_now() - t;
+  bench_sink = (void*)(uintptr_t)sum;
+
+  printf("  %-8s %10zu %9.1f %9.1f %9.1f %9.1f %9.1f\n",
+         sorted ? "sorted" : "random", n, put / n * 1e9, seq / n * 1e9,
+         skew / n * 1e9, uni / n * 1e9, rem / n * 1e9);
+  splay_free(s);
+  free(keys);
+  free(order);
+  free(hot);
+  free(any);
+}
+
+static bool _count_entry(void *ctx, void *k, void *v)
+{
+  (void)k; (void)v;
+  (*(size_t*)ctx)++;
+  return true;
+}
+
+static size_t visits;
+static void _visit_entry(void *k, void *v)
+{
+  (void)k; (void)v;
+  visits++;
+}
+
+/* Keys 0, 2, 4, ...: each scan from a random lo covers width keys. */
+static void _bench_range(size_t n, int width, size_t scans)
+{
+  int *keys = malloc(n * sizeof(int));
+  int lo, hi;
+  uint64_t r = 88172645463325252ULL;
+  splay *s = splay_create(_int_cmp, NULL);
+  size_t seen = 0, j;
+  double t, scan, full;
+  int tmp;
+
+  for (size_t i = 0; i < n; i++) keys[i] = (int)(2 * i);
+  for (size_t i = n - 1; i > 0; i--) {
+    j = (size_t)(_next(&r) % (i + 1));
+    tmp = keys[i]; keys[i] = keys[j]; keys[j] = tmp;
+  }
+  for (size_t i = 0; i < n; i++) splay_put(s, &keys[i], &keys[i]);
+  t = bench_now();
+  for (size_t i = 0; i < scans; i++) {
+    lo = (int)(_next(&r) % (2 * n));
+    hi = lo + 2 * width;
+    splay_range(s, &lo, &hi, _count_entry, &seen);
+  }
+  scan = bench_now() - t;
+  t = bench_now();
+  splay_iter(s, _visit_entry);
+  full = bench_now() - t;
+  bench_sink = (void*)(uintptr_t)(seen + visits);
+  printf("  %10zu %6d %10.1f %10.1f %12.2f\n", n, width,
+         scan / scans * 1e9, scan / (double)seen * 1e9, full * 1e3);
+  splay_free(s);
+  free(keys);
+}
+
+/* Keys 0 .. n-1 in order, loaded both ways; the gets after each show
+   what the shape the load left costs the first lookups. */
+static void _bench_build(size_t n)
+{
+  int *keys = malloc(n * sizeof(int));
+  void **kp = malloc(n * sizeof(void*));
+  uint64_t r = 88172645463325252ULL, sum = 0;
+  double t, load[2], get[2], merge;
+  splay *s, *hi;
+
+  for (size_t i = 0; i < n; i++) {
+    keys[i] = (int)i;
+    kp[i] = &keys[i];
+  }
+  for (int k = 0; k < 2; k++) {
+    s = splay_create(_int_cmp, NULL);
+    t = bench_now();
+    if (k) {
+      splay_build_sorted(s, kp, kp, n);
+    } else {
+      for (size_t i = 0; i < n; i++) splay_put(s, kp[i], kp[i]);
+    }
+    load[k] = bench_now() - t;
+    t = bench_now();
+    for (size_t i = 0; i < n; i++) {
+      sum += (uint64_t)*(int*)splay_get(s, &keys[_next(&r) % n]);
+    }
+    get[k] = bench_now() - t;
+    splay_free(s);
+  }
+  s = splay_create(_int_cmp, NULL);
+  hi = splay_create(_int_cmp, NULL);
+  splay_build_sorted(s, kp, kp, n / 2);
+  splay_build_sorted(hi, kp + n / 2, kp + n / 2, n - n / 2);
+  t = bench_now();
+  splay_merge(s, hi);
+  merge = bench_now() - t;
+  bench_sink = (void*)(uintptr_t)sum;
+  printf("  %10zu %9.1f %9.1f %9.1f %9.1f %9.1f\n", n, load[0] / n * 1e9,
+         get[0] / n * 1e9, load[1] / n * 1e9, get[1] / n * 1e9,
+         merge * 1e9);
+  splay_free(s);
+  splay_free(hi);
+  free(keys);
+  free(kp);
+}
+
+/* Keys 0 .. n-1, put shuffled. A move takes [lo, hi) out of one tree by
+   two splits and a join, and into the other by a split and two joins. */
+static void _bench_split(size_t n, size_t rounds)
+{
+  int *keys = malloc(n * sizeof(int));
+  int at, lo, hi;
+  uint64_t r = 88172645463325252ULL;
+  splay *s = splay_create(_int_cmp, NULL), *t = splay_create(_int_cmp, NULL);
+  splay *mid, *tail;
+  double tm, split, move;
+  size_t j;
+  int tmp;
+
+  for (size_t i = 0; i < n; i++) keys[i] = (int)i;
+  for (size_t i = n - 1; i > 0; i--) {
+    j = (size_t)(_next(&r) % (i + 1));
+    tmp = keys[i]; keys[i] = keys[j]; keys[j] = tmp;
+  }
+  for (size_t i = 0; i < n; i++) splay_put(s, &keys[i], &keys[i]);
+  tm = bench_now();
+  for (size_t i = 0; i < rounds; i++) {
+    at = (int)(_next(&r) % n);
+    tail = splay_split(s, &at);
+    splay_join(s, tail);
+    splay_free(tail);
+  }
+  split = bench_now() - tm;
+  tm = bench_now();
+  for (size_t i = 0; i < rounds; i++) {
+    splay *from = i % 2 ? t : s, *to = i % 2 ? s : t;
+    lo = (int)(_next(&r) % n);
+    hi = lo + (int)(n / 1000);
+    mid = splay_split(from, &lo);
+    tail = splay_split(mid, &hi);
+    splay_join(from, tail);
+    splay_free(tail);
+    tail = splay_split(to, &lo);
+    splay_join(to, mid);
+    splay_join(to, tail);
+    splay_free(mid);
+    splay_free(tail);
+  }
+  move = bench_now() - tm;
+  bench_sink = (void*)(uintptr_t)(splay_count(s) + splay_count(t));
+  printf("  %10zu %10zu %12.1f %12.1f\n", n, rounds,
+         split / rounds * 1e9, move / rounds * 1e9);
+  splay_free(s);
+  splay_free(t);
+  free(keys);
+}
+
+/* Keys 0 .. n-1, put shuffled; ranks and selects of random keys, and
+   counts of ranges a hundredth of the keys wide. */
+static void _bench_rank(size_t n, size_t calls)
+{
+  int *keys = malloc(n * sizeof(int));
+  int lo, hi;
+  uint64_t r = 88172645463325252ULL, sum = 0;
+  splay *s = splay_create(_int_cmp, NULL);
+  double t, rank, sel, cnt;
+  size_t j;
+  int tmp;
+
+  for (size_t i = 0; i < n; i++) keys[i] = (int)i;
+  for (size_t i = n - 1; i > 0; i--) {
+    j = (size_t)(_next(&r) % (i + 1));
+    tmp = keys[i]; keys[i] = keys[j]; keys[j] = tmp;
+  }
+  for (size_t i = 0; i < n; i++) splay_put(s, &keys[i], &keys[i]);
+  t = bench_now();
+  for (size_t i = 0; i < calls; i++) {
+    lo = (int)(_next(&r) % n);
+    sum += splay_rank(s, &lo);
+  }
+  rank = bench_now() - t;
+  t = bench_now();
+  for (size_t i = 0; i < calls; i++) {
+    sum += (uint64_t)*(int*)splay_select(s, (uint32_t)(_next(&r) % n), NULL);
+  }
+  sel = bench_now() - t;
+  t = bench_now();
+  for (size_t i = 0; i < calls; i++) {
+    lo = (int)(_next(&r) % n);
+    hi = lo + (int)(n / 100);
+    sum += splay_count_range(s, &lo, &hi);
+  }
+  cnt = bench_now() - t;
+  bench_sink = (void*)(uintptr_t)sum;
+  printf("  %10zu %10zu %9.1f %9.1f %9.1f\n", n, calls,
+         rank / calls * 1e9, sel / calls * 1e9, cnt / calls * 1e9);
+  splay_free(s);
+  free(keys);
+}
+
+void bench_splay_tree(void)
+{
+  printf("splay-tree: int keys by insert order; gets in order, 7/8 on 64 "
+         "keys, uniform (ns/op)\n");
+  printf("  %-8s %10s %9s %9s %9s %9s %9s\n", "insert", "keys", "put",
+         "get seq", "get skew", "get unif", "remove");
+  _bench_order(100000, true);
+  _bench_order(100000, false);
+  _bench_order(10000000, true);
+  _bench_order(10000000, false);
+
+  printf("splay-tree: range scans from random keys\n");
+  printf("  %10s %6s %10s %10s %12s\n", "keys", "width", "ns/scan",
+         "ns/entry", "ms/full iter");
+  _bench_range(1000000, 1, 1000000);
+  _bench_range(1000000, 10, 1000000);
+  _bench_range(1000000, 100, 100000);
+  _bench_range(1000000, 10000, 1000);
+
+  printf("splay-tree: loading sorted keys (ns/key), then uniform gets "
+         "(ns/get)\n");
+  printf("  %10s %9s %9s %9s %9s %9s\n", "keys", "put", "get", "build",
+         "get", "merge ns");
+  _bench_build(100000);
+  _bench_build(10000000);
+
+  printf("splay-tree: split and join (ns/round)\n");
+  printf("  %10s %10s %12s %12s\n", "keys", "rounds", "split+join",
+         "range move");
+#ifdef SPLAY_ORDER_STATS
+  _bench_split(100000, 100000);
+  _bench_split(1000000, 100000);
+#else
+  /* Each split counts the smaller half: fewer rounds. */
+  _bench_split(100000, 1000);
+  _bench_split(1000000, 1000);
+#endif
+
+#ifdef SPLAY_ORDER_STATS
+  printf("splay-tree: order statistics, subtree sizes (ns/call)\n");
+#else
+  printf("splay-tree: order statistics, walked (ns/call)\n");
+#endif
+  printf("  %10s %10s %9s %9s %9s\n", "keys", "calls", "rank", "select",
+         "count");
+  _bench_rank(100000, 1000);
+  _bench_rank(1000000, 100);
+#ifdef SPLAY_ORDER_STATS
+  _bench_rank(1000000, 1000000);
+#endif
+}
@@ -0,0 +1,98 @@
+/* ------------------------------------------------------------------------- *\
+   benchmarks for typed hash map
+     - a uint64_t -> uint64_t instantiation against hmap64, whose items
+       are void*, and against hmap over the same keys as 8 byte keys
+       with boxed values.
+   -------------------------------------------------------------------------
+   LICENSE: This program is free software. You can modify it and/or re-
+   distribute it under the terms of the Apache 2.0 License. You should have
+   received a copy of the Apache 2.0 License along with this program. If
+   not, please see: http://www.apache.org/licenses/LICENSE-2.0.txt
+
+   DISCLAIMER: This program is distributed in the hope that it will be
+   useful, but without any warrantee; without even the implied warantee
+   of fitness for any particular purpose. See the License for more details.
+\* ------------------------------------------------------------------------- */
+#include <stdbool.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "typed-hash-map.h"
+#include "int-hash-map.h"
+#include "b-ocic.h"
+
+#define _U64_EQ(a, b) ((a) == (b))
+OC_HMAP_DEFINE(bench_u64map, uint64_t, uint64_t, oc_hash_u64, _U64_EQ)
+
+/* helper declarations */
+static void _bench_u64(size_t n);
+
+static void _bench_u64(size_t n)
+{
+  uint64_t *ids = malloc(n * sizeof(uint64_t));
+  uint64_t *seek = malloc(n * sizeof(uint64_t));
+  uint64_t *boxed = malloc(n * sizeof(uint64_t));
+  uint64_t r = 88172645463325252ULL, sum;
+  double t, put[3], hit[3];
+  bench_u64map *tm = bench_u64map_create();
+  hmap64 *h64 = hmap64_create(NULL);
+  hmap *h = hmap_create(NULL);
+  uint64_t *v;
+
+  for (size_t i = 0; i < n; i++) {
+    r ^= r << 13; r ^= r >> 7; r ^= r << 17;   /* xorshift */
+    ids[i] = r;
+    boxed[i] = i;
+  }
+  for (size_t i = 0; i < n; i++) {
+    r ^= r << 13; r ^= r >> 7; r ^= r << 17;
+    seek[i] = ids[r % n];
+  }
+
+  t = bench_now();
+  for (size_t i = 0; i < n; i++) bench_u64map_put(tm, ids[i], i);
+  put[0] = bench_now() - t;
+  t = bench_now();
+  for (size_t i = 0; i < n; i++) hmap64_put(h64, ids[i], &boxed[i]);
+  put[1] = bench_now() - t;
+  t = bench_now();
+  for (size_t i = 0; i < n; i++) hmap_put_n(h, &ids[i], 8, &boxed[i]);
+  put[2] = bench_now() - t;
+
+  sum = 0;
+  t = bench_now();
+  for (size_t i = 0; i < n; i++) {
+    v = bench_u64map_get(tm, seek[i]);
+    sum += *v;
+  }
+  hit[0] = bench_now() - t;
+  t = bench_now();
+  for (size_t i = 0; i < n; i++) sum += *(uint64_t*)hmap64_get(h64, seek[i]);
+  hit[1] = bench_now() - t;
+  t = bench_now();
+  for (size_t i = 0; i < n; i++) sum += *(uint64_t*)hmap_get_n(h, &seek[i], 8);
+  hit[2] = bench_now() - t;
+  bench_sink = (void*)(uintptr_t)sum;
+
+  printf("typed-hash-map: %zu random u64 keys -> u64, random order (ns/op)\n",
+         n);
+  printf("  %-16s %9s %9s\n", "", "put", "get-hit");
+  printf("  %-16s %9.1f %9.1f\n", "typed", put[0] / n * 1e9, hit[0] / n * 1e9);
+  printf("  %-16s %9.1f %9.1f\n", "hmap64, boxed", put[1] / n * 1e9,
+         hit[1] / n * 1e9);
+  printf("  %-16s %9.1f %9.1f\n", "hmap, boxed", put[2] / n * 1e9,
+         hit[2] / n * 1e9);
+  bench_u64map_free(tm);
+  hmap64_free(h64);
+  hmap_free(h);
+  free(ids);
+  free(seek);
+  free(boxed);
+}
+
+void bench_typed_hash_map(void)
+{
+  _bench_u64(100000);
+  _bench_u64(4000000);
+}
@@ -0,0 +1,87 @@
+/* ------------------------------------------------------------------------- *\
+   benchmarks for typed splay tree
+     - an int -> int instantiation against splay over boxed ints and a
+       comparator called through its pointer.
+   -------------------------------------------------------------------------
+   LICENSE: This program is free software. You can modify it and/or re-
+   distribute it under the terms of the Apache 2.0 License. You should have
+   received a copy of the Apache 2.0 License along with this program. If
+   not, please see: http://www.apache.org/licenses/LICENSE-2.0.txt
+
+   DISCLAIMER: This program is distributed in the hope that it will be
+   useful, but without any warrantee; without even the implied warantee
+   of fitness for any particular purpose. See the License for more details.
+\* ------------------------------------------------------------------------- */
+#include <stdbool.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "typed-splay-tree.h"
+#include "splay-tree.h"
+#include "b-ocic.h"
+
+#define _INT_CMP(a, b) (((a) > (b)) - ((a) < (b)))
+OC_SPLAY_DEFINE(bench_itree, int, int, _INT_CMP)
+
+/* helper declarations */
+static int  _box_cmp(void*, void*);
+static void _bench_ints(size_t n);
+
+static int _box_cmp(void *a, void *b)
+{
+  int x = *(int*)a, y = *(int*)b;
+  return (x > y) - (x < y);
+}
+
+/* Random keys, then lookups skewed to a few hot ones, as splay suits. */
+static void _bench_ints(size_t n)
+{
+  int *keys = malloc(n * sizeof(int));
+  int *seek = malloc(n * sizeof(int));
+  uint64_t r = 88172645463325252ULL, sum = 0;
+  double t, put[2], get[2];
+  bench_itree *tt = bench_itree_create();
+  splay *s = splay_create(_box_cmp, NULL);
+
+  for (size_t i = 0; i < n; i++) {
+    r ^= r << 13; r ^= r >> 7; r ^= r << 17;   /* xorshift */
+    keys[i] = (int)(r >> 33);
+  }
+  for (size_t i = 0; i < n; i++) {
+    r ^= r << 13; r ^= r >> 7; r ^= r << 17;
+    seek[i] = keys[(r % 8 == 0) ? r % n : r % 64];
+  }
+
+  t = bench_now();
+  for (size_t i = 0; i < n; i++) bench_itree_put(tt, keys[i], keys[i]);
+  put[0] = bench_now() - t;
+  t = bench_now();
+  for (size_t i = 0; i < n; i++) splay_put(s, &keys[i], &keys[i]);
+  put[1] = bench_now() - t;
+
+  t = bench_now();
+  for (size_t i = 0; i < n; i++) sum += (uint64_t)*bench_itree_get(tt, seek[i]);
+  get[0] = bench_now() - t;
+  t = bench_now();
+  for (size_t i = 0; i < n; i++) sum += (uint64_t)*(int*)splay_get(s, &seek[i]);
+  get[1] = bench_now() - t;
+  bench_sink = (void*)(uintptr_t)sum;
+
+  printf("typed-splay-tree: %zu random int keys, 7/8 of gets on 64 (ns/op)\n",
+         n);
+  printf("  %-16s %9s %9s\n", "", "put", "get");
+  printf("  %-16s %9.1f %9.1f\n", "typed", put[0] / n * 1e9, get[0] / n * 1e9);
+  printf("  %-16s %9.1f %9.1f\n", "splay, boxed", put[1] / n * 1e9,
+         get[1] / n * 1e9);
+  bench_itree_free(tt);
+  splay_free(s);
+  free(keys);
+  free(seek);
+}
+
+void bench_typed_splay_tree(void)
+{
+  _bench_ints(100000);
+  _bench_ints(1000000);
+}
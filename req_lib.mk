@@ -1,2 +1,4 @@
-
 DEV_ENV_LIB := 
+
+# concurrent-hash-map uses pthreads.
+STD_LIBS := -lpthread
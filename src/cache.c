@@ -0,0 +1,312 @@
+/* ------------------------------------------------------------------------- *\
+   Cache
+     - An hmap from key to entry, and every entry on one ring, linked
+       through the entries themselves: the list costs no allocation of
+       its own, and an entry found in the map is moved or unlinked in
+       place.
+     - LRU keeps the ring in recency order, newest just after the
+       sentinel, and evicts from just before it.
+     - CLOCK keeps the ring in insertion order, with a hand. A new entry
+       goes in just behind the hand, the last place it reaches. To evict,
+       the hand clears the reference bits of the entries it passes and
+       stops at the first entry whose bit was already clear.
+     - Each entry keeps its key's hash, so an eviction does not hash the
+       key again; the map is driven through hmap's _hashed calls with
+       that hash, which keep its counters and filter.
+     - inline_keys copies each key into its entry's own allocation, and
+       keys the map on that copy; the map itself never copies, so the
+       key it holds is always the entry's.
+   -------------------------------------------------------------------------
+   LICENSE: This program is free software. You can modify it and/or re-
+   distribute it under the terms of the Apache 2.0 License. You should have
+   received a copy of the Apache 2.0 License along with this program. If
+   not, please see: http://www.apache.org/licenses/LICENSE-2.0.txt
+
+   DISCLAIMER: This program is distributed in the hope that it will be
+   useful, but without any warrantee; without even the implied warantee
+   of fitness for any particular purpose. See the License for more details.
+\* ------------------------------------------------------------------------- */
+
+#include <stdlib.h>
+#include <string.h>
+#include "cache.h"
+
+/* Default numbers */
+#define DEFAULT_ENTRIES 1024
+
+typedef struct cache_entry {
+  struct cache_entry *prev;
+  struct cache_entry *next;
+  void    *key;
+  void    *item;
+  uint64_t hash;
+  size_t   bytes;
+  uint32_t len;
+  uint8_t  ref;      /* CLOCK: used since the hand last passed. */
+  char     inline_key[];
+} cache_entry;
+
+struct oc_cache {
+  hmap           *map;
+  cache_entry     ring;      /* sentinel: ring.next is the first entry. */
+  cache_entry    *hand;      /* CLOCK: the next entry to look at. */
+  oc_cache_policy policy;
+  uint32_t        max_entries;
+  size_t          max_bytes;
+  size_t          bytes;
+  uint64_t        hits;
+  uint64_t        misses;
+  uint64_t        evictions;
+  map_destructor  rel;
+  bool            inline_keys;
+};
+
+/* Private declarations. */
+static inline void _link_after(cache_entry *at, cache_entry *e);
+static inline void _unlink(oc_cache*, cache_entry *e);
+static void _insert(oc_cache*, cache_entry *e);
+static void _evict(oc_cache*, cache_entry *keep);
+static cache_entry *_victim(oc_cache*, cache_entry *keep);
+static void _drop(oc_cache*, cache_entry *e);
+static inline bool _over(const oc_cache*);
+
+oc_cache*
+oc_cache_create(map_destructor release, const oc_cache_opts *opts)
+{
+  oc_cache *c = malloc(sizeof(oc_cache));
+  hmap_opts mo;
+
+  memset(c, 0, sizeof(oc_cache));
+  if (opts) {
+    c->policy      = opts->policy;
+    c->max_entries = opts->max_entries;
+    c->max_bytes   = opts->max_bytes;
+    mo = opts->map;
+  } else {
+    memset(&mo, 0, sizeof(mo));
+  }
+  if (!c->max_entries && !c->max_bytes) c->max_entries = DEFAULT_ENTRIES;
+  if (!mo.capacity) mo.capacity = c->max_entries;
+  c->inline_keys = mo.inline_keys;
+  mo.inline_keys = false;
+  c->map  = hmap_create_opts(NULL, &mo);
+  c->ring.prev = c->ring.next = &c->ring;
+  c->hand = &c->ring;
+  c->rel  = release;
+  return c;
+}
+
+void
+oc_cache_free(oc_cache *c)
+{
+  cache_entry *e, *next;
+  for (e = c->ring.next; e != &c->ring; e = next) {
+    next = e->next;
+    if (c->rel) c->rel(e->key, e->item);
+    free(e);
+  }
+  hmap_free(c->map);
+  free(c);
+}
+
+void
+oc_cache_put(oc_cache *c, char* key, void *val, size_t bytes)
+{
+  oc_cache_put_n(c, key, strlen(key), val, bytes);
+}
+
+void*
+oc_cache_get(oc_cache *c, const char* key)
+{
+  return oc_cache_get_n(c, key, strlen(key));
+}
+
+void
+oc_cache_remove(oc_cache *c, const char* key)
+{
+  oc_cache_remove_n(c, key, strlen(key));
+}
+
+/*
+ * One probe, through slot, new key or held. A held key's entry keeps its
+ * place, counts as used, and keeps the key the map holds: the caller's
+ * key, if another pointer, goes to the destructor with the old item, if
+ * that is another, so each is released once. With inline keys, the map
+ * must be keyed on the entry's copy, made only once the entry exists: a
+ * get, then a put for a new key, and a replaced key keeps the copy it
+ * has, which the destructor is passed for the call only.
+ */
+void
+oc_cache_put_n(oc_cache *c, const void *key, size_t len, void *val,
+               size_t bytes)
+{
+  hmap *m = c->map;
+  uint64_t hash = hmap_hash_n(m, key, len);
+  void *k = (void*)(uintptr_t)key;
+  cache_entry *e;
+  void **slot = NULL;
+  bool created;
+
+  if (len > HMAP_MAX_KEY_LEN) return;
+  if (c->inline_keys) {
+    e = hmap_get_hashed_n(m, hash, key, len);
+  } else {
+    slot = hmap_slot_hashed_n(m, hash, key, len, &created);
+    e = created ? NULL : *slot;
+  }
+  if (e) {
+    if (c->rel) {
+      void *gone_key  = c->inline_keys ? e->key : k != e->key ? k : NULL;
+      void *gone_item = e->item != val ? e->item : NULL;
+      if (gone_key || gone_item) c->rel(gone_key, gone_item);
+    }
+    c->bytes -= e->bytes;
+    if (c->policy == OC_CACHE_LRU) {
+      _unlink(c, e);
+      _link_after(&c->ring, e);
+    } else {
+      e->ref = 1;
+    }
+  } else {
+    e = malloc(sizeof(cache_entry) + (c->inline_keys ? len + 1 : 0));
+    e->hash = hash;
+    e->len  = (uint32_t)len;
+    e->ref  = 0;
+    if (c->inline_keys) {
+      memcpy(e->inline_key, key, len);
+      e->inline_key[len] = '\0';
+      e->key = e->inline_key;
+      hmap_put_hashed_n(m, hash, e->key, len, e);
+    } else {
+      e->key = k;
+      *slot = e;
+    }
+    _insert(c, e);
+  }
+  e->item  = val;
+  e->bytes = bytes;
+  c->bytes += bytes;
+  _evict(c, e);
+}
+
+void*
+oc_cache_get_n(oc_cache *c, const void *key, size_t len)
+{
+  hmap *m = c->map;
+  cache_entry *e = hmap_get_n(m, key, len);
+
+  if (!e) {
+    c->misses++;
+    return NULL;
+  }
+  c->hits++;
+  if (c->policy == OC_CACHE_CLOCK) {
+    if (!e->ref) e->ref = 1;
+  } else if (c->ring.next != e) {
+    _unlink(c, e);
+    _link_after(&c->ring, e);
+  }
+  return e->item;
+}
+
+void
+oc_cache_remove_n(oc_cache *c, const void *key, size_t len)
+{
+  hmap *m = c->map;
+  cache_entry *e = hmap_get_n(m, key, len);
+  if (e) _drop(c, e);
+}
+
+uint32_t
+oc_cache_count(oc_cache *c)
+{
+  return hmap_count(c->map);
+}
+
+void
+oc_cache_get_stats(oc_cache *c, oc_cache_stats *s)
+{
+  s->hits      = c->hits;
+  s->misses    = c->misses;
+  s->evictions = c->evictions;
+  s->count     = hmap_count(c->map);
+  s->bytes     = c->bytes;
+}
+
+/* ------------------------------------------------------------------------- *\
+   private functions.
+\* ------------------------------------------------------------------------- */
+
+static inline void
+_link_after(cache_entry *at, cache_entry *e)
+{
+  e->prev = at;
+  e->next = at->next;
+  at->next->prev = e;
+  at->next = e;
+}
+
+/* The hand never rests on an entry that is gone. */
+static inline void
+_unlink(oc_cache *c, cache_entry *e)
+{
+  if (c->hand == e) c->hand = e->next;
+  e->prev->next = e->next;
+  e->next->prev = e->prev;
+}
+
+/* LRU: at the front. CLOCK: just behind the hand. */
+static void
+_insert(oc_cache *c, cache_entry *e)
+{
+  if (c->policy == OC_CACHE_LRU) {
+    _link_after(&c->ring, e);
+  } else {
+    _link_after(c->hand->prev, e);
+  }
+}
+
+static inline bool
+_over(const oc_cache *c)
+{
+  return (c->max_entries && hmap_count(c->map) > c->max_entries) ||
+         (c->max_bytes && c->bytes > c->max_bytes);
+}
+
+/* Down to budget, keep going last: it is the entry just put. */
+static void
+_evict(oc_cache *c, cache_entry *keep)
+{
+  while (_over(c)) {
+    _drop(c, hmap_count(c->map) == 1 ? keep : _victim(c, keep));
+    c->evictions++;
+  }
+}
+
+/* LRU: the last entry, which keep, at the front, is not. CLOCK: a sweep
+   of the hand, passing the sentinel and keep without stopping; with one
+   other entry or more, it stops within two laps. */
+static cache_entry *
+_victim(oc_cache *c, cache_entry *keep)
+{
+  cache_entry *e;
+  if (c->policy == OC_CACHE_LRU) return c->ring.prev;
+  for (e = c->hand; ; e = e->next) {
+    if (e == &c->ring || e == keep) continue;
+    if (!e->ref) break;
+    e->ref = 0;
+  }
+  c->hand = e;
+  return e;
+}
+
+static void
+_drop(oc_cache *c, cache_entry *e)
+{
+  hmap *m = c->map;
+  hmap_remove_hashed_n(m, e->hash, e->key, e->len);
+  _unlink(c, e);
+  c->bytes -= e->bytes;
+  if (c->rel) c->rel(e->key, e->item);
+  free(e);
+}
@@ -0,0 +1,98 @@
+#ifndef _CACHE_H
+#define _CACHE_H
+/* ------------------------------------------------------------------------- *\
+   Cache
+     - A bounded map: an hmap of entries, kept to a budget of entries, of
+       bytes, or both, by evicting the entry least worth keeping.
+     - Prefix: oc_cache
+     - Policies:
+         OC_CACHE_LRU   - evicts the least recently used entry. Each hit
+                          moves its entry to the front of the recency
+                          list: two pointer writes to its neighbours.
+         OC_CACHE_CLOCK - evicts an entry not used since the clock hand
+                          last passed it. A hit only sets the entry's
+                          reference bit, and leaves the list alone, so
+                          hits write nothing shared but that byte.
+     - Bytes are whatever the caller says each item costs, passed to put.
+     - The cache owns what it holds, as a map with a destructor does: an
+       evicted, removed or replaced entry's key and item go to the
+       destructor. Keys are kept by pointer, as hmap keeps them, unless
+       the map options ask for inline_keys: the cache then copies each
+       key into its entry, so callers may reuse key buffers, and the
+       destructor is passed that copy, for the call only, to release the
+       item alone.
+     - get allocates nothing, hit or miss; put allocates one entry for a
+       new key.
+     - Not thread safe.
+   -------------------------------------------------------------------------
+   LICENSE: This program is free software. You can modify it and/or re-
+   distribute it under the terms of the Apache 2.0 License. You should have
+   received a copy of the Apache 2.0 License along with this program. If
+   not, please see: http://www.apache.org/licenses/LICENSE-2.0.txt
+
+   DISCLAIMER: This program is distributed in the hope that it will be
+   useful, but without any warrantee; without even the implied warantee
+   of fitness for any particular purpose. See the License for more details.
+\* ------------------------------------------------------------------------- */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "hash-map.h"
+
+typedef struct oc_cache oc_cache;
+
+typedef enum oc_cache_policy {
+  OC_CACHE_LRU = 0,
+  OC_CACHE_CLOCK
+} oc_cache_policy;
+
+/* create options; a zeroed struct gives an LRU cache of 1024 entries:
+ *   policy      - OC_CACHE_LRU or OC_CACHE_CLOCK.
+ *   max_entries - most entries held; 0 for no limit on entries.
+ *   max_bytes   - most bytes held, summed over the bytes passed to put;
+ *                 0 for no limit on bytes. With both limits 0, the cache
+ *                 holds 1024 entries.
+ *   map         - options for the hmap behind the cache; its capacity
+ *                 defaults to max_entries.
+ */
+typedef struct oc_cache_opts {
+  oc_cache_policy policy;
+  uint32_t        max_entries;
+  size_t          max_bytes;
+  hmap_opts       map;
+} oc_cache_opts;
+
+typedef struct oc_cache_stats {
+  uint64_t hits;
+  uint64_t misses;
+  uint64_t evictions;   /* entries dropped for room; removes not counted. */
+  uint32_t count;
+  size_t   bytes;
+} oc_cache_stats;
+
+oc_cache* oc_cache_create(map_destructor, const oc_cache_opts*);
+void      oc_cache_free(oc_cache*);
+
+/* put: bytes is what the item counts against max_bytes. Putting a key
+ * already held replaces its item, and keeps the key the cache holds:
+ * the destructor is passed the key put, if another pointer, and the old
+ * item, if another, and NULL for either that is not, so each is released
+ * once; it is not called if both are the same. Puts
+ * evict as needed, the new entry last of all: an item over the whole
+ * byte budget is released at once. */
+void      oc_cache_put(oc_cache*, char* key, void *val, size_t bytes);
+void*     oc_cache_get(oc_cache*, const char* key);
+void      oc_cache_remove(oc_cache*, const char* key);
+uint32_t  oc_cache_count(oc_cache*);
+
+/* byte keys: len bytes at key, as for hmap_put_n; a put of a key over
+ * HMAP_MAX_KEY_LEN bytes does nothing. */
+void      oc_cache_put_n(oc_cache*, const void *key, size_t len, void *val,
+                         size_t bytes);
+void*     oc_cache_get_n(oc_cache*, const void *key, size_t len);
+void      oc_cache_remove_n(oc_cache*, const void *key, size_t len);
+
+void      oc_cache_get_stats(oc_cache*, oc_cache_stats*);
+
+#endif
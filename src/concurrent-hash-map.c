@@ -0,0 +1,407 @@
+/* ------------------------------------------------------------------------- *\
+   Concurrent Hash Map
+     - A chained table whose bucket heads and next links are only ever
+       changed with atomic release stores, so a reader walking a chain
+       always sees a whole chain, old or new.
+     - Writers lock one of STRIPES mutexes, picked by the low bits of the
+       hash. Tables are powers of two no smaller than STRIPES, so a key's
+       bucket maps to the same stripe at every size.
+     - Nodes are never changed once readers can reach them: put on an
+       existing key links in a new node in place of the old one.
+     - Growing takes every stripe, copies the nodes into a new table of
+       twice the size, and publishes it with one pointer store; readers
+       still in the old table finish there.
+     - Reclamation: unlinked nodes and old tables go on a retire list,
+       freed in batches once a grace period has passed. get counts itself
+       in and out on one of two reader counters, picked by the low bit of
+       an epoch; a grace period flips the epoch and waits for the counter
+       it left to drain, twice, so that every get that began before the
+       flips has finished. Counters are spread over READER_SLOTS cache
+       lines, picked by stack address, to keep readers on different
+       threads off each other's lines.
+   -------------------------------------------------------------------------
+   LICENSE: This program is free software. You can modify it and/or re-
+   distribute it under the terms of the Apache 2.0 License. You should have
+   received a copy of the Apache 2.0 License along with this program. If
+   not, please see: http://www.apache.org/licenses/LICENSE-2.0.txt
+
+   DISCLAIMER: This program is distributed in the hope that it will be
+   useful, but without any warrantee; without even the implied warantee
+   of fitness for any particular purpose. See the License for more details.
+\* ------------------------------------------------------------------------- */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+#include "concurrent-hash-map.h"
+#include "hash-map.h"
+
+/* Writer locks; a power of two, no larger than the initial table. */
+#define STRIPES      64
+/* Reader counter pairs; a power of two. */
+#define READER_SLOTS 32
+/* Retired nodes collected before paying for a grace period. */
+#define RETIRE_BATCH 256
+/* Grow once there are more items than buckets. */
+#define MAX_LOAD     1
+#define CACHE_LINE   64
+
+#define LOAD(p)     __atomic_load_n((p), __ATOMIC_ACQUIRE)
+#define STORE(p, v) __atomic_store_n((p), (v), __ATOMIC_RELEASE)
+
+typedef struct cnode {
+  uint64_t hash;
+  uint32_t len;
+  bool     release;          /* on reclaim, hand key and item to rel. */
+  void    *key;
+  void    *item;
+  struct cnode *next;
+  struct cnode *retired;
+} cnode;
+
+typedef struct ctable {
+  uint32_t size;
+  cnode   *buckets[];
+} ctable;
+
+typedef union stripe {
+  pthread_mutex_t lock;
+  char pad[CACHE_LINE];
+} stripe;
+
+struct chmap {
+  ctable         *table;
+  uint64_t        seed;
+  uint32_t        item_count;
+  map_destructor  rel;
+  stripe          locks[STRIPES];
+  pthread_mutex_t retire_lock;   /* guards the retire list. */
+  pthread_mutex_t sync_lock;     /* one grace period at a time. */
+  cnode          *retired_nodes;
+  uint32_t        retired_count;
+  uint32_t        epoch;         /* low bit: the counter gets join. */
+  uint64_t        readers[READER_SLOTS][CACHE_LINE / sizeof(uint64_t)];
+};
+
+/* Private declarations. */
+static ctable  *_table(uint32_t size);
+static cnode  **_find(ctable*, uint64_t, const void*, size_t);
+static void     _grow(chmap*, uint32_t size);
+static void     _retire(chmap*, cnode*);
+static void     _reclaim(chmap*, cnode*, ctable*);
+static void     _synchronize(chmap*);
+static void     _free_nodes(cnode*, map_destructor);
+static inline uint64_t *_read_lock(chmap*);
+static inline void      _read_unlock(uint64_t*);
+static inline bool _key_match(const cnode*, uint64_t, const void*, size_t);
+
+/* Default numbers */
+#define DEFAULT_SIZE 1024
+
+chmap*
+chmap_create(map_destructor release)
+{
+  chmap *c = malloc(sizeof(chmap));
+  memset(c, 0, sizeof(chmap));
+  c->table = _table(DEFAULT_SIZE);
+  c->seed  = hmap_random_seed();
+  c->rel   = release;
+  for (int i = 0; i < STRIPES; i++) pthread_mutex_init(&c->locks[i].lock, NULL);
+  pthread_mutex_init(&c->retire_lock, NULL);
+  pthread_mutex_init(&c->sync_lock, NULL);
+  return c;
+}
+
+void
+chmap_free(chmap *c)
+{
+  for (uint32_t i = 0; i < c->table->size; i++) {
+    _free_nodes(c->table->buckets[i], c->rel);
+  }
+  free(c->table);
+  /* No gets are left running, so the retired need no grace period. */
+  _reclaim(c, c->retired_nodes, NULL);
+  for (int i = 0; i < STRIPES; i++) pthread_mutex_destroy(&c->locks[i].lock);
+  pthread_mutex_destroy(&c->retire_lock);
+  pthread_mutex_destroy(&c->sync_lock);
+  free(c);
+}
+
+void
+chmap_put(chmap *c, char* key, void *val)
+{
+  chmap_put_n(c, key, strlen(key), val);
+}
+
+void*
+chmap_get(chmap *c, char* key)
+{
+  return chmap_get_n(c, key, strlen(key));
+}
+
+void
+chmap_remove(chmap *c, char* key)
+{
+  chmap_remove_n(c, key, strlen(key));
+}
+
+uint32_t
+chmap_count(chmap *c)
+{
+  return __atomic_load_n(&c->item_count, __ATOMIC_RELAXED);
+}
+
+void
+chmap_put_n(chmap *c, const void *key, size_t len, void *val)
+{
+  uint64_t hash = hmap_hash_wy(key, len, c->seed);
+  pthread_mutex_t *lock = &c->locks[hash & (STRIPES - 1)].lock;
+  cnode *n = malloc(sizeof(cnode));
+  cnode **link, *old;
+  ctable *t;
+  uint32_t items = 0, size;
+
+  n->hash    = hash;
+  n->len     = (uint32_t)len;
+  n->release = true;
+  n->key     = (void*)(uintptr_t)key;
+  n->item    = val;
+  n->retired = NULL;
+
+  pthread_mutex_lock(lock);
+  t = c->table;  /* stable: _grow holds every stripe. */
+  size = t->size;
+  link = _find(t, hash, key, len);
+  if (link) {
+    old = *link;
+    n->next = old->next;
+    STORE(link, n);
+  } else {
+    old = NULL;
+    link = &t->buckets[hash & (t->size - 1)];
+    n->next = *link;
+    STORE(link, n);
+    items = __atomic_add_fetch(&c->item_count, 1, __ATOMIC_RELAXED);
+  }
+  pthread_mutex_unlock(lock);
+
+  if (old) {
+    _retire(c, old);
+  } else if (items > size * MAX_LOAD) {
+    _grow(c, size);
+  }
+}
+
+void*
+chmap_get_n(chmap *c, const void *key, size_t len)
+{
+  uint64_t hash = hmap_hash_wy(key, len, c->seed);
+  uint64_t *ctr = _read_lock(c);
+  ctable *t = LOAD(&c->table);
+  void *item = NULL;
+
+  for (cnode *n = LOAD(&t->buckets[hash & (t->size - 1)]); n;
+       n = LOAD(&n->next)) {
+    if (_key_match(n, hash, key, len)) {
+      item = n->item;
+      break;
+    }
+  }
+  _read_unlock(ctr);
+  return item;
+}
+
+void
+chmap_remove_n(chmap *c, const void *key, size_t len)
+{
+  uint64_t hash = hmap_hash_wy(key, len, c->seed);
+  pthread_mutex_t *lock = &c->locks[hash & (STRIPES - 1)].lock;
+  cnode **link, *old = NULL;
+
+  pthread_mutex_lock(lock);
+  link = _find(c->table, hash, key, len);
+  if (link) {
+    old = *link;
+    STORE(link, old->next);
+    __atomic_sub_fetch(&c->item_count, 1, __ATOMIC_RELAXED);
+  }
+  pthread_mutex_unlock(lock);
+
+  if (old) {
+    old->release = false;
+    _retire(c, old);
+  }
+}
+
+/* ------------------------------------------------------------------------- *\
+   private functions.
+\* ------------------------------------------------------------------------- */
+
+static inline bool
+_key_match(const cnode *n, uint64_t hash, const void *key, size_t len)
+{
+  return n->hash == hash && n->len == len && memcmp(n->key, key, len) == 0;
+}
+
+static ctable *
+_table(uint32_t size)
+{
+  ctable *t = calloc(1, sizeof(ctable) + sizeof(cnode*) * size);
+  t->size = size;
+  return t;
+}
+
+/* Writers only, under the key's stripe: the link to key's node, or NULL. */
+static cnode **
+_find(ctable *t, uint64_t hash, const void *key, size_t len)
+{
+  cnode **link = &t->buckets[hash & (t->size - 1)];
+  for (; *link; link = &(*link)->next) {
+    if (_key_match(*link, hash, key, len)) return link;
+  }
+  return NULL;
+}
+
+/*
+ * Double the table put found overfull, unless another writer got there
+ * first. put passes only the size: once its stripe is let go, the table
+ * it saw may already be retired. Readers may be walking the old chains,
+ * so nodes are copied rather than relinked; the originals retire without
+ * release, since their copies now own the keys and items.
+ */
+static void
+_grow(chmap *c, uint32_t size)
+{
+  ctable *t, *nt;
+  cnode *n, *copy, *old_nodes = NULL;
+  uint32_t i, idx;
+
+  for (i = 0; i < STRIPES; i++) pthread_mutex_lock(&c->locks[i].lock);
+  t = c->table;
+  if (t->size != size) {
+    for (i = STRIPES; i-- > 0; ) pthread_mutex_unlock(&c->locks[i].lock);
+    return;
+  }
+  nt = _table(t->size * 2);
+  for (i = 0; i < t->size; i++) {
+    for (n = t->buckets[i]; n; n = n->next) {
+      copy = malloc(sizeof(cnode));
+      *copy = *n;
+      idx = n->hash & (nt->size - 1);
+      copy->next = nt->buckets[idx];
+      nt->buckets[idx] = copy;
+      n->release = false;
+      n->retired = old_nodes;
+      old_nodes = n;
+    }
+  }
+  STORE(&c->table, nt);
+  for (i = STRIPES; i-- > 0; ) pthread_mutex_unlock(&c->locks[i].lock);
+
+  /* Not batched: a whole table's worth of nodes is too much to let sit. */
+  _synchronize(c);
+  _reclaim(c, old_nodes, t);
+}
+
+/* Queue an unlinked node for freeing; the caller that fills a batch of
+   RETIRE_BATCH takes it and waits out the grace period. */
+static void
+_retire(chmap *c, cnode *n)
+{
+  cnode *batch = NULL;
+
+  pthread_mutex_lock(&c->retire_lock);
+  n->retired = c->retired_nodes;
+  c->retired_nodes = n;
+  if (++c->retired_count >= RETIRE_BATCH) {
+    batch = c->retired_nodes;
+    c->retired_nodes = NULL;
+    c->retired_count = 0;
+  }
+  pthread_mutex_unlock(&c->retire_lock);
+
+  if (batch) {
+    _synchronize(c);
+    _reclaim(c, batch, NULL);
+  }
+}
+
+/*
+ * Wait until every get that began before the call has finished. A get
+ * joins the counter of the epoch it read, but may read it just before a
+ * flip and join just after; draining one counter per flip, twice, waits
+ * out both, while gets that begin mid-wait join the other counter and
+ * can't hold the wait up.
+ */
+static void
+_synchronize(chmap *c)
+{
+  uint32_t drain;
+
+  pthread_mutex_lock(&c->sync_lock);
+  /* Order the caller's unlinking stores before the counter loads. */
+  __atomic_thread_fence(__ATOMIC_SEQ_CST);
+  for (int flip = 0; flip < 2; flip++) {
+    drain = __atomic_fetch_add(&c->epoch, 1, __ATOMIC_SEQ_CST) & 1;
+    for (uint32_t i = 0; i < READER_SLOTS; i++) {
+      while (__atomic_load_n(&c->readers[i][drain], __ATOMIC_ACQUIRE)) {
+        sched_yield();
+      }
+    }
+  }
+  pthread_mutex_unlock(&c->sync_lock);
+}
+
+/* Free retired nodes, and a retired table if any; no get may still
+   reach them. */
+static void
+_reclaim(chmap *c, cnode *n, ctable *t)
+{
+  cnode *next;
+
+  for (; n; n = next) {
+    next = n->retired;
+    if (n->release && c->rel) c->rel(n->key, n->item);
+    free(n);
+  }
+  free(t);
+}
+
+/* Iterative: a long chain must not cost a deep stack. */
+static void
+_free_nodes(cnode *n, map_destructor r)
+{
+  cnode *next;
+  while (n) {
+    next = n->next;
+    if (r) r(n->key, n->item);
+    free(n);
+    n = next;
+  }
+}
+
+/* Threads run on separate stacks, so a local's address tells them apart
+   well enough to spread them over the counter slots. */
+static inline uint64_t *
+_read_lock(chmap *c)
+{
+  int here;
+  uintptr_t a = (uintptr_t)&here;
+  uint32_t slot = (uint32_t)(((uint64_t)(a >> 12) * 0x9E3779B97F4A7C15ULL)
+                             >> 59) & (READER_SLOTS - 1);
+  uint32_t e = __atomic_load_n(&c->epoch, __ATOMIC_RELAXED) & 1;
+  uint64_t *ctr = &c->readers[slot][e];
+
+  /* seq_cst: the table loads that follow can't move ahead of the join. */
+  __atomic_fetch_add(ctr, 1, __ATOMIC_SEQ_CST);
+  return ctr;
+}
+
+static inline void
+_read_unlock(uint64_t *ctr)
+{
+  __atomic_fetch_sub(ctr, 1, __ATOMIC_RELEASE);
+}
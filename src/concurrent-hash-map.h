@@ -0,0 +1,57 @@
+#ifndef _CONCURRENT_HASH_MAP_H
+#define _CONCURRENT_HASH_MAP_H
+/* ------------------------------------------------------------------------- *\
+   Concurrent Hash Map
+     - A hash map many threads may share: put, get and remove may all be
+       called at once, from any thread, with no outside locking.
+     - Prefix: chmap
+     - May resize.
+     - get takes no locks and writes nothing shared but a reader counter:
+       bucket heads and links are read with atomic loads, and removed or
+       replaced nodes are only freed once every get that could still be
+       looking at them has finished.
+     - put and remove lock one of a fixed set of striped locks, picked by
+       the key's hash, so writers to different buckets rarely meet.
+     - Keys are hashed with hmap_hash_wy and a random seed per table.
+     - put replaces the entry of an existing key. The old key and item go
+       to the destructor, but not until no get can still be reading them.
+       An item a get has already returned is not covered: if callers keep
+       items past the call while other threads replace them, the items
+       need their own lifetime management.
+     - remove does not call the destructor, as with hmap; free does, for
+       every entry still in the map.
+     - chmap_free and chmap_count are not meant to race with writers:
+       free must be the last call, and count is a snapshot.
+     - Link with -lpthread.
+   -------------------------------------------------------------------------
+   LICENSE: This program is free software. You can modify it and/or re-
+   distribute it under the terms of the Apache 2.0 License. You should have
+   received a copy of the Apache 2.0 License along with this program. If
+   not, please see: http://www.apache.org/licenses/LICENSE-2.0.txt
+
+   DISCLAIMER: This program is distributed in the hope that it will be
+   useful, but without any warrantee; without even the implied warantee
+   of fitness for any particular purpose. See the License for more details.
+\* ------------------------------------------------------------------------- */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "oc-mem.h"
+
+typedef struct chmap chmap;
+
+chmap*   chmap_create(map_destructor);
+void     chmap_free(chmap*);
+
+void     chmap_put(chmap*, char* key, void *val);
+void*    chmap_get(chmap*, char* key);
+void     chmap_remove(chmap*, char* key);
+uint32_t chmap_count(chmap*);
+
+/* byte keys, as hmap_put_n and friends. */
+void     chmap_put_n(chmap*, const void *key, size_t len, void *val);
+void*    chmap_get_n(chmap*, const void *key, size_t len);
+void     chmap_remove_n(chmap*, const void *key, size_t len);
+
+#endif
@@ -0,0 +1,428 @@
+/* ------------------------------------------------------------------------- *\
+   Filter
+     - Bloom: blocks of 8 32-bit words, 64-byte aligned, so no block
+       straddles a cache line. The top 32 bits of the hash pick the block,
+       by a multiply rather than a modulo; the low 32 bits, multiplied by
+       8 odd salts, give one bit position per word from each product's top
+       5 bits. Bits per hash for a rate come from a table worked out for
+       this layout, which needs a little more than a classic Bloom filter.
+     - Cuckoo: a power of two of buckets, each one word of 4 fingerprint
+       lanes, 0 marking an empty lane. A hash's first bucket is its low
+       bits; its fingerprint, its top bits; its other bucket, the first
+       xor a hash of the fingerprint, so either bucket and the fingerprint
+       give the other, and a fingerprint can be moved without its hash.
+       A lane match is the has-a-zero-lane trick on the bucket xor the
+       fingerprint in every lane: one subtract, and, and not per bucket.
+     - An add that finds both buckets full kicks a random lane's
+       fingerprint to its other bucket, up to MAX_KICKS times. The
+       fingerprint still homeless then waits in a one-entry stash, which a
+       later remove may free; an add with the stash taken fails, and the
+       filter goes full.
+   -------------------------------------------------------------------------
+   LICENSE: This program is free software. You can modify it and/or re-
+   distribute it under the terms of the Apache 2.0 License. You should have
+   received a copy of the Apache 2.0 License along with this program. If
+   not, please see: http://www.apache.org/licenses/LICENSE-2.0.txt
+
+   DISCLAIMER: This program is distributed in the hope that it will be
+   useful, but without any warrantee; without even the implied warantee
+   of fitness for any particular purpose. See the License for more details.
+\* ------------------------------------------------------------------------- */
+
+#include <stdlib.h>
+#include <string.h>
+#include "filter.h"
+#include "hash-map.h"
+
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+/* Default numbers */
+#define DEFAULT_RATE  0.01
+#define BLOCK_WORDS   8
+#define BLOCK_BITS    256
+#define LINE_BYTES    64
+#define BUCKET_LANES  4
+#define MAX_KICKS     500
+#define FP_MULT       0x5bd1e995u
+#define FILTER_SEED   0x2545F4914F6CDD1DULL
+
+struct oc_filter {
+  oc_filter_kind kind;
+  void          *mem;       /* the allocation; the table is aligned in it. */
+  size_t         size;      /* bytes of table. */
+  union {
+    struct {
+      uint32_t  *words;
+      uint32_t   blocks;
+    } bloom;
+    struct {
+      void      *buckets;   /* uint32_t (8-bit lanes) or uint64_t each. */
+      uint32_t   mask;
+      uint32_t   bits;      /* bits per fingerprint: 8 or 16. */
+      uint32_t   stash_fp;  /* 0 when the stash is free. */
+      uint32_t   stash_at;  /* one of the stashed fingerprint's buckets. */
+      bool       full;
+      uint64_t   rng;
+    } cuckoo;
+  } f;
+};
+
+/*
+ * Split block false-positive rates by bits per hash: sum over the number
+ * of hashes j in a block, Poisson with mean 256 / bits, of the chance all
+ * 8 bits are set, (1 - (31/32)^j)^8.
+ */
+static const struct { double rate; uint32_t bits; } _bloom_bits[] = {
+  { 0.326, 4 },     { 0.179, 5 },     { 0.0993, 6 },    { 0.0565, 7 },
+  { 0.0332, 8 },    { 0.0202, 9 },    { 0.0126, 10 },   { 0.00817, 11 },
+  { 0.00542, 12 },  { 0.00369, 13 },  { 0.00256, 14 },  { 0.00182, 15 },
+  { 0.00132, 16 },  { 0.000723, 18 }, { 0.00042, 20 },  { 0.000256, 22 },
+  { 0.000163, 24 }, { 0.000107, 26 }, { 7.27e-05, 28 }, { 3.61e-05, 32 },
+  { 1.96e-05, 36 }, { 1.13e-05, 40 }, { 4.45e-06, 48 }, { 2.04e-06, 56 },
+  { 1.05e-06, 64 }
+};
+
+/* Cuckoo rates, 2 buckets of 4 lanes: 8 / 2^bits. */
+#define CUCKOO_RATE_8 (8.0 / 256.0)
+
+static const uint32_t _salt[BLOCK_WORDS] = {
+  0x47b6137bU, 0x44974d91U, 0x8824ad5bU, 0xa2b7289dU,
+  0x705495c7U, 0x2df1424bU, 0x9efc4947U, 0x5c6bfb31U
+};
+
+/* Private declarations. */
+static void *_table(oc_filter*, size_t size);
+static inline uint32_t *_block(const oc_filter*, uint64_t hash);
+static void _bloom_add(oc_filter*, uint64_t hash);
+static bool _bloom_test(const oc_filter*, uint64_t hash);
+static inline uint32_t _fp(const oc_filter*, uint64_t hash);
+static inline uint32_t _alt(const oc_filter*, uint32_t at, uint32_t fp);
+static inline uint64_t _bucket(const oc_filter*, uint32_t at);
+static inline void _set_bucket(oc_filter*, uint32_t at, uint64_t w);
+static inline uint32_t _lane(const oc_filter*, uint64_t w, uint32_t s);
+static inline uint64_t _with_lane(const oc_filter*, uint64_t w, uint32_t s,
+                                  uint32_t fp);
+static inline bool _holds(const oc_filter*, uint64_t w, uint32_t fp);
+static bool _place(oc_filter*, uint32_t at, uint32_t fp);
+static bool _take(oc_filter*, uint32_t at, uint32_t fp);
+static bool _cuckoo_add(oc_filter*, uint64_t hash);
+static bool _cuckoo_test(const oc_filter*, uint64_t hash);
+static bool _cuckoo_remove(oc_filter*, uint64_t hash);
+
+oc_filter*
+oc_filter_create(oc_filter_kind kind, uint32_t capacity, double fp_rate)
+{
+  oc_filter *f = malloc(sizeof(oc_filter));
+  size_t i, n = sizeof(_bloom_bits) / sizeof(_bloom_bits[0]);
+  uint64_t blocks;
+  uint32_t buckets = 2;
+
+  memset(f, 0, sizeof(oc_filter));
+  f->kind = kind;
+  if (!(fp_rate > 0 && fp_rate < 1)) fp_rate = DEFAULT_RATE;
+  if (!capacity) capacity = 1;
+  if (kind == OC_FILTER_BLOOM) {
+    for (i = 0; i < n - 1 && _bloom_bits[i].rate > fp_rate; i++);
+    blocks = ((uint64_t)capacity * _bloom_bits[i].bits + BLOCK_BITS - 1) /
+             BLOCK_BITS;
+    f->f.bloom.blocks = (uint32_t)blocks;
+    f->f.bloom.words  = _table(f, blocks * BLOCK_WORDS * sizeof(uint32_t));
+  } else {
+    /* 4-way buckets fill to about 95% before adds start to fail. */
+    while ((uint64_t)buckets * BUCKET_LANES * 95 < (uint64_t)capacity * 100) {
+      buckets <<= 1;
+    }
+    f->f.cuckoo.bits = fp_rate >= CUCKOO_RATE_8 ? 8 : 16;
+    f->f.cuckoo.mask = buckets - 1;
+    f->f.cuckoo.rng  = 88172645463325252ULL;
+    f->f.cuckoo.buckets = _table(f, (size_t)buckets *
+                                    (f->f.cuckoo.bits == 8 ? 4 : 8));
+  }
+  return f;
+}
+
+void
+oc_filter_free(oc_filter *f)
+{
+  free(f->mem);
+  free(f);
+}
+
+void
+oc_filter_clear(oc_filter *f)
+{
+  void *t = f->kind == OC_FILTER_BLOOM ? (void*)f->f.bloom.words
+                                       : f->f.cuckoo.buckets;
+  memset(t, 0, f->size);
+  if (f->kind == OC_FILTER_CUCKOO) {
+    f->f.cuckoo.stash_fp = 0;
+    f->f.cuckoo.full = false;
+  }
+}
+
+bool
+oc_filter_add(oc_filter *f, uint64_t hash)
+{
+  if (f->kind == OC_FILTER_BLOOM) {
+    _bloom_add(f, hash);
+    return true;
+  }
+  return _cuckoo_add(f, hash);
+}
+
+bool
+oc_filter_may_contain(const oc_filter *f, uint64_t hash)
+{
+  if (f->kind == OC_FILTER_BLOOM) return _bloom_test(f, hash);
+  return _cuckoo_test(f, hash);
+}
+
+bool
+oc_filter_remove(oc_filter *f, uint64_t hash)
+{
+  if (f->kind == OC_FILTER_BLOOM) return false;
+  return _cuckoo_remove(f, hash);
+}
+
+bool
+oc_filter_removable(const oc_filter *f)
+{
+  return f->kind == OC_FILTER_CUCKOO;
+}
+
+size_t
+oc_filter_bytes(const oc_filter *f)
+{
+  return sizeof(oc_filter) + f->size;
+}
+
+uint64_t
+oc_filter_hash(const void *key, size_t len)
+{
+  return hmap_hash_wy(key, len, FILTER_SEED);
+}
+
+/* ------------------------------------------------------------------------- *\
+   private functions.
+\* ------------------------------------------------------------------------- */
+
+/* Zeroed, on a cache line boundary. */
+static void *
+_table(oc_filter *f, size_t size)
+{
+  uintptr_t p;
+  f->mem  = calloc(1, size + LINE_BYTES - 1);
+  f->size = size;
+  p = ((uintptr_t)f->mem + LINE_BYTES - 1) & ~(uintptr_t)(LINE_BYTES - 1);
+  return (void*)p;
+}
+
+static inline uint32_t *
+_block(const oc_filter *f, uint64_t hash)
+{
+  uint64_t b = ((hash >> 32) * f->f.bloom.blocks) >> 32;
+  return f->f.bloom.words + b * BLOCK_WORDS;
+}
+
+#ifdef __AVX2__
+
+static inline __m256i
+_bloom_mask(uint32_t key)
+{
+  const __m256i salt = _mm256_loadu_si256((const __m256i*)_salt);
+  __m256i bit = _mm256_mullo_epi32(_mm256_set1_epi32((int)key), salt);
+  bit = _mm256_srli_epi32(bit, 27);
+  return _mm256_sllv_epi32(_mm256_set1_epi32(1), bit);
+}
+
+static void
+_bloom_add(oc_filter *f, uint64_t hash)
+{
+  __m256i *b = (__m256i*)_block(f, hash);
+  _mm256_store_si256(b, _mm256_or_si256(_mm256_load_si256(b),
+                                        _bloom_mask((uint32_t)hash)));
+}
+
+static bool
+_bloom_test(const oc_filter *f, uint64_t hash)
+{
+  const __m256i *b = (const __m256i*)_block(f, hash);
+  return _mm256_testc_si256(_mm256_load_si256(b),
+                            _bloom_mask((uint32_t)hash));
+}
+
+#else
+
+/* Without AVX2, a word at a time; a test stops at the first clear bit,
+   which for a hash never added is most often in the first word or two. */
+static void
+_bloom_add(oc_filter *f, uint64_t hash)
+{
+  uint32_t *b = _block(f, hash), key = (uint32_t)hash;
+  for (int i = 0; i < BLOCK_WORDS; i++) {
+    b[i] |= 1u << ((key * _salt[i]) >> 27);
+  }
+}
+
+static bool
+_bloom_test(const oc_filter *f, uint64_t hash)
+{
+  const uint32_t *b = _block(f, hash);
+  uint32_t key = (uint32_t)hash;
+  for (int i = 0; i < BLOCK_WORDS; i++) {
+    if (!(b[i] & (1u << ((key * _salt[i]) >> 27)))) return false;
+  }
+  return true;
+}
+
+#endif
+
+static inline uint32_t
+_fp(const oc_filter *f, uint64_t hash)
+{
+  uint32_t fp = (uint32_t)(hash >> (64 - f->f.cuckoo.bits));
+  return fp ? fp : 1;
+}
+
+static inline uint32_t
+_alt(const oc_filter *f, uint32_t at, uint32_t fp)
+{
+  return (at ^ (fp * FP_MULT)) & f->f.cuckoo.mask;
+}
+
+static inline uint64_t
+_bucket(const oc_filter *f, uint32_t at)
+{
+  const void *b = f->f.cuckoo.buckets;
+  if (f->f.cuckoo.bits == 8) return ((const uint32_t*)b)[at];
+  return ((const uint64_t*)b)[at];
+}
+
+static inline void
+_set_bucket(oc_filter *f, uint32_t at, uint64_t w)
+{
+  void *b = f->f.cuckoo.buckets;
+  if (f->f.cuckoo.bits == 8) ((uint32_t*)b)[at] = (uint32_t)w;
+  else                       ((uint64_t*)b)[at] = w;
+}
+
+static inline uint32_t
+_lane(const oc_filter *f, uint64_t w, uint32_t s)
+{
+  uint32_t bits = f->f.cuckoo.bits;
+  return (uint32_t)(w >> (s * bits)) & ((1u << bits) - 1);
+}
+
+static inline uint64_t
+_with_lane(const oc_filter *f, uint64_t w, uint32_t s, uint32_t fp)
+{
+  uint32_t bits = f->f.cuckoo.bits;
+  uint64_t m = (uint64_t)((1u << bits) - 1) << (s * bits);
+  return (w & ~m) | ((uint64_t)fp << (s * bits));
+}
+
+/* Any lane equal to fp: xor makes that lane zero, and a zero lane is the
+   only one whose top bit survives (v - 1) & ~v. */
+static inline bool
+_holds(const oc_filter *f, uint64_t w, uint32_t fp)
+{
+  uint64_t lo = f->f.cuckoo.bits == 8 ? 0x01010101ULL : 0x0001000100010001ULL;
+  uint64_t hi = lo << (f->f.cuckoo.bits - 1);
+  uint64_t v  = w ^ (lo * fp);
+  return ((v - lo) & ~v & hi) != 0;
+}
+
+static bool
+_place(oc_filter *f, uint32_t at, uint32_t fp)
+{
+  uint64_t w = _bucket(f, at);
+  for (uint32_t s = 0; s < BUCKET_LANES; s++) {
+    if (!_lane(f, w, s)) {
+      _set_bucket(f, at, _with_lane(f, w, s, fp));
+      return true;
+    }
+  }
+  return false;
+}
+
+static bool
+_take(oc_filter *f, uint32_t at, uint32_t fp)
+{
+  uint64_t w = _bucket(f, at);
+  for (uint32_t s = 0; s < BUCKET_LANES; s++) {
+    if (_lane(f, w, s) == fp) {
+      _set_bucket(f, at, _with_lane(f, w, s, 0));
+      return true;
+    }
+  }
+  return false;
+}
+
+static bool
+_cuckoo_add(oc_filter *f, uint64_t hash)
+{
+  uint32_t fp = _fp(f, hash), at = (uint32_t)hash & f->f.cuckoo.mask;
+  uint32_t alt = _alt(f, at, fp), s, kicked;
+  uint64_t w, r;
+
+  if (f->f.cuckoo.full) return false;
+  if (_place(f, at, fp) || _place(f, alt, fp)) return true;
+  if (f->f.cuckoo.stash_fp) {
+    f->f.cuckoo.full = true;
+    return false;
+  }
+  r = f->f.cuckoo.rng;
+  if (r & 1) at = alt;
+  for (int k = 0; k < MAX_KICKS; k++) {
+    r ^= r << 13; r ^= r >> 7; r ^= r << 17;   /* xorshift */
+    s = (uint32_t)(r >> 32) % BUCKET_LANES;
+    w = _bucket(f, at);
+    kicked = _lane(f, w, s);
+    _set_bucket(f, at, _with_lane(f, w, s, fp));
+    fp = kicked;
+    at = _alt(f, at, fp);
+    if (_place(f, at, fp)) {
+      f->f.cuckoo.rng = r;
+      return true;
+    }
+  }
+  f->f.cuckoo.rng = r;
+  f->f.cuckoo.stash_fp = fp;
+  f->f.cuckoo.stash_at = at;
+  return true;
+}
+
+static bool
+_cuckoo_test(const oc_filter *f, uint64_t hash)
+{
+  uint32_t fp = _fp(f, hash), at = (uint32_t)hash & f->f.cuckoo.mask;
+  uint32_t alt = _alt(f, at, fp);
+
+  if (_holds(f, _bucket(f, at), fp) || _holds(f, _bucket(f, alt), fp)) {
+    return true;
+  }
+  return f->f.cuckoo.full ||
+         (f->f.cuckoo.stash_fp == fp &&
+          (f->f.cuckoo.stash_at == at || f->f.cuckoo.stash_at == alt));
+}
+
+/* A lane freed may be where the stashed fingerprint can go. */
+static bool
+_cuckoo_remove(oc_filter *f, uint64_t hash)
+{
+  uint32_t fp = _fp(f, hash), at = (uint32_t)hash & f->f.cuckoo.mask;
+  uint32_t alt = _alt(f, at, fp), sfp = f->f.cuckoo.stash_fp;
+  uint32_t sat = f->f.cuckoo.stash_at;
+
+  if (sfp == fp && (sat == at || sat == alt)) {
+    f->f.cuckoo.stash_fp = 0;
+    return true;
+  }
+  if (!_take(f, at, fp) && !_take(f, alt, fp)) return false;
+  if (sfp && (_place(f, sat, sfp) || _place(f, _alt(f, sat, sfp), sfp))) {
+    f->f.cuckoo.stash_fp = 0;
+  }
+  return true;
+}
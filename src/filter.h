@@ -0,0 +1,82 @@
+#ifndef _FILTER_H
+#define _FILTER_H
+/* ------------------------------------------------------------------------- *\
+   Filter
+     - Approximate membership over 64-bit hashes: may_contain never says
+       no for a hash that was added, and says yes for one that was not at
+       about the false-positive rate asked for. A "no" is a definite miss,
+       answered from one or two cache lines, however large the structure
+       the filter stands in front of.
+     - Prefix: oc_filter
+     - Kinds:
+         OC_FILTER_BLOOM  - a split block Bloom filter. Each hash sets or
+                            tests 8 bits in one 32-byte block, one bit in
+                            each of the block's 8 words, so a probe is one
+                            cache line and 8 independent lanes: built with
+                            AVX2 (-mavx2), one multiply, shift and test
+                            covers all 8. Adds never fail. Removes do
+                            nothing: a removed hash stays a false positive
+                            until the filter is cleared and filled again.
+         OC_FILTER_CUCKOO - a cuckoo filter: 4 fingerprints of 8 or 16
+                            bits per bucket, each hash in one of 2 buckets.
+                            A bucket is one word, tested for the
+                            fingerprint in all 4 lanes at once. Supports
+                            remove. 8-bit fingerprints give about 3%
+                            false positives, 16-bit about 0.012%: the
+                            smaller one that meets the rate asked for.
+     - Sized at create time for a number of hashes and a false-positive
+       rate; 0 < rate < 1, else 0.01. A Bloom filter over capacity only
+       gets less exact. A cuckoo filter over capacity can fail an add: it
+       then answers yes to everything, as a filter may, until cleared.
+     - Hashes should be well mixed in all 64 bits, as hmap's are:
+       oc_filter_hash hashes bytes for a filter used on its own.
+     - Not thread safe for adds and removes; may_contain only reads.
+   -------------------------------------------------------------------------
+   LICENSE: This program is free software. You can modify it and/or re-
+   distribute it under the terms of the Apache 2.0 License. You should have
+   received a copy of the Apache 2.0 License along with this program. If
+   not, please see: http://www.apache.org/licenses/LICENSE-2.0.txt
+
+   DISCLAIMER: This program is distributed in the hope that it will be
+   useful, but without any warrantee; without even the implied warantee
+   of fitness for any particular purpose. See the License for more details.
+\* ------------------------------------------------------------------------- */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct oc_filter oc_filter;
+
+typedef enum oc_filter_kind {
+  OC_FILTER_BLOOM = 0,
+  OC_FILTER_CUCKOO
+} oc_filter_kind;
+
+oc_filter* oc_filter_create(oc_filter_kind, uint32_t capacity,
+                            double fp_rate);
+void       oc_filter_free(oc_filter*);
+
+/* forget every hash added, and a cuckoo filter's failed add. */
+void       oc_filter_clear(oc_filter*);
+
+/* add: false if a cuckoo filter had no room; it now says yes to all.
+ * Adding a hash twice holds two copies in a cuckoo filter, and removing
+ * it once leaves one. */
+bool       oc_filter_add(oc_filter*, uint64_t hash);
+bool       oc_filter_may_contain(const oc_filter*, uint64_t hash);
+
+/* remove: one copy of a hash that was added, true if one was found. Only
+ * a hash that was added may be removed; removing another can remove a
+ * colliding hash's copy, and make a false negative. Bloom filters can't
+ * remove, and return false. */
+bool       oc_filter_remove(oc_filter*, uint64_t hash);
+bool       oc_filter_removable(const oc_filter*);
+
+/* bytes of filter, the structure's own included. */
+size_t     oc_filter_bytes(const oc_filter*);
+
+/* len bytes at key, hashed with a fixed seed: the same in every run. */
+uint64_t   oc_filter_hash(const void *key, size_t len);
+
+#endif
@@ -0,0 +1,459 @@
+/* ------------------------------------------------------------------------- *\
+   Hash Map: Chained Engine
+     - The original hmap: a bucket array, each bucket a singly linked list
+       of map_nodes.
+     - put replaces the entry for a key already in the map, as the other
+       engines do, so no bucket holds a key twice.
+     - Grows by doubling once the load factor passes MAX_LOAD. The move is
+       incremental: both tables stay live, and each later put, get and
+       remove moves the next few old buckets across, so no single call
+       pays for the whole rehash. Nodes carry their hash, so moving one
+       never rehashes its key.
+     - put_bulk carves all its nodes from one slab, laid out in bucket
+       order. A slab node that is removed is only unlinked; slabs are
+       freed with the map.
+   -------------------------------------------------------------------------
+   LICENSE: This program is free software. You can modify it and/or re-
+   distribute it under the terms of the Apache 2.0 License. You should have
+   received a copy of the Apache 2.0 License along with this program. If
+   not, please see: http://www.apache.org/licenses/LICENSE-2.0.txt
+
+   DISCLAIMER: This program is distributed in the hope that it will be
+   useful, but without any warrantee; without even the implied warantee
+   of fitness for any particular purpose. See the License for more details.
+\* ------------------------------------------------------------------------- */
+
+#include <stdlib.h>
+#include <string.h>
+#include "hash-map-engine.h"
+
+/* Grow once there are more items than buckets. */
+#define MAX_LOAD 1
+/* Old buckets moved per call while a resize is under way. */
+#define MIGRATE_STEP 4
+/* Slab nodes, inline keys and all, start on multiples of this. */
+#define NODE_ALIGN 8
+
+/* The header of each put_bulk slab; its nodes follow. */
+typedef struct node_slab {
+  struct node_slab *next;
+} node_slab;
+
+/* Private declarations. */
+static void  _init(hmap*);
+static void  _release(hmap*);
+static void  _put(hmap*, uint64_t, void*, size_t, void*);
+static map_node *_insert(hmap*, uint64_t, void*, size_t, void*);
+static void  _replace(hmap*, map_node*, void*, void*);
+static void* _get(hmap*, uint64_t, const void*, size_t);
+static void  _remove(hmap*, uint64_t, const void*, size_t);
+static void  _prefetch(hmap*, uint64_t, int);
+static void  _each(hmap*, hmap_visit, void*);
+static void** _slot(hmap*, uint64_t, void*, size_t, bool*);
+static void  _iter_init(hmap*, hmap_iter*);
+static bool  _iter_next(hmap_iter*, void**, size_t*, void**);
+static void  _reserve(hmap*, uint32_t);
+static void  _put_bulk(hmap*, const uint64_t*, char**, const uint32_t*,
+                       void**, size_t);
+static void  _stats(hmap*, hmap_stats*, bool);
+static void  _walk(hmap*, hmap_stats*, map_node**, uint32_t, uint32_t,
+                   uint32_t*);
+static uint32_t _bucket(const hmap*, uint64_t);
+static inline size_t _node_size(const hmap*, uint32_t len);
+static void  _each_in(map_node**, uint32_t, uint32_t, hmap_visit, void*);
+static void  _free_map_node_list(map_node *, map_destructor);
+static void  _start_resize(hmap*);
+static void  _migrate(hmap*, uint32_t buckets);
+static map_node **_find(hmap*, uint64_t, const void*, size_t);
+static map_node **_find_in(map_node **, uint64_t, const void*, size_t);
+
+const hmap_engine_ops hmap_chained_ops = {
+  _init, _release, _put, _get, _remove, _prefetch, _each, _slot,
+  _iter_init, _iter_next, _reserve, _put_bulk, _stats
+};
+
+static void
+_init(hmap *h)
+{
+  h->e.chained.nodes = malloc(sizeof(map_node*) * h->map_size);
+  memset(h->e.chained.nodes, 0, sizeof(map_node*) * h->map_size);
+}
+
+static void
+_release(hmap *h)
+{
+  for (uint32_t i = 0; i < h->map_size; i++) {
+    if (h->e.chained.nodes[i]) {
+      _free_map_node_list(h->e.chained.nodes[i], h->rel);
+    }
+  }
+  free(h->e.chained.nodes);
+  if (h->e.chained.old_nodes) {
+    for (uint32_t i = h->e.chained.migrate; i < h->e.chained.old_size; i++) {
+      if (h->e.chained.old_nodes[i]) {
+        _free_map_node_list(h->e.chained.old_nodes[i], h->rel);
+      }
+    }
+    free(h->e.chained.old_nodes);
+  }
+  for (node_slab *slab = h->e.chained.slabs, *next; slab; slab = next) {
+    next = slab->next;
+    free(slab);
+  }
+}
+
+static void
+_put(hmap *h, uint64_t hash, void *key, size_t len, void *val)
+{
+  map_node **link;
+
+  if (h->e.chained.old_nodes) _migrate(h, MIGRATE_STEP);
+  link = _find(h, hash, key, len);
+  if (link) {
+    _replace(h, *link, key, val);
+  } else {
+    _insert(h, hash, key, len, val);
+  }
+}
+
+/* A node's inline key is the map's own: only its item is released. */
+static void
+_replace(hmap *h, map_node *node, void *key, void *val)
+{
+  hmap_release_replaced(h, h->inline_keys ? NULL : node->key, node->item,
+                        key, val);
+  if (!h->inline_keys) node->key = key;
+  node->item = val;
+}
+
+/* A new node for a key not in the map, at the head of its bucket. */
+static map_node *
+_insert(hmap *h, uint64_t hash, void *key, size_t len, void *val)
+{
+  map_node *node;
+
+  if (!h->e.chained.old_nodes && h->item_count >= h->map_size * MAX_LOAD) {
+    _start_resize(h);
+  }
+  node = malloc(sizeof(map_node) + (h->inline_keys ? len + 1 : 0));
+  if (h->inline_keys) {
+    memcpy(node->inline_key, key, len);
+    node->inline_key[len] = '\0';
+    key = node->inline_key;
+  }
+  node->key = key;
+  node->len = (uint32_t)len;
+  node->in_slab = false;
+  node->item = val;
+  node->hash = hash;
+  uint64_t idx  = node->hash & (uint64_t)(h->map_size - 1); /* Modulo. */
+  node->next = h->e.chained.nodes[idx];
+  h->e.chained.nodes[idx] = node;
+  h->item_count++;
+  return node;
+}
+
+static void**
+_slot(hmap *h, uint64_t hash, void *key, size_t len, bool *created)
+{
+  map_node **link;
+  if (h->e.chained.old_nodes) _migrate(h, MIGRATE_STEP);
+  link = _find(h, hash, key, len);
+  *created = !link;
+  if (link) return &(*link)->item;
+  return &_insert(h, hash, key, len, NULL)->item;
+}
+
+static void*
+_get(hmap *h, uint64_t hash, const void *key, size_t len)
+{
+  map_node **link;
+  if (h->e.chained.old_nodes) _migrate(h, MIGRATE_STEP);
+  link = _find(h, hash, key, len);
+  return link ? (*link)->item : NULL;
+}
+
+static void
+_remove(hmap *h, uint64_t hash, const void *key, size_t len)
+{
+  map_node **link, *n;
+  if (h->e.chained.old_nodes) _migrate(h, MIGRATE_STEP);
+  link = _find(h, hash, key, len);
+  if (!link) return;
+  n = *link;
+  *link = n->next;
+  if (!n->in_slab) free(n);
+  h->item_count--;
+  return;
+}
+
+/* Stage 0: the bucket; stage 1: the first node in it. While a resize is
+   under way, get finds most keys in the new table; only that is fetched. */
+static void
+_prefetch(hmap *h, uint64_t hash, int stage)
+{
+  map_node **bucket = &h->e.chained.nodes[hash & (h->map_size - 1)];
+  if (stage == 0) {
+    HMAP_PREFETCH(bucket);
+  } else if (*bucket) {
+    HMAP_PREFETCH(*bucket);
+  }
+}
+
+/* The new table, then the old buckets not yet moved. */
+static void
+_each(hmap *h, hmap_visit fn, void *ctx)
+{
+  _each_in(h->e.chained.nodes, 0, h->map_size, fn, ctx);
+  if (h->e.chained.old_nodes) {
+    _each_in(h->e.chained.old_nodes, h->e.chained.migrate,
+             h->e.chained.old_size, fn, ctx);
+  }
+}
+
+static void
+_each_in(map_node **buckets, uint32_t from, uint32_t to, hmap_visit fn,
+         void *ctx)
+{
+  for (uint32_t i = from; i < to; i++) {
+    for (map_node *n = buckets[i]; n; n = n->next) {
+      fn(ctx, n->hash, n->key, n->len, n->item);
+    }
+  }
+}
+
+/* Finishes any resize first, so only one table is left to walk: pos is
+   the next bucket, node the next node in the current one. */
+static void
+_iter_init(hmap *h, hmap_iter *it)
+{
+  if (h->e.chained.old_nodes) _migrate(h, UINT32_MAX);
+  it->pos  = 0;
+  it->node = NULL;
+}
+
+static bool
+_iter_next(hmap_iter *it, void **key, size_t *len, void **item)
+{
+  hmap *h = it->h;
+  map_node *n;
+
+  while (!it->node) {
+    if (it->pos >= h->map_size) return false;
+    it->node = h->e.chained.nodes[it->pos++];
+  }
+  n = it->node;
+  it->node = n->next;
+  *key  = n->key;
+  *len  = n->len;
+  *item = n->item;
+  return true;
+}
+
+/* Room for n items: no more items than buckets. Any resize under way is
+   finished, and the table rehashed straight to its final size. */
+static void
+_reserve(hmap *h, uint32_t n)
+{
+  uint32_t size = h->map_size;
+
+  while (size < n && size < (1u << 31)) size <<= 1;
+  if (size == h->map_size) return;
+  if (h->e.chained.old_nodes) _migrate(h, UINT32_MAX);
+  h->e.chained.old_nodes = h->e.chained.nodes;
+  h->e.chained.old_size  = h->map_size;
+  h->e.chained.migrate   = 0;
+  h->map_size = size;
+  h->e.chained.nodes = calloc(h->map_size, sizeof(map_node*));
+  h->resizes++;
+  _migrate(h, UINT32_MAX);
+}
+
+static uint32_t
+_bucket(const hmap *h, uint64_t hash)
+{
+  return (uint32_t)(hash & (h->map_size - 1));
+}
+
+static inline size_t
+_node_size(const hmap *h, uint32_t len)
+{
+  size_t size = sizeof(map_node) + (h->inline_keys ? len + 1 : 0);
+  return (size + NODE_ALIGN - 1) & ~(size_t)(NODE_ALIGN - 1);
+}
+
+/*
+ * One slab for all n nodes, filled in bucket order, so the nodes of
+ * neighbouring buckets are neighbours too. Each node goes in at the head
+ * of its bucket, as put would put it. A key already in the map, or met
+ * earlier in the batch (keys in the same bucket keep their order), is
+ * replaced as put replaces it, and its slab node left unused.
+ */
+static void
+_put_bulk(hmap *h, const uint64_t *hash, char **keys, const uint32_t *len,
+          void **vals, size_t n)
+{
+  uint32_t  *order;
+  node_slab *slab;
+  map_node  *node, **bucket, **link;
+  char      *at;
+  size_t     bytes = sizeof(node_slab);
+  uint32_t   i;
+
+  if (h->e.chained.old_nodes) _migrate(h, UINT32_MAX);
+  for (size_t k = 0; k < n; k++) bytes += _node_size(h, len[k]);
+  slab = malloc(bytes);
+  slab->next = h->e.chained.slabs;
+  h->e.chained.slabs = slab;
+  at = (char*)(slab + 1);
+
+  order = hmap_bulk_order(h, hash, n, _bucket);
+  for (size_t k = 0; k < n; k++) {
+    i = order[k];
+    node = (map_node*)at;
+    at += _node_size(h, len[i]);
+    link = _find_in(&h->e.chained.nodes[_bucket(h, hash[i])], hash[i],
+                    keys[i], len[i]);
+    if (link) {
+      _replace(h, *link, keys[i], vals[i]);
+      continue;
+    }
+    node->key = keys[i];
+    if (h->inline_keys) {
+      memcpy(node->inline_key, keys[i], len[i]);
+      node->inline_key[len[i]] = '\0';
+      node->key = node->inline_key;
+    }
+    node->hash    = hash[i];
+    node->len     = len[i];
+    node->in_slab = true;
+    node->item    = vals[i];
+    bucket = &h->e.chained.nodes[_bucket(h, hash[i])];
+    node->next = *bucket;
+    *bucket = node;
+    h->item_count++;
+  }
+  free(order);
+}
+
+/*
+ * Returns the link that points at the node for key, or NULL. Entries put
+ * since a resize began are all in the new table, so it is searched first.
+ */
+static map_node **
+_find(hmap *h, uint64_t hash, const void *key, size_t len)
+{
+  map_node **link;
+  uint32_t idx = hash & (h->map_size - 1);
+  link = _find_in(&h->e.chained.nodes[idx], hash, key, len);
+  if (link || !h->e.chained.old_nodes) return link;
+  idx = hash & (h->e.chained.old_size - 1);
+  if (idx < h->e.chained.migrate) return NULL;
+  return _find_in(&h->e.chained.old_nodes[idx], hash, key, len);
+}
+
+static map_node **
+_find_in(map_node **link, uint64_t hash, const void *key, size_t len)
+{
+  for (; *link; link = &(*link)->next) {
+    if (hmap_key_match((*link)->hash, (*link)->len, (*link)->key,
+                       hash, len, key)) {
+      return link;
+    }
+  }
+  return NULL;
+}
+
+static void
+_start_resize(hmap *h)
+{
+  h->e.chained.old_nodes = h->e.chained.nodes;
+  h->e.chained.old_size  = h->map_size;
+  h->e.chained.migrate   = 0;
+  h->map_size <<= 1;
+  /* calloc: a large zeroed table comes from fresh pages, not a memset. */
+  h->e.chained.nodes = calloc(h->map_size, sizeof(map_node*));
+  h->resizes++;
+}
+
+/*
+ * Move up to the next n old buckets into the new table. No key is in
+ * both tables, so chain order does not matter: each node is pushed onto
+ * the front of its new bucket.
+ */
+static void
+_migrate(hmap *h, uint32_t n)
+{
+  map_node **dst = h->e.chained.nodes, *node, *next;
+  uint32_t idx;
+
+  while (n-- && h->e.chained.migrate < h->e.chained.old_size) {
+    node = h->e.chained.old_nodes[h->e.chained.migrate++];
+    for (; node; node = next) {
+      next = node->next;
+      idx = node->hash & (h->map_size - 1);
+      node->next = dst[idx];
+      dst[idx] = node;
+    }
+  }
+  if (h->e.chained.migrate == h->e.chained.old_size) {
+    free(h->e.chained.old_nodes);
+    h->e.chained.old_nodes = NULL;
+    h->e.chained.old_size  = 0;
+    h->e.chained.migrate   = 0;
+  }
+}
+
+/*
+ * Nodes are counted at the size put gives them; slab nodes round up a
+ * little, and removed ones still hold their place in the slab. While a
+ * resize is under way, an old node's probe is its place in its old
+ * chain, and its home the new bucket it is bound for.
+ */
+static void
+_stats(hmap *h, hmap_stats *s, bool walk)
+{
+  uint32_t *per_home;
+
+  s->bytes = (size_t)(h->map_size + h->e.chained.old_size)
+               * sizeof(map_node*)
+             + (size_t)h->item_count * sizeof(map_node);
+  if (!walk) return;
+  per_home = calloc(h->map_size, sizeof(uint32_t));
+  _walk(h, s, h->e.chained.nodes, 0, h->map_size, per_home);
+  if (h->e.chained.old_nodes) {
+    _walk(h, s, h->e.chained.old_nodes, h->e.chained.migrate,
+          h->e.chained.old_size, per_home);
+  }
+  hmap_stats_spread(s, per_home, h->map_size);
+  free(per_home);
+}
+
+static void
+_walk(hmap *h, hmap_stats *s, map_node **buckets, uint32_t from,
+      uint32_t to, uint32_t *per_home)
+{
+  uint32_t probe;
+
+  for (uint32_t i = from; i < to; i++) {
+    probe = 0;
+    for (map_node *node = buckets[i]; node; node = node->next) {
+      hmap_stats_probe(s, probe++);
+      per_home[_bucket(h, node->hash)]++;
+      if (h->inline_keys) s->bytes += node->len + 1;
+    }
+  }
+}
+
+/* Iterative: a long chain must not cost a deep stack. */
+static void
+_free_map_node_list(map_node *node, map_destructor r)
+{
+  map_node *next;
+  while (node) {
+    next = node->next;
+    if (r) r((void*)node->key, node->item);
+    if (!node->in_slab) free(node);
+    node = next;
+  }
+}
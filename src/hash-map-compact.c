@@ -0,0 +1,416 @@
+/* ------------------------------------------------------------------------- *\
+   Hash Map: Compact Engine
+     - Entries live in one dense array, in insertion order, 24 bytes
+       each: key, item, a 32 bit fold of the hash, and the key length.
+       Iteration is a straight walk down that array.
+     - The hash table proper is a separate index of map_size positions
+       into the array, 8, 16 or 32 bits wide as the table size needs,
+       linearly probed from a Fibonacci-mixed home. An index slot holds
+       0 when empty, 1 when its entry was removed, else the entry's
+       position plus 2; a zeroed index is an empty one.
+     - At most 2/3 of the index is ever in use. The entry array itself
+       grows by half as needed, up to that limit, so a table pays for
+       little more than the entries it holds.
+     - remove leaves a hole in the array, its key NULL, and a removed
+       mark in the index. Once the array reaches the limit, or live and
+       removed slots together fill the index to it, the index is rebuilt
+       and the holes squeezed out, doubling the index first if more than
+       3/4 of the entries are live.
+     - put replaces the item of an existing key, releasing the old key and
+       item through the destructor.
+     - put_bulk keeps insertion order, so puts its keys in as given,
+       prefetching the index ahead; reserve has sized the entry array
+       for them all.
+   -------------------------------------------------------------------------
+   LICENSE: This program is free software. You can modify it and/or re-
+   distribute it under the terms of the Apache 2.0 License. You should have
+   received a copy of the Apache 2.0 License along with this program. If
+   not, please see: http://www.apache.org/licenses/LICENSE-2.0.txt
+
+   DISCLAIMER: This program is distributed in the hope that it will be
+   useful, but without any warrantee; without even the implied warantee
+   of fitness for any particular purpose. See the License for more details.
+\* ------------------------------------------------------------------------- */
+
+#include <stdlib.h>
+#include <string.h>
+#include "hash-map-engine.h"
+
+#define FIB_MULT 0x9E3779B97F4A7C15ULL
+
+/* Index slot values; an entry at position p is stored as p + IX_FIRST. */
+#define IX_EMPTY 0
+#define IX_DUMMY 1
+#define IX_FIRST 2
+
+/* Entries the array starts with room for. */
+#define MIN_ROOM 8
+/* Keys a bulk put prefetches the index for ahead of inserting. */
+#define PREFETCH_AHEAD 16
+
+/* Private declarations. */
+static void  _init(hmap*);
+static void  _release(hmap*);
+static void  _put(hmap*, uint64_t, void*, size_t, void*);
+static void* _get(hmap*, uint64_t, const void*, size_t);
+static void  _remove(hmap*, uint64_t, const void*, size_t);
+static void  _prefetch(hmap*, uint64_t, int);
+static void  _each(hmap*, hmap_visit, void*);
+static void** _slot(hmap*, uint64_t, void*, size_t, bool*);
+static void  _iter_init(hmap*, hmap_iter*);
+static bool  _iter_next(hmap_iter*, void**, size_t*, void**);
+static void  _reserve(hmap*, uint32_t);
+static void  _put_bulk(hmap*, const uint64_t*, char**, const uint32_t*,
+                       void**, size_t);
+static void  _stats(hmap*, hmap_stats*, bool);
+static compact_entry *_upsert(hmap*, uint64_t, void*, size_t, bool *found);
+static uint32_t _lookup(hmap*, uint32_t, const void*, size_t);
+static void  _make_room(hmap*);
+static void  _rebuild(hmap*, uint32_t size);
+static void  _size_index(hmap*, uint32_t size);
+static inline uint32_t _fold(uint64_t hash);
+static inline uint32_t _home(uint32_t hash32, uint32_t mask);
+static inline uint32_t _ix(const hmap*, uint32_t i);
+static inline void     _set_ix(hmap*, uint32_t i, uint32_t v);
+
+const hmap_engine_ops hmap_compact_ops = {
+  _init, _release, _put, _get, _remove, _prefetch, _each, _slot,
+  _iter_init, _iter_next, _reserve, _put_bulk, _stats
+};
+
+static inline uint32_t
+_fold(uint64_t hash)
+{
+  return (uint32_t)(hash ^ (hash >> 32));
+}
+
+static inline uint32_t
+_home(uint32_t hash32, uint32_t mask)
+{
+  return (uint32_t)(((uint64_t)hash32 * FIB_MULT) >> 32) & mask;
+}
+
+static inline uint32_t
+_ix(const hmap *h, uint32_t i)
+{
+  switch (h->e.compact.width) {
+    case 1:  return ((const uint8_t*)h->e.compact.index)[i];
+    case 2:  return ((const uint16_t*)h->e.compact.index)[i];
+    default: return ((const uint32_t*)h->e.compact.index)[i];
+  }
+}
+
+static inline void
+_set_ix(hmap *h, uint32_t i, uint32_t v)
+{
+  switch (h->e.compact.width) {
+    case 1:  ((uint8_t*)h->e.compact.index)[i]  = (uint8_t)v;  break;
+    case 2:  ((uint16_t*)h->e.compact.index)[i] = (uint16_t)v; break;
+    default: ((uint32_t*)h->e.compact.index)[i] = v;           break;
+  }
+}
+
+static void
+_init(hmap *h)
+{
+  _size_index(h, h->map_size);
+  h->e.compact.room    = MIN_ROOM;
+  h->e.compact.entries = malloc(MIN_ROOM * sizeof(compact_entry));
+  h->e.compact.used    = 0;
+  h->e.compact.dummies = 0;
+}
+
+static void
+_release(hmap *h)
+{
+  compact_entry *e;
+  if (h->rel) {
+    for (uint32_t i = 0; i < h->e.compact.used; i++) {
+      e = &h->e.compact.entries[i];
+      if (e->key) h->rel(e->key, e->item);
+    }
+  }
+  free(h->e.compact.entries);
+  free(h->e.compact.index);
+}
+
+/* A fresh, empty index of size slots, as narrow as its positions allow. */
+static void
+_size_index(hmap *h, uint32_t size)
+{
+  h->map_size = size;
+  h->e.compact.cap   = size / 3 * 2;
+  h->e.compact.width = size <= 256 ? 1 : size <= 65536 ? 2 : 4;
+  h->e.compact.index = calloc(size, h->e.compact.width);
+}
+
+static void
+_put(hmap *h, uint64_t hash, void *key, size_t len, void *val)
+{
+  bool found;
+  compact_entry *e = _upsert(h, hash, key, len, &found);
+  if (found) {
+    hmap_release_replaced(h, e->key, e->item, key, val);
+    e->key = key;
+  }
+  e->item = val;
+}
+
+static void**
+_slot(hmap *h, uint64_t hash, void *key, size_t len, bool *created)
+{
+  bool found;
+  compact_entry *e = _upsert(h, hash, key, len, &found);
+  *created = !found;
+  return &e->item;
+}
+
+/*
+ * The entry for key, or a new one appended for it with a NULL item. An
+ * insert makes room only once the probe has missed, so overwriting a key
+ * never grows the table; it then probes again, for its place in the new
+ * index. A new entry takes the first removed slot on its probe path, if
+ * any.
+ */
+static compact_entry *
+_upsert(hmap *h, uint64_t hash, void *key, size_t len, bool *found)
+{
+  compact_entry *e;
+  uint32_t h32 = _fold(hash);
+  uint32_t mask, idx, v, free_at;
+
+  for (;;) {
+    mask = h->map_size - 1;
+    free_at = UINT32_MAX;
+    for (idx = _home(h32, mask); ; idx = (idx + 1) & mask) {
+      v = _ix(h, idx);
+      if (v == IX_EMPTY) break;
+      if (v == IX_DUMMY) {
+        if (free_at == UINT32_MAX) free_at = idx;
+        continue;
+      }
+      e = &h->e.compact.entries[v - IX_FIRST];
+      if (hmap_key_match(e->hash, e->len, e->key, h32, len, key)) {
+        *found = true;
+        return e;
+      }
+    }
+    if (h->e.compact.used < h->e.compact.room &&
+        h->item_count + h->e.compact.dummies < h->e.compact.cap) {
+      break;
+    }
+    _make_room(h);
+  }
+  if (free_at != UINT32_MAX) {
+    idx = free_at;
+    h->e.compact.dummies--;
+  }
+  _set_ix(h, idx, h->e.compact.used + IX_FIRST);
+  e = &h->e.compact.entries[h->e.compact.used++];
+  e->key  = key;
+  e->item = NULL;
+  e->hash = h32;
+  e->len  = (uint32_t)len;
+  h->item_count++;
+  *found = false;
+  return e;
+}
+
+/* The index slot pointing at key's entry, or UINT32_MAX. */
+static uint32_t
+_lookup(hmap *h, uint32_t h32, const void *key, size_t len)
+{
+  const compact_entry *e;
+  uint32_t mask = h->map_size - 1;
+  uint32_t idx, v;
+
+  for (idx = _home(h32, mask); ; idx = (idx + 1) & mask) {
+    v = _ix(h, idx);
+    if (v == IX_EMPTY) return UINT32_MAX;
+    if (v == IX_DUMMY) continue;
+    e = &h->e.compact.entries[v - IX_FIRST];
+    if (hmap_key_match(e->hash, e->len, e->key, h32, len, key)) return idx;
+  }
+}
+
+static void*
+_get(hmap *h, uint64_t hash, const void *key, size_t len)
+{
+  uint32_t idx = _lookup(h, _fold(hash), key, len);
+  if (idx == UINT32_MAX) return NULL;
+  return h->e.compact.entries[_ix(h, idx) - IX_FIRST].item;
+}
+
+/* The last entry is simply dropped; any other leaves a hole. */
+static void
+_remove(hmap *h, uint64_t hash, const void *key, size_t len)
+{
+  uint32_t idx = _lookup(h, _fold(hash), key, len);
+  uint32_t pos;
+
+  if (idx == UINT32_MAX) return;
+  pos = _ix(h, idx) - IX_FIRST;
+  _set_ix(h, idx, IX_DUMMY);
+  h->e.compact.dummies++;
+  h->e.compact.entries[pos].key = NULL;
+  if (pos + 1 == h->e.compact.used) h->e.compact.used--;
+  h->item_count--;
+}
+
+/* Stage 0: the home index slot; stage 1: the entry it points at. */
+static void
+_prefetch(hmap *h, uint64_t hash, int stage)
+{
+  uint32_t idx = _home(_fold(hash), h->map_size - 1);
+  uint32_t v;
+  if (stage == 0) {
+    HMAP_PREFETCH((const char*)h->e.compact.index + idx * h->e.compact.width);
+  } else if ((v = _ix(h, idx)) >= IX_FIRST) {
+    HMAP_PREFETCH(&h->e.compact.entries[v - IX_FIRST]);
+  }
+}
+
+/* Insertion order. Only 32 bits of each hash are kept, so the full hash
+   a visitor is owed is worked out again from the key. */
+static void
+_each(hmap *h, hmap_visit fn, void *ctx)
+{
+  compact_entry *e;
+  for (uint32_t i = 0; i < h->e.compact.used; i++) {
+    e = &h->e.compact.entries[i];
+    if (e->key) fn(ctx, h->hash(e->key, e->len, h->seed), e->key, e->len,
+                   e->item);
+  }
+}
+
+static void
+_iter_init(hmap *h, hmap_iter *it)
+{
+  (void)h;
+  it->pos = 0;
+}
+
+static bool
+_iter_next(hmap_iter *it, void **key, size_t *len, void **item)
+{
+  hmap *h = it->h;
+  compact_entry *e;
+  while (it->pos < h->e.compact.used) {
+    e = &h->e.compact.entries[it->pos++];
+    if (!e->key) continue;
+    *key  = e->key;
+    *len  = e->len;
+    *item = e->item;
+    return true;
+  }
+  return false;
+}
+
+/* Room for n items: an index whose 2/3 limit takes them, holes squeezed
+   out if need be, and an entry array long enough for the rest. */
+static void
+_reserve(hmap *h, uint32_t n)
+{
+  uint32_t size  = h->map_size;
+  uint32_t extra = n > h->item_count ? n - h->item_count : 0;
+  uint32_t room;
+
+  while (size / 3 * 2 < n && size < (1u << 31)) size <<= 1;
+  if (size != h->map_size ||
+      (uint64_t)h->e.compact.used + extra > h->e.compact.cap) {
+    _rebuild(h, size);
+  }
+  room = h->e.compact.used + extra;
+  if (room > h->e.compact.cap) room = h->e.compact.cap;
+  if (room > h->e.compact.room) {
+    h->e.compact.entries = realloc(h->e.compact.entries,
+                                   room * sizeof(compact_entry));
+    h->e.compact.room = room;
+  }
+}
+
+static void
+_put_bulk(hmap *h, const uint64_t *hash, char **keys, const uint32_t *len,
+          void **vals, size_t n)
+{
+  for (size_t i = 0; i < n; i++) {
+    if (i + PREFETCH_AHEAD < n) _prefetch(h, hash[i + PREFETCH_AHEAD], 0);
+    _put(h, hash[i], keys[i], len[i], vals[i]);
+  }
+}
+
+/* Probes are index slots from home; tombstones, the holes removes left
+   in the entry array. */
+static void
+_stats(hmap *h, hmap_stats *s, bool walk)
+{
+  uint32_t mask = h->map_size - 1;
+  uint32_t *per_home, v;
+  const compact_entry *e;
+
+  s->bytes = (size_t)h->map_size * h->e.compact.width
+             + (size_t)h->e.compact.room * sizeof(compact_entry);
+  if (!walk) return;
+  s->tombstones = h->e.compact.used - h->item_count;
+  per_home = calloc(h->map_size, sizeof(uint32_t));
+  for (uint32_t i = 0; i < h->map_size; i++) {
+    v = _ix(h, i);
+    if (v < IX_FIRST) continue;
+    e = &h->e.compact.entries[v - IX_FIRST];
+    hmap_stats_probe(s, (i - _home(e->hash, mask)) & mask);
+    per_home[_home(e->hash, mask)]++;
+  }
+  hmap_stats_spread(s, per_home, h->map_size);
+  free(per_home);
+}
+
+/* The entry array is full: grow it by half, up to the index's limit, or
+   else rebuild, doubling the index unless a quarter of the array or
+   more is holes. A rebuild also clears the index once removed slots have
+   filled it, which put and remove of the last entry can do with the
+   array nowhere near full. */
+static void
+_make_room(hmap *h)
+{
+  uint32_t room = h->e.compact.room;
+
+  if (room < h->e.compact.cap &&
+      h->item_count + h->e.compact.dummies < h->e.compact.cap) {
+    room += room / 2;
+    if (room > h->e.compact.cap) room = h->e.compact.cap;
+    h->e.compact.entries = realloc(h->e.compact.entries,
+                                   room * sizeof(compact_entry));
+    h->e.compact.room = room;
+    return;
+  }
+  _rebuild(h, (uint64_t)h->item_count * 4 > (uint64_t)h->e.compact.cap * 3
+                 ? h->map_size << 1 : h->map_size);
+}
+
+/* Squeeze the holes out of the entry array, keeping order, and index the
+   rest afresh in an index of size slots. Stored hashes spare a rehash. */
+static void
+_rebuild(hmap *h, uint32_t size)
+{
+  compact_entry *e = h->e.compact.entries;
+  uint32_t n = 0, mask, idx, room;
+
+  for (uint32_t i = 0; i < h->e.compact.used; i++) {
+    if (e[i].key) e[n++] = e[i];
+  }
+  free(h->e.compact.index);
+  _size_index(h, size);
+  h->resizes++;
+  mask = size - 1;
+  for (uint32_t i = 0; i < n; i++) {
+    idx = _home(e[i].hash, mask);
+    while (_ix(h, idx) != IX_EMPTY) idx = (idx + 1) & mask;
+    _set_ix(h, idx, i + IX_FIRST);
+  }
+  room = n + n / 2 + MIN_ROOM;
+  if (room > h->e.compact.cap) room = h->e.compact.cap;
+  h->e.compact.entries = realloc(e, room * sizeof(compact_entry));
+  h->e.compact.room = room;
+  h->e.compact.used = n;
+  h->e.compact.dummies = 0;
+}
@@ -0,0 +1,241 @@
+#ifndef _HASH_MAP_ENGINE_H
+#define _HASH_MAP_ENGINE_H
+/* ------------------------------------------------------------------------- *\
+   Hash Map Engines
+     - Internal to hmap: not part of the public interface.
+     - hash-map.c owns the public functions and hashes each key exactly
+       once; it then hands the hash to the engine the map was created with.
+     - Each engine lives in its own hash-map-<engine>.c file and exports a
+       single table of operations.
+   -------------------------------------------------------------------------
+   LICENSE: This program is free software. You can modify it and/or re-
+   distribute it under the terms of the Apache 2.0 License. You should have
+   received a copy of the Apache 2.0 License along with this program. If
+   not, please see: http://www.apache.org/licenses/LICENSE-2.0.txt
+
+   DISCLAIMER: This program is distributed in the hope that it will be
+   useful, but without any warrantee; without even the implied warantee
+   of fitness for any particular purpose. See the License for more details.
+\* ------------------------------------------------------------------------- */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include "hash-map.h"
+
+/* Chained: a bucket array of singly linked nodes. With inline keys, the
+   key's bytes follow the node in the same allocation, and key points at
+   them: a short key shares the node's cache line. Nodes put in bulk are
+   carved from one slab per call, not allocated one by one. */
+typedef struct map_node {
+  uint64_t hash;
+  uint32_t len;
+  bool     in_slab;  /* put by hmap_put_bulk: freed with its slab. */
+  void * key;
+  void* item;
+  struct map_node *next;
+  char     inline_key[];
+} map_node;
+
+/* Open addressing (Robin Hood, Swiss): one flat slot array. */
+typedef struct oa_slot {
+  uint64_t hash;
+  uint32_t len;
+  void *key;
+  void *item;
+} oa_slot;
+
+/* Compact: entries in insertion order; the index holds their positions.
+   A removed entry keeps its place, with a NULL key, until a resize. The
+   hash is folded to 32 bits, to keep entries at 24 bytes. */
+typedef struct compact_entry {
+  void    *key;
+  void    *item;
+  uint32_t hash;
+  uint32_t len;
+} compact_entry;
+
+/*
+ * Equal bytes? Keys of 4 to 32 bytes are compared with a few fixed-width
+ * loads from each end, overlapping in the middle, rather than a call to
+ * memcmp; most keys are that short.
+ */
+static inline bool
+hmap_key_eq(const void *a, const void *b, size_t len)
+{
+  const unsigned char *x = a, *y = b;
+  uint64_t p[4], q[4];
+  uint32_t s[2], t[2];
+
+  if (len >= 8 && len <= 32) {
+    memcpy(&p[0], x, 8);           memcpy(&q[0], y, 8);
+    memcpy(&p[1], x + len - 8, 8); memcpy(&q[1], y + len - 8, 8);
+    if (len <= 16) return ((p[0] ^ q[0]) | (p[1] ^ q[1])) == 0;
+    memcpy(&p[2], x + 8, 8);       memcpy(&q[2], y + 8, 8);
+    memcpy(&p[3], x + len - 16, 8); memcpy(&q[3], y + len - 16, 8);
+    return ((p[0] ^ q[0]) | (p[1] ^ q[1]) |
+            (p[2] ^ q[2]) | (p[3] ^ q[3])) == 0;
+  }
+  if (len >= 4 && len < 8) {
+    memcpy(&s[0], x, 4);           memcpy(&t[0], y, 4);
+    memcpy(&s[1], x + len - 4, 4); memcpy(&t[1], y + len - 4, 4);
+    return ((s[0] ^ t[0]) | (s[1] ^ t[1])) == 0;
+  }
+  return memcmp(a, b, len) == 0;
+}
+
+/* Keys are bytes, not strings: reject on hash, then length, then bytes. */
+static inline bool
+hmap_key_match(uint64_t hash, uint32_t len, const void *key,
+               uint64_t seek_hash, size_t seek_len, const void *seek)
+{
+  return hash == seek_hash && len == seek_len && hmap_key_eq(key, seek, len);
+}
+
+#ifdef __GNUC__
+#define HMAP_PREFETCH(p) __builtin_prefetch(p)
+#else
+#define HMAP_PREFETCH(p) ((void)(p))
+#endif
+
+/* Called once per entry. */
+typedef void (*hmap_visit)(void *ctx, uint64_t hash, void *key, size_t len,
+                           void *item);
+
+/* Frozen: one slot of a file written by hmap_freeze. off is from the start
+   of the blob; 0 marks an empty slot. val_len is HMAP_FROZEN_NULL for a
+   NULL item. */
+typedef struct frozen_slot {
+  uint64_t hash;
+  uint64_t off;
+  uint32_t key_len;
+  uint32_t val_len;
+} frozen_slot;
+
+#define HMAP_FROZEN_NULL UINT32_MAX
+
+/*
+ * iter_init, iter_next: walk the visible entries, as each does, one per
+ * call; the engine keeps its place in the iterator's pos and node.
+ *
+ * slot: the address of key's item, after inserting key with a NULL item
+ * if it is absent; *created says which. Finds or inserts in one probe.
+ *
+ * prefetch: a hint only, no side effects. Stage 0 is called for a whole
+ * batch of hashes, then stage 1 for the same batch, then get: stage 0
+ * fetches the table entry for the hash, stage 1 whatever that entry
+ * leads to, so each stage's misses overlap across the batch.
+ *
+ * reserve: size the table, once, to hold n entries in all without
+ * growing again.
+ *
+ * put_bulk: put n keys, as n puts in array order would, their hashes and
+ * lengths worked out already; the table has been reserved for them.
+ *
+ * stats: bytes, always; with walk, the probe of every entry through
+ * hmap_stats_probe, tombstones, and entries per home through
+ * hmap_stats_spread. Must not change the table: a chained map's resize
+ * under way is walked as it stands.
+ */
+typedef struct hmap_engine_ops {
+  void  (*init)(hmap*);
+  void  (*release)(hmap*);
+  void  (*put)(hmap*, uint64_t hash, void *key, size_t len, void *val);
+  void* (*get)(hmap*, uint64_t hash, const void *key, size_t len);
+  void  (*remove)(hmap*, uint64_t hash, const void *key, size_t len);
+  void  (*prefetch)(hmap*, uint64_t hash, int stage);
+  void  (*each)(hmap*, hmap_visit, void *ctx);
+  void** (*slot)(hmap*, uint64_t hash, void *key, size_t len, bool *created);
+  void  (*iter_init)(hmap*, hmap_iter*);
+  bool  (*iter_next)(hmap_iter*, void **key, size_t *len, void **item);
+  void  (*reserve)(hmap*, uint32_t n);
+  void  (*put_bulk)(hmap*, const uint64_t *hash, char **keys,
+                    const uint32_t *len, void **vals, size_t n);
+  void  (*stats)(hmap*, hmap_stats*, bool walk);
+} hmap_engine_ops;
+
+struct hmap {
+  const hmap_engine_ops *ops;
+  hmap_hash_fn hash;
+  uint64_t     seed;
+  union {
+    struct {
+      map_node **nodes;
+      map_node **old_nodes;  /* non-NULL while a resize is under way. */
+      uint32_t   old_size;
+      uint32_t   migrate;    /* next old bucket to move. */
+      void      *slabs;      /* node blocks from put_bulk, in a list. */
+    } chained;
+    struct {
+      oa_slot   *slots;      /* an empty slot has a NULL key. */
+    } rh;
+    struct {
+      oa_slot   *slots;
+      uint8_t   *ctrl;       /* one control byte per slot. */
+      uint32_t   growth_left;
+    } swiss;
+    struct {
+      compact_entry *entries;
+      void          *index;  /* map_size uint8, 16 or 32 bit positions. */
+      uint32_t       used;   /* entries appended, removed ones included. */
+      uint32_t       dummies; /* index slots of removed entries. */
+      uint32_t       room;   /* entries allocated. */
+      uint32_t       cap;    /* most entries the index takes: 2/3 of it. */
+      uint8_t        width;  /* bytes per index slot. */
+    } compact;
+    struct {
+      const void        *base;   /* the whole mapped file. */
+      size_t             length;
+      const frozen_slot *slots;
+      const char        *blob;
+    } frozen;
+  } e;
+  uint32_t    map_size;   /* buckets or slots; always a power of two. */
+  uint32_t    item_count;
+  uint32_t    resizes;    /* counted by the engines, for hmap_get_stats. */
+  map_destructor rel;
+  bool        inline_keys;  /* chained nodes carry a copy of their key. */
+  oc_filter  *filter;       /* attached by hmap_attach_filter, or NULL. */
+  struct {
+    uint64_t gets, misses, puts, removes, filtered;
+  } counts;                 /* kept only with HMAP_COUNTERS. */
+};
+
+/*
+ * A put that replaces an entry: its old key and item go to the
+ * destructor, each only if the put does not store the same pointer
+ * again, with NULL in its place; no call at all if neither goes.
+ */
+static inline void
+hmap_release_replaced(const hmap *h, void *old_key, void *old_item,
+                      const void *key, const void *val)
+{
+  void *k = old_key != key ? old_key : NULL;
+  void *v = old_item != val ? old_item : NULL;
+  if (h->rel && (k || v)) h->rel(k, v);
+}
+
+extern const hmap_engine_ops hmap_chained_ops;
+extern const hmap_engine_ops hmap_robin_hood_ops;
+extern const hmap_engine_ops hmap_swiss_ops;
+extern const hmap_engine_ops hmap_compact_ops;
+extern const hmap_engine_ops hmap_frozen_ops;
+
+/* Bulk puts: 0 .. n-1 in the order that fills the table from one end to
+   the other, by the top bits of each hash's home as home gives it; keys
+   with the same home keep their order. hash-map.c. */
+uint32_t *hmap_bulk_order(const hmap*, const uint64_t *hash, size_t n,
+                          uint32_t (*home)(const hmap*, uint64_t hash));
+
+/* Stats walks: one entry's probe, into the histogram, max, collisions
+   and, until hmap_get_stats divides it, the sum in mean_probe; and the
+   variance of per_home, entries at each of homes homes. hash-map.c. */
+void hmap_stats_probe(hmap_stats*, uint32_t probe);
+void hmap_stats_spread(hmap_stats*, const uint32_t *per_home, uint32_t homes);
+
+/* Frozen tables: hash-map-frozen.c. */
+bool hmap_frozen_write(hmap*, const char *path, hmap_item_len);
+bool hmap_frozen_load(hmap*, const char *path);
+
+#endif
@@ -0,0 +1,425 @@
+/* ------------------------------------------------------------------------- *\
+   Hash Map: Frozen Engine
+     - A read-only table answered straight from a file written by
+       hmap_freeze and mapped by hmap_open_mmap: no parsing, and no
+       allocation per entry. Pages of the file are shared by every
+       process that maps it.
+     - File layout, all offsets from the start of the file, in the
+       byte order of the machine that wrote it:
+         header   magic, hash kind and seed, slot and item counts, and
+                  the offsets of the other two parts.
+         slots    a power of two of frozen_slots, linearly probed from
+                  a Fibonacci-mixed home, at most 3/4 full.
+         blob     each entry's key bytes, a NUL, then its item's bytes
+                  and a NUL. Byte 0 of the blob is unused, so an offset
+                  of 0 can mark an empty slot.
+     - Items are frozen as C strings, or as the bytes an item_len callback
+       counts, each followed by a NUL; get returns a pointer into the
+       mapping, which is read-only.
+     - A freeze writes a temporary file made by mkstemp next to path and
+       renames it into place, so writers to one path never share a file.
+     - put and remove do nothing, and slot returns NULL.
+   -------------------------------------------------------------------------
+   LICENSE: This program is free software. You can modify it and/or re-
+   distribute it under the terms of the Apache 2.0 License. You should have
+   received a copy of the Apache 2.0 License along with this program. If
+   not, please see: http://www.apache.org/licenses/LICENSE-2.0.txt
+
+   DISCLAIMER: This program is distributed in the hope that it will be
+   useful, but without any warrantee; without even the implied warantee
+   of fitness for any particular purpose. See the License for more details.
+\* ------------------------------------------------------------------------- */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "hash-map-engine.h"
+
+#define MAGIC    "OCHMAPF1"
+#define FIB_MULT 0x9E3779B97F4A7C15ULL
+
+/* Hash functions a file can name. */
+#define HASH_WY  1
+#define HASH_DJB 2
+
+typedef struct frozen_header {
+  char     magic[8];
+  uint32_t hash_kind;
+  uint32_t slot_count;
+  uint64_t seed;
+  uint64_t item_count;
+  uint64_t slots_off;
+  uint64_t blob_off;
+  uint64_t blob_len;
+} frozen_header;
+
+/* What hmap_frozen_write gathers before writing. */
+typedef struct frozen_build {
+  oa_slot      *slots;      /* an empty slot has a NULL key. */
+  uint32_t     *item_len;   /* by slot: its item's size, measured once. */
+  hmap_item_len len_of;     /* NULL for C string items. */
+  uint32_t      mask;
+  uint64_t      items;
+  uint64_t      blob_len;
+  bool          ok;         /* false once an item is too big. */
+} frozen_build;
+
+/* Private declarations. */
+static void  _init(hmap*);
+static void  _release(hmap*);
+static void  _put(hmap*, uint64_t, void*, size_t, void*);
+static void* _get(hmap*, uint64_t, const void*, size_t);
+static void  _remove(hmap*, uint64_t, const void*, size_t);
+static void  _prefetch(hmap*, uint64_t, int);
+static void  _each(hmap*, hmap_visit, void*);
+static void** _slot(hmap*, uint64_t, void*, size_t, bool*);
+static void  _iter_init(hmap*, hmap_iter*);
+static bool  _iter_next(hmap_iter*, void**, size_t*, void**);
+static void  _reserve(hmap*, uint32_t);
+static void  _put_bulk(hmap*, const uint64_t*, char**, const uint32_t*,
+                       void**, size_t);
+static void  _stats(hmap*, hmap_stats*, bool);
+static void  _gather(void*, uint64_t, void*, size_t, void*);
+static bool  _write(FILE*, const frozen_build*, const frozen_header*);
+static inline uint32_t _home(uint64_t hash, uint32_t mask);
+
+const hmap_engine_ops hmap_frozen_ops = {
+  _init, _release, _put, _get, _remove, _prefetch, _each, _slot,
+  _iter_init, _iter_next, _reserve, _put_bulk, _stats
+};
+
+static inline uint32_t
+_home(uint64_t hash, uint32_t mask)
+{
+  return (uint32_t)((hash * FIB_MULT) >> 32) & mask;
+}
+
+/* Frozen maps come only from hmap_frozen_load. */
+static void
+_init(hmap *h)
+{
+  (void)h;
+}
+
+static void
+_release(hmap *h)
+{
+  munmap((void*)(uintptr_t)h->e.frozen.base, h->e.frozen.length);
+}
+
+static void
+_put(hmap *h, uint64_t hash, void *key, size_t len, void *val)
+{
+  (void)h; (void)hash; (void)key; (void)len; (void)val;
+}
+
+static void
+_remove(hmap *h, uint64_t hash, const void *key, size_t len)
+{
+  (void)h; (void)hash; (void)key; (void)len;
+}
+
+static void
+_reserve(hmap *h, uint32_t n)
+{
+  (void)h; (void)n;
+}
+
+static void
+_put_bulk(hmap *h, const uint64_t *hash, char **keys, const uint32_t *len,
+          void **vals, size_t n)
+{
+  (void)h; (void)hash; (void)keys; (void)len; (void)vals; (void)n;
+}
+
+/* No slot in a read-only mapping can be handed out for writing. */
+static void**
+_slot(hmap *h, uint64_t hash, void *key, size_t len, bool *created)
+{
+  (void)h; (void)hash; (void)key; (void)len;
+  *created = false;
+  return NULL;
+}
+
+static void*
+_get(hmap *h, uint64_t hash, const void *key, size_t len)
+{
+  const frozen_slot *s;
+  const char *k;
+  uint32_t mask = h->map_size - 1;
+
+  for (uint32_t idx = _home(hash, mask); ; idx = (idx + 1) & mask) {
+    s = &h->e.frozen.slots[idx];
+    if (!s->off) return NULL;
+    k = h->e.frozen.blob + s->off;
+    if (hmap_key_match(s->hash, s->key_len, k, hash, len, key)) {
+      if (s->val_len == HMAP_FROZEN_NULL) return NULL;
+      return (void*)(uintptr_t)(k + s->key_len + 1);
+    }
+  }
+}
+
+/* Stage 0: the home slot; stage 1: the key it points at. */
+static void
+_prefetch(hmap *h, uint64_t hash, int stage)
+{
+  const frozen_slot *s = &h->e.frozen.slots[_home(hash, h->map_size - 1)];
+  if (stage == 0) {
+    HMAP_PREFETCH(s);
+  } else if (s->off) {
+    HMAP_PREFETCH(h->e.frozen.blob + s->off);
+  }
+}
+
+static void
+_each(hmap *h, hmap_visit fn, void *ctx)
+{
+  const frozen_slot *s;
+  const char *k;
+  void *item;
+
+  for (uint32_t i = 0; i < h->map_size; i++) {
+    s = &h->e.frozen.slots[i];
+    if (!s->off) continue;
+    k = h->e.frozen.blob + s->off;
+    item = s->val_len == HMAP_FROZEN_NULL ? NULL
+                                          : (void*)(uintptr_t)(k + s->key_len + 1);
+    fn(ctx, s->hash, (void*)(uintptr_t)k, s->key_len, item);
+  }
+}
+
+/* The map's bytes are the file's, shared with whoever else maps it. */
+static void
+_stats(hmap *h, hmap_stats *s, bool walk)
+{
+  uint32_t mask = h->map_size - 1;
+  uint32_t *per_home;
+  const frozen_slot *slot;
+
+  s->bytes = h->e.frozen.length;
+  if (!walk) return;
+  per_home = calloc(h->map_size, sizeof(uint32_t));
+  for (uint32_t i = 0; i < h->map_size; i++) {
+    slot = &h->e.frozen.slots[i];
+    if (!slot->off) continue;
+    hmap_stats_probe(s, (i - _home(slot->hash, mask)) & mask);
+    per_home[_home(slot->hash, mask)]++;
+  }
+  hmap_stats_spread(s, per_home, h->map_size);
+  free(per_home);
+}
+
+static void
+_iter_init(hmap *h, hmap_iter *it)
+{
+  (void)h;
+  it->pos = 0;
+}
+
+static bool
+_iter_next(hmap_iter *it, void **key, size_t *len, void **item)
+{
+  hmap *h = it->h;
+  const frozen_slot *s;
+  const char *k;
+
+  while (it->pos < h->map_size) {
+    s = &h->e.frozen.slots[it->pos++];
+    if (!s->off) continue;
+    k = h->e.frozen.blob + s->off;
+    *key  = (void*)(uintptr_t)k;
+    *len  = s->key_len;
+    *item = s->val_len == HMAP_FROZEN_NULL ? NULL
+                                           : (void*)(uintptr_t)(k + s->key_len + 1);
+    return true;
+  }
+  return false;
+}
+
+/* ------------------------------------------------------------------------- *\
+   writing and loading.
+\* ------------------------------------------------------------------------- */
+
+/*
+ * Write h's entries to path, by way of a temporary file renamed into
+ * place, so a reader never maps a half-written table. mkstemp gives each
+ * writer its own temporary file; it is made readable to all, as the
+ * mapping is meant to be shared. The hash must be one a file can name: a
+ * function pointer means nothing to another process.
+ */
+bool
+hmap_frozen_write(hmap *h, const char *path, hmap_item_len len_of)
+{
+  frozen_build b;
+  frozen_header hd;
+  uint32_t size = 16;
+  size_t plen = strlen(path);
+  char *tmp;
+  FILE *f = NULL;
+  bool ok;
+  int fd;
+
+  memset(&hd, 0, sizeof(hd));
+  if (h->hash == hmap_hash_wy) {
+    hd.hash_kind = HASH_WY;
+  } else if (h->hash == hmap_hash_djb) {
+    hd.hash_kind = HASH_DJB;
+  } else {
+    return false;
+  }
+  while ((uint64_t)size * 3 < (uint64_t)h->item_count * 4) size <<= 1;
+
+  b.slots    = calloc(size, sizeof(oa_slot));
+  b.item_len = malloc(size * sizeof(uint32_t));
+  b.len_of   = len_of;
+  b.mask     = size - 1;
+  b.items    = 0;
+  b.blob_len = 1;
+  b.ok       = true;
+  if (b.slots && b.item_len) h->ops->each(h, _gather, &b);
+  if (!b.slots || !b.item_len || !b.ok) {
+    free(b.slots);
+    free(b.item_len);
+    return false;
+  }
+
+  memcpy(hd.magic, MAGIC, sizeof(hd.magic));
+  hd.seed       = h->seed;
+  hd.slot_count = size;
+  hd.item_count = b.items;
+  hd.slots_off  = sizeof(frozen_header);
+  hd.blob_off   = hd.slots_off + (uint64_t)size * sizeof(frozen_slot);
+  hd.blob_len   = b.blob_len;
+
+  tmp = malloc(plen + 8);
+  memcpy(tmp, path, plen);
+  memcpy(tmp + plen, ".XXXXXX", 8);
+  fd = mkstemp(tmp);
+  if (fd >= 0) {
+    if (fchmod(fd, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH) == 0) {
+      f = fdopen(fd, "wb");
+    }
+    if (!f) close(fd);
+  }
+  ok = f && _write(f, &b, &hd);
+  if (f && fclose(f) != 0) ok = false;
+  if (ok) ok = rename(tmp, path) == 0;
+  if (!ok && fd >= 0) remove(tmp);
+  free(tmp);
+  free(b.slots);
+  free(b.item_len);
+  return ok;
+}
+
+/* Place one entry in the build table, its item measured once. */
+static void
+_gather(void *ctx, uint64_t hash, void *key, size_t len, void *item)
+{
+  frozen_build *b = ctx;
+  uint32_t idx = _home(hash, b->mask);
+  size_t ilen = 0;
+  oa_slot *s;
+
+  if (item) ilen = b->len_of ? b->len_of(item) : strlen(item);
+  if (ilen >= HMAP_FROZEN_NULL) b->ok = false;
+  if (!b->ok) return;
+  while (b->slots[idx].key) idx = (idx + 1) & b->mask;
+  s = &b->slots[idx];
+  s->hash = hash;
+  s->len  = (uint32_t)len;
+  s->key  = key;
+  s->item = item;
+  b->item_len[idx] = (uint32_t)ilen;
+  b->items++;
+  b->blob_len += len + 1 + (item ? ilen + 1 : 0);
+}
+
+static bool
+_write(FILE *f, const frozen_build *b, const frozen_header *hd)
+{
+  frozen_slot fs;
+  const oa_slot *s;
+  uint64_t off = 1;
+  uint32_t vlen;
+
+  if (fwrite(hd, sizeof(*hd), 1, f) != 1) return false;
+  for (uint32_t i = 0; i <= b->mask; i++) {
+    s = &b->slots[i];
+    memset(&fs, 0, sizeof(fs));
+    if (s->key) {
+      vlen = b->item_len[i];
+      fs.hash    = s->hash;
+      fs.off     = off;
+      fs.key_len = s->len;
+      fs.val_len = s->item ? vlen : HMAP_FROZEN_NULL;
+      off += s->len + 1 + (s->item ? (uint64_t)vlen + 1 : 0);
+    }
+    if (fwrite(&fs, sizeof(fs), 1, f) != 1) return false;
+  }
+  if (fputc(0, f) == EOF) return false;
+  for (uint32_t i = 0; i <= b->mask; i++) {
+    s = &b->slots[i];
+    if (!s->key) continue;
+    if (fwrite(s->key, 1, s->len, f) != s->len || fputc(0, f) == EOF) {
+      return false;
+    }
+    vlen = b->item_len[i];
+    if (s->item && (fwrite(s->item, 1, vlen, f) != vlen ||
+                    fputc(0, f) == EOF)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/*
+ * Map path and point h at it. The header is checked against the file's
+ * size before anything in it is trusted; the slots and blob are not
+ * checked entry by entry, which would defeat the point.
+ */
+bool
+hmap_frozen_load(hmap *h, const char *path)
+{
+  const frozen_header *hd;
+  struct stat st;
+  void *base;
+  int fd = open(path, O_RDONLY);
+
+  if (fd < 0) return false;
+  if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(frozen_header)) {
+    close(fd);
+    return false;
+  }
+  base = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (base == MAP_FAILED) return false;
+
+  hd = base;
+  if (memcmp(hd->magic, MAGIC, sizeof(hd->magic)) != 0 ||
+      (hd->hash_kind != HASH_WY && hd->hash_kind != HASH_DJB) ||
+      hd->slot_count == 0 || (hd->slot_count & (hd->slot_count - 1)) ||
+      hd->slots_off != sizeof(frozen_header) ||
+      hd->blob_off != hd->slots_off +
+                      (uint64_t)hd->slot_count * sizeof(frozen_slot) ||
+      hd->blob_off + hd->blob_len != (uint64_t)st.st_size ||
+      hd->item_count >= hd->slot_count) {
+    munmap(base, (size_t)st.st_size);
+    return false;
+  }
+
+  h->hash        = hd->hash_kind == HASH_WY ? hmap_hash_wy : hmap_hash_djb;
+  h->seed        = hd->seed;
+  h->map_size    = hd->slot_count;
+  h->item_count  = (uint32_t)hd->item_count;
+  h->e.frozen.base   = base;
+  h->e.frozen.length = (size_t)st.st_size;
+  h->e.frozen.slots  = (const frozen_slot*)((const char*)base + hd->slots_off);
+  h->e.frozen.blob   = (const char*)base + hd->blob_off;
+  return true;
+}
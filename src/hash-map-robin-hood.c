@@ -0,0 +1,375 @@
+/* ------------------------------------------------------------------------- *\
+   Hash Map: Robin Hood Engine
+     - Open addressing over one flat array of oa_slots (hash, key, item),
+       so a lookup walks adjacent memory instead of chasing node pointers.
+     - Robin Hood probing: an insert that has travelled further from its
+       home slot than the resident takes that slot, and carries on with
+       the resident instead. Probe lengths stay short and even, and a
+       lookup can stop as soon as it meets a resident closer to home than
+       itself.
+     - Backward-shift deletion: no tombstones; the run after a removed
+       slot slides back one place.
+     - put replaces the item of an existing key, releasing the old key and
+       item through the destructor.
+     - Grows (doubling, reusing stored hashes) past MAX_LOAD.
+     - put_bulk inserts in home slot order, so the probes sweep the table
+       once from end to end.
+   -------------------------------------------------------------------------
+   LICENSE: This program is free software. You can modify it and/or re-
+   distribute it under the terms of the Apache 2.0 License. You should have
+   received a copy of the Apache 2.0 License along with this program. If
+   not, please see: http://www.apache.org/licenses/LICENSE-2.0.txt
+
+   DISCLAIMER: This program is distributed in the hope that it will be
+   useful, but without any warrantee; without even the implied warantee
+   of fitness for any particular purpose. See the License for more details.
+\* ------------------------------------------------------------------------- */
+
+#include <stdlib.h>
+#include <string.h>
+#include "hash-map-engine.h"
+
+/* Grow when the table would be more than 9/10ths full. */
+#define MAX_LOAD_NUM 9
+#define MAX_LOAD_DEN 10
+
+/* Private declarations. */
+static void  _init(hmap*);
+static void  _release(hmap*);
+static void  _put(hmap*, uint64_t, void*, size_t, void*);
+static void* _get(hmap*, uint64_t, const void*, size_t);
+static void  _remove(hmap*, uint64_t, const void*, size_t);
+static void  _prefetch(hmap*, uint64_t, int);
+static void  _each(hmap*, hmap_visit, void*);
+static void** _slot(hmap*, uint64_t, void*, size_t, bool*);
+static void  _iter_init(hmap*, hmap_iter*);
+static bool  _iter_next(hmap_iter*, void**, size_t*, void**);
+static void  _reserve(hmap*, uint32_t);
+static void  _put_bulk(hmap*, const uint64_t*, char**, const uint32_t*,
+                       void**, size_t);
+static void  _stats(hmap*, hmap_stats*, bool);
+static uint32_t _bulk_home(const hmap*, uint64_t);
+static oa_slot *_upsert(hmap*, uint64_t, void*, size_t, bool *found);
+static oa_slot *_find(hmap*, uint64_t, const void*, size_t);
+static void  _resize(hmap*, uint32_t size);
+static void  _place(oa_slot*, uint32_t mask, oa_slot, uint32_t, uint32_t);
+static inline uint32_t _home(uint64_t hash, uint32_t mask);
+static inline uint32_t _distance(uint64_t hash, uint32_t idx, uint32_t mask);
+
+const hmap_engine_ops hmap_robin_hood_ops = {
+  _init, _release, _put, _get, _remove, _prefetch, _each, _slot,
+  _iter_init, _iter_next, _reserve, _put_bulk, _stats
+};
+
+static void
+_init(hmap *h)
+{
+  h->e.rh.slots = calloc(h->map_size, sizeof(oa_slot));
+}
+
+static void
+_release(hmap *h)
+{
+  if (h->rel) {
+    for (uint32_t i = 0; i < h->map_size; i++) {
+      if (h->e.rh.slots[i].key) {
+        h->rel(h->e.rh.slots[i].key, h->e.rh.slots[i].item);
+      }
+    }
+  }
+  free(h->e.rh.slots);
+}
+
+/*
+ * Linear probing punishes runs of neighbouring hashes, which similar keys
+ * produce, so the home slot comes from the middle bits of a Fibonacci
+ * multiply rather than the low bits of the hash.
+ */
+#define FIB_MULT 0x9E3779B97F4A7C15ULL
+
+static inline uint32_t
+_home(uint64_t hash, uint32_t mask)
+{
+  return (uint32_t)((hash * FIB_MULT) >> 32) & mask;
+}
+
+static inline uint32_t
+_distance(uint64_t hash, uint32_t idx, uint32_t mask)
+{
+  return (idx - _home(hash, mask)) & mask;
+}
+
+static void
+_put(hmap *h, uint64_t hash, void *key, size_t len, void *val)
+{
+  bool found;
+  oa_slot *s = _upsert(h, hash, key, len, &found);
+  if (found) {
+    hmap_release_replaced(h, s->key, s->item, key, val);
+    s->key = key;
+  }
+  s->item = val;
+}
+
+static void**
+_slot(hmap *h, uint64_t hash, void *key, size_t len, bool *created)
+{
+  bool found;
+  oa_slot *s = _upsert(h, hash, key, len, &found);
+  *created = !found;
+  return &s->item;
+}
+
+/*
+ * The slot holding key, or the slot key was just inserted into, with a
+ * NULL item. An insert that would pass the load limit grows the table
+ * first, so the slot returned stays put; at the limit, a lookup comes
+ * first, so overwriting a key never grows it.
+ */
+static oa_slot *
+_upsert(hmap *h, uint64_t hash, void *key, size_t len, bool *found)
+{
+  oa_slot ins, tmp, *s;
+  uint32_t mask, idx, dist, sdist;
+
+  if ((uint64_t)(h->item_count + 1) * MAX_LOAD_DEN >
+      (uint64_t)h->map_size * MAX_LOAD_NUM) {
+    if ((s = _find(h, hash, key, len))) {
+      *found = true;
+      return s;
+    }
+    _resize(h, h->map_size << 1);
+  }
+  mask = h->map_size - 1;
+  idx  = _home(hash, mask);
+  dist = 0;
+
+  /* Until something is displaced, ins is the caller's key and may already
+     be present. Once we pass a resident closer to home, it cannot be. */
+  for (;;) {
+    s = &h->e.rh.slots[idx];
+    if (!s->key) {
+      s->hash = hash;
+      s->len  = (uint32_t)len;
+      s->key  = key;
+      s->item = NULL;
+      break;
+    }
+    if (hmap_key_match(s->hash, s->len, s->key, hash, len, key)) {
+      *found = true;
+      return s;
+    }
+    sdist = _distance(s->hash, idx, mask);
+    if (sdist < dist) {
+      ins.hash = hash;
+      ins.len  = (uint32_t)len;
+      ins.key  = key;
+      ins.item = NULL;
+      tmp = *s;
+      *s  = ins;
+      _place(h->e.rh.slots, mask, tmp, (idx + 1) & mask, sdist + 1);
+      break;
+    }
+    idx = (idx + 1) & mask;
+    dist++;
+  }
+  h->item_count++;
+  *found = false;
+  return s;
+}
+
+static void*
+_get(hmap *h, uint64_t hash, const void *key, size_t len)
+{
+  oa_slot *s = _find(h, hash, key, len);
+  return s ? s->item : NULL;
+}
+
+/* The slot holding key, or NULL: the probe stops at an empty slot, or at
+   a resident closer to its home than key would be. */
+static oa_slot *
+_find(hmap *h, uint64_t hash, const void *key, size_t len)
+{
+  oa_slot *s;
+  uint32_t mask = h->map_size - 1;
+  uint32_t idx  = _home(hash, mask);
+  uint32_t dist = 0;
+
+  for (;;) {
+    s = &h->e.rh.slots[idx];
+    if (!s->key || _distance(s->hash, idx, mask) < dist) return NULL;
+    if (hmap_key_match(s->hash, s->len, s->key, hash, len, key)) return s;
+    idx = (idx + 1) & mask;
+    dist++;
+  }
+}
+
+static void
+_remove(hmap *h, uint64_t hash, const void *key, size_t len)
+{
+  oa_slot *s;
+  uint32_t mask = h->map_size - 1;
+  uint32_t idx  = _home(hash, mask);
+  uint32_t dist = 0;
+  uint32_t next;
+
+  for (;;) {
+    s = &h->e.rh.slots[idx];
+    if (!s->key || _distance(s->hash, idx, mask) < dist) return;
+    if (hmap_key_match(s->hash, s->len, s->key, hash, len, key)) break;
+    idx = (idx + 1) & mask;
+    dist++;
+  }
+  /* Backward shift: pull the rest of the run one slot toward home. */
+  next = (idx + 1) & mask;
+  while (h->e.rh.slots[next].key &&
+         _distance(h->e.rh.slots[next].hash, next, mask) > 0) {
+    h->e.rh.slots[idx] = h->e.rh.slots[next];
+    idx  = next;
+    next = (next + 1) & mask;
+  }
+  h->e.rh.slots[idx].key = NULL;
+  h->item_count--;
+}
+
+/* Stage 0: the home slot; stage 1: the key stored there. */
+static void
+_prefetch(hmap *h, uint64_t hash, int stage)
+{
+  oa_slot *s = &h->e.rh.slots[_home(hash, h->map_size - 1)];
+  if (stage == 0) {
+    HMAP_PREFETCH(s);
+  } else if (s->key) {
+    HMAP_PREFETCH(s->key);
+  }
+}
+
+static void
+_each(hmap *h, hmap_visit fn, void *ctx)
+{
+  oa_slot *s;
+  for (uint32_t i = 0; i < h->map_size; i++) {
+    s = &h->e.rh.slots[i];
+    if (s->key) fn(ctx, s->hash, s->key, s->len, s->item);
+  }
+}
+
+static void
+_iter_init(hmap *h, hmap_iter *it)
+{
+  (void)h;
+  it->pos = 0;
+}
+
+static bool
+_iter_next(hmap_iter *it, void **key, size_t *len, void **item)
+{
+  hmap *h = it->h;
+  oa_slot *s;
+  while (it->pos < h->map_size) {
+    s = &h->e.rh.slots[it->pos++];
+    if (!s->key) continue;
+    *key  = s->key;
+    *len  = s->len;
+    *item = s->item;
+    return true;
+  }
+  return false;
+}
+
+/* Room for n items under MAX_LOAD. */
+static void
+_reserve(hmap *h, uint32_t n)
+{
+  uint32_t size = h->map_size;
+
+  while ((uint64_t)n * MAX_LOAD_DEN > (uint64_t)size * MAX_LOAD_NUM &&
+         size < (1u << 31)) {
+    size <<= 1;
+  }
+  if (size != h->map_size) _resize(h, size);
+}
+
+static void
+_stats(hmap *h, hmap_stats *s, bool walk)
+{
+  uint32_t mask = h->map_size - 1;
+  uint32_t *per_home;
+  oa_slot *slot;
+
+  s->bytes = (size_t)h->map_size * sizeof(oa_slot);
+  if (!walk) return;
+  per_home = calloc(h->map_size, sizeof(uint32_t));
+  for (uint32_t i = 0; i < h->map_size; i++) {
+    slot = &h->e.rh.slots[i];
+    if (!slot->key) continue;
+    hmap_stats_probe(s, _distance(slot->hash, i, mask));
+    per_home[_home(slot->hash, mask)]++;
+  }
+  hmap_stats_spread(s, per_home, h->map_size);
+  free(per_home);
+}
+
+static uint32_t
+_bulk_home(const hmap *h, uint64_t hash)
+{
+  return _home(hash, h->map_size - 1);
+}
+
+static void
+_put_bulk(hmap *h, const uint64_t *hash, char **keys, const uint32_t *len,
+          void **vals, size_t n)
+{
+  uint32_t *order = hmap_bulk_order(h, hash, n, _bulk_home);
+  uint32_t  i;
+
+  for (size_t k = 0; k < n; k++) {
+    i = order[k];
+    _put(h, hash[i], keys[i], len[i], vals[i]);
+  }
+  free(order);
+}
+
+/* Insert a slot known not to be in the table, starting the probe at idx,
+   dist slots from its home: no key comparisons. */
+static void
+_place(oa_slot *slots, uint32_t mask, oa_slot ins, uint32_t idx,
+       uint32_t dist)
+{
+  oa_slot tmp;
+  uint32_t sdist;
+
+  for (;;) {
+    if (!slots[idx].key) {
+      slots[idx] = ins;
+      return;
+    }
+    sdist = _distance(slots[idx].hash, idx, mask);
+    if (sdist < dist) {
+      tmp = slots[idx];
+      slots[idx] = ins;
+      ins  = tmp;
+      dist = sdist;
+    }
+    idx = (idx + 1) & mask;
+    dist++;
+  }
+}
+
+static void
+_resize(hmap *h, uint32_t size)
+{
+  oa_slot *old = h->e.rh.slots;
+  uint32_t old_size = h->map_size;
+
+  h->map_size = size;
+  h->e.rh.slots = calloc(h->map_size, sizeof(oa_slot));
+  h->resizes++;
+  for (uint32_t i = 0; i < old_size; i++) {
+    if (old[i].key) {
+      _place(h->e.rh.slots, h->map_size - 1, old[i],
+             _home(old[i].hash, h->map_size - 1), 0);
+    }
+  }
+  free(old);
+}
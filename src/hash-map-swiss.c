@@ -0,0 +1,426 @@
+/* ------------------------------------------------------------------------- *\
+   Hash Map: Swiss Engine
+     - Open addressing over a flat oa_slot array, plus one control byte per
+       slot: EMPTY, DELETED, or 7 bits of the key's hash when full.
+     - Slots are probed a group of 16 at a time: the group's control bytes
+       are compared against the 7 hash bits in one SSE2 compare + movemask,
+       and only the slots that match are looked at. A typical miss reads
+       one 16 byte group and never touches a key or calls memcmp.
+     - Groups are probed triangularly (1, 2, 3 ... groups on), which visits
+       every group of a power of two table once.
+     - Grows (doubling, reusing stored hashes) past 7/8ths full. Removal
+       leaves a tombstone only where a probe could have run through the
+       slot's group; tombstones are cleared by the next rehash.
+     - put replaces the item of an existing key, releasing the old key and
+       item through the destructor.
+     - put_bulk inserts in home group order, so the probes sweep the
+       table once from end to end.
+     - Without SSE2 the group match falls back to a byte loop.
+   -------------------------------------------------------------------------
+   LICENSE: This program is free software. You can modify it and/or re-
+   distribute it under the terms of the Apache 2.0 License. You should have
+   received a copy of the Apache 2.0 License along with this program. If
+   not, please see: http://www.apache.org/licenses/LICENSE-2.0.txt
+
+   DISCLAIMER: This program is distributed in the hope that it will be
+   useful, but without any warrantee; without even the implied warantee
+   of fitness for any particular purpose. See the License for more details.
+\* ------------------------------------------------------------------------- */
+
+#include <stdlib.h>
+#include <string.h>
+#include "hash-map-engine.h"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#define GROUP    16
+#define EMPTY    0x80
+#define DELETED  0xFE
+#define FIB_MULT 0x9E3779B97F4A7C15ULL
+
+/* Private declarations. */
+static void  _init(hmap*);
+static void  _release(hmap*);
+static void  _put(hmap*, uint64_t, void*, size_t, void*);
+static void* _get(hmap*, uint64_t, const void*, size_t);
+static void  _remove(hmap*, uint64_t, const void*, size_t);
+static void  _prefetch(hmap*, uint64_t, int);
+static void  _each(hmap*, hmap_visit, void*);
+static void  _iter_init(hmap*, hmap_iter*);
+static bool  _iter_next(hmap_iter*, void**, size_t*, void**);
+static void** _slot(hmap*, uint64_t, void*, size_t, bool*);
+static void  _reserve(hmap*, uint32_t);
+static void  _put_bulk(hmap*, const uint64_t*, char**, const uint32_t*,
+                       void**, size_t);
+static void  _stats(hmap*, hmap_stats*, bool);
+static uint32_t _steps(uint32_t from, uint32_t to, uint32_t gmask);
+static uint32_t _bulk_home(const hmap*, uint64_t);
+static oa_slot *_upsert(hmap*, uint64_t, void*, size_t, bool *found);
+static void  _alloc(hmap*, uint32_t size);
+static void  _rehash(hmap*, uint32_t size);
+static oa_slot *_find(hmap*, uint64_t, const void*, size_t);
+static uint32_t _find_free(hmap*, uint64_t);
+static inline uint32_t _match(const uint8_t *group, uint8_t byte);
+static inline uint32_t _match_free(const uint8_t *group);
+static inline uint32_t _lowest(uint32_t mask);
+
+const hmap_engine_ops hmap_swiss_ops = {
+  _init, _release, _put, _get, _remove, _prefetch, _each, _slot,
+  _iter_init, _iter_next, _reserve, _put_bulk, _stats
+};
+
+/*
+ * The group comes from the middle bits of a Fibonacci multiply, and the
+ * control byte from its top 7 bits, so the two are independent of each
+ * other and of the low bits that similar keys tend to share.
+ */
+#define MIX(hash)       ((hash) * FIB_MULT)
+#define H1(mix, gmask)  ((uint32_t)((mix) >> 32) & (gmask))
+#define H2(mix)         ((uint8_t)((mix) >> 57))
+
+#ifdef __SSE2__
+
+static inline uint32_t
+_match(const uint8_t *group, uint8_t byte)
+{
+  __m128i ctrl = _mm_loadu_si128((const __m128i*)group);
+  return (uint32_t)_mm_movemask_epi8(
+      _mm_cmpeq_epi8(ctrl, _mm_set1_epi8((char)byte)));
+}
+
+/* EMPTY and DELETED are the only control bytes with the high bit set. */
+static inline uint32_t
+_match_free(const uint8_t *group)
+{
+  return (uint32_t)_mm_movemask_epi8(
+      _mm_loadu_si128((const __m128i*)group));
+}
+
+#else
+
+static inline uint32_t
+_match(const uint8_t *group, uint8_t byte)
+{
+  uint32_t mask = 0;
+  for (int i = 0; i < GROUP; i++) {
+    if (group[i] == byte) mask |= 1u << i;
+  }
+  return mask;
+}
+
+static inline uint32_t
+_match_free(const uint8_t *group)
+{
+  uint32_t mask = 0;
+  for (int i = 0; i < GROUP; i++) {
+    if (group[i] & 0x80) mask |= 1u << i;
+  }
+  return mask;
+}
+
+#endif
+
+static inline uint32_t
+_lowest(uint32_t mask)
+{
+#ifdef __GNUC__
+  return (uint32_t)__builtin_ctz(mask);
+#else
+  uint32_t i = 0;
+  while (!(mask & 1)) { mask >>= 1; i++; }
+  return i;
+#endif
+}
+
+static void
+_alloc(hmap *h, uint32_t size)
+{
+  h->map_size = size;
+  h->e.swiss.slots = malloc(sizeof(oa_slot) * size);
+  h->e.swiss.ctrl  = malloc(size);
+  memset(h->e.swiss.ctrl, EMPTY, size);
+  h->e.swiss.growth_left = size - size / 8 - h->item_count;
+}
+
+static void
+_init(hmap *h)
+{
+  if (h->map_size < GROUP) h->map_size = GROUP;
+  _alloc(h, h->map_size);
+}
+
+static void
+_release(hmap *h)
+{
+  if (h->rel) {
+    for (uint32_t i = 0; i < h->map_size; i++) {
+      if (!(h->e.swiss.ctrl[i] & 0x80)) {
+        h->rel(h->e.swiss.slots[i].key, h->e.swiss.slots[i].item);
+      }
+    }
+  }
+  free(h->e.swiss.slots);
+  free(h->e.swiss.ctrl);
+}
+
+static oa_slot *
+_find(hmap *h, uint64_t hash, const void *key, size_t len)
+{
+  uint64_t mix   = MIX(hash);
+  uint32_t gmask = h->map_size / GROUP - 1;
+  uint32_t g     = H1(mix, gmask);
+  uint8_t  h2    = H2(mix);
+  const uint8_t *group;
+  oa_slot *s;
+  uint32_t m;
+
+  for (uint32_t probe = 1; ; probe++) {
+    group = h->e.swiss.ctrl + g * GROUP;
+    for (m = _match(group, h2); m; m &= m - 1) {
+      s = &h->e.swiss.slots[g * GROUP + _lowest(m)];
+      if (hmap_key_match(s->hash, s->len, s->key, hash, len, key)) return s;
+    }
+    if (_match(group, EMPTY)) return NULL;
+    g = (g + probe) & gmask;
+  }
+}
+
+/* The first EMPTY or DELETED slot on hash's probe sequence. */
+static uint32_t
+_find_free(hmap *h, uint64_t hash)
+{
+  uint64_t mix   = MIX(hash);
+  uint32_t gmask = h->map_size / GROUP - 1;
+  uint32_t g     = H1(mix, gmask);
+  uint32_t m;
+
+  for (uint32_t probe = 1; ; probe++) {
+    m = _match_free(h->e.swiss.ctrl + g * GROUP);
+    if (m) return g * GROUP + _lowest(m);
+    g = (g + probe) & gmask;
+  }
+}
+
+static void
+_put(hmap *h, uint64_t hash, void *key, size_t len, void *val)
+{
+  bool found;
+  oa_slot *s = _upsert(h, hash, key, len, &found);
+  if (found) {
+    hmap_release_replaced(h, s->key, s->item, key, val);
+    s->key = key;
+  }
+  s->item = val;
+}
+
+static void**
+_slot(hmap *h, uint64_t hash, void *key, size_t len, bool *created)
+{
+  bool found;
+  oa_slot *s = _upsert(h, hash, key, len, &found);
+  *created = !found;
+  return &s->item;
+}
+
+/* The slot holding key, or the slot key was just inserted into, with a
+   NULL item. */
+static oa_slot *
+_upsert(hmap *h, uint64_t hash, void *key, size_t len, bool *found)
+{
+  oa_slot *s = _find(h, hash, key, len);
+  uint32_t idx;
+
+  *found = s != NULL;
+  if (s) return s;
+  idx = _find_free(h, hash);
+  if (h->e.swiss.ctrl[idx] == EMPTY && h->e.swiss.growth_left == 0) {
+    /* Out of room through tombstones, with live entries under 25/32 of
+       the slots? Clean up in place; otherwise double. */
+    if ((uint64_t)h->item_count * 32 <= (uint64_t)h->map_size * 25) {
+      _rehash(h, h->map_size);
+    } else {
+      _rehash(h, h->map_size * 2);
+    }
+    idx = _find_free(h, hash);
+  }
+  if (h->e.swiss.ctrl[idx] == EMPTY) h->e.swiss.growth_left--;
+  h->e.swiss.ctrl[idx] = H2(MIX(hash));
+  s = &h->e.swiss.slots[idx];
+  s->hash = hash;
+  s->len  = (uint32_t)len;
+  s->key  = key;
+  s->item = NULL;
+  h->item_count++;
+  return s;
+}
+
+static void*
+_get(hmap *h, uint64_t hash, const void *key, size_t len)
+{
+  oa_slot *s = _find(h, hash, key, len);
+  return s ? s->item : NULL;
+}
+
+static void
+_remove(hmap *h, uint64_t hash, const void *key, size_t len)
+{
+  oa_slot *s = _find(h, hash, key, len);
+  uint32_t idx;
+
+  if (!s) return;
+  idx = (uint32_t)(s - h->e.swiss.slots);
+  /* A probe stops at the first group holding an EMPTY, so if this group
+     already has one, no probe runs through it and the slot can be EMPTY. */
+  if (_match(h->e.swiss.ctrl + (idx & ~(uint32_t)(GROUP - 1)), EMPTY)) {
+    h->e.swiss.ctrl[idx] = EMPTY;
+    h->e.swiss.growth_left++;
+  } else {
+    h->e.swiss.ctrl[idx] = DELETED;
+  }
+  h->item_count--;
+}
+
+/* Stage 0: the home group's control bytes; stage 1: its first slot that
+   matches, if any. A miss usually needs nothing past stage 0. */
+static void
+_prefetch(hmap *h, uint64_t hash, int stage)
+{
+  uint64_t mix = MIX(hash);
+  uint32_t g   = H1(mix, h->map_size / GROUP - 1);
+  uint32_t m;
+
+  if (stage == 0) {
+    HMAP_PREFETCH(h->e.swiss.ctrl + g * GROUP);
+  } else {
+    m = _match(h->e.swiss.ctrl + g * GROUP, H2(mix));
+    if (m) HMAP_PREFETCH(&h->e.swiss.slots[g * GROUP + _lowest(m)]);
+  }
+}
+
+static void
+_each(hmap *h, hmap_visit fn, void *ctx)
+{
+  oa_slot *s;
+  for (uint32_t i = 0; i < h->map_size; i++) {
+    if (h->e.swiss.ctrl[i] & 0x80) continue;
+    s = &h->e.swiss.slots[i];
+    fn(ctx, s->hash, s->key, s->len, s->item);
+  }
+}
+
+static void
+_iter_init(hmap *h, hmap_iter *it)
+{
+  (void)h;
+  it->pos = 0;
+}
+
+static bool
+_iter_next(hmap_iter *it, void **key, size_t *len, void **item)
+{
+  hmap *h = it->h;
+  oa_slot *s;
+  while (it->pos < h->map_size) {
+    if (h->e.swiss.ctrl[it->pos] & 0x80) {
+      it->pos++;
+      continue;
+    }
+    s = &h->e.swiss.slots[it->pos++];
+    *key  = s->key;
+    *len  = s->len;
+    *item = s->item;
+    return true;
+  }
+  return false;
+}
+
+/* Room for n items in the 7/8ths of the slots a table fills. Tombstones
+   count against growth_left, so a table big enough but short of free
+   slots is cleaned up in place. */
+static void
+_reserve(hmap *h, uint32_t n)
+{
+  uint32_t size = h->map_size;
+
+  while ((uint64_t)n > size - size / 8 && size < (1u << 31)) size <<= 1;
+  if (size != h->map_size ||
+      (n > h->item_count && n - h->item_count > h->e.swiss.growth_left)) {
+    _rehash(h, size);
+  }
+}
+
+/* The home slot of the group, so parts follow the slot array. */
+static uint32_t
+_bulk_home(const hmap *h, uint64_t hash)
+{
+  return H1(MIX(hash), h->map_size / GROUP - 1) * GROUP;
+}
+
+static void
+_put_bulk(hmap *h, const uint64_t *hash, char **keys, const uint32_t *len,
+          void **vals, size_t n)
+{
+  uint32_t *order = hmap_bulk_order(h, hash, n, _bulk_home);
+  uint32_t  i;
+
+  for (size_t k = 0; k < n; k++) {
+    i = order[k];
+    _put(h, hash[i], keys[i], len[i], vals[i]);
+  }
+  free(order);
+}
+
+static void
+_rehash(hmap *h, uint32_t size)
+{
+  oa_slot *old_slots = h->e.swiss.slots;
+  uint8_t *old_ctrl  = h->e.swiss.ctrl;
+  uint32_t old_size  = h->map_size;
+  uint32_t idx;
+
+  _alloc(h, size);
+  h->resizes++;
+  for (uint32_t i = 0; i < old_size; i++) {
+    if (old_ctrl[i] & 0x80) continue;
+    idx = _find_free(h, old_slots[i].hash);
+    h->e.swiss.ctrl[idx]  = old_ctrl[i];
+    h->e.swiss.slots[idx] = old_slots[i];
+  }
+  free(old_slots);
+  free(old_ctrl);
+}
+
+/* A slot's probe is the groups a get steps through before its own. */
+static void
+_stats(hmap *h, hmap_stats *s, bool walk)
+{
+  uint32_t gmask = h->map_size / GROUP - 1;
+  uint32_t *per_home, home;
+  oa_slot *slot;
+
+  s->bytes = (size_t)h->map_size * (sizeof(oa_slot) + 1);
+  if (!walk) return;
+  per_home = calloc(gmask + 1, sizeof(uint32_t));
+  for (uint32_t i = 0; i < h->map_size; i++) {
+    if (h->e.swiss.ctrl[i] == DELETED) s->tombstones++;
+    if (h->e.swiss.ctrl[i] & 0x80) continue;
+    slot = &h->e.swiss.slots[i];
+    home = H1(MIX(slot->hash), gmask);
+    hmap_stats_probe(s, _steps(home, i / GROUP, gmask));
+    per_home[home]++;
+  }
+  hmap_stats_spread(s, per_home, gmask + 1);
+  free(per_home);
+}
+
+/* Steps of the triangular probe sequence from group from to group to;
+   it visits every group, so it always gets there. */
+static uint32_t
+_steps(uint32_t from, uint32_t to, uint32_t gmask)
+{
+  uint32_t probe = 0;
+  while (from != to) from = (from + ++probe) & gmask;
+  return probe;
+}
@@ -1,8 +1,11 @@
 /* ------------------------------------------------------------------------- *\
    Hash Map
-     - Basic hash map, requiring string keys.
+     - Basic hash map, with string keys, or byte keys of known length
+       through the _n functions (keys up to 4GB, may hold NUL bytes).
      - Prefix: hmap
      - May resize.
+     - Hashes the key and hands off to the engine chosen at create time;
+       see hash-map-engine.h.
    -------------------------------------------------------------------------
    LICENSE: This program is free software. You can modify it and/or re-
    distribute it under the terms of the Apache 2.0 License. You should have
@@ -14,28 +17,28 @@
    of fitness for any particular purpose. See the License for more details.
 \* ------------------------------------------------------------------------- */
 
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 #include "hash-map.h"
-
-typedef struct map_node {
-  uint64_t hash;
-  char * key;
-  void* item;
-  struct map_node *next;
-} map_node;
-
-struct hmap {
-  map_node ** nodes;
-  uint32_t    map_size;
-  uint32_t    item_count;
-  uint32_t    collisions;
-  map_destructor rel;
-};
+#include "hash-map-engine.h"
 
 /* Private declarations. */
-static void _free_map_node_list(map_node *, map_destructor);
-static uint64_t _hash_string(char * key);
+static inline uint64_t _hash(const hmap*, const void *key, size_t len);
+static inline void  _put(hmap*, uint64_t, void *key, size_t len, void *val);
+static inline void* _get(hmap*, uint64_t, const void *key, size_t len);
+static inline void  _remove(hmap*, uint64_t, const void *key, size_t len);
+static inline void** _slot(hmap*, uint64_t, void *key, size_t len,
+                           bool *created);
+static void _filter_add(void *ctx, uint64_t hash, void *key, size_t len,
+                        void *item);
+static const hmap_engine_ops *_engine_ops(hmap_engine);
+static uint64_t _table_seed(const hmap*);
+static inline void     _wymum(uint64_t *a, uint64_t *b);
+static inline uint64_t _wymix(uint64_t a, uint64_t b);
+static inline uint64_t _wyr8(const unsigned char *p);
+static inline uint64_t _wyr4(const unsigned char *p);
 
 /* Debugging and test accessors. */
 uint32_t _hmap_size(hmap*);
@@ -43,90 +46,317 @@ uint32_t _hmap_collisions(hmap*);
 
 /* Default numbers */
 const unsigned int default_size = 1024;
+/* Keys hashed and prefetched ahead of resolving, per batch step. */
+#define BATCH_WINDOW 32
+/* A bulk put takes keys BULK_CHUNK at a time, and sorts each chunk into
+   1 << PART_BITS parts of the table. */
+#define BULK_CHUNK (1 << 16)
+#define PART_BITS  12
+
+/* Hot-path counters, for hmap_get_stats: compiled out unless asked for. */
+#ifdef HMAP_COUNTERS
+#define HMAP_COUNT(h, field, n) ((h)->counts.field += (n))
+#else
+#define HMAP_COUNT(h, field, n) ((void)0)
+#endif
 
 hmap*
 hmap_create(map_destructor release)
 {
-  hmap *h = malloc(sizeof(hmap));
+  return hmap_create_opts(release, NULL);
+}
+
+hmap*
+hmap_create_opts(map_destructor release, const hmap_opts *opts)
+{
+  const hmap_engine_ops *ops;
+  hmap *h;
+
+  ops = _engine_ops(opts ? opts->engine : HMAP_ENGINE_DEFAULT);
+  if (opts && opts->inline_keys) ops = &hmap_chained_ops;
+  h = malloc(sizeof(hmap));
   memset(h, 0, sizeof(hmap));
+  h->ops = ops;
+  h->hash = (opts && opts->hash) ? opts->hash : hmap_hash_wy;
+  h->seed = (opts && opts->seed) ? opts->seed : _table_seed(h);
   h->map_size = default_size;
-  h->nodes = malloc(sizeof(hmap*) * default_size);
-  memset(h->nodes, 0, sizeof(hmap*) * default_size);
   h->rel = release;
+  h->inline_keys = opts && opts->inline_keys;
+  h->ops->init(h);
+  if (opts && opts->capacity) h->ops->reserve(h, opts->capacity);
   return h;
 }
 
+hmap*
+hmap_create_with_capacity(map_destructor release, uint32_t capacity)
+{
+  hmap_opts opts = { .capacity = capacity };
+  return hmap_create_opts(release, &opts);
+}
+
+void
+hmap_reserve(hmap *h, uint32_t n)
+{
+  h->ops->reserve(h, n);
+}
+
 void
 hmap_free(hmap *h)
 {
-  if (h->rel) {
-    for (uint32_t i = 0; i < h->map_size; i++) {
-      if (h->nodes[i]) _free_map_node_list(h->nodes[i], h->rel);
-    }
-  }
+  h->ops->release(h);
   free(h);
 }
 
 void
 hmap_put(hmap *h, char* key, void *val)
 {
-  map_node *node = malloc(sizeof(map_node));
-  node->key = key;
-  node->item = val;
-  node->next = NULL;
-  node->hash = _hash_string(key);
-  uint64_t idx  = node->hash & (uint64_t)(h->map_size - 1); /* Modulo. */
-  if (!h->nodes[idx]) {
-    h->nodes[idx] = node;
-  } else {
-    h->collisions++;
-    /* TODO: test and expand on collision threshold */
-    node->next = h->nodes[idx];
-    h->nodes[idx] = node;
-  }
-  h->item_count++;
-  return;
+  hmap_put_n(h, key, strlen(key), val);
 }
 
 void*
 hmap_get(hmap *h, char* key)
 {
-    map_node *n;
-    uint64_t hash = _hash_string(key);
-    uint32_t idx = hash & (h->map_size - 1);
-    if (!h->nodes[idx]) return NULL;
-    for (n = h->nodes[idx]; n; n = n->next) {
-      if (n->hash == hash && strcmp(key, n->key) == 0) {
-        return n->item;
-      }
-    }
-    return NULL;
+  return hmap_get_n(h, key, strlen(key));
 }
 
 void
 hmap_remove(hmap *h, char* key)
 {
-  map_node *n, *prev;
-  uint64_t hash = _hash_string(key);
-  uint32_t idx = hash & (h->map_size - 1);
-  if (!h->nodes[idx]) return;
-  n = h->nodes[idx];
-  prev = NULL;
-  while (n) {
-    if (n->hash == hash && strcmp(key, n->key) == 0) {
-      if (prev) {
-        prev->next = n->next;
-      } else {
-        h->nodes[idx] = n->next;
-      }
-      free(n);
-      h->item_count--;
-      return;
+  hmap_remove_n(h, key, strlen(key));
+}
+
+void**
+hmap_slot(hmap *h, char* key, bool *created)
+{
+  return hmap_slot_n(h, key, strlen(key), created);
+}
+
+/* The map stores, and hands to the destructor, a non-const key. */
+void
+hmap_put_n(hmap *h, const void *key, size_t len, void *val)
+{
+  _put(h, _hash(h, key, len), (void*)(uintptr_t)key, len, val);
+}
+
+void**
+hmap_slot_n(hmap *h, const void *key, size_t len, bool *created)
+{
+  return _slot(h, _hash(h, key, len), (void*)(uintptr_t)key, len, created);
+}
+
+void*
+hmap_get_n(hmap *h, const void *key, size_t len)
+{
+  return _get(h, _hash(h, key, len), key, len);
+}
+
+void
+hmap_remove_n(hmap *h, const void *key, size_t len)
+{
+  _remove(h, _hash(h, key, len), key, len);
+}
+
+uint64_t
+hmap_hash(const hmap *h, const char* key)
+{
+  return _hash(h, key, strlen(key));
+}
+
+uint64_t
+hmap_hash_n(const hmap *h, const void *key, size_t len)
+{
+  return _hash(h, key, len);
+}
+
+void
+hmap_put_hashed(hmap *h, uint64_t hash, char* key, void *val)
+{
+  _put(h, hash, key, strlen(key), val);
+}
+
+void*
+hmap_get_hashed(hmap *h, uint64_t hash, const char* key)
+{
+  return _get(h, hash, key, strlen(key));
+}
+
+void
+hmap_remove_hashed(hmap *h, uint64_t hash, const char* key)
+{
+  _remove(h, hash, key, strlen(key));
+}
+
+void
+hmap_put_hashed_n(hmap *h, uint64_t hash, const void *key, size_t len,
+                  void *val)
+{
+  _put(h, hash, (void*)(uintptr_t)key, len, val);
+}
+
+void*
+hmap_get_hashed_n(hmap *h, uint64_t hash, const void *key, size_t len)
+{
+  return _get(h, hash, key, len);
+}
+
+void
+hmap_remove_hashed_n(hmap *h, uint64_t hash, const void *key, size_t len)
+{
+  _remove(h, hash, key, len);
+}
+
+void**
+hmap_slot_hashed(hmap *h, uint64_t hash, char* key, bool *created)
+{
+  return _slot(h, hash, key, strlen(key), created);
+}
+
+void**
+hmap_slot_hashed_n(hmap *h, uint64_t hash, const void *key, size_t len,
+                   bool *created)
+{
+  return _slot(h, hash, (void*)(uintptr_t)key, len, created);
+}
+
+/*
+ * A chunk at a time, so the hashes and lengths held up front stay under
+ * a MB however many keys there are; a chunk is still enough keys per part
+ * of the table for its inserts to land close together.
+ */
+void
+hmap_put_bulk(hmap *h, char **keys, void **vals, size_t n)
+{
+  size_t    chunk = n < BULK_CHUNK ? n : BULK_CHUNK;
+  uint64_t *hash;
+  uint32_t *len;
+  uint64_t  total = (uint64_t)h->item_count + n;
+
+  if (!n) return;
+  h->ops->reserve(h, total > UINT32_MAX ? UINT32_MAX : (uint32_t)total);
+  hash = malloc(chunk * sizeof(uint64_t));
+  len  = malloc(chunk * sizeof(uint32_t));
+  for (; n; n -= chunk, keys += chunk, vals += chunk) {
+    if (chunk > n) chunk = n;
+    for (size_t i = 0; i < chunk; i++) {
+      len[i]  = (uint32_t)strlen(keys[i]);
+      hash[i] = _hash(h, keys[i], len[i]);
+    }
+    h->ops->put_bulk(h, hash, keys, len, vals, chunk);
+    HMAP_COUNT(h, puts, chunk);
+    for (size_t i = 0; h->filter && i < chunk; i++) {
+      oc_filter_add(h->filter, hash[i]);
     }
-    prev = n;
-    n = n->next;
   }
-  return;
+  free(hash);
+  free(len);
+}
+
+/*
+ * A stable counting sort on the top PART_BITS bits of each home: every
+ * part covers a run of the table small enough to stay in cache while its
+ * keys go in, and the parts come in table order.
+ */
+uint32_t *
+hmap_bulk_order(const hmap *h, const uint64_t *hash, size_t n,
+                uint32_t (*home)(const hmap*, uint64_t))
+{
+  uint32_t *start = calloc((size_t)1 << PART_BITS, sizeof(uint32_t));
+  uint32_t *order = malloc(n * sizeof(uint32_t));
+  uint32_t  shift = 0, sum = 0, c;
+
+  while (((uint64_t)1 << (shift + PART_BITS)) < h->map_size) shift++;
+  for (size_t i = 0; i < n; i++) start[home(h, hash[i]) >> shift]++;
+  for (uint32_t p = 0; p < (1u << PART_BITS); p++) {
+    c = start[p];
+    start[p] = sum;
+    sum += c;
+  }
+  for (size_t i = 0; i < n; i++) {
+    order[start[home(h, hash[i]) >> shift]++] = (uint32_t)i;
+  }
+  free(start);
+  return order;
+}
+
+void
+hmap_get_batch(hmap *h, char **keys, size_t n, void **out)
+{
+  uint64_t hash[BATCH_WINDOW];
+  size_t   len[BATCH_WINDOW];
+  bool     miss[BATCH_WINDOW];
+  size_t   w, i;
+
+  for (; n; n -= w, keys += w, out += w) {
+    w = n < BATCH_WINDOW ? n : BATCH_WINDOW;
+    for (i = 0; i < w; i++) {
+      len[i]  = strlen(keys[i]);
+      hash[i] = _hash(h, keys[i], len[i]);
+      miss[i] = h->filter && !oc_filter_may_contain(h->filter, hash[i]);
+      if (!miss[i]) h->ops->prefetch(h, hash[i], 0);
+    }
+    for (i = 0; i < w; i++) if (!miss[i]) h->ops->prefetch(h, hash[i], 1);
+    for (i = 0; i < w; i++) {
+      out[i] = miss[i] ? NULL : h->ops->get(h, hash[i], keys[i], len[i]);
+      HMAP_COUNT(h, filtered, miss[i]);
+      HMAP_COUNT(h, misses, !out[i]);
+    }
+    HMAP_COUNT(h, gets, w);
+  }
+}
+
+void
+hmap_attach_filter(hmap *h, oc_filter *f)
+{
+  h->filter = f;
+  if (f) h->ops->each(h, _filter_add, f);
+}
+
+/* The walk sums probes into mean_probe, and the histogram counts the
+   entries walked. */
+void
+hmap_get_stats(hmap *h, hmap_stats *s, bool walk)
+{
+  uint32_t walked = 0;
+
+  memset(s, 0, sizeof(hmap_stats));
+  s->count    = h->item_count;
+  s->slots    = h->map_size;
+  s->load     = h->map_size ? (double)h->item_count / h->map_size : 0.0;
+  s->resizes  = h->resizes;
+  s->gets     = h->counts.gets;
+  s->misses   = h->counts.misses;
+  s->puts     = h->counts.puts;
+  s->removes  = h->counts.removes;
+  s->filtered = h->counts.filtered;
+  h->ops->stats(h, s, walk);
+  s->bytes += sizeof(hmap);
+  if (!walk) return;
+  for (int i = 0; i < HMAP_PROBE_HIST; i++) walked += s->probe_hist[i];
+  if (walked) s->mean_probe /= walked;
+}
+
+void
+hmap_stats_probe(hmap_stats *s, uint32_t probe)
+{
+  s->probe_hist[probe < HMAP_PROBE_HIST ? probe : HMAP_PROBE_HIST - 1]++;
+  if (probe > s->max_probe) s->max_probe = probe;
+  if (probe) s->collisions++;
+  s->mean_probe += probe;
+}
+
+void
+hmap_stats_spread(hmap_stats *s, const uint32_t *per_home, uint32_t homes)
+{
+  double sum = 0.0, sq = 0.0, mean;
+
+  if (!homes) return;
+  for (uint32_t i = 0; i < homes; i++) {
+    sum += per_home[i];
+    sq  += (double)per_home[i] * per_home[i];
+  }
+  mean = sum / homes;
+  s->occupancy_var = sq / homes - mean * mean;
+  s->dispersion    = mean > 0.0 ? s->occupancy_var / mean : 0.0;
 }
 
 uint32_t
@@ -135,20 +365,56 @@ hmap_count(hmap *h)
   return h->item_count;
 }
 
-/* ------------------------------------------------------------------------- *\
-   private functions.
-\* ------------------------------------------------------------------------- */
+void
+hmap_iter_init(hmap *h, hmap_iter *it)
+{
+  it->h    = h;
+  it->pos  = 0;
+  it->node = NULL;
+  h->ops->iter_init(h, it);
+}
+
+bool
+hmap_iter_next(hmap_iter *it, const void **key, size_t *len, void **item)
+{
+  void *k, *v;
+  size_t l;
+  if (!it->h->ops->iter_next(it, &k, &l, &v)) return false;
+  if (key)  *key  = k;
+  if (len)  *len  = l;
+  if (item) *item = v;
+  return true;
+}
+
+bool
+hmap_freeze(hmap *h, const char *path)
+{
+  return hmap_frozen_write(h, path, NULL);
+}
+
+bool
+hmap_freeze_with(hmap *h, const char *path, hmap_item_len item_len)
+{
+  return hmap_frozen_write(h, path, item_len);
+}
 
-static void _free_map_node_list(map_node *node, map_destructor r)
+hmap*
+hmap_open_mmap(const char *path)
 {
-  if (!node) return;
-  if (node->next) {
-    _free_map_node_list(node->next, r);
+  hmap *h = malloc(sizeof(hmap));
+  memset(h, 0, sizeof(hmap));
+  h->ops = &hmap_frozen_ops;
+  if (!hmap_frozen_load(h, path)) {
+    free(h);
+    return NULL;
   }
-  if (r) r((void*)node->key, node->item);
-  free(node);
+  return h;
 }
 
+/* ------------------------------------------------------------------------- *\
+   hash functions.
+\* ------------------------------------------------------------------------- */
+
 #define MAGIC_PRIME 97
 /*
  * After trying many approaches and several different data sets, this
@@ -156,24 +422,277 @@ static void _free_map_node_list(map_node *node, map_destructor r)
  * books, performs best on small to middling strings ... ie., typical
  * keys into maps.
  */
-static uint64_t _hash_string(char * key)
+uint64_t hmap_hash_djb(const void *key, size_t sz, uint64_t seed)
 {
-  int sz = strlen(key);
-  uint64_t hash = (key[sz-1] & 15) * MAGIC_PRIME;
+  const unsigned char *k = key;
+  (void)seed;
+  if (!sz) return 0;
+  uint64_t hash = (k[sz-1] & 15) * MAGIC_PRIME;
 
-  for(int pos = 0; pos < sz; pos++) {
-    hash = ((hash << 5) + hash) ^ key[pos];
+  for(size_t pos = 0; pos < sz; pos++) {
+    hash = ((hash << 5) + hash) ^ k[pos];
   }
-  hash += ((key[sz-1] * 7) + (key[sz - 1] & 15));
+  hash += ((k[sz-1] * 7) + (k[sz - 1] & 15));
   return hash;
 }
 
+/*
+ * wyhash (Wang Yi's, public domain), final version 4: reads 8 bytes at a
+ * time, 16 per round up to 48 bytes and three independent 16 byte lanes
+ * beyond that, and folds each pair of words with one 64x64->128 multiply.
+ */
+static const uint64_t _wyp[4] = {
+  0xa0761d6478bd642fULL, 0xe7037ed1a0b428dbULL,
+  0x8ebc6af09c88c6e3ULL, 0x589965cc75374cc3ULL
+};
+
+/* 128 bit product of *a and *b: low half to *a, high half to *b. */
+static inline void
+_wymum(uint64_t *a, uint64_t *b)
+{
+#ifdef __SIZEOF_INT128__
+  __uint128_t r = (__uint128_t)*a * *b;
+  *a = (uint64_t)r;
+  *b = (uint64_t)(r >> 64);
+#else
+  uint64_t ha = *a >> 32, hb = *b >> 32, la = (uint32_t)*a, lb = (uint32_t)*b;
+  uint64_t rh = ha * hb, rm0 = ha * lb, rm1 = hb * la, rl = la * lb;
+  uint64_t t = rl + (rm0 << 32), c = t < rl, lo;
+  lo = t + (rm1 << 32);
+  c += lo < t;
+  *a = lo;
+  *b = rh + (rm0 >> 32) + (rm1 >> 32) + c;
+#endif
+}
+
+/* The same product, folded to 64 bits. */
+static inline uint64_t
+_wymix(uint64_t a, uint64_t b)
+{
+  _wymum(&a, &b);
+  return a ^ b;
+}
+
+/* Unaligned little-endian-or-native loads; memcpy compiles to one mov. */
+static inline uint64_t
+_wyr8(const unsigned char *p)
+{
+  uint64_t v;
+  memcpy(&v, p, 8);
+  return v;
+}
+
+static inline uint64_t
+_wyr4(const unsigned char *p)
+{
+  uint32_t v;
+  memcpy(&v, p, 4);
+  return v;
+}
+
+uint64_t hmap_hash_wy(const void *key, size_t len, uint64_t seed)
+{
+  const unsigned char *p = key;
+  uint64_t a, b;
+
+  seed ^= _wymix(seed ^ _wyp[0], _wyp[1]);
+  if (len <= 16) {
+    if (len >= 4) {
+      a = (_wyr4(p) << 32) | _wyr4(p + ((len >> 3) << 2));
+      b = (_wyr4(p + len - 4) << 32) | _wyr4(p + len - 4 - ((len >> 3) << 2));
+    } else if (len > 0) {
+      a = ((uint64_t)p[0] << 16) | ((uint64_t)p[len >> 1] << 8) | p[len - 1];
+      b = 0;
+    } else {
+      a = b = 0;
+    }
+  } else {
+    size_t i = len;
+    if (i > 48) {
+      uint64_t see1 = seed, see2 = seed;
+      do {
+        seed = _wymix(_wyr8(p) ^ _wyp[1], _wyr8(p + 8) ^ seed);
+        see1 = _wymix(_wyr8(p + 16) ^ _wyp[2], _wyr8(p + 24) ^ see1);
+        see2 = _wymix(_wyr8(p + 32) ^ _wyp[3], _wyr8(p + 40) ^ see2);
+        p += 48;
+        i -= 48;
+      } while (i > 48);
+      seed ^= see1 ^ see2;
+    }
+    while (i > 16) {
+      seed = _wymix(_wyr8(p) ^ _wyp[1], _wyr8(p + 8) ^ seed);
+      i -= 16;
+      p += 16;
+    }
+    a = _wyr8(p + i - 16);
+    b = _wyr8(p + i - 8);
+  }
+  a ^= _wyp[1];
+  b ^= seed;
+  _wymum(&a, &b);
+  return _wymix(a ^ _wyp[0] ^ len, b ^ _wyp[1]);
+}
+
+/*
+ * Process-wide entropy, read once from /dev/urandom where there is one
+ * (else the clocks), mixed with a counter so each call differs. Threads
+ * that race to the first call may each read some entropy, but one
+ * compare-and-swap settles which becomes base, and all use that.
+ */
+uint64_t
+hmap_random_seed(void)
+{
+  static uint64_t base = 0;
+  static uint64_t counter = 0;
+  uint64_t seed, n, b;
+
+#ifdef __GNUC__
+  b = __atomic_load_n(&base, __ATOMIC_ACQUIRE);
+#else
+  b = base;
+#endif
+  if (!b) {
+    uint64_t fresh = 0, none = 0;
+    FILE *f = fopen("/dev/urandom", "rb");
+    if (!f || fread(&fresh, sizeof(fresh), 1, f) != 1) {
+      fresh = (uint64_t)time(NULL) ^ ((uint64_t)clock() << 32);
+    }
+    if (f) fclose(f);
+    b = fresh | 1;
+#ifdef __GNUC__
+    if (!__atomic_compare_exchange_n(&base, &none, b, false,
+                                     __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+      b = none;
+    }
+#else
+    base = b;
+#endif
+  }
+#ifdef __GNUC__
+  n = __atomic_add_fetch(&counter, 1, __ATOMIC_RELAXED);
+#else
+  n = ++counter;
+#endif
+  seed = _wymix(b, n * _wyp[2]);
+  return seed ? seed : 1;
+}
+
+/* A table's default seed: a fresh one, mixed with the table's address. */
+static uint64_t
+_table_seed(const hmap *h)
+{
+  uint64_t seed = _wymix(hmap_random_seed(), (uintptr_t)h ^ _wyp[3]);
+  return seed ? seed : 1;
+}
+
+/* ------------------------------------------------------------------------- *\
+   private functions.
+\* ------------------------------------------------------------------------- */
+
+/* The default hash is called directly, so it can be inlined. */
+static inline uint64_t
+_hash(const hmap *h, const void *key, size_t len)
+{
+  if (h->hash == hmap_hash_wy) return hmap_hash_wy(key, len, h->seed);
+  return h->hash(key, len, h->seed);
+}
+
+/*
+ * With a filter attached: a definite miss goes no further than the
+ * filter. Each put that adds an entry adds its hash, and each remove that
+ * takes one away removes it, so every key get can find has a copy left.
+ * A key longer than HMAP_MAX_KEY_LEN, which the engines' 32-bit lengths
+ * would truncate, is turned away before any of that, and not counted.
+ */
+static inline void
+_put(hmap *h, uint64_t hash, void *key, size_t len, void *val)
+{
+  uint32_t before = h->item_count;
+  if (len > HMAP_MAX_KEY_LEN) return;
+  HMAP_COUNT(h, puts, 1);
+  h->ops->put(h, hash, key, len, val);
+  if (h->filter && h->item_count != before) oc_filter_add(h->filter, hash);
+}
+
+static inline void*
+_get(hmap *h, uint64_t hash, const void *key, size_t len)
+{
+  void *item;
+  if (len > HMAP_MAX_KEY_LEN) return NULL;
+  HMAP_COUNT(h, gets, 1);
+  if (h->filter && !oc_filter_may_contain(h->filter, hash)) {
+    HMAP_COUNT(h, filtered, 1);
+    HMAP_COUNT(h, misses, 1);
+    return NULL;
+  }
+  item = h->ops->get(h, hash, key, len);
+  if (!item) HMAP_COUNT(h, misses, 1);
+  return item;
+}
+
+static inline void
+_remove(hmap *h, uint64_t hash, const void *key, size_t len)
+{
+  uint32_t before = h->item_count;
+  if (len > HMAP_MAX_KEY_LEN) return;
+  HMAP_COUNT(h, removes, 1);
+  if (h->filter && !oc_filter_may_contain(h->filter, hash)) return;
+  h->ops->remove(h, hash, key, len);
+  if (h->filter && h->item_count != before &&
+      oc_filter_removable(h->filter)) {
+    oc_filter_remove(h->filter, hash);
+  }
+}
+
+static inline void**
+_slot(hmap *h, uint64_t hash, void *key, size_t len, bool *created)
+{
+  bool made = false;
+  void **slot;
+  if (len > HMAP_MAX_KEY_LEN) {
+    if (created) *created = false;
+    return NULL;
+  }
+  slot = h->ops->slot(h, hash, key, len, &made);
+  if (made) {
+    HMAP_COUNT(h, puts, 1);
+    if (h->filter) oc_filter_add(h->filter, hash);
+  } else {
+    HMAP_COUNT(h, gets, 1);
+  }
+  if (created) *created = made;
+  return slot;
+}
+
+static void
+_filter_add(void *ctx, uint64_t hash, void *key, size_t len, void *item)
+{
+  (void)key; (void)len; (void)item;
+  oc_filter_add(ctx, hash);
+}
+
+
+static const hmap_engine_ops *
+_engine_ops(hmap_engine e)
+{
+  if (e == HMAP_ENGINE_DEFAULT) e = HMAP_DEFAULT_ENGINE;
+  switch (e) {
+    case HMAP_ROBIN_HOOD: return &hmap_robin_hood_ops;
+    case HMAP_SWISS:      return &hmap_swiss_ops;
+    case HMAP_COMPACT:    return &hmap_compact_ops;
+    default:              return &hmap_chained_ops;
+  }
+}
+
 uint32_t _hmap_size(hmap *h)
 {
   return h->map_size;
 }
 
+/* Entries away from home, as they stand: removes take theirs away. */
 uint32_t _hmap_collisions(hmap *h)
 {
-  return h->collisions;
+  hmap_stats s;
+  hmap_get_stats(h, &s, true);
+  return s.collisions;
 }
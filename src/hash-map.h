@@ -2,9 +2,32 @@
 #define _HASH_MAP_H
 /* ------------------------------------------------------------------------- *\
    Hash Map
-     - Basic hash map, requiring string keys.
+     - Basic hash map, with string keys, or byte keys of known length
+       through the _n functions (keys up to 4GB, may hold NUL bytes).
      - Prefix: hmap
      - May resize.
+     - Engines: the storage behind the map is chosen at create time.
+       HMAP_CHAINED is the original bucket-and-node table; HMAP_ROBIN_HOOD
+       is a flat open-addressed table; HMAP_SWISS adds a control byte per
+       slot and probes 16 slots at once, for read-heavy tables where most
+       lookups miss. HMAP_COMPACT keeps entries in one dense array in
+       insertion order, 24 bytes each, behind an index of 8, 16 or 32
+       bit positions: the smallest table, and the fastest to iterate.
+       hmap_create uses HMAP_DEFAULT_ENGINE, which a build
+       may override (-D HMAP_DEFAULT_ENGINE=HMAP_ROBIN_HOOD) to switch
+       every caller over at once.
+     - Counters: -D HMAP_COUNTERS counts gets, misses, puts and removes
+       for hmap_get_stats, at an increment per call.
+     - Hashing: by default a seeded, word-at-a-time hash (hmap_hash_wy)
+       with a random seed per table, so keys chosen to collide in one
+       table or run won't collide in another. A create option can supply
+       any other hmap_hash_fn, or a fixed seed. hmap_hash_djb is the
+       original byte-at-a-time hash; it ignores the seed.
+     - Duplicate keys: every engine replaces the existing entry on put,
+       so a change of engine never changes what a put does. The old key
+       and item are released through the destructor: each only if the
+       put does not pass the same pointer again, with NULL in place of
+       the one kept, and no call if both are kept.
    -------------------------------------------------------------------------
    LICENSE: This program is free software. You can modify it and/or re-
    distribute it under the terms of the Apache 2.0 License. You should have
@@ -17,17 +40,229 @@
 \* ------------------------------------------------------------------------- */
 
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 #include "oc-mem.h"
+#include "filter.h"
 
 typedef struct hmap hmap;
 
+typedef enum hmap_engine {
+  HMAP_ENGINE_DEFAULT = 0,
+  HMAP_CHAINED,
+  HMAP_ROBIN_HOOD,
+  HMAP_SWISS,
+  HMAP_COMPACT
+} hmap_engine;
+
+#ifndef HMAP_DEFAULT_ENGINE
+#define HMAP_DEFAULT_ENGINE HMAP_CHAINED
+#endif
+
+/* hash functions: len bytes at key, mixed with the table's seed. */
+typedef uint64_t (*hmap_hash_fn)(const void *key, size_t len, uint64_t seed);
+
+uint64_t hmap_hash_wy(const void *key, size_t len, uint64_t seed);
+uint64_t hmap_hash_djb(const void *key, size_t len, uint64_t seed);
+
+/* a fresh random seed; a table's default seed is one of these, mixed
+ * with the table's address. Safe to call from any thread. */
+uint64_t hmap_random_seed(void);
+
+/* create options; a zeroed struct gives the defaults:
+ *   hash        - NULL for hmap_hash_wy.
+ *   seed        - 0 for a random seed per table.
+ *   inline_keys - true for each node to carry a copy of its key's
+ *                 bytes in the same allocation, so callers need not keep
+ *                 keys alive, and a short key is in the node's cache
+ *                 line: get makes no separate trip to the key. The
+ *                 destructor is then passed the map's copy, for the call
+ *                 only: it releases the item alone. Only the chained
+ *                 engine has nodes to hold the bytes; the slot engines
+ *                 have no room in a slot, and a block per key made them
+ *                 slower, so with inline_keys the map is chained, whatever
+ *                 engine is asked for.
+ *   capacity    - entries to size the table for up front, as hmap_reserve
+ *                 does; 0 for the default start size.
+ */
+typedef struct hmap_opts {
+  hmap_engine  engine;
+  hmap_hash_fn hash;
+  uint64_t     seed;
+  bool         inline_keys;
+  uint32_t     capacity;
+} hmap_opts;
+
 hmap*    hmap_create(map_destructor);
+hmap*    hmap_create_opts(map_destructor, const hmap_opts*);
+hmap*    hmap_create_with_capacity(map_destructor, uint32_t capacity);
 void     hmap_free(hmap*);
 
+/* size the table, in one step, to hold n entries in all without growing;
+ * a map already that large is left alone. Loading a known number of keys
+ * then costs no rehashing, and no old and new table live side by side. */
+void     hmap_reserve(hmap*, uint32_t n);
+
 void     hmap_put(hmap*, char* key, void *val);
 void*    hmap_get(hmap*, char* key);
 void     hmap_remove(hmap*, char* key);
 uint32_t hmap_count(hmap*);
 
+/* byte keys: len bytes at key; the map keeps the pointer, not a copy.
+ * A string key and the same bytes passed with their strlen are one key.
+ * Keys are at most HMAP_MAX_KEY_LEN bytes: with a longer one, here or in
+ * the _hashed functions below, put and remove do nothing, and get and
+ * slot return NULL (slot with *created false). */
+#define HMAP_MAX_KEY_LEN UINT32_MAX
+
+void     hmap_put_n(hmap*, const void *key, size_t len, void *val);
+void*    hmap_get_n(hmap*, const void *key, size_t len);
+void     hmap_remove_n(hmap*, const void *key, size_t len);
+
+/* precomputed hashes: hmap_hash gives key's hash as this map hashes it,
+ * and the _hashed functions take that hash in place of hashing the key
+ * again; the key itself is still needed, to compare. A hash is good for
+ * any map hashed the same way: the same hash function and the same seed,
+ * as maps created with equal hash and nonzero seed options are. Passing
+ * a hash from a map hashed otherwise finds nothing, or worse, a put the
+ * map can never find again. */
+uint64_t hmap_hash(const hmap*, const char* key);
+uint64_t hmap_hash_n(const hmap*, const void *key, size_t len);
+void     hmap_put_hashed(hmap*, uint64_t hash, char* key, void *val);
+void*    hmap_get_hashed(hmap*, uint64_t hash, const char* key);
+void     hmap_remove_hashed(hmap*, uint64_t hash, const char* key);
+void     hmap_put_hashed_n(hmap*, uint64_t hash, const void *key, size_t len,
+                           void *val);
+void*    hmap_get_hashed_n(hmap*, uint64_t hash, const void *key,
+                           size_t len);
+void     hmap_remove_hashed_n(hmap*, uint64_t hash, const void *key,
+                              size_t len);
+void**   hmap_slot_hashed(hmap*, uint64_t hash, char* key, bool *created);
+void**   hmap_slot_hashed_n(hmap*, uint64_t hash, const void *key,
+                            size_t len, bool *created);
+
+/* find or insert in one probe: the address of key's item, after putting
+ * key with a NULL item if it was absent. *created (if not NULL) says
+ * which. Like put, a new entry keeps the key pointer. The address is
+ * good until the next put, slot or remove. */
+void**   hmap_slot(hmap*, char* key, bool *created);
+void**   hmap_slot_n(hmap*, const void *key, size_t len, bool *created);
+
+/* iteration: entries in the engine's order (insertion order for
+ * HMAP_COMPACT), one per call to hmap_iter_next, which returns false at
+ * the end. key, len and item may each be NULL. Any put, slot or remove
+ * ends the iteration: start again with hmap_iter_init. */
+typedef struct hmap_iter {
+  hmap    *h;
+  uint32_t pos;
+  void    *node;
+} hmap_iter;
+
+void     hmap_iter_init(hmap*, hmap_iter*);
+bool     hmap_iter_next(hmap_iter*, const void **key, size_t *len,
+                        void **item);
+
+/* put n string keys at once, vals[i] for keys[i], as n calls to hmap_put
+ * in array order would. Hashes every key first, reserves room for them
+ * all, then inserts them sorted by where they land, so the table fills
+ * from one end to the other instead of in random order. The chained
+ * engine carves all n nodes from one allocation, which is given back
+ * when the map is freed: removing a bulk-loaded key frees nothing.
+ * HMAP_COMPACT keeps its insertion order, so its keys go in as given. */
+void     hmap_put_bulk(hmap*, char **keys, void **vals, size_t n);
+
+/* look up n keys at once, out[i] receiving the item for keys[i] (or NULL).
+ * Hashes and prefetches ahead, so the cache misses of separate lookups
+ * overlap instead of queueing; worth it on tables larger than the cache. */
+void     hmap_get_batch(hmap*, char **keys, size_t n, void **out);
+
+/* negative lookups: with a filter attached, get, remove and get_batch
+ * answer a key the filter rules out without touching the table, and every
+ * put, slot or bulk put that adds an entry adds its hash. Attaching adds
+ * the hash of every entry already in the map; NULL detaches. The filter
+ * stays the caller's, to size for the map and free after it. A Bloom
+ * filter keeps the hashes of removed keys, each a false positive until
+ * the filter is cleared and attached again; a cuckoo filter takes them
+ * out. Only the map's own functions keep it up to date. A filter pays
+ * where a miss costs more than its one or two cache lines: a chained map
+ * past the cache, with most lookups missing. A swiss map's misses are
+ * about as cheap as the filter's. */
+void     hmap_attach_filter(hmap*, oc_filter*);
+
+/* instrumentation: hmap_get_stats fills in a snapshot of the map. Without
+ * walk it reads a few fields, cheap enough to poll on every scrape:
+ *   count, slots, load - entries, buckets or slots, and their ratio.
+ *   resizes            - times the table was rebuilt: grown, or cleaned
+ *                        of removed entries in place (swiss, compact).
+ *   bytes              - the map's own allocations: the table, and nodes
+ *                        or entries. Key copies (inline_keys) are added
+ *                        only by a walk.
+ *   gets, misses, puts, removes, filtered
+ *                      - calls since create, counted only in a build
+ *                        with -D HMAP_COUNTERS; else 0, and nothing on
+ *                        the hot path. misses are gets that returned
+ *                        NULL, filtered those the filter answered. A
+ *                        slot counts as a put if it made the entry, and
+ *                        else as a get that found it.
+ * With walk, every slot is visited, O(slots), and the rest filled in:
+ *   probe_hist, max_probe, mean_probe
+ *                      - how far each entry sits from where a get for it
+ *                        starts: its place in its chain (chained), slots
+ *                        from home (robin hood, compact, frozen), or
+ *                        groups of 16 from home (swiss). The last bucket
+ *                        of the histogram holds every longer probe.
+ *   collisions         - entries with a probe above 0.
+ *   tombstones         - removed entries still taking room (swiss,
+ *                        compact).
+ *   occupancy_var, dispersion
+ *                      - the variance of entries per home (bucket, slot,
+ *                        or swiss group), and that over its mean: near 1
+ *                        for a hash that spreads keys as chance would,
+ *                        well above it when keys clump.
+ */
+#define HMAP_PROBE_HIST 16
+
+typedef struct hmap_stats {
+  uint32_t count;
+  uint32_t slots;
+  double   load;
+  uint32_t resizes;
+  size_t   bytes;
+  uint64_t gets, misses, puts, removes, filtered;
+  uint32_t probe_hist[HMAP_PROBE_HIST];
+  uint32_t max_probe;
+  double   mean_probe;
+  uint32_t collisions;
+  uint32_t tombstones;
+  double   occupancy_var;
+  double   dispersion;
+} hmap_stats;
+
+void     hmap_get_stats(hmap*, hmap_stats*, bool walk);
+
+/* snapshots: hmap_freeze writes the map's entries to path, for
+ * hmap_open_mmap to map back read-only. The opened map answers get, get_n
+ * and get_batch straight from the file, with no parsing and no allocation
+ * per entry, and shares its pages with every other process mapping the
+ * same file; put and remove do nothing, slot returns NULL, and items it
+ * returns must not be written to. The file keeps the hash and seed, so
+ * only maps hashed with hmap_hash_wy or hmap_hash_djb can be frozen.
+ * Files are for machines of the writer's byte order. freeze returns
+ * false, and open_mmap NULL, on failure.
+ *
+ * hmap_freeze takes every non-NULL item as a C string: only a map of
+ * string items may be frozen with it. Any other map needs
+ * hmap_freeze_with, whose item_len gives each item's size in bytes,
+ * under 4 GiB (else the freeze fails); those bytes are written, followed
+ * by a NUL. A frozen item does not carry its size back to get, so items
+ * of varying size must record their own. The file is written under a
+ * unique temporary name in path's directory, then renamed over path, so
+ * concurrent freezes to one path never mix and a reader never sees a
+ * partial file. */
+typedef size_t (*hmap_item_len)(const void *item);
+
+bool     hmap_freeze(hmap*, const char *path);
+bool     hmap_freeze_with(hmap*, const char *path, hmap_item_len);
+hmap*    hmap_open_mmap(const char *path);
+
 #endif
@@ -0,0 +1,212 @@
+/* ------------------------------------------------------------------------- *\
+   Integer Hash Map
+     - Open addressing over one array of int_slots, linearly probed from
+       the top bits of the mixed key. A zero key marks an empty slot; key
+       0 itself lives beside the table.
+     - Grows by doubling past MAX_LOAD; stored keys are remixed on the
+       way, which costs less than a load from memory.
+   -------------------------------------------------------------------------
+   LICENSE: This program is free software. You can modify it and/or re-
+   distribute it under the terms of the Apache 2.0 License. You should have
+   received a copy of the Apache 2.0 License along with this program. If
+   not, please see: http://www.apache.org/licenses/LICENSE-2.0.txt
+
+   DISCLAIMER: This program is distributed in the hope that it will be
+   useful, but without any warrantee; without even the implied warantee
+   of fitness for any particular purpose. See the License for more details.
+\* ------------------------------------------------------------------------- */
+
+#include <stdlib.h>
+#include <string.h>
+#include "int-hash-map.h"
+#include "hash-map.h"
+
+/* Grow when the table would be more than 3/4 full. */
+#define MAX_LOAD_NUM 3
+#define MAX_LOAD_DEN 4
+
+typedef struct int_slot {
+  uint64_t key;
+  void    *item;
+} int_slot;
+
+struct hmap64 {
+  int_slot *slots;
+  uint64_t  seed;
+  uint32_t  map_size;    /* always a power of two. */
+  uint32_t  shift;       /* 64 - log2(map_size): home is the mix's top bits. */
+  uint32_t  used;        /* slots in use, key 0 aside. */
+  uint32_t  item_count;
+  bool      has_zero;
+  void     *zero_item;
+  map_destructor rel;
+};
+
+/* Default numbers */
+#define DEFAULT_SIZE  16
+#define DEFAULT_SHIFT 60
+
+/* Private declarations. */
+static inline uint64_t _mix(uint64_t key, uint64_t seed);
+static inline uint32_t _home(const hmap64*, uint64_t key);
+static void _grow(hmap64*);
+
+hmap64*
+hmap64_create(map_destructor release)
+{
+  hmap64 *h = malloc(sizeof(hmap64));
+  memset(h, 0, sizeof(hmap64));
+  h->map_size = DEFAULT_SIZE;
+  h->shift    = DEFAULT_SHIFT;
+  h->seed     = hmap_random_seed();
+  h->slots    = calloc(DEFAULT_SIZE, sizeof(int_slot));
+  h->rel      = release;
+  return h;
+}
+
+void
+hmap64_free(hmap64 *h)
+{
+  uint64_t zero = 0;
+  if (h->rel) {
+    for (uint32_t i = 0; i < h->map_size; i++) {
+      if (h->slots[i].key) h->rel(&h->slots[i].key, h->slots[i].item);
+    }
+    if (h->has_zero) h->rel(&zero, h->zero_item);
+  }
+  free(h->slots);
+  free(h);
+}
+
+void
+hmap64_put(hmap64 *h, uint64_t key, void *val)
+{
+  int_slot *s;
+  uint32_t mask, idx;
+  uint64_t zero = 0;
+
+  if (!key) {
+    if (h->has_zero) {
+      if (h->rel) h->rel(&zero, h->zero_item);
+    } else {
+      h->has_zero = true;
+      h->item_count++;
+    }
+    h->zero_item = val;
+    return;
+  }
+  if ((uint64_t)(h->used + 1) * MAX_LOAD_DEN >
+      (uint64_t)h->map_size * MAX_LOAD_NUM) {
+    _grow(h);
+  }
+  mask = h->map_size - 1;
+  for (idx = _home(h, key); ; idx = (idx + 1) & mask) {
+    s = &h->slots[idx];
+    if (s->key == key) {
+      if (h->rel) h->rel(&s->key, s->item);
+      s->item = val;
+      return;
+    }
+    if (!s->key) break;
+  }
+  s->key  = key;
+  s->item = val;
+  h->used++;
+  h->item_count++;
+}
+
+void*
+hmap64_get(hmap64 *h, uint64_t key)
+{
+  const int_slot *s;
+  uint32_t mask = h->map_size - 1;
+
+  if (!key) return h->has_zero ? h->zero_item : NULL;
+  for (uint32_t idx = _home(h, key); ; idx = (idx + 1) & mask) {
+    s = &h->slots[idx];
+    if (s->key == key) return s->item;
+    if (!s->key) return NULL;
+  }
+}
+
+/*
+ * Backward shift: each later slot of the run moves into the hole unless
+ * its home lies between the hole and itself, where it would be lost.
+ */
+void
+hmap64_remove(hmap64 *h, uint64_t key)
+{
+  uint32_t mask = h->map_size - 1;
+  uint32_t idx, next, home;
+
+  if (!key) {
+    if (h->has_zero) {
+      h->has_zero  = false;
+      h->zero_item = NULL;
+      h->item_count--;
+    }
+    return;
+  }
+  for (idx = _home(h, key); h->slots[idx].key != key;
+       idx = (idx + 1) & mask) {
+    if (!h->slots[idx].key) return;
+  }
+  for (next = (idx + 1) & mask; h->slots[next].key; next = (next + 1) & mask) {
+    home = _home(h, h->slots[next].key);
+    if (((next - home) & mask) >= ((next - idx) & mask)) {
+      h->slots[idx] = h->slots[next];
+      idx = next;
+    }
+  }
+  h->slots[idx].key = 0;
+  h->used--;
+  h->item_count--;
+}
+
+uint32_t
+hmap64_count(hmap64 *h)
+{
+  return h->item_count;
+}
+
+/* ------------------------------------------------------------------------- *\
+   private functions.
+\* ------------------------------------------------------------------------- */
+
+/* Two xor-shift-multiply rounds: every input bit reaches every output
+   bit, so sequential IDs land far apart. */
+static inline uint64_t
+_mix(uint64_t key, uint64_t seed)
+{
+  key ^= seed;
+  key ^= key >> 32;
+  key *= 0xd6e8feb86659fd93ULL;
+  key ^= key >> 32;
+  key *= 0xd6e8feb86659fd93ULL;
+  key ^= key >> 32;
+  return key;
+}
+
+static inline uint32_t
+_home(const hmap64 *h, uint64_t key)
+{
+  return (uint32_t)(_mix(key, h->seed) >> h->shift);
+}
+
+static void
+_grow(hmap64 *h)
+{
+  int_slot *old = h->slots;
+  uint32_t old_size = h->map_size, mask, idx;
+
+  h->map_size <<= 1;
+  h->shift--;
+  h->slots = calloc(h->map_size, sizeof(int_slot));
+  mask = h->map_size - 1;
+  for (uint32_t i = 0; i < old_size; i++) {
+    if (!old[i].key) continue;
+    for (idx = _home(h, old[i].key); h->slots[idx].key; idx = (idx + 1) & mask);
+    h->slots[idx] = old[i];
+  }
+  free(old);
+}
@@ -0,0 +1,46 @@
+#ifndef _INT_HASH_MAP_H
+#define _INT_HASH_MAP_H
+/* ------------------------------------------------------------------------- *\
+   Integer Hash Map
+     - A hash map keyed by 64 bit integers, such as IDs: no strings to
+       build, no strlen, and no key to chase through a pointer.
+     - Prefix: hmap64
+     - May resize.
+     - Keys are stored inline, beside their items, in one flat array of
+       16 byte slots, linearly probed. Removal shifts the rest of the run
+       back, so there are no tombstones. Key 0 is kept aside, so every
+       integer is a valid key.
+     - Keys are mixed with a strong integer mixer and a random seed per
+       table, so IDs in sequence or in strides spread evenly.
+     - Ownership follows hmap: put replaces the item of an existing key,
+       releasing the old pair through the destructor; remove does not
+       call it; free does, for every entry left. The map owns no key
+       memory, so the destructor's key argument points at the stored
+       uint64_t, valid for the call only.
+   -------------------------------------------------------------------------
+   LICENSE: This program is free software. You can modify it and/or re-
+   distribute it under the terms of the Apache 2.0 License. You should have
+   received a copy of the Apache 2.0 License along with this program. If
+   not, please see: http://www.apache.org/licenses/LICENSE-2.0.txt
+
+   DISCLAIMER: This program is distributed in the hope that it will be
+   useful, but without any warrantee; without even the implied warantee
+   of fitness for any particular purpose. See the License for more details.
+\* ------------------------------------------------------------------------- */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "oc-mem.h"
+
+typedef struct hmap64 hmap64;
+
+hmap64*  hmap64_create(map_destructor);
+void     hmap64_free(hmap64*);
+
+void     hmap64_put(hmap64*, uint64_t key, void *val);
+void*    hmap64_get(hmap64*, uint64_t key);
+void     hmap64_remove(hmap64*, uint64_t key);
+uint32_t hmap64_count(hmap64*);
+
+#endif
@@ -0,0 +1,484 @@
+/* ------------------------------------------------------------------------- *\
+   Minimal Perfect Hash
+     - Keys are hashed once, with hmap_hash_wy and a seed per build. The
+       top 32 bits pick a partition; the low 32 bits pick a bucket in it,
+       skewed so that 60% of keys land in the first 30% of buckets; the
+       position hash is a remix of all 64.
+     - A partition of n keys has a table of n + n/50 + 1 positions. Its
+       buckets are placed biggest first: each tries pilots 0, 1, 2 ...
+       until (mix(hash) ^ mix(pilot)) % table size is free for every key
+       in the bucket. Big buckets go while the table is empty, and the
+       small ones fill in the gaps.
+     - Positions past n are then remapped to the free positions below
+       n, so slots are exactly 0 .. n-1: minimal.
+     - A pilot that won't fit in 16 bits, or two distinct keys sharing
+       a 64 bit hash, fails the attempt; the build starts over with a
+       new seed.
+   -------------------------------------------------------------------------
+   LICENSE: This program is free software. You can modify it and/or re-
+   distribute it under the terms of the Apache 2.0 License. You should have
+   received a copy of the Apache 2.0 License along with this program. If
+   not, please see: http://www.apache.org/licenses/LICENSE-2.0.txt
+
+   DISCLAIMER: This program is distributed in the hope that it will be
+   useful, but without any warrantee; without even the implied warantee
+   of fitness for any particular purpose. See the License for more details.
+\* ------------------------------------------------------------------------- */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "perfect-hash.h"
+#include "hash-map-engine.h"
+
+/* Keys per partition, on average; small enough that positions fit the
+   16 bit remap table, and a partition's table fits in cache. */
+#define PARTITION_KEYS 32768
+#define PARTITION_MAX  UINT16_MAX
+/* Buckets per partition: BUCKETS_C * n / log2(n). */
+#define BUCKETS_C_NUM  3
+#define BUCKETS_C_DEN  1
+/* 60% of keys go to the first 30% of buckets. */
+#define SKEW_KEYS      2576980377u   /* 0.6 * 2^32 */
+#define SKEW_BUCKETS_NUM 3
+#define SKEW_BUCKETS_DEN 10
+#define PILOT_MAX      UINT16_MAX
+#define ATTEMPTS       16
+
+typedef struct mph_entry {
+  uint64_t    hash;
+  const void *key;
+  void       *item;
+  uint32_t    len;
+} mph_entry;
+
+typedef struct mph_part {
+  uint32_t offset;     /* its first slot, and first key while building. */
+  uint32_t n;
+  uint32_t tsize;
+  uint32_t buckets;
+  uint32_t dense;      /* buckets that take SKEW_KEYS of the keys. */
+  uint32_t pilot_off;
+  uint32_t remap_off;
+} mph_part;
+
+struct mph {
+  uint64_t   seed;
+  uint32_t   count;
+  uint32_t   parts_count;
+  mph_part  *parts;
+  uint16_t  *pilots;
+  uint16_t  *remap;
+  mph_entry *entries;    /* count + 1: see _build. */
+  size_t     pilot_count;
+  size_t     remap_count;
+};
+
+typedef enum { PART_OK, PART_RETRY, PART_DUPLICATE } part_status;
+
+/* Shared by the build threads. */
+typedef struct build_ctx {
+  mph             *m;
+  mph_entry       *in;        /* the keys, grouped by partition. */
+  size_t           n;
+  uint32_t         next;      /* next partition to take, or key block. */
+  part_status      status;
+  pthread_mutex_t  lock;
+} build_ctx;
+
+/* Private declarations. */
+static mph  *_build(mph_entry *in, size_t n, int threads);
+static bool  _layout(mph*, mph_entry *in, mph_entry *grouped, size_t n);
+static void  _run(build_ctx*, int threads, void *(*fn)(void*));
+static void *_hash_worker(void*);
+static void *_part_worker(void*);
+static part_status _build_part(mph*, mph_part*, mph_entry *keys);
+static void  _gather(void*, uint64_t, void*, size_t, void*);
+static inline uint64_t _mix(uint64_t);
+static inline uint32_t _part_of(uint64_t hash, uint32_t parts);
+static inline uint32_t _bucket(uint64_t hash, const mph_part*);
+static inline uint32_t _position(uint64_t mixed, uint16_t pilot, uint32_t tsize);
+
+mph*
+mph_create(char **keys, void **items, size_t n, int threads)
+{
+  mph_entry *in = malloc(sizeof(mph_entry) * (n ? n : 1));
+  mph *m;
+
+  for (size_t i = 0; i < n; i++) {
+    in[i].key  = keys[i];
+    in[i].len  = (uint32_t)strlen(keys[i]);
+    in[i].item = items ? items[i] : NULL;
+  }
+  m = _build(in, n, threads);
+  free(in);
+  return m;
+}
+
+mph*
+mph_create_from_hmap(hmap *h, int threads)
+{
+  mph_entry *in = malloc(sizeof(mph_entry) * (hmap_count(h) + 1));
+  size_t n = 0;
+  void *ctx[2] = { in, &n };
+  mph *m;
+
+  h->ops->each(h, _gather, ctx);
+  m = _build(in, n, threads);
+  free(in);
+  return m;
+}
+
+void
+mph_free(mph *m)
+{
+  free(m->parts);
+  free(m->pilots);
+  free(m->remap);
+  free(m->entries);
+  free(m);
+}
+
+void*
+mph_get(mph *m, char* key)
+{
+  return mph_get_n(m, key, strlen(key));
+}
+
+void*
+mph_get_n(mph *m, const void *key, size_t len)
+{
+  uint64_t hash = hmap_hash_wy(key, len, m->seed);
+  const mph_part *p = &m->parts[_part_of(hash, m->parts_count)];
+  uint32_t pos = _position(_mix(hash), m->pilots[p->pilot_off + _bucket(hash, p)],
+                           p->tsize);
+  const mph_entry *e;
+
+  if (pos >= p->n) pos = m->remap[p->remap_off + pos - p->n];
+  e = &m->entries[p->offset + pos];
+  if (hmap_key_match(e->hash, e->len, e->key, hash, len, key)) return e->item;
+  return NULL;
+}
+
+uint32_t
+mph_count(mph *m)
+{
+  return m->count;
+}
+
+double
+mph_bits_per_key(mph *m)
+{
+  size_t bytes = m->pilot_count * sizeof(uint16_t) +
+                 m->remap_count * sizeof(uint16_t) +
+                 m->parts_count * sizeof(mph_part);
+  return m->count ? 8.0 * (double)bytes / m->count : 0.0;
+}
+
+/* ------------------------------------------------------------------------- *\
+   private functions.
+\* ------------------------------------------------------------------------- */
+
+/* splitmix64's finalizer. */
+static inline uint64_t
+_mix(uint64_t x)
+{
+  x ^= x >> 30;
+  x *= 0xBF58476D1CE4E5B9ULL;
+  x ^= x >> 27;
+  x *= 0x94D049BB133111EBULL;
+  return x ^ (x >> 31);
+}
+
+static inline uint32_t
+_part_of(uint64_t hash, uint32_t parts)
+{
+  return (uint32_t)(((hash >> 32) * parts) >> 32);
+}
+
+/* The divisions are by constants, so they compile to multiplies. */
+static inline uint32_t
+_bucket(uint64_t hash, const mph_part *p)
+{
+  uint32_t lo = (uint32_t)hash;
+  if (lo < SKEW_KEYS) {
+    return (uint32_t)((uint64_t)lo * p->dense / SKEW_KEYS);
+  }
+  return p->dense + (uint32_t)((uint64_t)(lo - SKEW_KEYS) *
+                               (p->buckets - p->dense) /
+                               (0x100000000ULL - SKEW_KEYS));
+}
+
+/* mixed: _mix(hash), which the build works out once per key. */
+static inline uint32_t
+_position(uint64_t mixed, uint16_t pilot, uint32_t tsize)
+{
+  return (uint32_t)((mixed ^ _mix(pilot)) % tsize);
+}
+
+/* each's callback for mph_create_from_hmap. */
+static void
+_gather(void *ctx, uint64_t hash, void *key, size_t len, void *item)
+{
+  mph_entry *in = ((void**)ctx)[0];
+  size_t *n = ((void**)ctx)[1];
+  (void)hash;
+  in[*n].key  = key;
+  in[*n].len  = (uint32_t)len;
+  in[*n].item = item;
+  (*n)++;
+}
+
+/*
+ * Try seeds until every partition builds. The slot array has one extra
+ * entry, never a match, past the end: an empty partition's lone table
+ * position remaps to its offset, which for the last partition is count.
+ */
+static mph *
+_build(mph_entry *in, size_t n, int threads)
+{
+  mph *m = malloc(sizeof(mph));
+  mph_entry *grouped = malloc(sizeof(mph_entry) * (n ? n : 1));
+  build_ctx ctx;
+
+  if (threads <= 0) threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+  if (threads <= 0) threads = 1;
+  memset(m, 0, sizeof(mph));
+  ctx.m = m;
+  ctx.in = in;
+  ctx.n = n;
+  pthread_mutex_init(&ctx.lock, NULL);
+
+  for (int attempt = 0; attempt < ATTEMPTS; attempt++) {
+    m->seed = hmap_random_seed();
+    ctx.next = 0;
+    _run(&ctx, threads, _hash_worker);
+    if (!_layout(m, in, grouped, n)) continue;
+
+    ctx.in = grouped;
+    ctx.next = 0;
+    ctx.status = PART_OK;
+    _run(&ctx, threads < (int)m->parts_count ? threads : (int)m->parts_count,
+         _part_worker);
+    ctx.in = in;
+    if (ctx.status == PART_OK) break;
+    free(m->parts);
+    free(m->pilots);
+    free(m->remap);
+    free(m->entries);
+    m->parts = NULL;
+    if (ctx.status == PART_DUPLICATE) break;
+  }
+  pthread_mutex_destroy(&ctx.lock);
+  free(grouped);
+  if (!m->parts) {
+    free(m);
+    return NULL;
+  }
+  return m;
+}
+
+/* Run fn on threads threads (the caller being one of them). */
+static void
+_run(build_ctx *ctx, int threads, void *(*fn)(void*))
+{
+  pthread_t *t = malloc(sizeof(pthread_t) * (threads > 1 ? threads : 1));
+  int started = 0;
+
+  while (started < threads - 1 &&
+         pthread_create(&t[started], NULL, fn, ctx) == 0) {
+    started++;
+  }
+  fn(ctx);
+  for (int i = 0; i < started; i++) pthread_join(t[i], NULL);
+  free(t);
+}
+
+#define HASH_BLOCK 4096
+
+static void *
+_hash_worker(void *arg)
+{
+  build_ctx *ctx = arg;
+  size_t from, to;
+
+  for (;;) {
+    from = (size_t)__atomic_fetch_add(&ctx->next, 1, __ATOMIC_RELAXED) *
+           HASH_BLOCK;
+    if (from >= ctx->n) return NULL;
+    to = from + HASH_BLOCK < ctx->n ? from + HASH_BLOCK : ctx->n;
+    for (size_t i = from; i < to; i++) {
+      ctx->in[i].hash = hmap_hash_wy(ctx->in[i].key, ctx->in[i].len,
+                                     ctx->m->seed);
+    }
+  }
+}
+
+/* Group the hashed keys by partition and size every table. False if a
+   partition came out too big for this seed. */
+static bool
+_layout(mph *m, mph_entry *in, mph_entry *grouped, size_t n)
+{
+  uint32_t parts = (uint32_t)(n / PARTITION_KEYS) + 1;
+  uint32_t *fill = calloc(parts, sizeof(uint32_t));
+  uint32_t lg, off = 0;
+  size_t pilots = 0, remaps = 0;
+  mph_part *p;
+
+  m->count = (uint32_t)n;
+  m->parts_count = parts;
+  m->parts = calloc(parts, sizeof(mph_part));
+  for (size_t i = 0; i < n; i++) m->parts[_part_of(in[i].hash, parts)].n++;
+  for (uint32_t i = 0; i < parts; i++) {
+    p = &m->parts[i];
+    if (p->n > PARTITION_MAX) {
+      free(fill);
+      free(m->parts);
+      m->parts = NULL;
+      return false;
+    }
+    for (lg = 1; (1u << lg) < p->n; lg++) ;
+    p->offset    = off;
+    p->tsize     = p->n + p->n / 50 + 1;
+    p->buckets   = (BUCKETS_C_NUM * p->n) / (BUCKETS_C_DEN * lg) + 1;
+    p->dense     = p->buckets * SKEW_BUCKETS_NUM / SKEW_BUCKETS_DEN;
+    p->pilot_off = (uint32_t)pilots;
+    p->remap_off = (uint32_t)remaps;
+    off    += p->n;
+    pilots += p->buckets;
+    remaps += p->tsize - p->n;
+  }
+  for (size_t i = 0; i < n; i++) {
+    p = &m->parts[_part_of(in[i].hash, parts)];
+    grouped[p->offset + fill[p - m->parts]++] = in[i];
+  }
+  free(fill);
+
+  m->pilot_count = pilots;
+  m->remap_count = remaps;
+  m->pilots  = calloc(pilots, sizeof(uint16_t));
+  m->remap   = calloc(remaps, sizeof(uint16_t));
+  m->entries = calloc(n + 1, sizeof(mph_entry));
+  m->entries[n].key = "";
+  m->entries[n].len = UINT32_MAX;
+  return true;
+}
+
+static void *
+_part_worker(void *arg)
+{
+  build_ctx *ctx = arg;
+  mph_part *p;
+  uint32_t i;
+  part_status s;
+
+  for (;;) {
+    i = __atomic_fetch_add(&ctx->next, 1, __ATOMIC_RELAXED);
+    if (i >= ctx->m->parts_count ||
+        __atomic_load_n(&ctx->status, __ATOMIC_RELAXED) != PART_OK) {
+      return NULL;
+    }
+    p = &ctx->m->parts[i];
+    s = _build_part(ctx->m, p, ctx->in + p->offset);
+    if (s != PART_OK) {
+      pthread_mutex_lock(&ctx->lock);
+      if (s > ctx->status) ctx->status = s;
+      pthread_mutex_unlock(&ctx->lock);
+    }
+  }
+}
+
+static part_status
+_build_part(mph *m, mph_part *p, mph_entry *keys)
+{
+  uint32_t *start = calloc(p->buckets + 1, sizeof(uint32_t));
+  uint32_t *size  = calloc(p->buckets, sizeof(uint32_t));
+  uint32_t *order = malloc(sizeof(uint32_t) * p->buckets);
+  uint32_t *key_of = malloc(sizeof(uint32_t) * (p->n ? p->n : 1));
+  uint32_t *pos_of = malloc(sizeof(uint32_t) * (p->n ? p->n : 1));
+  uint64_t *mixed  = malloc(sizeof(uint64_t) * (p->n ? p->n : 1));
+  uint8_t  *taken  = calloc(p->tsize, 1);
+  part_status status = PART_OK;
+  uint32_t *by_size;
+  uint32_t b, k, j, pilot, pos, free_pos, big = 0;
+  mph_entry *a, *c;
+
+  /* Counting sort the keys by bucket. */
+  for (k = 0; k < p->n; k++) {
+    size[_bucket(keys[k].hash, p)]++;
+    mixed[k] = _mix(keys[k].hash);
+  }
+  for (b = 0; b < p->buckets; b++) start[b + 1] = start[b] + size[b];
+  memset(size, 0, sizeof(uint32_t) * p->buckets);
+  for (k = 0; k < p->n; k++) {
+    b = _bucket(keys[k].hash, p);
+    key_of[start[b] + size[b]++] = k;
+  }
+  /* And the buckets by size, biggest first; sizes are small, so this is
+     a counting sort too. */
+  for (b = 0; b < p->buckets; b++) if (size[b] > big) big = size[b];
+  by_size = calloc(big + 2, sizeof(uint32_t));
+  for (b = 0; b < p->buckets; b++) by_size[big - size[b] + 1]++;
+  for (k = 1; k <= big + 1; k++) by_size[k] += by_size[k - 1];
+  for (b = 0; b < p->buckets; b++) order[by_size[big - size[b]]++] = b;
+  free(by_size);
+
+  for (uint32_t o = 0; o < p->buckets && status == PART_OK; o++) {
+    b = order[o];
+    if (!size[b]) break;
+    /* Equal hashes would collide under every pilot. */
+    for (k = start[b]; k < start[b + 1] && status == PART_OK; k++) {
+      for (j = k + 1; j < start[b + 1]; j++) {
+        a = &keys[key_of[k]];
+        c = &keys[key_of[j]];
+        if (a->hash != c->hash) continue;
+        status = hmap_key_match(a->hash, a->len, a->key, c->hash, c->len,
+                                c->key) ? PART_DUPLICATE : PART_RETRY;
+        break;
+      }
+    }
+    for (pilot = 0; status == PART_OK; pilot++) {
+      if (pilot > PILOT_MAX) {
+        status = PART_RETRY;
+        break;
+      }
+      for (k = start[b]; k < start[b + 1]; k++) {
+        pos = _position(mixed[key_of[k]], (uint16_t)pilot, p->tsize);
+        if (taken[pos]) break;
+        taken[pos] = 1;
+        pos_of[key_of[k]] = pos;
+      }
+      if (k == start[b + 1]) {
+        m->pilots[p->pilot_off + b] = (uint16_t)pilot;
+        break;
+      }
+      for (j = start[b]; j < k; j++) taken[pos_of[key_of[j]]] = 0;
+    }
+  }
+
+  if (status == PART_OK) {
+    /* Send each taken position past n to a free one below it. */
+    free_pos = 0;
+    for (pos = p->n; pos < p->tsize; pos++) {
+      if (!taken[pos]) continue;
+      while (taken[free_pos]) free_pos++;
+      m->remap[p->remap_off + pos - p->n] = (uint16_t)free_pos++;
+    }
+    for (k = 0; k < p->n; k++) {
+      pos = pos_of[k];
+      if (pos >= p->n) pos = m->remap[p->remap_off + pos - p->n];
+      m->entries[p->offset + pos] = keys[k];
+    }
+  }
+  free(start);
+  free(size);
+  free(order);
+  free(key_of);
+  free(pos_of);
+  free(mixed);
+  free(taken);
+  return status;
+}
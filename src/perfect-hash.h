@@ -0,0 +1,52 @@
+#ifndef _PERFECT_HASH_H
+#define _PERFECT_HASH_H
+/* ------------------------------------------------------------------------- *\
+   Minimal Perfect Hash
+     - A read-only map over a fixed set of keys, built once from an
+       array or from an hmap. Each key owns exactly one slot of an array
+       no bigger than the key count.
+     - Prefix: mph
+     - Lookup is one hash, one probe of a small pilot table, and one key
+       compare against the slot it picks; a key outside the set is
+       turned away by that compare.
+     - PTHash-style: keys are split into partitions by hash, and keys
+       within a partition into buckets; each bucket stores a 16 bit
+       pilot, found at build time, that sends its keys to free slots.
+       About 3.5 bits per key, beyond the slot array itself.
+     - Partitions are built independently, so the build runs on as many
+       threads as asked for. Link with -lpthread.
+     - The map refers to the callers' keys and items, and owns neither;
+       they must outlive it. Keys must be distinct.
+   -------------------------------------------------------------------------
+   LICENSE: This program is free software. You can modify it and/or re-
+   distribute it under the terms of the Apache 2.0 License. You should have
+   received a copy of the Apache 2.0 License along with this program. If
+   not, please see: http://www.apache.org/licenses/LICENSE-2.0.txt
+
+   DISCLAIMER: This program is distributed in the hope that it will be
+   useful, but without any warrantee; without even the implied warantee
+   of fitness for any particular purpose. See the License for more details.
+\* ------------------------------------------------------------------------- */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "hash-map.h"
+
+typedef struct mph mph;
+
+/* build over keys[i] -> items[i] (items may be NULL: every item NULL),
+ * or over an hmap's entries, on up to threads threads (0: one per online
+ * core). Returns NULL if a key repeats. */
+mph*     mph_create(char **keys, void **items, size_t n, int threads);
+mph*     mph_create_from_hmap(hmap*, int threads);
+void     mph_free(mph*);
+
+void*    mph_get(mph*, char* key);
+void*    mph_get_n(mph*, const void *key, size_t len);
+uint32_t mph_count(mph*);
+
+/* the hash structure's own size, pilots and remap table, per key. */
+double   mph_bits_per_key(mph*);
+
+#endif
@@ -0,0 +1,194 @@
+/* ------------------------------------------------------------------------- *\
+   Sharded Hash Map
+     - An array of shards, each an hmap and a mutex padded out to a cache
+       line of its own, so locking one shard never disturbs another's
+       line. Every shard shares one hash function and seed, so a key
+       hashed once is handed to its shard's _hashed calls, which keep
+       the shard's counters and filter as the plain calls do.
+     - The shard comes from the top bits of the hash; the engines place
+       keys by the low and middle bits, so every shard fills evenly.
+     - A capacity option is the whole map's: each shard reserves its
+       share, rounded up.
+     - get takes the same lock as put: the chained engine moves buckets
+       during a get while it resizes.
+   -------------------------------------------------------------------------
+   LICENSE: This program is free software. You can modify it and/or re-
+   distribute it under the terms of the Apache 2.0 License. You should have
+   received a copy of the Apache 2.0 License along with this program. If
+   not, please see: http://www.apache.org/licenses/LICENSE-2.0.txt
+
+   DISCLAIMER: This program is distributed in the hope that it will be
+   useful, but without any warrantee; without even the implied warantee
+   of fitness for any particular purpose. See the License for more details.
+\* ------------------------------------------------------------------------- */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include "sharded-hash-map.h"
+
+#define DEFAULT_SHARDS 64
+#define MAX_SHARDS     (1u << 16)
+#define CACHE_LINE     64
+
+typedef struct shard {
+  pthread_mutex_t lock;
+  hmap           *map;
+  uint32_t        items;  /* map's count, stored under lock, read without. */
+} shard;
+
+typedef union shard_line {
+  shard s;
+  char  pad[(sizeof(shard) + CACHE_LINE - 1) / CACHE_LINE * CACHE_LINE];
+} shard_line;
+
+struct shmap {
+  shard_line  *shards;
+  uint32_t     count;
+  uint32_t     shift;    /* 64 - log2(count): the shard is hash >> shift. */
+  hmap_hash_fn hash;
+  uint64_t     seed;
+};
+
+/* Private declarations. */
+static inline uint64_t _hash(shmap*, const void*, size_t);
+static inline shard   *_shard(shmap*, uint64_t hash);
+
+shmap*
+shmap_create(map_destructor release)
+{
+  return shmap_create_opts(release, NULL, 0);
+}
+
+shmap*
+shmap_create_opts(map_destructor release, const hmap_opts *opts,
+                  uint32_t shards)
+{
+  shmap *s = malloc(sizeof(shmap));
+  hmap_opts o;
+  uint32_t n = 1, bits = 0;
+
+  if (opts) o = *opts;
+  else      memset(&o, 0, sizeof(o));
+  if (!o.hash) o.hash = hmap_hash_wy;
+  if (!o.seed) o.seed = hmap_random_seed();
+  if (!shards) shards = DEFAULT_SHARDS;
+  if (shards > MAX_SHARDS) shards = MAX_SHARDS;
+  while (n < shards) {
+    n <<= 1;
+    bits++;
+  }
+  o.capacity = (uint32_t)(((uint64_t)o.capacity + n - 1) / n);
+  s->count  = n;
+  s->shift  = 64 - bits;
+  s->hash   = o.hash;
+  s->seed   = o.seed;
+  s->shards = calloc(n, sizeof(shard_line));
+  for (uint32_t i = 0; i < n; i++) {
+    pthread_mutex_init(&s->shards[i].s.lock, NULL);
+    s->shards[i].s.map = hmap_create_opts(release, &o);
+    if (!s->shards[i].s.map) {
+      pthread_mutex_destroy(&s->shards[i].s.lock);
+      s->count = i;
+      shmap_free(s);
+      return NULL;
+    }
+  }
+  return s;
+}
+
+void
+shmap_free(shmap *s)
+{
+  for (uint32_t i = 0; i < s->count; i++) {
+    hmap_free(s->shards[i].s.map);
+    pthread_mutex_destroy(&s->shards[i].s.lock);
+  }
+  free(s->shards);
+  free(s);
+}
+
+void
+shmap_put(shmap *s, char* key, void *val)
+{
+  shmap_put_n(s, key, strlen(key), val);
+}
+
+void*
+shmap_get(shmap *s, char* key)
+{
+  return shmap_get_n(s, key, strlen(key));
+}
+
+void
+shmap_remove(shmap *s, char* key)
+{
+  shmap_remove_n(s, key, strlen(key));
+}
+
+void
+shmap_put_n(shmap *s, const void *key, size_t len, void *val)
+{
+  uint64_t hash = _hash(s, key, len);
+  shard *sh = _shard(s, hash);
+  pthread_mutex_lock(&sh->lock);
+  hmap_put_hashed_n(sh->map, hash, key, len, val);
+  __atomic_store_n(&sh->items, hmap_count(sh->map), __ATOMIC_RELAXED);
+  pthread_mutex_unlock(&sh->lock);
+}
+
+void*
+shmap_get_n(shmap *s, const void *key, size_t len)
+{
+  uint64_t hash = _hash(s, key, len);
+  shard *sh = _shard(s, hash);
+  void *item;
+  pthread_mutex_lock(&sh->lock);
+  item = hmap_get_hashed_n(sh->map, hash, key, len);
+  pthread_mutex_unlock(&sh->lock);
+  return item;
+}
+
+void
+shmap_remove_n(shmap *s, const void *key, size_t len)
+{
+  uint64_t hash = _hash(s, key, len);
+  shard *sh = _shard(s, hash);
+  pthread_mutex_lock(&sh->lock);
+  hmap_remove_hashed_n(sh->map, hash, key, len);
+  __atomic_store_n(&sh->items, hmap_count(sh->map), __ATOMIC_RELAXED);
+  pthread_mutex_unlock(&sh->lock);
+}
+
+/* Each shard's count is copied out under its lock by the writers, and
+ * read here whole, with no lock: a snapshot, taken without holding up
+ * any writer. */
+uint32_t
+shmap_count(shmap *s)
+{
+  uint32_t total = 0;
+  for (uint32_t i = 0; i < s->count; i++) {
+    total += __atomic_load_n(&s->shards[i].s.items, __ATOMIC_RELAXED);
+  }
+  return total;
+}
+
+/* ------------------------------------------------------------------------- *\
+   private functions.
+\* ------------------------------------------------------------------------- */
+
+static inline uint64_t
+_hash(shmap *s, const void *key, size_t len)
+{
+  if (s->hash == hmap_hash_wy) return hmap_hash_wy(key, len, s->seed);
+  return s->hash(key, len, s->seed);
+}
+
+/* A single shard has a shift of 64, which C does not define. */
+static inline shard *
+_shard(shmap *s, uint64_t hash)
+{
+  return s->count == 1 ? &s->shards[0].s : &s->shards[hash >> s->shift].s;
+}
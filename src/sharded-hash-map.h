@@ -0,0 +1,57 @@
+#ifndef _SHARDED_HASH_MAP_H
+#define _SHARDED_HASH_MAP_H
+/* ------------------------------------------------------------------------- *\
+   Sharded Hash Map
+     - A hash map many threads may share, split into independent hmaps:
+       the top bits of a key's hash pick its shard, and the shard's own
+       lock is all a call takes. Each shard grows on its own, so one
+       writer's resize holds up only the writers to that shard.
+     - Prefix: shmap
+     - Each shard is an ordinary hmap, of any engine and with any of its
+       create options; keys are hashed once, and the shard is handed the
+       hash. Ownership follows hmap: see hash-map.h.
+     - shmap_count adds up a count each shard keeps beside its lock,
+       taking no locks: cheap, exact whenever no writer is running, and
+       approximate while writers are, as it sees some shards before
+       their writes and some after.
+     - An item get has returned is not protected from a put or remove
+       racing with it on another thread; callers sharing items across
+       threads manage their lifetime.
+     - Link with -lpthread.
+   -------------------------------------------------------------------------
+   LICENSE: This program is free software. You can modify it and/or re-
+   distribute it under the terms of the Apache 2.0 License. You should have
+   received a copy of the Apache 2.0 License along with this program. If
+   not, please see: http://www.apache.org/licenses/LICENSE-2.0.txt
+
+   DISCLAIMER: This program is distributed in the hope that it will be
+   useful, but without any warrantee; without even the implied warantee
+   of fitness for any particular purpose. See the License for more details.
+\* ------------------------------------------------------------------------- */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "hash-map.h"
+
+typedef struct shmap shmap;
+
+/* shards is rounded up to a power of two; 0 for the default, 64. opts
+ * as for hmap_create_opts, and may be NULL; its capacity is for the
+ * whole map, and is divided among the shards. Returns NULL if a shard's
+ * map cannot be made. */
+shmap*   shmap_create(map_destructor);
+shmap*   shmap_create_opts(map_destructor, const hmap_opts*, uint32_t shards);
+void     shmap_free(shmap*);
+
+void     shmap_put(shmap*, char* key, void *val);
+void*    shmap_get(shmap*, char* key);
+void     shmap_remove(shmap*, char* key);
+uint32_t shmap_count(shmap*);
+
+/* byte keys, as hmap_put_n and friends. */
+void     shmap_put_n(shmap*, const void *key, size_t len, void *val);
+void*    shmap_get_n(shmap*, const void *key, size_t len);
+void     shmap_remove_n(shmap*, const void *key, size_t len);
+
+#endif
@@ -9,6 +9,22 @@
        memory, pass in a NULL destructor.
      - items inserted with duplicate keys will replace the prior one, which
        will also free the memory (if a destructor is provided).
+     - Top-down splaying (Sleator and Tarjan): put, get and remove each
+       splay the key they seek to the root in one pass down, with no
+       parent links and no recursion, for amortized O(log n) per call.
+       Sorted inserts leave a chain, but the next lookups fold it back.
+       Freeing and iteration need no stack either, whatever the shape.
+     - Order statistics (-D SPLAY_ORDER_STATS): each node keeps the size
+       of its subtree, set as the splay reassembles the tree, so rank and
+       select take one splay. Without the flag, nodes stay four words and
+       those calls walk the entries in key order instead.
+     - splay_build_sorted links sorted input into a balanced tree, every
+       node carved from one slab; a slab node that is removed is only
+       unlinked. A split can leave one slab's nodes in two trees, so each
+       tree holds the slabs it may have nodes in, and the last tree to
+       let go of a slab frees it. A node is told to be a slab's by its
+       address, against the slabs the tree holds, so removes and frees
+       cost a check per slab held, and nodes need no flag.
    -------------------------------------------------------------------------
    LICENSE: This program is free software. You can modify it and/or re-
    distribute it under the terms of the Apache 2.0 License. You should have
@@ -21,6 +37,7 @@
 \* ------------------------------------------------------------------------- */
 
 #include <stdlib.h>
+#include <string.h>
 #include "splay-tree.h"
 #include <stdio.h>
 
@@ -33,33 +50,74 @@ typedef struct splay_node {
   void   *v;
   struct  splay_node *l;
   struct  splay_node *r;
+#ifdef SPLAY_ORDER_STATS
+  uint32_t size;
+#endif
 } splay_node;
 
-typedef struct splay_seq {
-  splay_node *ggp, *gp, *p;
-} splay_seq;
+/* The header of each splay_build_sorted slab; its n nodes follow. refs
+   counts the trees holding it. */
+typedef struct splay_slab {
+  size_t refs;
+  size_t n;
+} splay_slab;
+
+#ifdef SPLAY_ORDER_STATS
+#define _SIZE(sn)   ((sn) ? (sn)->size : 0)
+#define _RESIZE(sn) ((sn)->size = _SIZE((sn)->l) + _SIZE((sn)->r) + 1)
+#else
+#define _SIZE(sn)   0
+#define _RESIZE(sn) ((void)0)
+#endif
 
 struct splay {
   comparator      cmp;
   map_destructor  rel;
   splay_node     *root;
   uint32_t        count;
+  oc_filter      *filter;
+  splay_key_hash  hash;
+  splay_slab    **slabs;
+  uint32_t        n_slabs;
 };
 
+/* Nodes a walk keeps on the C stack before it moves to the heap. */
+#define WALK_STACK 64
+
+/* Called once per node, in key order; must not change the tree. */
+typedef void (*_visit)(void *ctx, splay_node *sn);
+
 /* ------------------------------------------------------------------------- *\
    private method declarations
 \* ------------------------------------------------------------------------- */
 
 static void _free_tree(splay *s, splay_node *sn);
-static void _insert_node(splay *s, splay_node *curr, splay_node *ins);
-static void* _find(splay *s, splay_seq *seq, splay_node *sn, void *seek);
-static void _splay(splay *s, splay_seq *seq, splay_node *sn);
-static inline void _rotate_left(splay_node *gp, splay_node *p, splay_node *c);
-static inline void _rotate_right(splay_node *gp, splay_node *p, splay_node *c);
-static void _remove(splay *s, splay_node *p, splay_node *sn);
-static void _traverse(splay_node *, void(*)(void*,void*));
-static inline void _shift_seq(splay_seq *seq, splay_node *sn);
-static inline void _set_gp(splay_node *gp, splay_node *p, splay_node *sn);
+static splay_node *_assemble(splay_node *sn, splay_node *side,
+                             splay_node *l, splay_node *r,
+                             uint32_t ls, uint32_t rs);
+static splay_node *_splay(splay *s, splay_node *sn, void *key);
+static splay_node *_splay_edge(splay_node *sn, int dir);
+static splay_node *_join(splay_node *lo, splay_node *hi);
+static splay_node *_build(splay_node *nodes, size_t n);
+static void _hold(splay *s, splay_slab *slab);
+static void _let_go(splay *s);
+static bool _in_slab(splay *s, splay_node *sn);
+static void _take(splay *a, splay *b);
+#ifndef SPLAY_ORDER_STATS
+static uint32_t _count_apart(splay_node *a, splay_node *b, uint32_t n);
+#endif
+static bool _succ(splay *s);
+static bool _pred(splay *s);
+static bool _bound(splay *s, void *key, bool above);
+static bool _at(splay_cursor *c, bool found);
+static bool _walk(splay_node *sn, splay_range_fn fn, void *ctx);
+static void _in_order(splay_node *sn, _visit fn, void *ctx);
+#ifndef SPLAY_ORDER_STATS
+static bool _tally(void *ctx, void *key, void *val);
+static bool _nth(void *ctx, void *key, void *val);
+#endif
+static void _visit_iter(void *ctx, splay_node *sn);
+static void _visit_fill(void *ctx, splay_node *sn);
 static void _print_tree(splay_node *sn, int depth, int dir);
 
 /* ------------------------------------------------------------------------- *\
@@ -72,245 +130,472 @@ void splay_print_tree(splay *s);
    private method implementations
 \* ------------------------------------------------------------------------- */
 
+/* Rotate each left child up until there is none, then free the root: no
+   stack, however the tree is shaped. */
 static void
-_free_tree(splay *s, splay_node *sn) {
-  if (sn->l) _free_tree(s, sn->l);
-  if (sn->r) _free_tree(s, sn->r);
-  if (s->rel) {
-    s->rel(sn->k, sn->v);
-  }
-  s->count--;
-  free(sn);
-}
-
-static void
-_insert_node(splay *s, splay_node *curr, splay_node *ins)
+_free_tree(splay *s, splay_node *sn)
 {
-  int dir = s->cmp(ins->k, curr->k);
-
-  if (dir == 0) {
-    /* Matching key: replace node. */
-    if (s->rel) {
-      s->rel(curr->k, curr->v);
-    }
-    curr->k = ins->k;
-    curr->v = ins->v;
-    free(ins);
-  } else if (dir < 0) {
-    if (curr->l) {
-      _insert_node(s, curr->l, ins);
+  splay_node *c;
+  while (sn) {
+    if (sn->l) {
+      c = sn->l;
+      sn->l = c->r;
+      c->r = sn;
+      sn = c;
     } else {
-      curr->l = ins;
-      s->count++;
-    }
-  } else {
-    if (curr->r) {
-      _insert_node(s, curr->r, ins);
-    } else {
-      curr->r = ins;
-      s->count++;
+      c = sn->r;
+      if (s->rel) {
+        s->rel(sn->k, sn->v);
+      }
+      s->count--;
+      if (!_in_slab(s, sn)) free(sn);
+      sn = c;
     }
   }
-  return;
 }
 
-static inline void
-_shift_seq(splay_seq *seq, splay_node *sn)
+/*
+ * Hang the side trees under sn, where a top-down splay stopped, and
+ * return it as the new root. ls and rs count the nodes linked into each
+ * side tree, and with order statistics, which the splay can't size on the
+ * way down, they size the side trees' spines: each spine node holds the
+ * rest of its side tree below it.
+ */
+static splay_node *
+_assemble(splay_node *sn, splay_node *side, splay_node *l, splay_node *r,
+          uint32_t ls, uint32_t rs)
 {
-  seq->ggp = seq->gp;
-  seq->gp = seq->p;
-  seq->p = sn;
+#ifdef SPLAY_ORDER_STATS
+  splay_node *y;
+  ls += _SIZE(sn->l);
+  rs += _SIZE(sn->r);
+  sn->size = ls + rs + 1;
+  l->r = r->l = NULL;
+  for (y = side->r; y; y = y->r) {
+    y->size = ls;
+    ls -= 1 + _SIZE(y->l);
+  }
+  for (y = side->l; y; y = y->l) {
+    y->size = rs;
+    rs -= 1 + _SIZE(y->r);
+  }
+#else
+  (void)ls;
+  (void)rs;
+#endif
+  l->r = sn->l;
+  r->l = sn->r;
+  sn->l = side->r;
+  sn->r = side->l;
+  return sn;
 }
 
-/* Could be recursive; but let's not be clever. */
-static void*
-_find(splay *s, splay_seq *seq, splay_node *sn, void *seek)
+/*
+ * Top-down splay: walking down from sn, each node passed hangs off one of
+ * two side trees, those less than key on the left, greater on the right,
+ * rotating first whenever two steps go the same way (zig-zig), which is
+ * what halves the depth of a long path. The walk ends at key's node, or
+ * at the last node before the empty link where key would be, and the
+ * side trees are reassembled under it. Returns the new root.
+ */
+static splay_node *
+_splay(splay *s, splay_node *sn, void *key)
 {
+  splay_node side, *l = &side, *r = &side, *y;
+  uint32_t ls = 0, rs = 0;
   int dir;
-  while(sn) {
-    dir = s->cmp(seek, sn->k);
-    if (dir == 0) {
-      _splay(s, seq, sn);
-      return sn->v;
-    }
-    _shift_seq(seq, sn);
+
+  side.l = side.r = NULL;
+  for (;;) {
+    dir = s->cmp(key, sn->k);
     if (dir < 0) {
+      if (!sn->l) break;
+      if (s->cmp(key, sn->l->k) < 0) {
+        y = sn->l;                      /* rotate right */
+        sn->l = y->r;
+        y->r = sn;
+        _RESIZE(sn);
+        sn = y;
+        if (!sn->l) break;
+      }
+      r->l = sn;                        /* link right */
+      r = sn;
       sn = sn->l;
-    } else {
+      rs += 1 + _SIZE(r->r);
+    } else if (dir > 0) {
+      if (!sn->r) break;
+      if (s->cmp(key, sn->r->k) > 0) {
+        y = sn->r;                      /* rotate left */
+        sn->r = y->l;
+        y->l = sn;
+        _RESIZE(sn);
+        sn = y;
+        if (!sn->r) break;
+      }
+      l->r = sn;                        /* link left */
+      l = sn;
       sn = sn->r;
+      ls += 1 + _SIZE(l->l);
+    } else {
+      break;
     }
   }
-  /* Not found. */
-  return NULL;
+  return _assemble(sn, &side, l, r, ls, rs);
 }
 
-static inline void
-_set_gp(splay_node *gp, splay_node *p, splay_node *sn)
+/* The same splay, for the first node (dir < 0) or the last (dir > 0):
+   every step goes the one way, so no key is compared. */
+static splay_node *
+_splay_edge(splay_node *sn, int dir)
 {
-  if (gp->l == p) gp->l = sn;
-  else            gp->r = sn;
+  splay_node side, *l = &side, *r = &side, *y;
+  uint32_t ls = 0, rs = 0;
+
+  side.l = side.r = NULL;
+  if (dir < 0) {
+    while (sn->l) {
+      if (sn->l->l) {
+        y = sn->l;                      /* rotate right */
+        sn->l = y->r;
+        y->r = sn;
+        _RESIZE(sn);
+        sn = y;
+        if (!sn->l) break;
+      }
+      r->l = sn;                        /* link right */
+      r = sn;
+      sn = sn->l;
+      rs += 1 + _SIZE(r->r);
+    }
+  } else {
+    while (sn->r) {
+      if (sn->r->r) {
+        y = sn->r;                      /* rotate left */
+        sn->r = y->l;
+        y->l = sn;
+        _RESIZE(sn);
+        sn = y;
+        if (!sn->r) break;
+      }
+      l->r = sn;                        /* link left */
+      l = sn;
+      sn = sn->r;
+      ls += 1 + _SIZE(l->l);
+    }
+  }
+  return _assemble(sn, &side, l, r, ls, rs);
 }
 
-/*  Rotate Right (C moves up and to the right; P moves down and to the right)
+/* One tree of every key in lo, then every key in hi: lo's last node,
+   splayed up, has no right child, and hi goes there. */
+static splay_node *
+_join(splay_node *lo, splay_node *hi)
+{
+  if (!lo) return hi;
+  if (!hi) return lo;
+  lo = _splay_edge(lo, 1);
+  lo->r = hi;
+  _RESIZE(lo);
+  return lo;
+}
 
-        GP                       GP
-       /  \                     /  \
-      P    *                   C    *
-     / \                      / \
-    C   V1        ====>     V2   P
-   / \                          /  \
-  V2  V3                      V3    V1
+/*
+ * Link nodes[0, n), in key order, into a balanced tree: each range's
+ * middle node is its root, and the halves either side its subtrees. The
+ * pending ranges are never more than the tree is deep, about log2 n, so
+ * a fixed stack does. Returns the root.
+ */
+#define BUILD_STACK 128
+typedef struct _range {
+  size_t       lo, hi;
+  splay_node **link;
+} _range;
 
- Changes: (downward)
-   V3 Moves from C->R to P->L
-   GP->L moves from P to C
-   C->R moves from V3 to P
+static splay_node *
+_build(splay_node *nodes, size_t n)
+{
+  _range stack[BUILD_STACK], at = { 0, n, NULL };
+  splay_node *root, *sn;
+  size_t top = 0, mid;
 
- Note that the change is in effect regardless of whether P is l or r on GP,
- but we need to correct the correct direction on GP.
+  at.link = &root;
+  stack[top++] = at;
+  while (top) {
+    at = stack[--top];
+    if (at.lo == at.hi) {
+      *at.link = NULL;
+      continue;
+    }
+    mid = at.lo + (at.hi - at.lo) / 2;
+    sn = &nodes[mid];
+    *at.link = sn;
+#ifdef SPLAY_ORDER_STATS
+    sn->size = (uint32_t)(at.hi - at.lo);
+#endif
+    stack[top].lo = mid + 1;
+    stack[top].hi = at.hi;
+    stack[top++].link = &sn->r;
+    stack[top].lo = at.lo;
+    stack[top].hi = mid;
+    stack[top++].link = &sn->l;
+  }
+  return root;
+}
 
-*/
-static inline void _rotate_right(splay_node *gp, splay_node *p, splay_node *c)
+/* s holds slab, if it didn't already. */
+static void
+_hold(splay *s, splay_slab *slab)
 {
-    splay_node *v3 = c->r; /* Could be null */
-    c->r = p;
-    p->l = v3;
-    if (gp) _set_gp(gp, p, c);
+  for (uint32_t i = 0; i < s->n_slabs; i++) {
+    if (s->slabs[i] == slab) return;
+  }
+  s->slabs = realloc(s->slabs, (s->n_slabs + 1) * sizeof(splay_slab*));
+  s->slabs[s->n_slabs++] = slab;
+  slab->refs++;
 }
 
-/*  Rotate Left (C moves up and to the left; P moves down and to the left)
-
-        GP                       GP
-       /  \                     /  \
-      P    *                   C    *
-     / \                      / \
-   V1   C        ====>       P   V3
-       / \                  / \
-     V2   V3              V1   V2
+/* s lets go of every slab it holds, freeing those no tree holds now. */
+static void
+_let_go(splay *s)
+{
+  for (uint32_t i = 0; i < s->n_slabs; i++) {
+    if (--s->slabs[i]->refs == 0) free(s->slabs[i]);
+  }
+  free(s->slabs);
+  s->slabs = NULL;
+  s->n_slabs = 0;
+}
 
- Changes: (downward)
-   V2 Moves from C->L to P->R
-   GP->L moves from P to C (or GP->R; either way, correct accordingly.)
-   C->L moves from V2 to P
+/* Whether sn was carved from a slab: a tree holds every slab its nodes
+   may come from, so sn's address is checked against those, and nodes
+   carry no flag. A tree built without splay_build_sorted holds none. */
+static bool
+_in_slab(splay *s, splay_node *sn)
+{
+  uintptr_t at = (uintptr_t)sn, lo;
+  for (uint32_t i = 0; i < s->n_slabs; i++) {
+    lo = (uintptr_t)(s->slabs[i] + 1);
+    if (at >= lo && at < lo + s->slabs[i]->n * sizeof(splay_node)) {
+      return true;
+    }
+  }
+  return false;
+}
 
-*/
-static inline void _rotate_left(splay_node *gp, splay_node *p, splay_node *c)
+/* a takes over b's entries, which the caller links into a's tree: their
+   keys into a's filter (unless b shares it), their count, and b's slabs.
+   b is left empty. */
+static void
+_take(splay *a, splay *b)
 {
-  splay_node *v2 = c->l; /* Could be null */
-  c->l = p;
-  p->r = v2; /* was c */
-  if (gp) _set_gp(gp, p, c);
+  if (a->filter && a->filter != b->filter) {
+    _in_order(b->root, _visit_fill, a);
+  }
+  a->count += b->count;
+  for (uint32_t i = 0; i < b->n_slabs; i++) _hold(a, b->slabs[i]);
+  _let_go(b);
+  b->root = NULL;
+  b->count = 0;
 }
 
-static void _splay(splay *s, splay_seq *seq, splay_node *sn)
+#ifndef SPLAY_ORDER_STATS
+/*
+ * Without subtree sizes, a split counts one of its halves: a node from
+ * each in turn, so the smaller half, whichever it is, sets the cost.
+ * Returns the number of nodes under a, of n under a and b together.
+ */
+static uint32_t
+_count_apart(splay_node *a, splay_node *b, uint32_t n)
 {
-  /* No op if root. */
-  if (!seq->p) return;
+  splay_node *local[2][WALK_STACK], **stack[2], **grown, *sn;
+  size_t top[2], cap[2];
+  uint32_t seen[2] = { 0, 0 };
+  int side = 0;
 
-  /* Are we going to set to root? */
-  if (!seq->ggp || !seq->gp) {
-    s->root = sn;
+  for (int i = 0; i < 2; i++) {
+    stack[i] = local[i];
+    cap[i] = WALK_STACK;
+    top[i] = 0;
   }
-
-  /* Determine splay action */
-  if(!seq->gp) {
-    /* Parent is root: simple case. */
-    if (seq->p->l == sn) {
-      _rotate_right(NULL, seq->p, sn);
-    } else {
-      _rotate_left(NULL, seq->p, sn);
+  if (a) stack[0][top[0]++] = a;
+  if (b) stack[1][top[1]++] = b;
+  while (top[side]) {
+    sn = stack[side][--top[side]];
+    seen[side]++;
+    if (top[side] + 2 > cap[side]) {
+      grown = malloc(2 * cap[side] * sizeof(splay_node*));
+      memcpy(grown, stack[side], top[side] * sizeof(splay_node*));
+      if (stack[side] != local[side]) free(stack[side]);
+      stack[side] = grown;
+      cap[side] *= 2;
     }
-    return;
+    if (sn->l) stack[side][top[side]++] = sn->l;
+    if (sn->r) stack[side][top[side]++] = sn->r;
+    side = !side;
   }
-
-  /* The two-step : rotation sequence varies */
-  /* PROBLEM!!! the top down sequences don't work because the hierarchy has
-     changed. */
-  if (seq->p->l == sn && seq->gp->l == seq->p) {
-    _rotate_right(seq->ggp, seq->gp, seq->p);
-    _rotate_right(seq->ggp, seq->p, sn);
-  } else if (seq->p->r == sn && seq->gp->r == seq->p) {
-    _rotate_left(seq->ggp, seq->gp, seq->p);
-    _rotate_left(seq->ggp, seq->p, sn);
-  } else if (seq->p->l == sn) {
-    _rotate_right(seq->gp, seq->p, sn);
-    _rotate_left(seq->ggp, seq->gp, sn);
-  } else {
-    _rotate_left(seq->gp, seq->p, sn);
-    _rotate_right(seq->ggp, seq->gp, sn);
+  for (int i = 0; i < 2; i++) {
+    if (stack[i] != local[i]) free(stack[i]);
   }
+  return side == 0 ? seen[0] : n - seen[1];
+}
+#endif
 
+/*
+ * Make the root's successor the root: splay the first node of the right
+ * subtree up, which has no left child, and hang the old root there. By
+ * the sequential access theorem, stepping through k entries this way
+ * costs O(k) amortized. _pred is its mirror.
+ */
+static bool
+_succ(splay *s)
+{
+  splay_node *sn = s->root, *r;
+  if (!sn->r) return false;
+  r = _splay_edge(sn->r, -1);
+  sn->r = NULL;
+  _RESIZE(sn);
+  r->l = sn;
+  _RESIZE(r);
+  s->root = r;
+  return true;
 }
 
-void
-_remove(splay *s, splay_node *p, splay_node *sn)
+static bool
+_pred(splay *s)
 {
-  splay_node *l, *r, *orphan;
-  if (!sn) return;
-  l = sn->l;
-  r = sn->r;
-  orphan = NULL;
-  if (!p) {
-    /* Need to update root */
-    if (l) s->root = l;
-    else   s->root = r;
-  }
-  /* Actual tree repair */
-
-  /* Update parental bonds, if needed. */
-  if (p) {
-    if (l) {
-      p->l = l;
-    } else if (r) {
-      p->l = r;
-    }
-  }
+  splay_node *sn = s->root, *l;
+  if (!sn->l) return false;
+  l = _splay_edge(sn->l, 1);
+  sn->l = NULL;
+  _RESIZE(sn);
+  l->r = sn;
+  _RESIZE(l);
+  s->root = l;
+  return true;
+}
 
-  /* Update children */
-  if (l) {
-    orphan = l->r;
-    l->r = r;
-  }
-
-  /* Find a home for an orphan */
-  if (orphan) {
-    while (l) {
-      if (s->cmp(orphan->k, l->k) < 0) {
-        if (l->l) l = l->l;
-        else {
-          l->l = orphan;
-          break;
-        }
-      } else {
-        if (l->r) l = l->r;
-        else {
-          l->r = orphan;
-          break;
-        }
+/* The first key >= key, or > key if above, splayed to the root; false,
+   with the tree splayed all the same, if there is none. */
+static bool
+_bound(splay *s, void *key, bool above)
+{
+  int dir;
+  if (!s->root) return false;
+  s->root = _splay(s, s->root, key);
+  dir = s->cmp(key, s->root->k);
+  if (dir < 0 || (dir == 0 && !above)) return true;
+  return _succ(s);
+}
+
+/* The cursor on the root, or off the end. */
+static bool
+_at(splay_cursor *c, bool found)
+{
+  c->key = found ? c->s->root->k : NULL;
+  c->val = found ? c->s->root->v : NULL;
+  return found;
+}
+
+/* In order over the subtree at sn, until fn returns false, which _walk
+   passes back. The stack is as deep as the subtree is tall; it starts on
+   the C stack and moves to the heap only past that. */
+static bool
+_walk(splay_node *sn, splay_range_fn fn, void *ctx)
+{
+  splay_node *local[WALK_STACK], **stack = local, **grown;
+  size_t top = 0, cap = WALK_STACK;
+  bool go = true;
+
+  while (go && (sn || top)) {
+    if (sn) {
+      if (top == cap) {
+        grown = malloc(2 * cap * sizeof(splay_node*));
+        memcpy(grown, stack, cap * sizeof(splay_node*));
+        if (stack != local) free(stack);
+        stack = grown;
+        cap *= 2;
       }
+      stack[top++] = sn;
+      sn = sn->l;
+    } else {
+      sn = stack[--top];
+      go = fn(ctx, sn->k, sn->v);
+      sn = sn->r;
     }
   }
+  if (stack != local) free(stack);
+  return go;
+}
 
-  /* free the node */
-  if (s->rel) {
-    s->rel(sn->k, sn->v);
+/* Morris traversal: threads each left subtree's last node back to its
+   successor, and unthreads it on the way past, so the walk needs neither
+   a stack nor parent links. */
+static void
+_in_order(splay_node *sn, _visit fn, void *ctx)
+{
+  splay_node *p;
+  while (sn) {
+    if (!sn->l) {
+      fn(ctx, sn);
+      sn = sn->r;
+      continue;
+    }
+    for (p = sn->l; p->r && p->r != sn; p = p->r);
+    if (!p->r) {
+      p->r = sn;
+      sn = sn->l;
+    } else {
+      p->r = NULL;
+      fn(ctx, sn);
+      sn = sn->r;
+    }
   }
-  free(sn);
 }
 
-void
-_traverse(splay_node *sn, void(*handle)(void*, void*))
+/* A function pointer can't pass through a void*; its address can. */
+static void
+_visit_iter(void *ctx, splay_node *sn)
 {
-  if (sn->l) {
-    _traverse(sn->l, handle);
-  }
-  handle(sn->k, sn->v);
-  if (sn->r) {
-    _traverse(sn->r, handle);
-  }
+  (*(iter_func*)ctx)(sn->k, sn->v);
 }
 
-void
+static void
+_visit_fill(void *ctx, splay_node *sn)
+{
+  splay *s = ctx;
+  oc_filter_add(s->filter, s->hash(sn->k));
+}
+
+#ifndef SPLAY_ORDER_STATS
+/* Counts the entries it is shown, into the uint32_t at ctx. */
+static bool
+_tally(void *ctx, void *key, void *val)
+{
+  (void)key;
+  (void)val;
+  (*(uint32_t*)ctx)++;
+  return true;
+}
+
+/* Counts down to the entry wanted, and stops there with it in ctx. */
+typedef struct _nth_ctx {
+  uint32_t i;
+  void    *key;
+  void    *val;
+} _nth_ctx;
+
+static bool
+_nth(void *ctx, void *key, void *val)
+{
+  _nth_ctx *n = ctx;
+  if (n->i--) return true;
+  n->key = key;
+  n->val = val;
+  return false;
+}
+#endif
+
+static void
 _print_tree(splay_node *sn, int depth, int dir)
 {
   if (!sn) return;
@@ -331,9 +616,9 @@ _print_tree(splay_node *sn, int depth, int dir)
 }
 
 void
-splay_iter(splay *s, void(*handle)(void*, void*))
+splay_iter(splay *s, iter_func handle)
 {
-  _traverse(s->root, handle);
+  _in_order(s->root, _visit_iter, &handle);
 }
 
 void
@@ -359,67 +644,390 @@ splay_create(comparator compare, map_destructor release)
   s->cmp  = compare;
   s->rel  = release;
   s->root = NULL;
+  s->count = 0;
+  s->filter = NULL;
+  s->hash = NULL;
+  s->slabs = NULL;
+  s->n_slabs = 0;
   return s;
 }
 
 void
 splay_free(splay *s)
 {
-  if (s->root) {
-    _free_tree(s, s->root);
-  }
+  _free_tree(s, s->root);
+  _let_go(s);
   free(s);
   return;
 }
 
+/* Splay key's neighbour up, then put the new node above it, with the
+   neighbour on one side and the subtree beyond it on the other. */
 void
 splay_put(splay *s, void *key, void *val)
 {
-    splay_node *sn = malloc(sizeof(splay_node));
-    sn->l = NULL;
-    sn->r = NULL;
-    sn->k = key;
-    sn->v = val;
-    if (!s->root) {
-      s->root = sn;
-      s->count++;
-    } else {
-      _insert_node(s, s->root, sn);
+  splay_node *sn;
+  int dir = 0;
+
+  if (s->root) {
+    s->root = _splay(s, s->root, key);
+    dir = s->cmp(key, s->root->k);
+    if (dir == 0) {
+      /* Matching key: replace. */
+      if (s->rel) {
+        s->rel(s->root->k, s->root->v);
+      }
+      s->root->k = key;
+      s->root->v = val;
+      return;
     }
+  }
+  sn = malloc(sizeof(splay_node));
+  sn->k = key;
+  sn->v = val;
+  if (!s->root) {
+    sn->l = sn->r = NULL;
+  } else if (dir < 0) {
+    sn->l = s->root->l;
+    sn->r = s->root;
+    s->root->l = NULL;
+    _RESIZE(s->root);
+  } else {
+    sn->r = s->root->r;
+    sn->l = s->root;
+    s->root->r = NULL;
+    _RESIZE(s->root);
+  }
+  _RESIZE(sn);
+  s->root = sn;
+  s->count++;
+  if (s->filter) oc_filter_add(s->filter, s->hash(key));
 }
 
 void*
 splay_get(splay *s, void *key)
 {
   if (!s->root) return NULL;
-  if (s->cmp(s->root->k, key) == 0) {
-    return s->root->v;
-  } else {
-    splay_seq seq = {0};
-    return _find(s, &seq, s->root, key);
+  if (s->filter && !oc_filter_may_contain(s->filter, s->hash(key))) {
+    return NULL;
   }
+  s->root = _splay(s, s->root, key);
+  return s->cmp(key, s->root->k) == 0 ? s->root->v : NULL;
 }
 
+/* With key splayed to the root, splaying its left subtree for key again
+   brings up its predecessor, which has no right child to lose. */
 void
 splay_remove(splay *s, void *key)
 {
-  int dir;
-  splay_node *sn = s->root;
-  splay_node *p = NULL;
-  while(sn) {
-    dir = s->cmp(key, sn->k);
-    if (!dir) {
-      _remove(s, p, sn);
-      s->count--;
-      return;
+  splay_node *sn;
+  uint64_t hash = 0;
+
+  if (!s->root) return;
+  if (s->filter) {
+    hash = s->hash(key);
+    if (!oc_filter_may_contain(s->filter, hash)) return;
+  }
+  s->root = _splay(s, s->root, key);
+  if (s->cmp(key, s->root->k) != 0) return;
+  sn = s->root;
+  if (!sn->l) {
+    s->root = sn->r;
+  } else {
+    s->root = _splay(s, sn->l, key);
+    s->root->r = sn->r;
+    _RESIZE(s->root);
+  }
+  if (s->rel) {
+    s->rel(sn->k, sn->v);
+  }
+  if (!_in_slab(s, sn)) free(sn);
+  s->count--;
+  if (s->filter) oc_filter_remove(s->filter, hash);
+}
+
+/*
+ * Sorted keys all below the tree's first key or above its last are
+ * linked into a tree of their own, in O(n), and merged in; anything else
+ * (keys out of order, or falling among the tree's) goes in one put at a
+ * time. The n-1 comparisons that tell which cost less than the puts.
+ */
+void
+splay_build_sorted(splay *s, void **keys, void **vals, size_t n)
+{
+  splay t = *s;
+  splay_slab *slab;
+  splay_node *nodes;
+  size_t i;
+  bool apart;
+
+  if (!n) return;
+  for (i = 1; i < n && s->cmp(keys[i - 1], keys[i]) < 0; i++);
+  apart = i == n;
+  if (apart && s->root) {
+    s->root = _splay_edge(s->root, -1);
+    if (s->cmp(keys[n - 1], s->root->k) >= 0) {
+      s->root = _splay_edge(s->root, 1);
+      apart = s->cmp(keys[0], s->root->k) > 0;
     }
-    p = sn;
-    if (dir < 0) {
+  }
+  if (!apart) {
+    for (i = 0; i < n; i++) splay_put(s, keys[i], vals ? vals[i] : NULL);
+    return;
+  }
+
+  slab = malloc(sizeof(splay_slab) + n * sizeof(splay_node));
+  slab->refs = 0;
+  slab->n = n;
+  nodes = (splay_node*)(slab + 1);
+  for (i = 0; i < n; i++) {
+    nodes[i].k = keys[i];
+    nodes[i].v = vals ? vals[i] : NULL;
+  }
+  t.root = _build(nodes, n);
+  t.count = (uint32_t)n;
+  t.filter = NULL;
+  t.slabs = NULL;
+  t.n_slabs = 0;
+  _hold(&t, slab);
+  splay_merge(s, &t);
+}
+
+/*
+ * Splaying a's last key and b's first key up tells whether b lies wholly
+ * above a, and if not, their other ends whether it lies below; _join
+ * then puts one tree under the other's edge node.
+ */
+bool
+splay_merge(splay *a, splay *b)
+{
+  splay_node *lo = a->root, *hi = b->root;
+
+  if (a == b || a->cmp != b->cmp) return false;
+  if (lo && hi) {
+    lo = _splay_edge(lo, 1);
+    hi = _splay_edge(hi, -1);
+    a->root = lo;
+    b->root = hi;
+    if (a->cmp(lo->k, hi->k) >= 0) {
+      hi = a->root = _splay_edge(lo, -1);
+      lo = b->root = _splay_edge(b->root, 1);
+      if (a->cmp(lo->k, hi->k) >= 0) return false;
+    }
+  }
+  _take(a, b);
+  a->root = _join(lo, hi);
+  return true;
+}
+
+/* Splay key's neighbour up: the keys >= key are then either it and its
+   right subtree, or its right subtree alone. t gets no filter: one
+   shared would have each tree's removes clear hashes the other holds. */
+splay*
+splay_split(splay *s, void *key)
+{
+  splay *t = splay_create(s->cmp, s->rel);
+  splay_node *sn;
+
+  for (uint32_t i = 0; i < s->n_slabs; i++) _hold(t, s->slabs[i]);
+  if (!s->root) return t;
+  sn = s->root = _splay(s, s->root, key);
+  if (s->cmp(key, sn->k) <= 0) {
+    t->root = sn;
+    s->root = sn->l;
+    sn->l = NULL;
+  } else {
+    t->root = sn->r;
+    sn->r = NULL;
+  }
+  _RESIZE(sn);
+#ifdef SPLAY_ORDER_STATS
+  t->count = _SIZE(t->root);
+#else
+  t->count = _count_apart(t->root, s->root, s->count);
+#endif
+  s->count -= t->count;
+  return t;
+}
+
+bool
+splay_join(splay *a, splay *b)
+{
+  splay_node *lo = a->root, *hi = b->root;
+
+  if (a == b || a->cmp != b->cmp) return false;
+  if (lo && hi) {
+    a->root = lo = _splay_edge(lo, 1);
+    b->root = hi = _splay_edge(hi, -1);
+    if (a->cmp(lo->k, hi->k) >= 0) return false;
+  }
+  _take(a, b);
+  a->root = _join(lo, hi);
+  return true;
+}
+
+void*
+splay_lower_bound(splay *s, void *key, void **val)
+{
+  bool found = _bound(s, key, false);
+  if (val) *val = found ? s->root->v : NULL;
+  return found ? s->root->k : NULL;
+}
+
+void*
+splay_upper_bound(splay *s, void *key, void **val)
+{
+  bool found = _bound(s, key, true);
+  if (val) *val = found ? s->root->v : NULL;
+  return found ? s->root->k : NULL;
+}
+
+/*
+ * Two splays bracket the range: lo's neighbour to the root, then hi's to
+ * the root of the right subtree, R. Every key between the two is then in
+ * R's left subtree, and nothing else is, so walking it visits the k keys
+ * in range and no others. The root and R are in range or not by their
+ * own keys.
+ */
+void
+splay_range(splay *s, void *lo, void *hi, splay_range_fn fn, void *ctx)
+{
+  splay_node *sn;
+
+  if (!s->root) return;
+  s->root = lo ? _splay(s, s->root, lo) : _splay_edge(s->root, -1);
+  sn = s->root;
+  if (!lo || s->cmp(sn->k, lo) >= 0) {
+    if (hi && s->cmp(sn->k, hi) >= 0) return;
+    if (!fn(ctx, sn->k, sn->v)) return;
+  }
+  if (!sn->r) return;
+  if (!hi) {
+    _walk(sn->r, fn, ctx);
+    return;
+  }
+  sn->r = _splay(s, sn->r, hi);
+  sn = sn->r;
+  if (!_walk(sn->l, fn, ctx)) return;
+  if (s->cmp(sn->k, hi) < 0) fn(ctx, sn->k, sn->v);
+}
+
+/* With key's neighbour at the root, the keys below key are its left
+   subtree, and the root itself if it is below key too. */
+uint32_t
+splay_rank(splay *s, void *key)
+{
+#ifdef SPLAY_ORDER_STATS
+  if (!s->root) return 0;
+  s->root = _splay(s, s->root, key);
+  return _SIZE(s->root->l) + (s->cmp(key, s->root->k) > 0);
+#else
+  uint32_t n = 0;
+  splay_range(s, NULL, key, _tally, &n);
+  return n;
+#endif
+}
+
+/* Down by subtree sizes to the i-th node, then splay it up by its key,
+   which retraces the same path. */
+void*
+splay_select(splay *s, uint32_t i, void **val)
+{
+#ifdef SPLAY_ORDER_STATS
+  splay_node *sn = s->root;
+  uint32_t ls;
+
+  if (i >= s->count) {
+    if (val) *val = NULL;
+    return NULL;
+  }
+  while ((ls = _SIZE(sn->l)) != i) {
+    if (i < ls) {
       sn = sn->l;
     } else {
+      i -= ls + 1;
       sn = sn->r;
     }
   }
+  s->root = _splay(s, s->root, sn->k);
+  if (val) *val = sn->v;
+  return sn->k;
+#else
+  _nth_ctx n = { i, NULL, NULL };
+  if (i < s->count) splay_range(s, NULL, NULL, _nth, &n);
+  if (val) *val = n.val;
+  return n.key;
+#endif
+}
+
+uint32_t
+splay_count_range(splay *s, void *lo, void *hi)
+{
+#ifdef SPLAY_ORDER_STATS
+  uint32_t below_hi = hi ? splay_rank(s, hi) : s->count;
+  uint32_t below_lo = lo ? splay_rank(s, lo) : 0;
+  return below_hi > below_lo ? below_hi - below_lo : 0;
+#else
+  uint32_t n = 0;
+  splay_range(s, lo, hi, _tally, &n);
+  return n;
+#endif
+}
+
+bool
+splay_cursor_first(splay *s, splay_cursor *c)
+{
+  c->s = s;
+  if (s->root) s->root = _splay_edge(s->root, -1);
+  return _at(c, s->root != NULL);
+}
+
+bool
+splay_cursor_last(splay *s, splay_cursor *c)
+{
+  c->s = s;
+  if (s->root) s->root = _splay_edge(s->root, 1);
+  return _at(c, s->root != NULL);
+}
+
+bool
+splay_cursor_seek(splay *s, splay_cursor *c, void *key)
+{
+  c->s = s;
+  return _at(c, _bound(s, key, false));
+}
+
+/* Usually the cursor's key is still at the root, and one step does it;
+   otherwise its key is found again first. */
+bool
+splay_cursor_next(splay_cursor *c)
+{
+  splay *s = c->s;
+  if (!c->key) return false;
+  if (s->root && s->cmp(c->key, s->root->k) == 0) return _at(c, _succ(s));
+  return _at(c, _bound(s, c->key, true));
+}
+
+bool
+splay_cursor_prev(splay_cursor *c)
+{
+  splay *s = c->s;
+  int dir;
+  if (!c->key || !s->root) return _at(c, false);
+  if (s->cmp(c->key, s->root->k) != 0) {
+    s->root = _splay(s, s->root, c->key);
+    dir = s->cmp(c->key, s->root->k);
+    if (dir > 0) return _at(c, true);
+  }
+  return _at(c, _pred(s));
+}
+
+void
+splay_attach_filter(splay *s, oc_filter *f, splay_key_hash hash)
+{
+  s->filter = f;
+  s->hash = hash;
+  if (f) _in_order(s->root, _visit_fill, s);
 }
 
 uint32_t
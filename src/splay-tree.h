@@ -11,6 +11,8 @@
        memory, pass in a NULL destructor.
      - items inserted with duplicate keys will replace the prior one, which
        will also free the memory (if a destructor is provided).
+     - Top-down splaying: put, get and remove are amortized O(log n),
+       sorted input included, and nothing recurses.
    -------------------------------------------------------------------------
    LICENSE: This program is free software. You can modify it and/or re-
    distribute it under the terms of the Apache 2.0 License. You should have
@@ -22,12 +24,16 @@
    of fitness for any particular purpose. See the License for more details.
 \* ------------------------------------------------------------------------- */
 
+#include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 #include "oc-mem.h"
 #include "comparator.h"
+#include "filter.h"
 
 typedef struct splay splay;
 typedef void(*iter_func)(void *key,void *val);
+typedef uint64_t(*splay_key_hash)(void *key);
 
 splay*   splay_create(comparator, map_destructor);
 void     splay_free(splay*);
@@ -38,4 +44,90 @@ void     splay_remove(splay*, void* key);
 uint32_t splay_count(splay*);
 void     splay_iter(splay*, iter_func);
 
+/* bulk loading: build_sorted puts n keys, given in ascending order, with
+ * vals[i] for keys[i] (vals may be NULL, for NULL values). Into an empty
+ * tree, or one whose keys all lie below keys[0] or above keys[n-1], it
+ * links them into a balanced tree in O(n), all n nodes carved from one
+ * allocation, which is given back when the tree is freed: removing a
+ * bulk-loaded key frees nothing. Keys out of order, or among the tree's
+ * own, are put one at a time instead. */
+void     splay_build_sorted(splay*, void **keys, void **vals, size_t n);
+
+/* merge: moves every entry of b into a, if a and b share a comparator and
+ * b's keys all lie below or all above a's, in O(log n) amortized; b is
+ * left empty, to reuse or free, and b's entries are released through a's
+ * destructor from then on. Returns false, and moves nothing, if the key
+ * ranges overlap. With a filter attached to a, b's keys are added to it,
+ * which takes O(size of b), unless b shares a's filter. */
+bool     splay_merge(splay *a, splay *b);
+
+/* split and join: split moves every entry with key >= key into a new
+ * tree, which it returns, with s's comparator and destructor but no
+ * filter; attach one to it if wanted. s keeps its filter, which still
+ * holds the moved keys: to s they are only false positives. Joining or
+ * merging the new tree back into s adds its keys to the filter again.
+ * join is merge for when a's keys all lie below b's, and returns false,
+ * moving nothing, otherwise. Each is a splay or two, amortized O(log n),
+ * but for the count of entries split off: in a build without
+ * -D SPLAY_ORDER_STATS that takes counting the smaller of the two
+ * halves, O(min(k, n - k)) for k of n entries. */
+splay*   splay_split(splay *s, void *key);
+bool     splay_join(splay *a, splay *b);
+
+/* ordered access: lower_bound is the entry of the first key >= key,
+ * upper_bound of the first key > key; each returns that key, or NULL if
+ * there is none, and its value through val if val is not NULL. Both
+ * splay the entry found to the root. */
+void*    splay_lower_bound(splay*, void *key, void **val);
+void*    splay_upper_bound(splay*, void *key, void **val);
+
+/* range: fn(ctx, key, val) for each entry with lo <= key < hi, in key
+ * order, until fn returns false. A NULL lo starts at the first key, a
+ * NULL hi runs to the last. Two splays bring the ends of the range up,
+ * leaving the entries between them in one subtree, which is walked: a
+ * scan of k entries is O(log n + k) amortized. fn must not call any
+ * splay_* function on the tree but splay_count: even a get splays, and
+ * would move the entries out from under the walk. */
+typedef bool (*splay_range_fn)(void *ctx, void *key, void *val);
+void     splay_range(splay*, void *lo, void *hi, splay_range_fn, void *ctx);
+
+/* order statistics: rank is the number of keys below key, whether or not
+ * key is in the tree; select is the entry at index i of key order, from
+ * 0, its key returned (NULL if i >= count) and its value through val if
+ * val is not NULL; count_range counts the keys in [lo, hi), a NULL end
+ * open, as splay_range would visit them. A build with -D
+ * SPLAY_ORDER_STATS keeps a subtree size in every node, a word more
+ * each, and each call is then a splay or two, amortized O(log n). Without
+ * it, they walk in key order: O(log n + k) for k keys below key, below i,
+ * or in range. Only splay-tree.c needs the flag: the declarations are
+ * the same either way. */
+uint32_t splay_rank(splay*, void *key);
+void*    splay_select(splay*, uint32_t i, void **val);
+uint32_t splay_count_range(splay*, void *lo, void *hi);
+
+/* cursors: a position in key order, kept as the key it is on, so puts and
+ * removes of other keys may come between its moves. first, last and seek
+ * (to key's lower bound) place it; next and prev move it one entry. Each
+ * returns false, and leaves key and val NULL, when there is no such
+ * entry. While the cursor is on a key, that key must not be freed. */
+typedef struct splay_cursor {
+  splay *s;
+  void  *key;
+  void  *val;
+} splay_cursor;
+
+bool     splay_cursor_first(splay*, splay_cursor*);
+bool     splay_cursor_last(splay*, splay_cursor*);
+bool     splay_cursor_seek(splay*, splay_cursor*, void *key);
+bool     splay_cursor_next(splay_cursor*);
+bool     splay_cursor_prev(splay_cursor*);
+
+/* negative lookups: with a filter attached, get and remove answer a key
+ * the filter rules out without a comparison, and leave the tree as it
+ * was, unsplayed. hash gives each key's hash, equal for keys that compare
+ * equal. Attaching adds every key already in the tree; NULL detaches.
+ * The filter stays the caller's, to free after the tree; see
+ * hmap_attach_filter for what Bloom and cuckoo filters do on remove. */
+void     splay_attach_filter(splay*, oc_filter*, splay_key_hash hash);
+
 #endif
@@ -0,0 +1,224 @@
+#ifndef _TYPED_HASH_MAP_H
+#define _TYPED_HASH_MAP_H
+/* ------------------------------------------------------------------------- *\
+   Typed Hash Map
+     - A generator for hash maps of one key type and one value type:
+         OC_HMAP_DEFINE(name, K, V, hash_fn, eq_fn)
+       defines the type name and its functions, all static inline, in the
+       file that uses it. hmap stays the generic, void* map.
+     - Prefix: the name given.
+     - Keys and values are stored inline, in one flat array of entries,
+       with a control byte per slot holding 7 bits of the hash: a probe
+       only calls eq_fn on slots whose byte matches. The hash and equality
+       functions are called directly, so the compiler can inline them.
+     - hash_fn(K) returns a uint64_t; eq_fn(K, K) returns true for equal
+       keys. Either may be a function or a function-like macro. Hashes
+       are mixed with a random seed per table, so hash_fn need not be
+       strong; oc_hash_u64 suits integer keys.
+     - Linear probing, up to 3/4 full; doubles beyond that. remove shifts
+       the rest of the run back, calling hash_fn again for each key it
+       moves, so there are no tombstones.
+     - The map holds keys and values by value and never frees them; a
+       map of pointers is released by walking it with name_next first.
+     - Functions defined (h is a name*):
+         name*  name_create(void)
+         void   name_free(h)
+         void   name_put(h, K key, V val)     replaces an existing key's
+                                              key and value
+         V*     name_get(h, K key)            NULL if absent; good until
+                                              the next put or remove
+         bool   name_remove(h, K key)         false if absent
+         uint32_t name_count(h)
+         bool   name_next(h, uint32_t *pos, K *key, V *val)
+                                              start with *pos = 0; false
+                                              at the end. Any put or
+                                              remove ends the walk.
+     - Links against hash-map.c, for the seed.
+   -------------------------------------------------------------------------
+   LICENSE: This program is free software. You can modify it and/or re-
+   distribute it under the terms of the Apache 2.0 License. You should have
+   received a copy of the Apache 2.0 License along with this program. If
+   not, please see: http://www.apache.org/licenses/LICENSE-2.0.txt
+
+   DISCLAIMER: This program is distributed in the hope that it will be
+   useful, but without any warrantee; without even the implied warantee
+   of fitness for any particular purpose. See the License for more details.
+\* ------------------------------------------------------------------------- */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "hash-map.h"
+
+#define OC_HMAP_FIB_MULT 0x9E3779B97F4A7C15ULL
+
+/* an integer mixer for integer keys: every input bit reaches every
+   output bit. */
+static inline uint64_t
+oc_hash_u64(uint64_t key)
+{
+  key ^= key >> 32;
+  key *= 0xd6e8feb86659fd93ULL;
+  key ^= key >> 32;
+  key *= 0xd6e8feb86659fd93ULL;
+  key ^= key >> 32;
+  return key;
+}
+
+#define OC_HMAP_DEFINE(name, K, V, hash_fn, eq_fn)                           \
+                                                                             \
+typedef struct name##_entry {                                                \
+  K key;                                                                     \
+  V val;                                                                     \
+} name##_entry;                                                              \
+                                                                             \
+typedef struct name {                                                        \
+  name##_entry *slots;                                                       \
+  uint8_t      *ctrl;        /* 0: empty, else 0x80 | 7 bits of hash. */     \
+  uint64_t      seed;                                                        \
+  uint32_t      map_size;    /* always a power of two. */                    \
+  uint32_t      shift;       /* 64 - log2(map_size). */                      \
+  uint32_t      item_count;                                                  \
+} name;                                                                      \
+                                                                             \
+static inline uint64_t                                                       \
+name##_mix_(const name *h, K key)                                            \
+{                                                                            \
+  return ((uint64_t)(hash_fn(key)) ^ h->seed) * OC_HMAP_FIB_MULT;            \
+}                                                                            \
+                                                                             \
+static inline void                                                           \
+name##_alloc_(name *h, uint32_t size, uint32_t shift)                        \
+{                                                                            \
+  h->map_size = size;                                                        \
+  h->shift    = shift;                                                       \
+  h->slots    = malloc(size * sizeof(name##_entry));                         \
+  h->ctrl     = calloc(size, 1);                                             \
+}                                                                            \
+                                                                             \
+static inline name*                                                          \
+name##_create(void)                                                          \
+{                                                                            \
+  name *h = malloc(sizeof(name));                                            \
+  h->seed       = hmap_random_seed();                                        \
+  h->item_count = 0;                                                         \
+  name##_alloc_(h, 16, 60);                                                  \
+  return h;                                                                  \
+}                                                                            \
+                                                                             \
+static inline void                                                           \
+name##_free(name *h)                                                         \
+{                                                                            \
+  free(h->slots);                                                            \
+  free(h->ctrl);                                                             \
+  free(h);                                                                   \
+}                                                                            \
+                                                                             \
+/* Place an entry known to be absent: no eq_fn calls. */                     \
+static inline void                                                           \
+name##_place_(name *h, uint64_t mix, const name##_entry *e)                  \
+{                                                                            \
+  uint32_t mask = h->map_size - 1;                                           \
+  uint32_t idx  = (uint32_t)(mix >> h->shift);                               \
+  while (h->ctrl[idx]) idx = (idx + 1) & mask;                               \
+  h->ctrl[idx]  = (uint8_t)(0x80 | ((mix >> 25) & 0x7F));                    \
+  h->slots[idx] = *e;                                                        \
+}                                                                            \
+                                                                             \
+static inline void                                                           \
+name##_grow_(name *h)                                                        \
+{                                                                            \
+  name##_entry *old = h->slots;                                              \
+  uint8_t *old_ctrl = h->ctrl;                                               \
+  uint32_t old_size = h->map_size;                                           \
+  name##_alloc_(h, old_size << 1, h->shift - 1);                             \
+  for (uint32_t i = 0; i < old_size; i++) {                                  \
+    if (old_ctrl[i]) name##_place_(h, name##_mix_(h, old[i].key), &old[i]);  \
+  }                                                                          \
+  free(old);                                                                 \
+  free(old_ctrl);                                                            \
+}                                                                            \
+                                                                             \
+/* The slot holding key, or UINT32_MAX. */                                   \
+static inline uint32_t                                                       \
+name##_find_(const name *h, K key)                                           \
+{                                                                            \
+  uint64_t mix  = name##_mix_(h, key);                                       \
+  uint32_t mask = h->map_size - 1;                                           \
+  uint32_t idx  = (uint32_t)(mix >> h->shift);                               \
+  uint8_t  tag  = (uint8_t)(0x80 | ((mix >> 25) & 0x7F));                    \
+  for (;; idx = (idx + 1) & mask) {                                          \
+    if (!h->ctrl[idx]) return UINT32_MAX;                                    \
+    if (h->ctrl[idx] == tag && eq_fn(h->slots[idx].key, key)) return idx;    \
+  }                                                                          \
+}                                                                            \
+                                                                             \
+static inline void                                                           \
+name##_put(name *h, K key, V val)                                            \
+{                                                                            \
+  name##_entry e;                                                            \
+  uint32_t idx = name##_find_(h, key);                                       \
+  e.key = key;                                                               \
+  e.val = val;                                                               \
+  if (idx != UINT32_MAX) {                                                   \
+    h->slots[idx] = e;                                                       \
+    return;                                                                  \
+  }                                                                          \
+  if ((uint64_t)(h->item_count + 1) * 4 > (uint64_t)h->map_size * 3) {       \
+    name##_grow_(h);                                                         \
+  }                                                                          \
+  name##_place_(h, name##_mix_(h, key), &e);                                 \
+  h->item_count++;                                                           \
+}                                                                            \
+                                                                             \
+static inline V*                                                             \
+name##_get(name *h, K key)                                                   \
+{                                                                            \
+  uint32_t idx = name##_find_(h, key);                                       \
+  return idx == UINT32_MAX ? NULL : &h->slots[idx].val;                      \
+}                                                                            \
+                                                                             \
+/* Backward shift: each later entry of the run moves into the hole unless */ \
+/* its home lies between the hole and itself. */                             \
+static inline bool                                                           \
+name##_remove(name *h, K key)                                                \
+{                                                                            \
+  uint32_t mask = h->map_size - 1;                                           \
+  uint32_t idx  = name##_find_(h, key);                                      \
+  uint32_t next, home;                                                       \
+  if (idx == UINT32_MAX) return false;                                       \
+  for (next = (idx + 1) & mask; h->ctrl[next]; next = (next + 1) & mask) {   \
+    home = (uint32_t)(name##_mix_(h, h->slots[next].key) >> h->shift);       \
+    if (((next - home) & mask) >= ((next - idx) & mask)) {                   \
+      h->slots[idx] = h->slots[next];                                        \
+      h->ctrl[idx]  = h->ctrl[next];                                         \
+      idx = next;                                                            \
+    }                                                                        \
+  }                                                                          \
+  h->ctrl[idx] = 0;                                                          \
+  h->item_count--;                                                           \
+  return true;                                                               \
+}                                                                            \
+                                                                             \
+static inline uint32_t                                                       \
+name##_count(const name *h)                                                  \
+{                                                                            \
+  return h->item_count;                                                      \
+}                                                                            \
+                                                                             \
+static inline bool                                                           \
+name##_next(const name *h, uint32_t *pos, K *key, V *val)                    \
+{                                                                            \
+  for (; *pos < h->map_size; (*pos)++) {                                     \
+    if (!h->ctrl[*pos]) continue;                                            \
+    if (key) *key = h->slots[*pos].key;                                      \
+    if (val) *val = h->slots[*pos].val;                                      \
+    (*pos)++;                                                                \
+    return true;                                                             \
+  }                                                                          \
+  return false;                                                              \
+}
+
+#endif
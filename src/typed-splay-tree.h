@@ -0,0 +1,218 @@
+#ifndef _TYPED_SPLAY_TREE_H
+#define _TYPED_SPLAY_TREE_H
+/* ------------------------------------------------------------------------- *\
+   Typed Splay Tree
+     - A generator for splay trees of one key type and one value type:
+         OC_SPLAY_DEFINE(name, K, V, cmp_fn)
+       defines the type name and its functions, all static inline, in the
+       file that uses it. splay stays the generic, void* tree.
+     - Prefix: the name given.
+     - Keys and values are stored inline in the nodes, and cmp_fn is
+       called directly, so the compiler can inline it. cmp_fn(K, K)
+       returns < 0, 0 or > 0, as a comparator does; it may be a function
+       or a function-like macro.
+     - Top-down splaying: one pass down from the root, no parent links
+       and no recursion, so a degenerate tree costs no stack.
+     - The tree holds keys and values by value and never frees them; a
+       tree of pointers is released by walking it with name_each first.
+     - Functions defined (t is a name*):
+         name*  name_create(void)
+         void   name_free(t)
+         void   name_put(t, K key, V val)     replaces an existing key's
+                                              key and value
+         V*     name_get(t, K key)            NULL if absent; good until
+                                              the next put or remove
+         bool   name_remove(t, K key)         false if absent
+         uint32_t name_count(t)
+         void   name_each(t, fn, ctx)         fn(K key, V *val, void *ctx)
+                                              for each entry, in key order;
+                                              fn must not change the tree.
+   -------------------------------------------------------------------------
+   LICENSE: This program is free software. You can modify it and/or re-
+   distribute it under the terms of the Apache 2.0 License. You should have
+   received a copy of the Apache 2.0 License along with this program. If
+   not, please see: http://www.apache.org/licenses/LICENSE-2.0.txt
+
+   DISCLAIMER: This program is distributed in the hope that it will be
+   useful, but without any warrantee; without even the implied warantee
+   of fitness for any particular purpose. See the License for more details.
+\* ------------------------------------------------------------------------- */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#define OC_SPLAY_DEFINE(name, K, V, cmp_fn)                                  \
+                                                                             \
+typedef struct name##_node {                                                 \
+  K k;                                                                       \
+  V v;                                                                       \
+  struct name##_node *l;                                                     \
+  struct name##_node *r;                                                     \
+} name##_node;                                                               \
+                                                                             \
+typedef struct name {                                                        \
+  name##_node *root;                                                         \
+  uint32_t     count;                                                        \
+} name;                                                                      \
+                                                                             \
+static inline name*                                                          \
+name##_create(void)                                                          \
+{                                                                            \
+  name *t  = malloc(sizeof(name));                                           \
+  t->root  = NULL;                                                           \
+  t->count = 0;                                                              \
+  return t;                                                                  \
+}                                                                            \
+                                                                             \
+/* Rotate each left child up until there is none, then free the root: */     \
+/* no stack, however the tree is shaped. */                                  \
+static inline void                                                           \
+name##_free(name *t)                                                         \
+{                                                                            \
+  name##_node *n = t->root, *c;                                              \
+  while (n) {                                                                \
+    if (n->l) {                                                              \
+      c = n->l;                                                              \
+      n->l = c->r;                                                           \
+      c->r = n;                                                              \
+      n = c;                                                                 \
+    } else {                                                                 \
+      c = n->r;                                                              \
+      free(n);                                                               \
+      n = c;                                                                 \
+    }                                                                        \
+  }                                                                          \
+  free(t);                                                                   \
+}                                                                            \
+                                                                             \
+/* Sleator's top-down splay: the nodes passed on the way down hang off */    \
+/* two side trees, reassembled under whichever node the search ends on: */   \
+/* key's, or its last neighbour's. */                                        \
+static inline name##_node*                                                   \
+name##_splay_(name##_node *n, K key)                                         \
+{                                                                            \
+  name##_node side, *l = &side, *r = &side, *y;                              \
+  int c;                                                                     \
+  side.l = side.r = NULL;                                                    \
+  for (;;) {                                                                 \
+    c = cmp_fn(key, n->k);                                                   \
+    if (c < 0) {                                                             \
+      if (!n->l) break;                                                      \
+      if (cmp_fn(key, n->l->k) < 0) {                                        \
+        y = n->l; n->l = y->r; y->r = n; n = y;                              \
+        if (!n->l) break;                                                    \
+      }                                                                      \
+      r->l = n; r = n; n = n->l;                                             \
+    } else if (c > 0) {                                                      \
+      if (!n->r) break;                                                      \
+      if (cmp_fn(key, n->r->k) > 0) {                                        \
+        y = n->r; n->r = y->l; y->l = n; n = y;                              \
+        if (!n->r) break;                                                    \
+      }                                                                      \
+      l->r = n; l = n; n = n->r;                                             \
+    } else {                                                                 \
+      break;                                                                 \
+    }                                                                        \
+  }                                                                          \
+  l->r = n->l;                                                               \
+  r->l = n->r;                                                               \
+  n->l = side.r;                                                             \
+  n->r = side.l;                                                             \
+  return n;                                                                  \
+}                                                                            \
+                                                                             \
+static inline void                                                           \
+name##_put(name *t, K key, V val)                                            \
+{                                                                            \
+  name##_node *n;                                                            \
+  int c = 0;                                                                 \
+  if (t->root) {                                                             \
+    t->root = name##_splay_(t->root, key);                                   \
+    c = cmp_fn(key, t->root->k);                                             \
+    if (c == 0) {                                                            \
+      t->root->k = key;                                                      \
+      t->root->v = val;                                                      \
+      return;                                                                \
+    }                                                                        \
+  }                                                                          \
+  n = malloc(sizeof(name##_node));                                           \
+  n->k = key;                                                                \
+  n->v = val;                                                                \
+  if (!t->root) {                                                            \
+    n->l = n->r = NULL;                                                      \
+  } else if (c < 0) {                                                        \
+    n->l = t->root->l;                                                       \
+    n->r = t->root;                                                          \
+    t->root->l = NULL;                                                       \
+  } else {                                                                   \
+    n->r = t->root->r;                                                       \
+    n->l = t->root;                                                          \
+    t->root->r = NULL;                                                       \
+  }                                                                          \
+  t->root = n;                                                               \
+  t->count++;                                                                \
+}                                                                            \
+                                                                             \
+static inline V*                                                             \
+name##_get(name *t, K key)                                                   \
+{                                                                            \
+  if (!t->root) return NULL;                                                 \
+  t->root = name##_splay_(t->root, key);                                     \
+  return cmp_fn(key, t->root->k) == 0 ? &t->root->v : NULL;                  \
+}                                                                            \
+                                                                             \
+/* With key splayed to the root, splaying its left subtree for key again */  \
+/* brings up its predecessor, which has no right child to lose. */           \
+static inline bool                                                           \
+name##_remove(name *t, K key)                                                \
+{                                                                            \
+  name##_node *n;                                                            \
+  if (!t->root) return false;                                                \
+  t->root = name##_splay_(t->root, key);                                     \
+  if (cmp_fn(key, t->root->k) != 0) return false;                            \
+  n = t->root;                                                               \
+  if (!n->l) {                                                               \
+    t->root = n->r;                                                          \
+  } else {                                                                   \
+    t->root = name##_splay_(n->l, key);                                      \
+    t->root->r = n->r;                                                       \
+  }                                                                          \
+  free(n);                                                                   \
+  t->count--;                                                                \
+  return true;                                                               \
+}                                                                            \
+                                                                             \
+static inline uint32_t                                                       \
+name##_count(const name *t)                                                  \
+{                                                                            \
+  return t->count;                                                           \
+}                                                                            \
+                                                                             \
+/* Morris traversal: threads each left subtree's last node back to its */    \
+/* successor, and unthreads it on the way past, so the walk needs */         \
+/* neither a stack nor parent links. */                                      \
+static inline void                                                           \
+name##_each(name *t, void (*fn)(K, V*, void*), void *ctx)                    \
+{                                                                            \
+  name##_node *n = t->root, *p;                                              \
+  while (n) {                                                                \
+    if (!n->l) {                                                             \
+      fn(n->k, &n->v, ctx);                                                  \
+      n = n->r;                                                              \
+      continue;                                                              \
+    }                                                                        \
+    for (p = n->l; p->r && p->r != n; p = p->r);                             \
+    if (!p->r) {                                                             \
+      p->r = n;                                                              \
+      n = n->l;                                                              \
+    } else {                                                                 \
+      p->r = NULL;                                                           \
+      fn(n->k, &n->v, ctx);                                                  \
+      n = n->r;                                                              \
+    }                                                                        \
+  }                                                                          \
+}
+
+#endif
@@ -0,0 +1,293 @@
+/* ------------------------------------------------------------------------- *\
+   unit tests for cache
+   -------------------------------------------------------------------------
+   LICENSE: This program is free software. You can modify it and/or re-
+   distribute it under the terms of the Apache 2.0 License. You should have
+   received a copy of the Apache 2.0 License along with this program. If
+   not, please see: http://www.apache.org/licenses/LICENSE-2.0.txt
+
+   DISCLAIMER: This program is distributed in the hope that it will be
+   useful, but without any warrantee; without even the implied warantee
+   of fitness for any particular purpose. See the License for more details.
+\* ------------------------------------------------------------------------- */
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "cache.h"
+
+/* public entry point */
+int test_cache(bool);
+
+/* helper declarations */
+static void _count_free(void*, void*);
+
+/* test declarations */
+static bool _test_lru(bool);
+static bool _test_clock(bool);
+static bool _test_bytes(bool, oc_cache_policy, const char*);
+static bool _test_replace_remove(bool, oc_cache_policy, const char*);
+static bool _test_churn(bool, oc_cache_policy, const char*);
+static bool _test_inline_keys(bool, oc_cache_policy, const char*);
+
+/* helper functions */
+static int _free_ctr = 0;
+static char *_free_key = NULL;
+static void _count_free(void* key, void* obj)
+{
+  (void)obj;
+  _free_key = key;
+  _free_ctr++;
+}
+
+/* test implementations */
+static bool _test_lru(bool quiet)
+{
+  bool result = true;
+  oc_cache_opts opts = { .policy = OC_CACHE_LRU, .max_entries = 3 };
+  oc_cache *c = oc_cache_create(&_count_free, &opts);
+  oc_cache_stats st;
+
+  oc_cache_put(c, "a", "1", 1);
+  oc_cache_put(c, "b", "2", 1);
+  oc_cache_put(c, "c", "3", 1);
+  _free_ctr = 0;
+  if (oc_cache_get(c, "a") == NULL) result = false;
+  oc_cache_put(c, "d", "4", 1);
+  if (_free_ctr != 1 || strcmp(_free_key, "b") ||
+      oc_cache_get(c, "b") || !oc_cache_get(c, "a")) {
+    if (!quiet) printf("ERR: Cache LRU evicted the wrong entry.\n");
+    result = false;
+  }
+  /* c is now the least recently used. */
+  oc_cache_put(c, "e", "5", 1);
+  if (_free_ctr != 2 || strcmp(_free_key, "c")) result = false;
+  oc_cache_get_stats(c, &st);
+  if (st.hits != 2 || st.misses != 1 || st.evictions != 2 || st.count != 3) {
+    if (!quiet) printf("ERR: Cache LRU counters off.\n");
+    result = false;
+  }
+  _free_ctr = 0;
+  oc_cache_free(c);
+  if (_free_ctr != 3) result = false;
+  return result;
+}
+
+/*
+ * The hand starts at the front: a, used, is passed over and cleared, and
+ * b goes. The next entry goes in just behind the hand, now at c, and c is
+ * the next to go.
+ */
+static bool _test_clock(bool quiet)
+{
+  bool result = true;
+  oc_cache_opts opts = { .policy = OC_CACHE_CLOCK, .max_entries = 3 };
+  oc_cache *c = oc_cache_create(&_count_free, &opts);
+
+  oc_cache_put(c, "a", "1", 1);
+  oc_cache_put(c, "b", "2", 1);
+  oc_cache_put(c, "c", "3", 1);
+  _free_ctr = 0;
+  oc_cache_get(c, "a");
+  oc_cache_put(c, "d", "4", 1);
+  if (_free_ctr != 1 || strcmp(_free_key, "b")) {
+    if (!quiet) printf("ERR: Cache CLOCK evicted the wrong entry.\n");
+    result = false;
+  }
+  oc_cache_put(c, "e", "5", 1);
+  if (_free_ctr != 2 || strcmp(_free_key, "c")) {
+    if (!quiet) printf("ERR: Cache CLOCK evicted the wrong entry.\n");
+    result = false;
+  }
+  /* Every other entry used: the hand clears them all, and takes one
+     rather than the entry just put. */
+  oc_cache_get(c, "a");
+  oc_cache_get(c, "d");
+  oc_cache_get(c, "e");
+  oc_cache_put(c, "f", "6", 1);
+  if (_free_ctr != 3 || !strcmp(_free_key, "f") || !oc_cache_get(c, "f")) {
+    if (!quiet) printf("ERR: Cache CLOCK evicted the entry just put.\n");
+    result = false;
+  }
+  oc_cache_free(c);
+  return result;
+}
+
+static bool _test_bytes(bool quiet, oc_cache_policy policy, const char *name)
+{
+  bool result = true;
+  oc_cache_opts opts = { .policy = policy, .max_bytes = 100 };
+  oc_cache *c = oc_cache_create(&_count_free, &opts);
+  oc_cache_stats st;
+
+  _free_ctr = 0;
+  oc_cache_put(c, "a", "1", 40);
+  oc_cache_put(c, "b", "2", 40);
+  oc_cache_put(c, "c", "3", 40);
+  oc_cache_get_stats(c, &st);
+  if (_free_ctr != 1 || strcmp(_free_key, "a") || st.bytes != 80) {
+    if (!quiet) printf("ERR: %s cache over its byte budget.\n", name);
+    result = false;
+  }
+  /* Over the whole budget on its own: everything goes, itself last. */
+  oc_cache_put(c, "big", "4", 150);
+  oc_cache_get_stats(c, &st);
+  if (_free_ctr != 4 || strcmp(_free_key, "big") || st.count != 0 ||
+      st.bytes != 0 || st.evictions != 4) {
+    if (!quiet) printf("ERR: %s cache kept an oversized item.\n", name);
+    result = false;
+  }
+  oc_cache_free(c);
+  return result;
+}
+
+static bool _test_replace_remove(bool quiet, oc_cache_policy policy,
+                                 const char *name)
+{
+  bool result = true;
+  oc_cache_opts opts = { .policy = policy, .max_entries = 10 };
+  oc_cache *c = oc_cache_create(&_count_free, &opts);
+  char k1[] = "key", k2[] = "key";
+  oc_cache_stats st;
+
+  _free_ctr = 0;
+  oc_cache_put(c, k1, "old", 5);
+  oc_cache_put(c, k2, "new", 7);
+  oc_cache_get_stats(c, &st);
+  if (_free_ctr != 1 || _free_key != k2 || st.count != 1 || st.bytes != 7 ||
+      strcmp(oc_cache_get(c, "key"), "new")) {
+    if (!quiet) printf("ERR: %s cache replace failed.\n", name);
+    result = false;
+  }
+  oc_cache_remove(c, "key");
+  oc_cache_remove(c, "absent");
+  oc_cache_get_stats(c, &st);
+  if (_free_ctr != 2 || _free_key != k1 || st.count != 0 || st.bytes != 0 ||
+      st.evictions != 0 || oc_cache_get(c, "key")) {
+    if (!quiet) printf("ERR: %s cache remove failed.\n", name);
+    result = false;
+  }
+  oc_cache_put_n(c, "a\0b", 3, "bytes", 1);
+  if (oc_cache_get_n(c, "a\0b", 3) == NULL || oc_cache_get(c, "a")) {
+    result = false;
+  }
+  oc_cache_remove_n(c, "a\0b", 3);
+  if (oc_cache_count(c) != 0) result = false;
+
+  /* The same key and item again release nothing; a new item for the
+     same key releases the old item alone. */
+  _free_ctr = 0;
+  oc_cache_put(c, k1, "same", 1);
+  oc_cache_put(c, k1, "same", 1);
+  if (_free_ctr != 0) result = false;
+  oc_cache_put(c, k1, "other", 1);
+  if (_free_ctr != 1 || _free_key != NULL ||
+      strcmp(oc_cache_get(c, k1), "other")) {
+    if (!quiet) printf("ERR: %s cache released a key it kept.\n", name);
+    result = false;
+  }
+  oc_cache_free(c);
+  return result;
+}
+
+/* Random puts, gets and removes: never over budget, and the count is
+   the number of keys get still finds. */
+static bool _test_churn(bool quiet, oc_cache_policy policy, const char *name)
+{
+  bool result = true;
+  oc_cache_opts opts = { .policy = policy, .max_entries = 500,
+                         .map = { .engine = HMAP_SWISS } };
+  oc_cache *c = oc_cache_create(NULL, &opts);
+  static char key[4000][12];
+  oc_cache_stats st;
+  uint64_t r = 88172645463325252ULL;
+  uint32_t i, held = 0;
+  void *got;
+
+  for (i = 0; i < 4000; i++) snprintf(key[i], 12, "ckey%u", i);
+  for (int op = 0; op < 200000; op++) {
+    r ^= r << 13; r ^= r >> 7; r ^= r << 17;   /* xorshift */
+    i = (uint32_t)(r % 4000);
+    switch ((r >> 32) % 4) {
+      case 0:
+        oc_cache_remove(c, key[i]);
+        break;
+      case 1:
+        oc_cache_put(c, key[i], key[i], 1);
+        break;
+      default:
+        got = oc_cache_get(c, key[i]);
+        if (got && got != key[i]) result = false;
+        break;
+    }
+    if (oc_cache_count(c) > 500) result = false;
+  }
+  oc_cache_get_stats(c, &st);
+  for (i = 0; i < 4000; i++) {
+    if (oc_cache_get(c, key[i])) held++;
+  }
+  if (held != st.count || st.hits + st.misses < 90000) result = false;
+  if (!result && !quiet) printf("ERR: %s cache churn failed.\n", name);
+  oc_cache_free(c);
+  return result;
+}
+
+/* One key buffer, rewritten for every call: the cache must hold keys of
+   its own, through eviction, replacement and remove. */
+static bool _test_inline_keys(bool quiet, oc_cache_policy policy,
+                              const char *name)
+{
+  bool result = true;
+  oc_cache_opts opts = { .policy = policy, .max_entries = 2,
+                         .map = { .engine = HMAP_SWISS,
+                                  .inline_keys = true } };
+  oc_cache *c = oc_cache_create(&_count_free, &opts);
+  static char vals[8][4] = { "v0", "v1", "v2", "v3", "v4", "v5", "v6", "v7" };
+  char buf[24];
+
+  _free_ctr = 0;
+  for (int i = 0; i < 8; i++) {
+    snprintf(buf, sizeof(buf), "ikey%d", i);
+    oc_cache_put(c, buf, vals[i], 1);
+    snprintf(buf, sizeof(buf), "ikey%d", i);
+    if (oc_cache_get(c, buf) != vals[i]) result = false;
+  }
+  snprintf(buf, sizeof(buf), "ikey7");
+  oc_cache_put(c, buf, vals[0], 1);
+  if (oc_cache_get(c, buf) != vals[0]) result = false;
+  snprintf(buf, sizeof(buf), "ikey6");
+  oc_cache_remove(c, buf);
+  snprintf(buf, sizeof(buf), "ikey3");
+  if (oc_cache_get(c, buf) || oc_cache_count(c) != 1) result = false;
+  /* Six evicted, one replaced, one removed. */
+  if (_free_ctr != 8) result = false;
+  if (!result && !quiet) printf("ERR: %s cache inline keys failed.\n", name);
+  oc_cache_free(c);
+  return result;
+}
+
+int test_cache(bool quiet)
+{
+  uint32_t errs = 0;
+
+  if (_test_lru(quiet) != true) errs++;
+  if (_test_clock(quiet) != true) errs++;
+  if (_test_bytes(quiet, OC_CACHE_LRU, "LRU") != true) errs++;
+  if (_test_bytes(quiet, OC_CACHE_CLOCK, "CLOCK") != true) errs++;
+  if (_test_replace_remove(quiet, OC_CACHE_LRU, "LRU") != true) errs++;
+  if (_test_replace_remove(quiet, OC_CACHE_CLOCK, "CLOCK") != true) errs++;
+  if (_test_churn(quiet, OC_CACHE_LRU, "LRU") != true) errs++;
+  if (_test_churn(quiet, OC_CACHE_CLOCK, "CLOCK") != true) errs++;
+  if (_test_inline_keys(quiet, OC_CACHE_LRU, "LRU") != true) errs++;
+  if (_test_inline_keys(quiet, OC_CACHE_CLOCK, "CLOCK") != true) errs++;
+
+  if (!quiet) {
+    if (errs)
+      printf("[FAIL] : Cache\n");
+    else
+      printf("[OK]   : Cache\n");
+  }
+
+  return errs;
+}
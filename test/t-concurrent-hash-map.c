@@ -0,0 +1,229 @@
+/* ------------------------------------------------------------------------- *\
+   unit tests for concurrent hash map
+   -------------------------------------------------------------------------
+   LICENSE: This program is free software. You can modify it and/or re-
+   distribute it under the terms of the Apache 2.0 License. You should have
+   received a copy of the Apache 2.0 License along with this program. If
+   not, please see: http://www.apache.org/licenses/LICENSE-2.0.txt
+
+   DISCLAIMER: This program is distributed in the hope that it will be
+   useful, but without any warrantee; without even the implied warantee
+   of fitness for any particular purpose. See the License for more details.
+\* ------------------------------------------------------------------------- */
+#define _POSIX_C_SOURCE 200809L
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "concurrent-hash-map.h"
+
+/* public entry point */
+int test_concurrent_hash_map(bool);
+
+/* helper declarations */
+static void _count_free(void*, void*);
+static void *_writer(void*);
+static void *_reader(void*);
+
+/* test declarations */
+static bool _test_put_get(bool);
+static bool _test_destructor(bool);
+static bool _test_grow(bool);
+static bool _test_threads(bool);
+
+/* helper functions */
+static int _free_ctr = 0;
+static void _count_free(void* key, void* obj)
+{
+  (void)key;
+  (void)obj;
+  __atomic_add_fetch(&_free_ctr, 1, __ATOMIC_RELAXED);
+}
+
+#define THREADS  4
+#define KEYS     4096
+#define ROUNDS   20
+
+static chmap *_shared;
+static char   _keys[THREADS][KEYS][16];
+static int    _bad_reads = 0;
+static bool   _writing = true;
+
+/* Each writer owns a key range, and cycles it through put, replace and
+   remove; every value it stores is the key string itself, or NULL. */
+static void *
+_writer(void *arg)
+{
+  char (*key)[16] = _keys[(intptr_t)arg];
+
+  for (int r = 0; r < ROUNDS; r++) {
+    for (int i = 0; i < KEYS; i++) chmap_put(_shared, key[i], key[i]);
+    for (int i = 0; i < KEYS; i += 2) chmap_put(_shared, key[i], key[i]);
+    for (int i = 0; i < KEYS; i += 3) chmap_remove(_shared, key[i]);
+  }
+  return NULL;
+}
+
+/* Readers may see any key present or absent, but never another's value. */
+static void *
+_reader(void *arg)
+{
+  char *v;
+  (void)arg;
+
+  while (__atomic_load_n(&_writing, __ATOMIC_ACQUIRE)) {
+    for (int t = 0; t < THREADS; t++) {
+      for (int i = 0; i < KEYS; i += 7) {
+        v = chmap_get(_shared, _keys[t][i]);
+        if (v && v != _keys[t][i]) {
+          __atomic_add_fetch(&_bad_reads, 1, __ATOMIC_RELAXED);
+        }
+      }
+    }
+  }
+  return NULL;
+}
+
+/* test implementations */
+static bool _test_put_get(bool quiet)
+{
+  bool result = true;
+  chmap *c = chmap_create(NULL);
+  const char k[] = { 'a', '\0', 'b' };
+
+  chmap_put(c, "keya", "vala");
+  chmap_put(c, "keyb", "valb");
+  chmap_put_n(c, k, 3, "valc");
+  if (strcmp(chmap_get(c, "keya"), "vala") ||
+      strcmp(chmap_get(c, "keyb"), "valb") ||
+      strcmp(chmap_get_n(c, k, 3), "valc") ||
+      chmap_get(c, "a") != NULL || chmap_count(c) != 3) {
+    if (!quiet) printf("ERR: Concurrent Hash Map put/get mismatch.\n");
+    result = false;
+  }
+  chmap_put(c, "keya", "newa");
+  chmap_remove(c, "keyb");
+  if (strcmp(chmap_get(c, "keya"), "newa") || chmap_get(c, "keyb") != NULL ||
+      chmap_count(c) != 2) {
+    if (!quiet) printf("ERR: Concurrent Hash Map replace/remove failed.\n");
+    result = false;
+  }
+  chmap_free(c);
+  return result;
+}
+
+static bool _test_destructor(bool quiet)
+{
+  bool result = true;
+  chmap *c = chmap_create(&_count_free);
+
+  _free_ctr = 0;
+  chmap_put(c, "keya", "vala");
+  chmap_put(c, "keyb", "valb");
+  chmap_put(c, "keya", "newa");  /* releases keya/vala, in due course */
+  chmap_remove(c, "keyb");       /* not released, as with hmap */
+  chmap_free(c);
+  if (_free_ctr != 2) {
+    if (!quiet) printf("ERR: Concurrent Hash Map released %d, not 2.\n",
+                       _free_ctr);
+    result = false;
+  }
+  return result;
+}
+
+static bool _test_grow(bool quiet)
+{
+  bool result = true;
+  chmap *c = chmap_create(&_count_free);
+  static char key[20000][12];
+
+  _free_ctr = 0;
+  for (int i = 0; i < 20000; i++) {
+    snprintf(key[i], 12, "nkey%d", i);
+    chmap_put(c, key[i], key[i]);
+  }
+  for (int i = 0; i < 20000; i++) {
+    if (chmap_get(c, key[i]) != key[i]) {
+      if (!quiet) printf("ERR: Concurrent Hash Map lost %s growing.\n", key[i]);
+      result = false;
+      break;
+    }
+  }
+  if (chmap_count(c) != 20000 || _free_ctr != 0) {
+    if (!quiet) printf("ERR: Concurrent Hash Map miscounted growing.\n");
+    result = false;
+  }
+  chmap_free(c);
+  if (_free_ctr != 20000) {
+    if (!quiet) printf("ERR: Concurrent Hash Map grow copies released.\n");
+    result = false;
+  }
+  return result;
+}
+
+static bool _test_threads(bool quiet)
+{
+  bool result = true;
+  pthread_t writers[THREADS], readers[THREADS];
+  uint32_t expect = 0;
+
+  _shared = chmap_create(NULL);
+  _bad_reads = 0;
+  _writing = true;
+  for (int t = 0; t < THREADS; t++) {
+    for (int i = 0; i < KEYS; i++) snprintf(_keys[t][i], 16, "t%dk%d", t, i);
+  }
+  for (intptr_t t = 0; t < THREADS; t++) {
+    pthread_create(&readers[t], NULL, _reader, NULL);
+    pthread_create(&writers[t], NULL, _writer, (void*)t);
+  }
+  for (int t = 0; t < THREADS; t++) pthread_join(writers[t], NULL);
+  __atomic_store_n(&_writing, false, __ATOMIC_RELEASE);
+  for (int t = 0; t < THREADS; t++) pthread_join(readers[t], NULL);
+
+  for (int t = 0; t < THREADS; t++) {
+    for (int i = 0; i < KEYS; i++) {
+      if ((i % 3 == 0) != (chmap_get(_shared, _keys[t][i]) == NULL)) {
+        if (!quiet) printf("ERR: Concurrent Hash Map wrong after threads: "
+                           "%s\n", _keys[t][i]);
+        result = false;
+        t = THREADS;
+        break;
+      }
+      if (i % 3) expect++;
+    }
+  }
+  if (result && chmap_count(_shared) != expect) {
+    if (!quiet) printf("ERR: Concurrent Hash Map count %u, not %u.\n",
+                       chmap_count(_shared), expect);
+    result = false;
+  }
+  if (_bad_reads) {
+    if (!quiet) printf("ERR: Concurrent Hash Map: %d bad reads.\n", _bad_reads);
+    result = false;
+  }
+  chmap_free(_shared);
+  return result;
+}
+
+int test_concurrent_hash_map(bool quiet)
+{
+  uint32_t errs = 0;
+
+  if (_test_put_get(quiet) != true) errs++;
+  if (_test_destructor(quiet) != true) errs++;
+  if (_test_grow(quiet) != true) errs++;
+  if (_test_threads(quiet) != true) errs++;
+
+  if (!quiet) {
+    if (errs)
+      printf("[FAIL] : Concurrent Hash Map\n");
+    else
+      printf("[OK]   : Concurrent Hash Map\n");
+  }
+
+  return errs;
+}
@@ -0,0 +1,256 @@
+/* ------------------------------------------------------------------------- *\
+   unit tests for filter
+   -------------------------------------------------------------------------
+   LICENSE: This program is free software. You can modify it and/or re-
+   distribute it under the terms of the Apache 2.0 License. You should have
+   received a copy of the Apache 2.0 License along with this program. If
+   not, please see: http://www.apache.org/licenses/LICENSE-2.0.txt
+
+   DISCLAIMER: This program is distributed in the hope that it will be
+   useful, but without any warrantee; without even the implied warantee
+   of fitness for any particular purpose. See the License for more details.
+\* ------------------------------------------------------------------------- */
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "filter.h"
+#include "hash-map.h"
+#include "splay-tree.h"
+
+/* public entry point */
+int test_filter(bool);
+
+/* helper declarations */
+static uint64_t _next(uint64_t *r);
+static int _str_cmp(void*, void*);
+static uint64_t _str_hash(void*);
+
+/* test declarations */
+static bool _test_rate(bool, oc_filter_kind, double rate, double most,
+                       const char*);
+static bool _test_cuckoo_remove(bool);
+static bool _test_cuckoo_full(bool);
+static bool _test_hmap(bool, hmap_engine, oc_filter_kind, const char*);
+static bool _test_splay(bool, oc_filter_kind, const char*);
+
+/* helper functions */
+static uint64_t _next(uint64_t *r)
+{
+  *r ^= *r << 13; *r ^= *r >> 7; *r ^= *r << 17;   /* xorshift */
+  return *r * 0x2545F4914F6CDD1DULL;
+}
+
+static int _str_cmp(void *a, void *b)
+{
+  return strcmp(a, b);
+}
+
+static uint64_t _str_hash(void *key)
+{
+  return oc_filter_hash(key, strlen(key));
+}
+
+#define ADDS   100000
+#define PROBES 200000
+
+/* test implementations */
+
+/* Filled to capacity: every hash added is there, and hashes never added
+   are there no more often than most. */
+static bool _test_rate(bool quiet, oc_filter_kind kind, double rate,
+                       double most, const char *name)
+{
+  bool result = true;
+  oc_filter *f = oc_filter_create(kind, ADDS, rate);
+  uint64_t r = 88172645463325252ULL, keep = r;
+  uint32_t missing = 0, false_pos = 0;
+
+  for (int i = 0; i < ADDS; i++) {
+    if (!oc_filter_add(f, _next(&r))) result = false;
+  }
+  r = keep;
+  for (int i = 0; i < ADDS; i++) {
+    if (!oc_filter_may_contain(f, _next(&r))) missing++;
+  }
+  for (int i = 0; i < PROBES; i++) {
+    if (oc_filter_may_contain(f, _next(&r))) false_pos++;
+  }
+  if (!result || missing || (double)false_pos / PROBES > most) {
+    if (!quiet) printf("ERR: %s filter: %u missing, %u false positives.\n",
+                       name, missing, false_pos);
+    result = false;
+  }
+  oc_filter_clear(f);
+  if (oc_filter_may_contain(f, keep)) result = false;
+  oc_filter_free(f);
+  return result;
+}
+
+static bool _test_cuckoo_remove(bool quiet)
+{
+  bool result = true;
+  oc_filter *f = oc_filter_create(OC_FILTER_CUCKOO, ADDS, 0.0001);
+  uint64_t r = 88172645463325252ULL, keep = r;
+  uint32_t still = 0;
+
+  for (int i = 0; i < ADDS; i++) oc_filter_add(f, _next(&r));
+  r = keep;
+  for (int i = 0; i < ADDS; i++) {
+    uint64_t h = _next(&r);
+    if (i % 2 == 0 && !oc_filter_remove(f, h)) result = false;
+  }
+  r = keep;
+  for (int i = 0; i < ADDS; i++) {
+    bool in = oc_filter_may_contain(f, _next(&r));
+    if (i % 2 && !in) result = false;
+    if (i % 2 == 0 && in) still++;
+  }
+  /* A hash added twice is there until removed twice. */
+  oc_filter_add(f, 42);
+  oc_filter_add(f, 42);
+  oc_filter_remove(f, 42);
+  if (!oc_filter_may_contain(f, 42)) result = false;
+  if (still > ADDS / 1000 || !oc_filter_removable(f)) result = false;
+  if (!result && !quiet) {
+    printf("ERR: Cuckoo filter remove failed, %u left behind.\n", still);
+  }
+  oc_filter_free(f);
+  return result;
+}
+
+/* Far over capacity, adds fail, and the filter then rules nothing out. */
+static bool _test_cuckoo_full(bool quiet)
+{
+  bool result = true;
+  oc_filter *f = oc_filter_create(OC_FILTER_CUCKOO, 100, 0.0001);
+  uint64_t r = 88172645463325252ULL, keep = r;
+  int i, added = 0;
+
+  for (i = 0; i < 1000 && oc_filter_add(f, _next(&r)); i++) added++;
+  if (added == 1000 || added < 100) result = false;
+  r = keep;
+  for (i = 0; i < added; i++) {
+    if (!oc_filter_may_contain(f, _next(&r))) result = false;
+  }
+  if (!oc_filter_may_contain(f, 12345)) result = false;
+  oc_filter_clear(f);
+  if (!oc_filter_add(f, 1) || oc_filter_may_contain(f, 12345)) {
+    result = false;
+  }
+  if (!result && !quiet) printf("ERR: Full cuckoo filter failed.\n");
+  oc_filter_free(f);
+  return result;
+}
+
+/* Every key the map holds still found, through put, replace, remove, slot,
+   bulk put and batch get, with the filter attached before and after the
+   keys went in. */
+static bool _test_hmap(bool quiet, hmap_engine engine, oc_filter_kind kind,
+                       const char *name)
+{
+  bool result = true;
+  hmap_opts opts = { .engine = engine };
+  hmap *h = hmap_create_opts(NULL, &opts);
+  oc_filter *f = oc_filter_create(kind, 40000, 0.01);
+  static char key[20000][12];
+  char *keys[20000], dup[] = "fkey1";
+  void *out[20000];
+  bool created;
+  uint32_t absent = 0;
+
+  for (int i = 0; i < 20000; i++) {
+    snprintf(key[i], 12, "fkey%d", i);
+    keys[i] = key[i];
+  }
+  for (int i = 0; i < 5000; i++) hmap_put(h, key[i], key[i]);
+  hmap_attach_filter(h, f);
+  for (int i = 5000; i < 10000; i++) hmap_put(h, key[i], key[i]);
+  hmap_put_bulk(h, keys + 10000, (void**)keys + 10000, 5000);
+  for (int i = 15000; i < 16000; i++) *hmap_slot(h, key[i], &created) = key[i];
+  hmap_put(h, dup, dup);
+  for (int i = 0; i < 16000; i += 4) hmap_remove(h, key[i]);
+  hmap_remove(h, dup);
+  hmap_get_batch(h, keys, 20000, out);
+  for (int i = 0; i < 20000; i++) {
+    bool want = i < 16000 && i % 4 && i != 1;
+    if ((hmap_get(h, key[i]) != NULL) != want || (out[i] != NULL) != want) {
+      result = false;
+    }
+    if (!oc_filter_may_contain(f, hmap_hash(h, key[i]))) absent++;
+  }
+  if (absent < 3000) result = false;
+  hmap_attach_filter(h, NULL);
+  if (hmap_get(h, key[2]) != key[2]) result = false;
+  if (!result && !quiet) printf("ERR: %s map with a filter failed.\n", name);
+  hmap_free(h);
+  oc_filter_free(f);
+  return result;
+}
+
+static bool _test_splay(bool quiet, oc_filter_kind kind, const char *name)
+{
+  bool result = true;
+  splay *s = splay_create(&_str_cmp, NULL);
+  oc_filter *f = oc_filter_create(kind, 4000, 0.01);
+  static char key[4000][12];
+
+  for (int i = 0; i < 4000; i++) snprintf(key[i], 12, "tkey%d", i);
+  for (int i = 0; i < 1000; i++) splay_put(s, key[i], key[i]);
+  splay_attach_filter(s, f, &_str_hash);
+  for (int i = 1000; i < 3000; i++) splay_put(s, key[i], key[i]);
+  splay_put(s, key[5], key[5]);
+  for (int i = 0; i < 3000; i += 3) splay_remove(s, key[i]);
+  splay_remove(s, key[3500]);
+  for (int i = 0; i < 4000; i++) {
+    bool want = i < 3000 && i % 3;
+    if ((splay_get(s, key[i]) != NULL) != want) result = false;
+  }
+  if (splay_count(s) != 2000) result = false;
+  if (!result && !quiet) printf("ERR: %s filtered splay failed.\n", name);
+  splay_free(s);
+  oc_filter_free(f);
+  return result;
+}
+
+int test_filter(bool quiet)
+{
+  uint32_t errs = 0;
+
+  if (_test_rate(quiet, OC_FILTER_BLOOM, 0.01, 0.015, "Bloom") != true) errs++;
+  if (_test_rate(quiet, OC_FILTER_BLOOM, 0.001, 0.0015, "Bloom") != true) {
+    errs++;
+  }
+  if (_test_rate(quiet, OC_FILTER_CUCKOO, 0.05, 0.04, "Cuckoo") != true) {
+    errs++;
+  }
+  if (_test_rate(quiet, OC_FILTER_CUCKOO, 0.001, 0.0003, "Cuckoo") != true) {
+    errs++;
+  }
+  if (_test_cuckoo_remove(quiet) != true) errs++;
+  if (_test_cuckoo_full(quiet) != true) errs++;
+  if (_test_hmap(quiet, HMAP_CHAINED, OC_FILTER_BLOOM, "Chained") != true) {
+    errs++;
+  }
+  if (_test_hmap(quiet, HMAP_CHAINED, OC_FILTER_CUCKOO, "Chained") != true) {
+    errs++;
+  }
+  if (_test_hmap(quiet, HMAP_ROBIN_HOOD, OC_FILTER_CUCKOO, "Robin Hood")
+      != true) errs++;
+  if (_test_hmap(quiet, HMAP_SWISS, OC_FILTER_BLOOM, "Swiss") != true) errs++;
+  if (_test_hmap(quiet, HMAP_COMPACT, OC_FILTER_CUCKOO, "Compact") != true) {
+    errs++;
+  }
+  if (_test_splay(quiet, OC_FILTER_BLOOM, "Bloom") != true) errs++;
+  if (_test_splay(quiet, OC_FILTER_CUCKOO, "Cuckoo") != true) errs++;
+
+  if (!quiet) {
+    if (errs)
+      printf("[FAIL] : Filter\n");
+    else
+      printf("[OK]   : Filter\n");
+  }
+
+  return errs;
+}
@@ -14,6 +14,7 @@
 #include <stdlib.h>
 #include <stdint.h>
 #include <stdio.h>
+#include <string.h>
 
 #include "hash-map.h"
 
@@ -33,6 +34,31 @@ static bool _test_free(bool);
 static bool _test_put_get(bool);
 static bool _test_collisions(bool);
 static bool _test_remove(bool);
+static bool _test_engine(bool, hmap_engine, const char*);
+static bool _test_churn(bool, hmap_engine, const char*);
+static bool _test_resize(bool);
+static bool _test_byte_keys(bool, hmap_engine, const char*);
+static bool _test_hash_hook(bool, hmap_engine, const char*);
+static bool _test_get_batch(bool, hmap_engine, const char*);
+static bool _test_freeze(bool, hmap_engine, const char*);
+static bool _test_slot(bool, hmap_engine, const char*);
+static bool _test_freeze_refused(bool);
+static bool _test_freeze_with(bool);
+static size_t _pair_len(const void*);
+static size_t _huge_len(const void*);
+static bool _test_iter(bool, hmap_engine, const char*);
+static bool _test_inline_keys(bool, hmap_engine, const char*);
+static void _inline_key(char*, int);
+static bool _test_bulk(bool, hmap_engine, const char*);
+static bool _test_reserve(bool, hmap_engine, const char*);
+static bool _test_hashed(bool, hmap_engine, const char*);
+static bool _test_stats(bool, hmap_engine, const char*);
+static bool _test_replace(bool, hmap_engine, const char*);
+static bool _test_overwrite(bool, hmap_engine, const char*);
+static char *_dup(const char*);
+static void _free_both(void*, void*);
+static uint32_t _walked(const hmap_stats*);
+static uint64_t _worst_hash(const void*, size_t, uint64_t);
 
 /* helper functions */
 static int _free_ctr = 0;
@@ -43,6 +69,59 @@ static void _fake_free(void* key, void* obj)
   _free_ctr++;
 }
 
+/* Every key collides: only the engine's collision handling is left. */
+static int _hash_ctr = 0;
+static uint64_t _worst_hash(const void *key, size_t len, uint64_t seed)
+{
+  (void)key;
+  (void)len;
+  _hash_ctr++;
+  return seed;
+}
+
+/* A destructor that frees what it is given, as real owners' do. */
+static int _freed_keys = 0, _freed_items = 0;
+static void _free_both(void* key, void* obj)
+{
+  if (key) {
+    free(key);
+    _freed_keys++;
+  }
+  if (obj) {
+    free(obj);
+    _freed_items++;
+  }
+}
+
+/* Items for hmap_freeze_with: binary, zero bytes and all. */
+typedef struct { uint32_t lo, hi; } pair;
+static size_t _pair_len(const void *item)
+{
+  (void)item;
+  return sizeof(pair);
+}
+
+static size_t _huge_len(const void *item)
+{
+  (void)item;
+  return UINT32_MAX;
+}
+
+static char *_dup(const char *s)
+{
+  char *d = malloc(strlen(s) + 1);
+  strcpy(d, s);
+  return d;
+}
+
+/* Entries a stats walk visited. */
+static uint32_t _walked(const hmap_stats *s)
+{
+  uint32_t n = 0;
+  for (int i = 0; i < HMAP_PROBE_HIST; i++) n += s->probe_hist[i];
+  return n;
+}
+
 /* test implementations */
 static bool _test_create(bool quiet)
 {
@@ -277,6 +356,876 @@ bool _test_remove(bool quiet)
   return result;
 }
 
+/* Growing, replacing and removing, on each engine. */
+static bool _test_engine(bool quiet, hmap_engine engine, const char *name)
+{
+  bool result = true;
+  hmap_opts opts = { .engine = engine };
+  hmap *h = hmap_create_opts(&_fake_free, &opts);
+  char key[5000][12];
+  char *v1 = "val1";
+  char *v2 = "val2";
+
+  for (int i = 0; i < 5000; i++) {
+    snprintf(key[i], 12, "nkey%d", i);
+    hmap_put(h, key[i], v1);
+  }
+  if (hmap_count(h) != 5000 || _hmap_size(h) < 5000) {
+    if (!quiet) printf("ERR: %s map did not grow: %u in %u.\n",
+                       name, hmap_count(h), _hmap_size(h));
+    result = false;
+  }
+  /* Replacing an existing key releases the old pair. */
+  _free_ctr = 0;
+  hmap_put(h, key[7], v2);
+  if (_free_ctr != 1 || hmap_count(h) != 5000 || hmap_get(h, "nkey7") != v2) {
+    if (!quiet) printf("ERR: %s map did not replace a key.\n", name);
+    result = false;
+  }
+  /* Remove every other key; later probes must still find the rest. */
+  for (int i = 0; i < 5000; i += 2) {
+    hmap_remove(h, key[i]);
+  }
+  for (int i = 0; i < 5000; i++) {
+    void *expect = (i % 2) ? (i == 7 ? v2 : v1) : NULL;
+    if (hmap_get(h, key[i]) != expect) {
+      if (!quiet) printf("ERR: %s lookup failed after remove: %s\n",
+                         name, key[i]);
+      result = false;
+      break;
+    }
+  }
+  if (hmap_count(h) != 2500) {
+    if (!quiet) printf("ERR: %s remove count not adjusted.\n", name);
+    result = false;
+  }
+  _free_ctr = 0;
+  hmap_free(h);
+  if (_free_ctr != 2500) {
+    if (!quiet) printf("ERR: %s map not calling destructor.\n", name);
+    result = false;
+  }
+  return result;
+}
+
+/* Many more puts and removes than the table holds, at a steady count;
+   then, emptied, a new key put and removed again, over and over. */
+static bool _test_churn(bool quiet, hmap_engine engine, const char *name)
+{
+  bool result = true;
+  hmap_opts opts = { .engine = engine };
+  hmap *h = hmap_create_opts(NULL, &opts);
+  static char key[20000][12];
+  uint32_t size;
+
+  for (int i = 0; i < 20000; i++) {
+    snprintf(key[i], 12, "churn%d", i);
+  }
+  for (int i = 0; i < 500; i++) {
+    hmap_put(h, key[i], key[i]);
+  }
+  size = _hmap_size(h);
+  for (int i = 500; i < 20000; i++) {
+    hmap_put(h, key[i], key[i]);
+    hmap_remove(h, key[i - 500]);
+  }
+  for (int i = 19500; i < 20000; i++) {
+    if (hmap_get(h, key[i]) != key[i]) {
+      if (!quiet) printf("ERR: %s lost %s under churn.\n", name, key[i]);
+      result = false;
+      break;
+    }
+  }
+  if (hmap_count(h) != 500 || hmap_get(h, key[0]) || _hmap_size(h) != size) {
+    if (!quiet) printf("ERR: %s map did not hold steady under churn.\n", name);
+    result = false;
+  }
+  for (int i = 19500; i < 20000; i++) hmap_remove(h, key[i]);
+  for (int i = 0; i < 20000; i++) {
+    hmap_put(h, key[i], key[i]);
+    if (hmap_get(h, key[i]) != key[i]) result = false;
+    hmap_remove(h, key[i]);
+  }
+  if (hmap_count(h) != 0 || hmap_get(h, key[19999])) {
+    if (!quiet) printf("ERR: %s map failed one-key churn.\n", name);
+    result = false;
+  }
+  hmap_free(h);
+  return result;
+}
+
+static bool _test_resize(bool quiet)
+{
+  bool result = true;
+  hmap *h = hmap_create(NULL);
+  static char key[20000][12];
+  char *old = "old";
+  char *new = "new";
+
+  /* The key sits in an old bucket when the resize starts. */
+  hmap_put(h, "dup", old);
+  for (int i = 0; i < 1100; i++) {
+    snprintf(key[i], 12, "nkey%d", i);
+    hmap_put(h, key[i], key[i]);
+  }
+  hmap_put(h, "dup", new);
+  if (_hmap_size(h) != 2048 || hmap_get(h, "dup") != new ||
+      hmap_count(h) != 1101) {
+    if (!quiet) printf("ERR: Hash Map resize did not replace a key.\n");
+    result = false;
+  }
+  for (int i = 1100; i < 20000; i++) {
+    snprintf(key[i], 12, "nkey%d", i);
+    hmap_put(h, key[i], key[i]);
+  }
+  for (int i = 0; i < 20000; i++) {
+    if (hmap_get(h, key[i]) != key[i]) {
+      if (!quiet) printf("ERR: Hash Map lost %s while resizing.\n", key[i]);
+      result = false;
+      break;
+    }
+  }
+  if (_hmap_size(h) < 16384) {
+    if (!quiet) printf("ERR: Hash Map did not grow: %u\n", _hmap_size(h));
+    result = false;
+  }
+  hmap_remove(h, "dup");
+  if (hmap_get(h, "dup") || hmap_count(h) != 20000) {
+    if (!quiet) printf("ERR: Hash Map resize left a stale duplicate.\n");
+    result = false;
+  }
+  hmap_free(h);
+  return result;
+}
+
+static bool _test_byte_keys(bool quiet, hmap_engine engine, const char *name)
+{
+  bool result = true;
+  hmap_opts opts = { .engine = engine };
+  hmap *h = hmap_create_opts(NULL, &opts);
+  const char k[] = { 'a', 'b', '\0', 'c', 'd' };
+  char *v[4] = { "v0", "v1", "v2", "v3" };
+
+  hmap_put_n(h, k, 5, v[0]);   /* NUL in the middle */
+  hmap_put_n(h, k, 3, v[1]);   /* NUL at the end */
+  hmap_put_n(h, k, 2, v[2]);   /* same bytes as the string "ab" */
+  hmap_put_n(h, "", 0, v[3]);  /* empty */
+  if (hmap_get_n(h, k, 5) != v[0] || hmap_get_n(h, k, 3) != v[1] ||
+      hmap_get(h, "ab") != v[2] || hmap_get(h, "") != v[3] ||
+      hmap_get_n(h, k, 4) != NULL || hmap_count(h) != 4) {
+    if (!quiet) printf("ERR: %s map confused keys by length.\n", name);
+    result = false;
+  }
+  hmap_remove_n(h, k, 3);
+  if (hmap_get_n(h, k, 3) != NULL || hmap_get_n(h, k, 5) != v[0]) {
+    if (!quiet) printf("ERR: %s map removed the wrong byte key.\n", name);
+    result = false;
+  }
+  hmap_free(h);
+  return result;
+}
+
+static bool _test_hash_hook(bool quiet, hmap_engine engine, const char *name)
+{
+  bool result = true;
+  hmap_opts opts = { .engine = engine, .hash = &_worst_hash, .seed = 42 };
+  hmap *h = hmap_create_opts(NULL, &opts);
+  char key[300][12];
+
+  _hash_ctr = 0;
+  for (int i = 0; i < 300; i++) {
+    snprintf(key[i], 12, "hook%d", i);
+    hmap_put(h, key[i], key[i]);
+  }
+  for (int i = 0; i < 300; i += 3) {
+    hmap_remove(h, key[i]);
+  }
+  for (int i = 0; i < 300; i++) {
+    if (hmap_get(h, key[i]) != ((i % 3) ? key[i] : NULL)) {
+      if (!quiet) printf("ERR: %s map failed with one hash for all.\n", name);
+      result = false;
+      break;
+    }
+  }
+  if (_hash_ctr != 300 + 100 + 300) {
+    if (!quiet) printf("ERR: %s map did not hash once per call.\n", name);
+    result = false;
+  }
+  hmap_free(h);
+  return result;
+}
+
+static bool _test_get_batch(bool quiet, hmap_engine engine, const char *name)
+{
+  bool result = true;
+  hmap_opts opts = { .engine = engine };
+  hmap *h = hmap_create_opts(NULL, &opts);
+  char key[3000][12];
+  char *keys[3000];
+  void *out[3000];
+
+  /* Even keys are put, odd ones are misses; 3000 is not a whole number
+     of batch windows. */
+  for (int i = 0; i < 3000; i++) {
+    snprintf(key[i], 12, "batch%d", i);
+    keys[i] = key[i];
+    if (i % 2 == 0) hmap_put(h, key[i], key[i]);
+  }
+  hmap_get_batch(h, keys, 3000, out);
+  for (int i = 0; i < 3000; i++) {
+    if (out[i] != ((i % 2 == 0) ? key[i] : NULL)) {
+      if (!quiet) printf("ERR: %s batch get wrong at %s.\n", name, key[i]);
+      result = false;
+      break;
+    }
+  }
+  hmap_free(h);
+  return result;
+}
+
+/* A word count: 20000 words, 500 distinct, each key hashed once. */
+static bool _test_slot(bool quiet, hmap_engine engine, const char *name)
+{
+  bool result = true;
+  hmap_opts opts = { .engine = engine };
+  hmap *h = hmap_create_opts(NULL, &opts);
+  static char word[500][12];
+  int made = 0;
+  bool created;
+  void **slot;
+
+  for (int i = 0; i < 500; i++) snprintf(word[i], 12, "word%d", i);
+  for (int i = 0; i < 20000; i++) {
+    slot = hmap_slot(h, word[(i * 7) % 500], &created);
+    if (created) made++;
+    *slot = (void*)((uintptr_t)*slot + 1);
+  }
+  if (made != 500 || hmap_count(h) != 500) {
+    if (!quiet) printf("ERR: %s slot created %d entries, count %u.\n",
+                       name, made, hmap_count(h));
+    result = false;
+  }
+  for (int i = 0; i < 500; i++) {
+    void *n = hmap_get(h, word[i]);
+    if ((uintptr_t)n != 40) {
+      if (!quiet) printf("ERR: %s slot miscounted %s.\n", name, word[i]);
+      result = false;
+      break;
+    }
+  }
+  /* slot must give the entry put replaced, the one get sees. */
+  hmap_put(h, "dup", "old");
+  hmap_put(h, "dup", "new");
+  slot = hmap_slot_n(h, "dup", 3, &created);
+  if (created || *slot != hmap_get(h, "dup")) {
+    if (!quiet) printf("ERR: %s slot found a stale entry.\n", name);
+    result = false;
+  }
+  hmap_free(h);
+  return result;
+}
+
+#define FROZEN_PATH "t-hash-map.frozen"
+
+static bool _test_freeze(bool quiet, hmap_engine engine, const char *name)
+{
+  bool result = true;
+  hmap_opts opts = { .engine = engine };
+  hmap *h = hmap_create_opts(NULL, &opts);
+  hmap *f;
+  static char key[5000][12];
+  char *keys[5000];
+  void *out[5000];
+  const char k[] = { 'a', '\0', 'b' };
+  char *v;
+
+  for (int i = 0; i < 5000; i++) {
+    snprintf(key[i], 12, "frz%d", i);
+    keys[i] = key[i];
+    if (i % 2 == 0) hmap_put(h, key[i], key[i]);
+  }
+  hmap_put(h, "dup", "old");
+  hmap_put(h, "dup", "new");
+  hmap_put_n(h, k, 3, "bytes");
+  hmap_put(h, "", "empty");
+  hmap_put(h, "null", NULL);
+  if (!hmap_freeze(h, FROZEN_PATH)) {
+    if (!quiet) printf("ERR: %s map failed to freeze.\n", name);
+    hmap_free(h);
+    return false;
+  }
+  hmap_free(h);
+
+  f = hmap_open_mmap(FROZEN_PATH);
+  if (!f) {
+    if (!quiet) printf("ERR: %s frozen map failed to open.\n", name);
+    remove(FROZEN_PATH);
+    return false;
+  }
+  hmap_get_batch(f, keys, 5000, out);
+  for (int i = 0; i < 5000; i++) {
+    v = out[i];
+    if ((i % 2 == 0) ? (!v || strcmp(v, key[i])) : v != NULL) {
+      if (!quiet) printf("ERR: %s frozen map wrong at %s.\n", name, key[i]);
+      result = false;
+      break;
+    }
+  }
+  hmap_put(f, "frz1", "ignored");
+  hmap_remove(f, "frz0");
+  if (hmap_slot(f, "frz2", NULL) != NULL) {
+    if (!quiet) printf("ERR: %s frozen map handed out a slot.\n", name);
+    result = false;
+  }
+  v = hmap_get(f, "dup");
+  if (!v || strcmp(v, "new") || hmap_get(f, "frz1") || !hmap_get(f, "frz0") ||
+      !hmap_get_n(f, k, 3) || strcmp(hmap_get_n(f, k, 3), "bytes") ||
+      !hmap_get(f, "") || strcmp(hmap_get(f, ""), "empty") ||
+      hmap_get(f, "null") || hmap_count(f) != 2504) {
+    if (!quiet) printf("ERR: %s frozen map lost an odd entry.\n", name);
+    result = false;
+  }
+  hmap_free(f);
+  remove(FROZEN_PATH);
+  return result;
+}
+
+static bool _test_freeze_refused(bool quiet)
+{
+  bool result = true;
+  hmap_opts opts = { .hash = &_worst_hash };
+  hmap *h = hmap_create_opts(NULL, &opts);
+  FILE *junk;
+
+  if (hmap_freeze(h, FROZEN_PATH)) {
+    if (!quiet) printf("ERR: Hash Map froze with an unnamed hash.\n");
+    result = false;
+  }
+  hmap_free(h);
+  junk = fopen(FROZEN_PATH, "wb");
+  fputs("not a frozen hash map, not by a long way", junk);
+  fclose(junk);
+  if (hmap_open_mmap(FROZEN_PATH) || hmap_open_mmap("no/such/file")) {
+    if (!quiet) printf("ERR: Hash Map opened a file that isn't a map.\n");
+    result = false;
+  }
+  remove(FROZEN_PATH);
+  return result;
+}
+
+/* Items that are not strings, written at the size item_len gives; one
+   too big for the file refuses the whole freeze. */
+static bool _test_freeze_with(bool quiet)
+{
+  bool result = true;
+  hmap *h = hmap_create(NULL);
+  hmap *f;
+  static char key[1000][12];
+  static pair val[1000];
+  const pair *v;
+  FILE *left = NULL;
+
+  for (int i = 0; i < 1000; i++) {
+    snprintf(key[i], 12, "pkey%d", i);
+    val[i].lo = (uint32_t)i << 16;
+    val[i].hi = 0;
+    hmap_put(h, key[i], &val[i]);
+  }
+  if (!hmap_freeze_with(h, FROZEN_PATH, _pair_len) ||
+      !(f = hmap_open_mmap(FROZEN_PATH))) {
+    if (!quiet) printf("ERR: Hash Map failed to freeze binary items.\n");
+    hmap_free(h);
+    remove(FROZEN_PATH);
+    return false;
+  }
+  for (int i = 0; i < 1000; i++) {
+    v = hmap_get(f, key[i]);
+    if (!v || memcmp(v, &val[i], sizeof(pair)) != 0) {
+      if (!quiet) printf("ERR: Hash Map froze %s short.\n", key[i]);
+      result = false;
+      break;
+    }
+  }
+  hmap_free(f);
+  remove(FROZEN_PATH);
+  if (hmap_freeze_with(h, FROZEN_PATH, _huge_len) ||
+      (left = fopen(FROZEN_PATH, "rb"))) {
+    if (!quiet) printf("ERR: Hash Map froze an item too big to hold.\n");
+    if (left) fclose(left);
+    remove(FROZEN_PATH);
+    result = false;
+  }
+  hmap_free(h);
+  return result;
+}
+
+/* Every entry once; compact in insertion order, holes skipped. */
+static bool _test_iter(bool quiet, hmap_engine engine, const char *name)
+{
+  bool result = true;
+  hmap_opts opts = { .engine = engine };
+  hmap *h = hmap_create_opts(NULL, &opts);
+  static char key[3000][12];
+  static bool seen[3000];
+  hmap_iter it;
+  const void *k;
+  void *item;
+  size_t len;
+  uint32_t n = 0, dups = 0;
+  int last = -1, i;
+
+  /* 1100 keys leave a chained map part way through its resize. */
+  hmap_put(h, "dup", "old");
+  for (i = 0; i < 1100; i++) {
+    snprintf(key[i], 12, "ikey%d", i);
+    hmap_put(h, key[i], key[i]);
+  }
+  hmap_put(h, "dup", "new");
+  for (i = 0; i < 1100; i += 3) hmap_remove(h, key[i]);
+  memset(seen, 0, sizeof(seen));
+
+  hmap_iter_init(h, &it);
+  while (hmap_iter_next(&it, &k, &len, &item)) {
+    n++;
+    if (len == 3 && memcmp(k, "dup", 3) == 0) {
+      dups++;
+      if (strcmp(item, "new") != 0) {
+        if (!quiet) printf("ERR: %s iteration saw a stale entry.\n", name);
+        result = false;
+      }
+      continue;
+    }
+    i = atoi((const char*)k + 4);
+    if (item != k || i % 3 == 0 || seen[i]) {
+      if (!quiet) printf("ERR: %s iteration gave a bad entry %s.\n", name,
+                         (const char*)k);
+      result = false;
+      break;
+    }
+    seen[i] = true;
+    if (engine == HMAP_COMPACT && i < last) {
+      if (!quiet) printf("ERR: %s iteration out of insertion order.\n", name);
+      result = false;
+      break;
+    }
+    last = i;
+  }
+  if (n != hmap_count(h) || dups != 1) {
+    if (!quiet) printf("ERR: %s iteration saw %u of %u entries.\n", name, n,
+                       hmap_count(h));
+    result = false;
+  }
+  /* NULL outputs are allowed; an empty map ends at once. */
+  hmap_free(h);
+  h = hmap_create_opts(NULL, &opts);
+  hmap_put(h, "one", NULL);
+  hmap_iter_init(h, &it);
+  if (!hmap_iter_next(&it, NULL, NULL, NULL) ||
+      hmap_iter_next(&it, NULL, NULL, NULL)) {
+    if (!quiet) printf("ERR: %s iteration of one entry failed.\n", name);
+    result = false;
+  }
+  hmap_remove(h, "one");
+  hmap_iter_init(h, &it);
+  if (hmap_iter_next(&it, NULL, NULL, NULL)) {
+    if (!quiet) printf("ERR: %s iteration of an empty map failed.\n", name);
+    result = false;
+  }
+  hmap_free(h);
+  return result;
+}
+
+/* i's key: i % 38 'k's, then i; 1 to 40 bytes. */
+static void _inline_key(char *buf, int i)
+{
+  memset(buf, 'k', (size_t)(i % 38));
+  snprintf(buf + i % 38, 12, "%d", i);
+}
+
+/* Keys written into one reused buffer: the map must hold copies. Every
+   engine takes the option, by making the map chained. */
+static bool _test_inline_keys(bool quiet, hmap_engine engine,
+                              const char *name)
+{
+  bool result = true;
+  hmap_opts opts = { .engine = engine, .inline_keys = true };
+  hmap *h = hmap_create_opts(&_fake_free, &opts);
+  char buf[48], seek[48];
+  hmap_iter it;
+  const void *k;
+  size_t len;
+  void *item;
+  uint32_t n = 0;
+
+  if (!h) {
+    if (!quiet) printf("ERR: %s refused inline keys.\n", name);
+    return false;
+  }
+  /* Lengths from 1 to 40 bytes, across every fixed-width compare. */
+  for (int i = 0; i < 3000; i++) {
+    _inline_key(buf, i);
+    hmap_put(h, buf, (void*)(uintptr_t)(i + 1));
+  }
+  memset(buf, 'x', sizeof(buf));
+  for (int i = 0; i < 3000; i++) {
+    _inline_key(seek, i);
+    if (hmap_get(h, seek) != (void*)(uintptr_t)(i + 1)) {
+      if (!quiet) printf("ERR: %s inline keys lost %s.\n", name, seek);
+      result = false;
+      break;
+    }
+  }
+  hmap_iter_init(h, &it);
+  while (hmap_iter_next(&it, &k, &len, &item)) {
+    if (len != strlen(k)) result = false;
+    n++;
+  }
+  if (n != 3000) result = false;
+  for (int i = 0; i < 3000; i += 2) {
+    _inline_key(seek, i);
+    hmap_remove(h, seek);
+  }
+  if (hmap_count(h) != 1500 || hmap_get(h, "k1") != (void*)2) result = false;
+  if (!result && !quiet) printf("ERR: %s inline keys failed.\n", name);
+  _free_ctr = 0;
+  hmap_free(h);
+  if (_free_ctr != 1500) {
+    if (!quiet) printf("ERR: %s inline keys released %d.\n", name, _free_ctr);
+    result = false;
+  }
+  return result;
+}
+
+/* Newest duplicate wins, in the bulk load and across it. More keys than
+   one chunk of a bulk put. */
+static bool _test_bulk(bool quiet, hmap_engine engine, const char *name)
+{
+  bool result = true;
+  hmap_opts opts = { .engine = engine, .capacity = 5000 };
+  hmap *h = hmap_create_opts(&_fake_free, &opts);
+  static char key[70000][12];
+  static char *keys[70000];
+  static void *vals[70000];
+  static char pre[4000][12];
+  char buf[100][48], *bkeys[100];
+  uint32_t size = _hmap_size(h);
+
+  for (int i = 0; i < 4000; i++) {
+    snprintf(pre[i], 12, "pkey%d", i);
+    hmap_put(h, pre[i], pre[i]);
+  }
+  if (_hmap_size(h) != size) {
+    if (!quiet) printf("ERR: %s grew under its capacity.\n", name);
+    result = false;
+  }
+  hmap_put(h, "dup", "old");
+  for (int i = 0; i < 70000; i++) {
+    snprintf(key[i], 12, "bkey%d", i);
+    keys[i] = key[i];
+    vals[i] = key[i];
+  }
+  keys[7]    = "dup";
+  vals[7]    = "first";
+  keys[9000] = "dup";
+  vals[9000] = "second";
+  hmap_put_bulk(h, keys, vals, 70000);
+  for (int i = 0; i < 70000; i++) {
+    if (i != 7 && i != 9000 && hmap_get(h, key[i]) != key[i]) {
+      if (!quiet) printf("ERR: %s bulk put lost %s.\n", name, key[i]);
+      result = false;
+      break;
+    }
+  }
+  if (hmap_get(h, "dup") != vals[9000] ||
+      hmap_count(h) != 4000 + 1 + 69998) {
+    if (!quiet) printf("ERR: %s bulk put mishandled duplicates.\n", name);
+    result = false;
+  }
+  hmap_remove(h, "dup");
+  if (hmap_get(h, "dup")) result = false;
+  for (int i = 0; i < 70000; i += 2) hmap_remove(h, key[i]);
+  if (hmap_get(h, key[1]) != key[1] || hmap_get(h, key[2])) result = false;
+  if (!result && !quiet) printf("ERR: %s bulk put failed.\n", name);
+  _free_ctr = 0;
+  hmap_free(h);
+  if (_free_ctr != 4000 + 34999) {
+    if (!quiet) printf("ERR: %s bulk put released %d.\n", name, _free_ctr);
+    result = false;
+  }
+
+  /* The map's own keys: the caller's buffers may change after the put. */
+  opts.inline_keys = true;
+  h = hmap_create_opts(NULL, &opts);
+  for (int i = 0; i < 100; i++) {
+    _inline_key(buf[i], i);
+    bkeys[i] = buf[i];
+  }
+  hmap_put_bulk(h, bkeys, vals, 100);
+  memset(buf, 'x', sizeof(buf));
+  for (int i = 0; i < 100; i++) {
+    _inline_key(buf[0], i);
+    if (hmap_get(h, buf[0]) != vals[i]) {
+      if (!quiet) printf("ERR: %s bulk put kept %s by pointer.\n", name,
+                         buf[0]);
+      result = false;
+      break;
+    }
+  }
+  hmap_free(h);
+  return result;
+}
+
+static bool _test_reserve(bool quiet, hmap_engine engine, const char *name)
+{
+  bool result = true;
+  hmap_opts opts = { .engine = engine };
+  hmap *h = hmap_create_opts(NULL, &opts);
+  static char key[50000][12];
+  uint32_t size;
+
+  for (int i = 0; i < 100; i++) {
+    snprintf(key[i], 12, "rkey%d", i);
+    hmap_put(h, key[i], key[i]);
+  }
+  hmap_reserve(h, 50000);
+  size = _hmap_size(h);
+  for (int i = 100; i < 50000; i++) {
+    snprintf(key[i], 12, "rkey%d", i);
+    hmap_put(h, key[i], key[i]);
+  }
+  if (_hmap_size(h) != size) {
+    if (!quiet) printf("ERR: %s grew after a reserve.\n", name);
+    result = false;
+  }
+  for (int i = 0; i < 50000; i++) {
+    if (hmap_get(h, key[i]) != key[i]) {
+      if (!quiet) printf("ERR: %s reserve lost %s.\n", name, key[i]);
+      result = false;
+      break;
+    }
+  }
+  hmap_reserve(h, 10);
+  if (_hmap_size(h) != size) result = false;
+  hmap_free(h);
+  return result;
+}
+
+/* One hash per key, used in three maps seeded alike: one of the engine
+   under test, and two others. */
+static bool _test_hashed(bool quiet, hmap_engine engine, const char *name)
+{
+  bool result = true;
+  hmap_opts opts = { .engine = engine, .seed = 42 };
+  hmap *h[3];
+  static char key[2000][12];
+  uint64_t hash;
+  const char bytes[5] = { 'a', 0, 'b', 0, 'c' };
+
+  h[0] = hmap_create_opts(NULL, &opts);
+  opts.engine = engine == HMAP_CHAINED ? HMAP_SWISS : HMAP_CHAINED;
+  h[1] = hmap_create_opts(NULL, &opts);
+  opts.engine = engine == HMAP_COMPACT ? HMAP_ROBIN_HOOD : HMAP_COMPACT;
+  h[2] = hmap_create_opts(NULL, &opts);
+  for (int i = 0; i < 2000; i++) {
+    snprintf(key[i], 12, "hkey%d", i);
+    hash = hmap_hash(h[0], key[i]);
+    if (hash != hmap_hash_n(h[2], key[i], strlen(key[i]))) result = false;
+    for (int m = 0; m < 3; m++) hmap_put_hashed(h[m], hash, key[i], key[i]);
+  }
+  for (int i = 0; i < 2000; i++) {
+    hash = hmap_hash(h[1], key[i]);
+    for (int m = 0; m < 3; m++) {
+      if (hmap_get_hashed(h[m], hash, key[i]) != key[i] ||
+          hmap_get(h[m], key[i]) != key[i]) {
+        if (!quiet) printf("ERR: %s hashed get lost %s.\n", name, key[i]);
+        result = false;
+      }
+    }
+    if (i % 2) {
+      for (int m = 0; m < 3; m++) hmap_remove_hashed(h[m], hash, key[i]);
+    }
+  }
+  for (int m = 0; m < 3; m++) {
+    if (hmap_count(h[m]) != 1000 || hmap_get(h[m], key[1])) result = false;
+  }
+  hash = hmap_hash_n(h[0], bytes, sizeof(bytes));
+  hmap_put_hashed_n(h[0], hash, bytes, sizeof(bytes), key[0]);
+  if (hmap_get_n(h[0], bytes, sizeof(bytes)) != key[0] ||
+      hmap_get_hashed_n(h[0], hash, bytes, 1)) {
+    result = false;
+  }
+  hmap_remove_hashed_n(h[0], hash, bytes, sizeof(bytes));
+  if (hmap_get_hashed_n(h[0], hash, bytes, sizeof(bytes))) result = false;
+#if SIZE_MAX > UINT32_MAX
+  /* A length that 32 bits would cut down to the key's own is refused. */
+  hmap_put_hashed_n(h[0], hash, bytes, sizeof(bytes), key[0]);
+  {
+    size_t huge = (size_t)HMAP_MAX_KEY_LEN + 1 + sizeof(bytes);
+    bool created = true;
+    hmap_put_hashed_n(h[0], hash, bytes, huge, key[1]);
+    hmap_remove_hashed_n(h[0], hash, bytes, huge);
+    if (hmap_get_hashed_n(h[0], hash, bytes, huge) ||
+        hmap_slot_hashed_n(h[0], hash, bytes, huge, &created) || created ||
+        hmap_get_n(h[0], bytes, sizeof(bytes)) != key[0]) {
+      if (!quiet) printf("ERR: %s took a key over 4 GiB.\n", name);
+      result = false;
+    }
+  }
+#endif
+  if (!result && !quiet) printf("ERR: %s hashed API failed.\n", name);
+  for (int m = 0; m < 3; m++) hmap_free(h[m]);
+  return result;
+}
+
+/* The cheap fields without a walk, every entry's probe with one, and
+   collisions that go down with removes; a good hash spreads keys as
+   chance would, the worst one piles them on one home. */
+static bool _test_stats(bool quiet, hmap_engine engine, const char *name)
+{
+  bool result = true;
+  hmap_opts opts = { .engine = engine, .seed = 7 };
+  hmap *h = hmap_create_opts(NULL, &opts), *f;
+  hmap_stats s, w;
+  static char key[20000][12];
+  uint32_t before;
+
+  for (int i = 0; i < 20000; i++) {
+    snprintf(key[i], 12, "skey%d", i);
+    hmap_put(h, key[i], key[i]);
+  }
+  for (int i = 0; i < 100; i++) hmap_get(h, i % 2 ? key[i] : "absent");
+  hmap_get_stats(h, &s, false);
+  if (s.count != 20000 || s.slots != _hmap_size(h) || !s.resizes ||
+      s.load != 20000.0 / s.slots || s.bytes < s.slots || s.max_probe ||
+      _walked(&s)) {
+    if (!quiet) printf("ERR: %s stats wrong without a walk.\n", name);
+    result = false;
+  }
+#ifdef HMAP_COUNTERS
+  if (s.gets != 100 || s.misses != 50 || s.puts != 20000) result = false;
+#else
+  if (s.gets || s.misses || s.puts) result = false;
+#endif
+  hmap_get_stats(h, &w, true);
+  if (_walked(&w) != 20000 || w.collisions != 20000 - w.probe_hist[0] ||
+      !w.max_probe || w.mean_probe <= 0.0 || w.bytes < s.bytes ||
+      w.dispersion < 0.7 || w.dispersion > 1.3) {
+    if (!quiet) printf("ERR: %s stats walk wrong, dispersion %.2f.\n", name,
+                       w.dispersion);
+    result = false;
+  }
+  before = w.collisions;
+  for (int i = 0; i < 20000; i += 2) hmap_remove(h, key[i]);
+  hmap_get_stats(h, &w, true);
+  if (_walked(&w) != 10000 || w.collisions >= before ||
+      _hmap_collisions(h) != w.collisions ||
+      (engine == HMAP_COMPACT && !w.tombstones)) {
+    if (!quiet) printf("ERR: %s stats wrong after removes.\n", name);
+    result = false;
+  }
+  if (hmap_freeze(h, FROZEN_PATH) && (f = hmap_open_mmap(FROZEN_PATH))) {
+    hmap_get_stats(f, &s, true);
+    if (_walked(&s) != 10000 || s.count != 10000) result = false;
+    hmap_free(f);
+  } else {
+    result = false;
+  }
+  remove(FROZEN_PATH);
+  hmap_free(h);
+
+  opts.hash = _worst_hash;
+  h = hmap_create_opts(NULL, &opts);
+  for (int i = 0; i < 200; i++) hmap_put(h, key[i], key[i]);
+  hmap_get_stats(h, &w, true);
+  if (w.dispersion < 10.0 || w.max_probe < 10) {
+    if (!quiet) printf("ERR: %s stats missed a bad hash.\n", name);
+    result = false;
+  }
+  /* A slot that finds its key is a get; one that makes it, a put. */
+  for (int i = 0; i < 10; i++) hmap_slot(h, key[i], NULL);
+  hmap_slot(h, key[200], NULL);
+  hmap_get_stats(h, &w, false);
+#ifdef HMAP_COUNTERS
+  if (w.gets != 10 || w.misses || w.puts != 201) {
+#else
+  if (w.gets || w.puts) {
+#endif
+    if (!quiet) printf("ERR: %s slot counted wrong.\n", name);
+    result = false;
+  }
+  hmap_free(h);
+  return result;
+}
+
+/* Putting the same pointers again must release neither, or the map
+   would hold freed memory; a new key or item releases the old alone. */
+static bool _test_replace(bool quiet, hmap_engine engine, const char *name)
+{
+  bool result = true;
+  hmap_opts opts = { .engine = engine };
+  hmap *h = hmap_create_opts(&_free_both, &opts);
+  char *k = _dup("rkey"), *k2 = _dup("rkey");
+  char *v = _dup("v"), *v2 = _dup("v2");
+
+  _freed_keys = _freed_items = 0;
+  hmap_put(h, k, v);
+  hmap_put(h, k, v);
+  if (_freed_keys || _freed_items || hmap_get(h, "rkey") != v) {
+    result = false;
+  }
+  hmap_put(h, k, v2);
+  if (_freed_keys || _freed_items != 1 || hmap_get(h, "rkey") != v2) {
+    result = false;
+  }
+  hmap_put(h, k2, v2);
+  if (_freed_keys != 1 || _freed_items != 1 || hmap_count(h) != 1 ||
+      hmap_get(h, "rkey") != v2) {
+    result = false;
+  }
+  if (!result && !quiet) printf("ERR: %s replace released too much.\n", name);
+  hmap_free(h);
+  if (_freed_keys != 2 || _freed_items != 2) {
+    if (!quiet) printf("ERR: %s replace freed %d keys, %d items.\n", name,
+                       _freed_keys, _freed_items);
+    result = false;
+  }
+  return result;
+}
+
+/* A map one key short of growing: putting its keys again replaces them,
+   and must not grow it; the next new key does. */
+static bool _test_overwrite(bool quiet, hmap_engine engine,
+                            const char *name)
+{
+  bool result = true;
+  hmap_opts opts = { .engine = engine };
+  hmap *h = hmap_create_opts(NULL, &opts);
+  static char key[10000][12];
+  uint32_t size = _hmap_size(h);
+  int brink = 0;
+
+  for (int i = 0; i < 10000 && !brink; i++) {
+    snprintf(key[i], 12, "okey%d", i);
+    hmap_put(h, key[i], key[i]);
+    if (_hmap_size(h) != size) brink = i;
+  }
+  hmap_free(h);
+  h = hmap_create_opts(NULL, &opts);
+  for (int i = 0; i < brink; i++) hmap_put(h, key[i], key[i]);
+  for (int i = 0; i < brink; i++) hmap_put(h, key[i], key[brink - 1 - i]);
+  if (!brink || _hmap_size(h) != size || hmap_count(h) != (uint32_t)brink) {
+    if (!quiet) printf("ERR: %s overwrite grew the table.\n", name);
+    result = false;
+  }
+  hmap_put(h, key[brink], key[brink]);
+  if (_hmap_size(h) == size || hmap_get(h, key[0]) != key[brink - 1]) {
+    if (!quiet) printf("ERR: %s did not grow past the brink.\n", name);
+    result = false;
+  }
+  hmap_free(h);
+  return result;
+}
+
 int test_hash_map(bool quiet)
 {
   uint32_t errs = 0;
@@ -286,6 +1235,68 @@ int test_hash_map(bool quiet)
   if (_test_put_get(quiet) != true) errs++;
   if (_test_collisions(quiet) != true) errs++;
   if (_test_remove(quiet) != true) errs++;
+  if (_test_engine(quiet, HMAP_CHAINED, "Chained") != true) errs++;
+  if (_test_engine(quiet, HMAP_ROBIN_HOOD, "Robin Hood") != true) errs++;
+  if (_test_engine(quiet, HMAP_SWISS, "Swiss") != true) errs++;
+  if (_test_engine(quiet, HMAP_COMPACT, "Compact") != true) errs++;
+  if (_test_churn(quiet, HMAP_ROBIN_HOOD, "Robin Hood") != true) errs++;
+  if (_test_churn(quiet, HMAP_SWISS, "Swiss") != true) errs++;
+  if (_test_churn(quiet, HMAP_COMPACT, "Compact") != true) errs++;
+  if (_test_byte_keys(quiet, HMAP_CHAINED, "Chained") != true) errs++;
+  if (_test_byte_keys(quiet, HMAP_ROBIN_HOOD, "Robin Hood") != true) errs++;
+  if (_test_byte_keys(quiet, HMAP_SWISS, "Swiss") != true) errs++;
+  if (_test_byte_keys(quiet, HMAP_COMPACT, "Compact") != true) errs++;
+  if (_test_hash_hook(quiet, HMAP_CHAINED, "Chained") != true) errs++;
+  if (_test_hash_hook(quiet, HMAP_ROBIN_HOOD, "Robin Hood") != true) errs++;
+  if (_test_hash_hook(quiet, HMAP_SWISS, "Swiss") != true) errs++;
+  if (_test_hash_hook(quiet, HMAP_COMPACT, "Compact") != true) errs++;
+  if (_test_get_batch(quiet, HMAP_CHAINED, "Chained") != true) errs++;
+  if (_test_get_batch(quiet, HMAP_ROBIN_HOOD, "Robin Hood") != true) errs++;
+  if (_test_get_batch(quiet, HMAP_SWISS, "Swiss") != true) errs++;
+  if (_test_get_batch(quiet, HMAP_COMPACT, "Compact") != true) errs++;
+  if (_test_slot(quiet, HMAP_CHAINED, "Chained") != true) errs++;
+  if (_test_slot(quiet, HMAP_ROBIN_HOOD, "Robin Hood") != true) errs++;
+  if (_test_slot(quiet, HMAP_SWISS, "Swiss") != true) errs++;
+  if (_test_slot(quiet, HMAP_COMPACT, "Compact") != true) errs++;
+  if (_test_freeze(quiet, HMAP_CHAINED, "Chained") != true) errs++;
+  if (_test_freeze(quiet, HMAP_ROBIN_HOOD, "Robin Hood") != true) errs++;
+  if (_test_freeze(quiet, HMAP_SWISS, "Swiss") != true) errs++;
+  if (_test_freeze(quiet, HMAP_COMPACT, "Compact") != true) errs++;
+  if (_test_freeze_refused(quiet) != true) errs++;
+  if (_test_freeze_with(quiet) != true) errs++;
+  if (_test_inline_keys(quiet, HMAP_CHAINED, "Chained") != true) errs++;
+  if (_test_inline_keys(quiet, HMAP_ROBIN_HOOD, "Robin Hood") != true) errs++;
+  if (_test_inline_keys(quiet, HMAP_SWISS, "Swiss") != true) errs++;
+  if (_test_inline_keys(quiet, HMAP_COMPACT, "Compact") != true) errs++;
+  if (_test_iter(quiet, HMAP_CHAINED, "Chained") != true) errs++;
+  if (_test_iter(quiet, HMAP_ROBIN_HOOD, "Robin Hood") != true) errs++;
+  if (_test_iter(quiet, HMAP_SWISS, "Swiss") != true) errs++;
+  if (_test_iter(quiet, HMAP_COMPACT, "Compact") != true) errs++;
+  if (_test_resize(quiet) != true) errs++;
+  if (_test_bulk(quiet, HMAP_CHAINED, "Chained") != true) errs++;
+  if (_test_bulk(quiet, HMAP_ROBIN_HOOD, "Robin Hood") != true) errs++;
+  if (_test_bulk(quiet, HMAP_SWISS, "Swiss") != true) errs++;
+  if (_test_bulk(quiet, HMAP_COMPACT, "Compact") != true) errs++;
+  if (_test_reserve(quiet, HMAP_CHAINED, "Chained") != true) errs++;
+  if (_test_reserve(quiet, HMAP_ROBIN_HOOD, "Robin Hood") != true) errs++;
+  if (_test_reserve(quiet, HMAP_SWISS, "Swiss") != true) errs++;
+  if (_test_reserve(quiet, HMAP_COMPACT, "Compact") != true) errs++;
+  if (_test_hashed(quiet, HMAP_CHAINED, "Chained") != true) errs++;
+  if (_test_hashed(quiet, HMAP_ROBIN_HOOD, "Robin Hood") != true) errs++;
+  if (_test_hashed(quiet, HMAP_SWISS, "Swiss") != true) errs++;
+  if (_test_hashed(quiet, HMAP_COMPACT, "Compact") != true) errs++;
+  if (_test_stats(quiet, HMAP_CHAINED, "Chained") != true) errs++;
+  if (_test_stats(quiet, HMAP_ROBIN_HOOD, "Robin Hood") != true) errs++;
+  if (_test_stats(quiet, HMAP_SWISS, "Swiss") != true) errs++;
+  if (_test_stats(quiet, HMAP_COMPACT, "Compact") != true) errs++;
+  if (_test_replace(quiet, HMAP_CHAINED, "Chained") != true) errs++;
+  if (_test_replace(quiet, HMAP_ROBIN_HOOD, "Robin Hood") != true) errs++;
+  if (_test_replace(quiet, HMAP_SWISS, "Swiss") != true) errs++;
+  if (_test_replace(quiet, HMAP_COMPACT, "Compact") != true) errs++;
+  if (_test_overwrite(quiet, HMAP_CHAINED, "Chained") != true) errs++;
+  if (_test_overwrite(quiet, HMAP_ROBIN_HOOD, "Robin Hood") != true) errs++;
+  if (_test_overwrite(quiet, HMAP_SWISS, "Swiss") != true) errs++;
+  if (_test_overwrite(quiet, HMAP_COMPACT, "Compact") != true) errs++;
 
   if (!quiet) {
     if (errs)
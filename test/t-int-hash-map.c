@@ -0,0 +1,176 @@
+/* ------------------------------------------------------------------------- *\
+   unit tests for integer hash map
+   -------------------------------------------------------------------------
+   LICENSE: This program is free software. You can modify it and/or re-
+   distribute it under the terms of the Apache 2.0 License. You should have
+   received a copy of the Apache 2.0 License along with this program. If
+   not, please see: http://www.apache.org/licenses/LICENSE-2.0.txt
+
+   DISCLAIMER: This program is distributed in the hope that it will be
+   useful, but without any warrantee; without even the implied warantee
+   of fitness for any particular purpose. See the License for more details.
+\* ------------------------------------------------------------------------- */
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "int-hash-map.h"
+
+/* public entry point */
+int test_int_hash_map(bool);
+
+/* helper declarations */
+static void _count_free(void*, void*);
+
+/* test declarations */
+static bool _test_put_get(bool);
+static bool _test_zero_key(bool);
+static bool _test_destructor(bool);
+static bool _test_against_reference(bool);
+
+/* helper functions */
+static int _free_ctr = 0;
+static uint64_t _free_key = 0;
+static void _count_free(void* key, void* obj)
+{
+  (void)obj;
+  _free_key = *(uint64_t*)key;
+  _free_ctr++;
+}
+
+/* test implementations */
+static bool _test_put_get(bool quiet)
+{
+  bool result = true;
+  hmap64 *h = hmap64_create(NULL);
+
+  /* Sequential and strided IDs, well past a few doublings. */
+  for (uint64_t i = 1; i <= 100000; i++) {
+    hmap64_put(h, i, (void*)(uintptr_t)i);
+    hmap64_put(h, i << 32, (void*)(uintptr_t)(i + 1));
+  }
+  if (hmap64_count(h) != 200000) {
+    if (!quiet) printf("ERR: Int Hash Map count %u.\n", hmap64_count(h));
+    result = false;
+  }
+  for (uint64_t i = 1; i <= 100000; i++) {
+    if (hmap64_get(h, i) != (void*)(uintptr_t)i ||
+        hmap64_get(h, i << 32) != (void*)(uintptr_t)(i + 1)) {
+      if (!quiet) printf("ERR: Int Hash Map lost key %llu.\n",
+                         (unsigned long long)i);
+      result = false;
+      break;
+    }
+  }
+  if (hmap64_get(h, 100001) || hmap64_get(h, UINT64_MAX)) {
+    if (!quiet) printf("ERR: Int Hash Map found a missing key.\n");
+    result = false;
+  }
+  hmap64_free(h);
+  return result;
+}
+
+static bool _test_zero_key(bool quiet)
+{
+  bool result = true;
+  hmap64 *h = hmap64_create(NULL);
+  char *v = "zero";
+
+  if (hmap64_get(h, 0)) result = false;
+  hmap64_put(h, 0, v);
+  hmap64_put(h, 1, v);
+  if (hmap64_get(h, 0) != v || hmap64_count(h) != 2) result = false;
+  hmap64_remove(h, 0);
+  if (hmap64_get(h, 0) || hmap64_get(h, 1) != v || hmap64_count(h) != 1) {
+    result = false;
+  }
+  hmap64_remove(h, 0);
+  if (hmap64_count(h) != 1) result = false;
+  if (!result && !quiet) printf("ERR: Int Hash Map mishandled key 0.\n");
+  hmap64_free(h);
+  return result;
+}
+
+static bool _test_destructor(bool quiet)
+{
+  bool result = true;
+  hmap64 *h = hmap64_create(&_count_free);
+
+  for (uint64_t i = 0; i < 1000; i++) hmap64_put(h, i, "v");
+  /* Replacing releases the old pair, with its key. */
+  _free_ctr = 0;
+  hmap64_put(h, 77, "w");
+  if (_free_ctr != 1 || _free_key != 77 || hmap64_count(h) != 1000) {
+    if (!quiet) printf("ERR: Int Hash Map did not release a replaced item.\n");
+    result = false;
+  }
+  /* remove does not release; free releases what is left. */
+  _free_ctr = 0;
+  for (uint64_t i = 0; i < 1000; i += 2) hmap64_remove(h, i);
+  if (_free_ctr != 0) result = false;
+  hmap64_free(h);
+  if (_free_ctr != 500) {
+    if (!quiet) printf("ERR: Int Hash Map released %d of 500.\n", _free_ctr);
+    result = false;
+  }
+  return result;
+}
+
+/* Random puts and removes over a small key range, checked against a plain
+   array: every removal shifts a run, and most runs are long. */
+static bool _test_against_reference(bool quiet)
+{
+  bool result = true;
+  hmap64 *h = hmap64_create(NULL);
+  static void *ref[4096];
+  uint64_t r = 88172645463325252ULL, k;
+  uint32_t live = 0;
+
+  for (int i = 0; i < 400000; i++) {
+    r ^= r << 13; r ^= r >> 7; r ^= r << 17;   /* xorshift */
+    k = r % 4096;
+    if ((r >> 20) % 3) {
+      if (!ref[k]) live++;
+      ref[k] = (void*)(uintptr_t)(i + 1);
+      hmap64_put(h, k * 0x10001, ref[k]);
+    } else {
+      if (ref[k]) live--;
+      ref[k] = NULL;
+      hmap64_remove(h, k * 0x10001);
+    }
+  }
+  for (k = 0; k < 4096; k++) {
+    if (hmap64_get(h, k * 0x10001) != ref[k]) {
+      if (!quiet) printf("ERR: Int Hash Map diverged at key %llu.\n",
+                         (unsigned long long)k);
+      result = false;
+      break;
+    }
+  }
+  if (hmap64_count(h) != live) {
+    if (!quiet) printf("ERR: Int Hash Map count %u, expected %u.\n",
+                       hmap64_count(h), live);
+    result = false;
+  }
+  hmap64_free(h);
+  return result;
+}
+
+int test_int_hash_map(bool quiet)
+{
+  uint32_t errs = 0;
+
+  if (_test_put_get(quiet) != true) errs++;
+  if (_test_zero_key(quiet) != true) errs++;
+  if (_test_destructor(quiet) != true) errs++;
+  if (_test_against_reference(quiet) != true) errs++;
+
+  if (!quiet) {
+    if (errs)
+      printf("[FAIL] : Int Hash Map\n");
+    else
+      printf("[OK]   : Int Hash Map\n");
+  }
+
+  return errs;
+}
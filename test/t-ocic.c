@@ -12,9 +12,17 @@ int main(int c, char ** argv) {
 
   errs += test_cmd_line_yn(quiet);
 	errs += test_hash_map(quiet);
+	errs += test_int_hash_map(quiet);
+	errs += test_concurrent_hash_map(quiet);
+	errs += test_sharded_hash_map(quiet);
+	errs += test_cache(quiet);
+	errs += test_filter(quiet);
+	errs += test_perfect_hash(quiet);
 	errs += test_singly_linked_list(quiet);
 	errs += test_sorted_list(quiet);
 	errs += test_splay_tree(quiet);
+	errs += test_typed_hash_map(quiet);
+	errs += test_typed_splay_tree(quiet);
 
 	if (!quiet) {
 		if (errs)
@@ -14,9 +14,17 @@
 \* ------------------------------------------------------------------------- */
 
 int test_hash_map( bool );
+int test_int_hash_map( bool );
+int test_concurrent_hash_map( bool );
+int test_sharded_hash_map( bool );
+int test_cache( bool );
+int test_filter( bool );
+int test_perfect_hash( bool );
 int test_singly_linked_list( bool );
 int test_sorted_list( bool );
 int test_splay_tree( bool );
+int test_typed_hash_map( bool );
+int test_typed_splay_tree( bool );
 int test_cmd_line_yn( bool );
 
 #endif
@@ -0,0 +1,144 @@
+/* ------------------------------------------------------------------------- *\
+   unit tests for minimal perfect hash
+   -------------------------------------------------------------------------
+   LICENSE: This program is free software. You can modify it and/or re-
+   distribute it under the terms of the Apache 2.0 License. You should have
+   received a copy of the Apache 2.0 License along with this program. If
+   not, please see: http://www.apache.org/licenses/LICENSE-2.0.txt
+
+   DISCLAIMER: This program is distributed in the hope that it will be
+   useful, but without any warrantee; without even the implied warantee
+   of fitness for any particular purpose. See the License for more details.
+\* ------------------------------------------------------------------------- */
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "perfect-hash.h"
+
+/* public entry point */
+int test_perfect_hash(bool);
+
+/* test declarations */
+static bool _test_array(bool, size_t n, int threads);
+static bool _test_duplicate(bool);
+static bool _test_from_hmap(bool);
+
+#define KEY_LEN 16
+
+/* test implementations */
+static bool _test_array(bool quiet, size_t n, int threads)
+{
+  bool result = true;
+  char *buf = malloc(n * KEY_LEN + 1);
+  char **keys = malloc((n + 1) * sizeof(char*));
+  char miss[KEY_LEN];
+  mph *m;
+
+  for (size_t i = 0; i < n; i++) {
+    keys[i] = buf + i * KEY_LEN;
+    snprintf(keys[i], KEY_LEN, "pkey%zu", i);
+  }
+  m = mph_create(keys, (void**)keys, n, threads);
+  if (!m || mph_count(m) != n) {
+    if (!quiet) printf("ERR: Perfect Hash failed to build %zu keys.\n", n);
+    free(buf);
+    free(keys);
+    if (m) mph_free(m);
+    return false;
+  }
+  for (size_t i = 0; i < n; i++) {
+    if (mph_get(m, keys[i]) != keys[i]) {
+      if (!quiet) printf("ERR: Perfect Hash lost %s of %zu.\n", keys[i], n);
+      result = false;
+      break;
+    }
+  }
+  for (size_t i = 0; i < n + 100; i++) {
+    snprintf(miss, KEY_LEN, "miss%zu", i);
+    if (mph_get(m, miss)) {
+      if (!quiet) printf("ERR: Perfect Hash found %s.\n", miss);
+      result = false;
+      break;
+    }
+  }
+  if (n >= 100000 && mph_bits_per_key(m) > 4.0) {
+    if (!quiet) printf("ERR: Perfect Hash takes %.2f bits per key.\n",
+                       mph_bits_per_key(m));
+    result = false;
+  }
+  mph_free(m);
+  free(buf);
+  free(keys);
+  return result;
+}
+
+static bool _test_duplicate(bool quiet)
+{
+  bool result = true;
+  char *keys[] = { "one", "two", "three", "two" };
+
+  if (mph_create(keys, NULL, 4, 1) != NULL) {
+    if (!quiet) printf("ERR: Perfect Hash built with a repeated key.\n");
+    result = false;
+  }
+  return result;
+}
+
+static bool _test_from_hmap(bool quiet)
+{
+  bool result = true;
+  hmap *h = hmap_create(NULL);
+  static char key[3000][12];
+  mph *m;
+
+  for (int i = 0; i < 3000; i++) {
+    snprintf(key[i], 12, "hkey%d", i);
+    hmap_put(h, key[i], key[i]);
+  }
+  /* The chained engine keeps both; only the newest is the map's. */
+  hmap_put(h, "dup", "old");
+  hmap_put(h, "dup", "new");
+  m = mph_create_from_hmap(h, 2);
+  if (!m || mph_count(m) != 3001) {
+    if (!quiet) printf("ERR: Perfect Hash failed to build from an hmap.\n");
+    hmap_free(h);
+    if (m) mph_free(m);
+    return false;
+  }
+  for (int i = 0; i < 3000; i++) {
+    if (mph_get(m, key[i]) != key[i]) {
+      if (!quiet) printf("ERR: Perfect Hash from hmap lost %s.\n", key[i]);
+      result = false;
+      break;
+    }
+  }
+  if (mph_get(m, "dup") != hmap_get(h, "dup")) {
+    if (!quiet) printf("ERR: Perfect Hash took a shadowed duplicate.\n");
+    result = false;
+  }
+  mph_free(m);
+  hmap_free(h);
+  return result;
+}
+
+int test_perfect_hash(bool quiet)
+{
+  uint32_t errs = 0;
+
+  if (_test_array(quiet, 0, 1) != true) errs++;
+  if (_test_array(quiet, 1, 1) != true) errs++;
+  if (_test_array(quiet, 1000, 1) != true) errs++;
+  if (_test_array(quiet, 200000, 4) != true) errs++;
+  if (_test_duplicate(quiet) != true) errs++;
+  if (_test_from_hmap(quiet) != true) errs++;
+
+  if (!quiet) {
+    if (errs)
+      printf("[FAIL] : Perfect Hash\n");
+    else
+      printf("[OK]   : Perfect Hash\n");
+  }
+
+  return errs;
+}
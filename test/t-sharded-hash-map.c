@@ -0,0 +1,169 @@
+/* ------------------------------------------------------------------------- *\
+   unit tests for sharded hash map
+   -------------------------------------------------------------------------
+   LICENSE: This program is free software. You can modify it and/or re-
+   distribute it under the terms of the Apache 2.0 License. You should have
+   received a copy of the Apache 2.0 License along with this program. If
+   not, please see: http://www.apache.org/licenses/LICENSE-2.0.txt
+
+   DISCLAIMER: This program is distributed in the hope that it will be
+   useful, but without any warrantee; without even the implied warantee
+   of fitness for any particular purpose. See the License for more details.
+\* ------------------------------------------------------------------------- */
+#define _POSIX_C_SOURCE 200809L
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "sharded-hash-map.h"
+
+/* public entry point */
+int test_sharded_hash_map(bool);
+
+/* helper declarations */
+static void _count_free(void*, void*);
+static void *_writer(void*);
+
+/* test declarations */
+static bool _test_put_get(bool, hmap_engine, uint32_t shards);
+static bool _test_threads(bool);
+
+/* helper functions */
+static int _free_ctr = 0;
+static void _count_free(void* key, void* obj)
+{
+  (void)key;
+  (void)obj;
+  __atomic_add_fetch(&_free_ctr, 1, __ATOMIC_RELAXED);
+}
+
+#define THREADS  8
+#define KEYS     4096
+#define ROUNDS   10
+
+static shmap *_shared;
+static char   _keys[THREADS][KEYS][16];
+
+/* Each writer owns a key range, and cycles it through put, replace and
+   remove, checking its own keys as it goes, and the count, read while
+   the others write, against the most there can be. */
+static void *
+_writer(void *arg)
+{
+  char (*key)[16] = _keys[(intptr_t)arg];
+  intptr_t bad = 0;
+
+  for (int r = 0; r < ROUNDS; r++) {
+    for (int i = 0; i < KEYS; i++) shmap_put(_shared, key[i], key[i]);
+    for (int i = 0; i < KEYS; i += 2) shmap_put(_shared, key[i], key[i]);
+    for (int i = 0; i < KEYS; i += 3) shmap_remove(_shared, key[i]);
+    if (shmap_count(_shared) > THREADS * KEYS) bad++;
+    for (int i = 0; i < KEYS; i++) {
+      if ((shmap_get(_shared, key[i]) == NULL) != (i % 3 == 0)) bad++;
+    }
+  }
+  return (void*)bad;
+}
+
+/* test implementations */
+static bool _test_put_get(bool quiet, hmap_engine engine, uint32_t shards)
+{
+  bool result = true;
+  hmap_opts opts = { .engine = engine };
+  shmap *s = shmap_create_opts(&_count_free, &opts, shards);
+  static char key[20000][12];
+  const char k[] = { 'a', '\0', 'b' };
+
+  _free_ctr = 0;
+  for (int i = 0; i < 20000; i++) {
+    snprintf(key[i], 12, "skey%d", i);
+    shmap_put(s, key[i], key[i]);
+  }
+  shmap_put_n(s, k, 3, "valc");
+  for (int i = 0; i < 20000; i++) {
+    if (shmap_get(s, key[i]) != key[i]) {
+      if (!quiet) printf("ERR: Sharded Hash Map lost %s.\n", key[i]);
+      result = false;
+      break;
+    }
+  }
+  if (strcmp(shmap_get_n(s, k, 3), "valc") || shmap_get(s, "a") ||
+      shmap_count(s) != 20001) {
+    if (!quiet) printf("ERR: Sharded Hash Map count %u.\n", shmap_count(s));
+    result = false;
+  }
+  for (int i = 0; i < 20000; i += 2) shmap_remove(s, key[i]);
+  shmap_remove_n(s, k, 3);
+  if (shmap_count(s) != 10000 || shmap_get(s, key[0])) {
+    if (!quiet) printf("ERR: Sharded Hash Map remove failed.\n");
+    result = false;
+  }
+  shmap_free(s);
+  if (_free_ctr != 10000) {
+    if (!quiet) printf("ERR: Sharded Hash Map released %d.\n", _free_ctr);
+    result = false;
+  }
+
+  /* Inline keys on any engine: the shards copy the reused buffer. */
+  opts.inline_keys = true;
+  s = shmap_create_opts(NULL, &opts, shards);
+  snprintf(key[0], 12, "inline");
+  shmap_put(s, key[0], key[1]);
+  snprintf(key[0], 12, "reused");
+  if (shmap_get(s, "inline") != key[1] || shmap_get(s, "reused")) {
+    if (!quiet) printf("ERR: Sharded Hash Map inline keys mishandled.\n");
+    result = false;
+  }
+  shmap_free(s);
+  return result;
+}
+
+static bool _test_threads(bool quiet)
+{
+  bool result = true;
+  pthread_t writers[THREADS];
+  hmap_opts opts = { .engine = HMAP_SWISS };
+  void *bad;
+
+  _shared = shmap_create_opts(NULL, &opts, 16);
+  for (int t = 0; t < THREADS; t++) {
+    for (int i = 0; i < KEYS; i++) snprintf(_keys[t][i], 16, "t%dk%d", t, i);
+  }
+  for (intptr_t t = 0; t < THREADS; t++) {
+    pthread_create(&writers[t], NULL, _writer, (void*)t);
+  }
+  for (int t = 0; t < THREADS; t++) {
+    pthread_join(writers[t], &bad);
+    if (bad) result = false;
+  }
+  if (!result && !quiet) printf("ERR: Sharded Hash Map lost a write.\n");
+  if (shmap_count(_shared) != THREADS * (KEYS - (KEYS + 2) / 3)) {
+    if (!quiet) printf("ERR: Sharded Hash Map count %u after threads.\n",
+                       shmap_count(_shared));
+    result = false;
+  }
+  shmap_free(_shared);
+  return result;
+}
+
+int test_sharded_hash_map(bool quiet)
+{
+  uint32_t errs = 0;
+
+  if (_test_put_get(quiet, HMAP_CHAINED, 0) != true) errs++;
+  if (_test_put_get(quiet, HMAP_SWISS, 1) != true) errs++;
+  if (_test_put_get(quiet, HMAP_ROBIN_HOOD, 5) != true) errs++;
+  if (_test_threads(quiet) != true) errs++;
+
+  if (!quiet) {
+    if (errs)
+      printf("[FAIL] : Sharded Hash Map\n");
+    else
+      printf("[OK]   : Sharded Hash Map\n");
+  }
+
+  return errs;
+}
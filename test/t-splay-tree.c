@@ -30,9 +30,24 @@ static bool _test_create(bool);
 static bool _test_free(bool);
 static bool _test_put_get(bool);
 static bool _test_remove(bool);
+static bool _test_rich_use(bool);
+static bool _test_sorted(bool);
+static bool _test_random_ops(bool);
+static bool _test_bounds(bool);
+static bool _test_range(bool);
+static bool _test_cursor(bool);
+static bool _test_order_stats(bool);
+static bool _test_build_sorted(bool);
+static bool _test_merge(bool);
+static bool _test_split_join(bool);
 
 static int  _compare(void*, void*);
+static int  _int_compare(void*, void*);
 static void _fake_free(void*, void*);
+static void _check_order(void*, void*);
+static bool _sum_keys(void*, void*, void*);
+static splay *_evens(int *keys, int n);
+static uint64_t _int_hash(void*);
 /* debugging tool..
 static void _print_tree(void*, void*);
 */
@@ -89,6 +104,48 @@ _compare(void *a, void *b)
   return strcmp((const char*)a,(const char*)b);
 }
 
+static int
+_int_compare(void *a, void *b)
+{
+  int x = *(int*)a, y = *(int*)b;
+  return (x > y) - (x < y);
+}
+
+/* splay_iter visits in key order: each key above the one before. */
+static int  order_last;
+static bool order_ok;
+static void _check_order(void *k, void *v)
+{
+  (void)v;
+  if (*(int*)k <= order_last) order_ok = false;
+  order_last = *(int*)k;
+}
+
+/* Adds up the keys it's passed, and stops once past 1000. */
+static bool _sum_keys(void *ctx, void *k, void *v)
+{
+  (void)v;
+  *(int*)ctx += *(int*)k;
+  return *(int*)ctx <= 1000;
+}
+
+static uint64_t _int_hash(void *k)
+{
+  return oc_filter_hash(k, sizeof(int));
+}
+
+/* keys[i] = 2i, put in shuffled order; each value its key. */
+static splay *_evens(int *keys, int n)
+{
+  splay *s = splay_create(&_int_compare, NULL);
+  for (int i = 0; i < n; i++) keys[i] = 2 * i;
+  for (int i = 0; i < n; i++) {
+    int j = (int)((i * 7919u) % (unsigned)n);
+    splay_put(s, &keys[j], &keys[j]);
+  }
+  return s;
+}
+
 static bool
 _test_put_get(bool quiet)
 {
@@ -254,6 +311,454 @@ _test_rich_use(bool quiet)
 
 }
 
+/* Sorted and reverse sorted keys, the worst case for an unbalanced tree:
+   inserting, finding and removing them all must neither recurse down the
+   chain nor take quadratic time. */
+#define SORTED_N 200000
+static bool
+_test_sorted(bool quiet)
+{
+  bool result = true;
+  splay *s = splay_create(&_int_compare, &_fake_free);
+  int *keys = malloc(SORTED_N * sizeof(int));
+
+  for (int i = 0; i < SORTED_N; i++) {
+    keys[i] = i;
+    splay_put(s, &keys[i], &keys[i]);
+  }
+  for (int i = 0; i < SORTED_N; i++) {
+    if (splay_get(s, &keys[i]) != &keys[i]) result = false;
+  }
+  order_last = -1;
+  order_ok = true;
+  splay_iter(s, _check_order);
+  if (!order_ok) result = false;
+  free_ctr = 0;
+  for (int i = SORTED_N - 1; i >= 0; i -= 2) splay_remove(s, &keys[i]);
+  if (free_ctr != SORTED_N / 2 || splay_count(s) != SORTED_N / 2) {
+    result = false;
+  }
+  for (int i = 0; i < SORTED_N; i++) {
+    if ((splay_get(s, &keys[i]) != NULL) != (i % 2 == 0)) result = false;
+  }
+  free_ctr = 0;
+  splay_free(s);
+  if (free_ctr != SORTED_N / 2) result = false;
+  if (!result && !quiet) {
+    printf("ERR: Splay Tree failed on sorted keys.\n");
+  }
+  free(keys);
+  return result;
+}
+
+/* Random puts, gets and removes, checked against a table of which keys
+   are in. */
+static bool
+_test_random_ops(bool quiet)
+{
+  bool result = true;
+  splay *s = splay_create(&_int_compare, NULL);
+  int keys[1000];
+  bool in[1000] = { false };
+  uint32_t count = 0, k;
+  uint64_t r = 88172645463325252ULL;
+
+  for (int i = 0; i < 1000; i++) keys[i] = i;
+  for (int i = 0; i < 200000; i++) {
+    r ^= r << 13; r ^= r >> 7; r ^= r << 17;   /* xorshift */
+    k = (uint32_t)(r >> 32) % 1000;
+    switch (r % 3) {
+      case 0:
+        splay_put(s, &keys[k], &keys[k]);
+        if (!in[k]) count++;
+        in[k] = true;
+        break;
+      case 1:
+        splay_remove(s, &keys[k]);
+        if (in[k]) count--;
+        in[k] = false;
+        break;
+      default:
+        if ((splay_get(s, &keys[k]) == &keys[k]) != in[k]) result = false;
+    }
+  }
+  if (splay_count(s) != count) result = false;
+  order_last = -1;
+  order_ok = true;
+  splay_iter(s, _check_order);
+  if (!order_ok) result = false;
+  if (!result && !quiet) {
+    printf("ERR: Splay Tree failed on random operations.\n");
+  }
+  splay_free(s);
+  return result;
+}
+
+static bool
+_test_bounds(bool quiet)
+{
+  bool result = true;
+  int keys[500], seek;
+  void *val;
+  splay *s = _evens(keys, 500);
+  splay *e = splay_create(&_int_compare, NULL);
+
+  for (seek = -3; seek < 1002; seek++) {
+    int *lo = splay_lower_bound(s, &seek, &val);
+    int *up = splay_upper_bound(s, &seek, NULL);
+    int want_lo = seek < 0 ? 0 : (seek + 1) / 2 * 2;
+    int want_up = seek < 0 ? 0 : seek / 2 * 2 + 2;
+    if (want_lo < 1000 ? (!lo || *lo != want_lo || val != lo) : lo != NULL) {
+      result = false;
+    }
+    if (want_up < 1000 ? (!up || *up != want_up) : up != NULL) {
+      result = false;
+    }
+  }
+  seek = 5;
+  if (splay_lower_bound(e, &seek, &val) || val ||
+      splay_upper_bound(e, &seek, NULL)) {
+    result = false;
+  }
+  if (splay_count(s) != 500) result = false;
+  if (!result && !quiet) printf("ERR: Splay Tree bounds failed.\n");
+  splay_free(s);
+  splay_free(e);
+  return result;
+}
+
+static bool
+_test_range(bool quiet)
+{
+  bool result = true;
+  int keys[500], lo = 11, hi = 20, sum = 0;
+  splay *s = _evens(keys, 500);
+
+  /* 12 + 14 + 16 + 18, not 20. */
+  splay_range(s, &lo, &hi, _sum_keys, &sum);
+  if (sum != 60) result = false;
+  /* 0 + 2 + ... + 62 = 992, then 64 goes over and stops it. */
+  sum = 0;
+  splay_range(s, NULL, NULL, _sum_keys, &sum);
+  if (sum != 1056) result = false;
+  sum = 0;
+  lo = 996;
+  splay_range(s, &lo, NULL, _sum_keys, &sum);
+  if (sum != 996 + 998) result = false;
+  sum = 0;
+  hi = 5;
+  lo = 4;
+  splay_range(s, &hi, &lo, _sum_keys, &sum);
+  lo = 2000;
+  splay_range(s, &lo, NULL, _sum_keys, &sum);
+  if (sum != 0) result = false;
+  if (!result && !quiet) printf("ERR: Splay Tree range failed.\n");
+  splay_free(s);
+  return result;
+}
+
+/* Forwards and backwards over every entry, and on past keys put and
+   removed around the cursor. */
+static bool
+_test_cursor(bool quiet)
+{
+  bool result = true;
+  int keys[500], extra[3] = { 101, 103, 105 }, seek = 99, n = 0;
+  splay *s = _evens(keys, 500);
+  splay_cursor c;
+
+  for (bool ok = splay_cursor_first(s, &c); ok; ok = splay_cursor_next(&c)) {
+    if (*(int*)c.key != 2 * n || c.val != c.key) result = false;
+    n++;
+  }
+  if (n != 500 || c.key || splay_cursor_next(&c)) result = false;
+  for (bool ok = splay_cursor_last(s, &c); ok; ok = splay_cursor_prev(&c)) {
+    n--;
+    if (*(int*)c.key != 2 * n) result = false;
+  }
+  if (n != 0) result = false;
+
+  if (!splay_cursor_seek(s, &c, &seek) || *(int*)c.key != 100) {
+    result = false;
+  }
+  splay_put(s, &extra[0], NULL);
+  splay_remove(s, &keys[51]);
+  splay_get(s, &keys[400]);
+  if (!splay_cursor_next(&c) || *(int*)c.key != 101) result = false;
+  splay_put(s, &extra[2], NULL);
+  splay_get(s, &keys[3]);
+  if (!splay_cursor_next(&c) || *(int*)c.key != 104) result = false;
+  splay_put(s, &extra[1], NULL);
+  splay_get(s, &keys[0]);
+  if (!splay_cursor_prev(&c) || *(int*)c.key != 103) result = false;
+  if (!splay_cursor_prev(&c) || *(int*)c.key != 101) result = false;
+  if (!splay_cursor_prev(&c) || *(int*)c.key != 100) result = false;
+  if (!splay_cursor_prev(&c) || *(int*)c.key != 98) result = false;
+  splay_free(s);
+
+  s = splay_create(&_int_compare, NULL);
+  if (splay_cursor_first(s, &c) || splay_cursor_last(s, &c) ||
+      splay_cursor_seek(s, &c, &seek) || splay_cursor_prev(&c)) {
+    result = false;
+  }
+  splay_free(s);
+  if (!result && !quiet) printf("ERR: Splay Tree cursor failed.\n");
+  return result;
+}
+
+/* Rank, select and count_range checked against a table of which keys are
+   in, through random puts and removes, and cursor steps and range scans
+   between them, each of which reshapes the tree. */
+static bool
+_test_order_stats(bool quiet)
+{
+  bool result = true;
+  splay *s = splay_create(&_int_compare, NULL);
+  splay_cursor c;
+  int keys[1001], *got;
+  bool in[1000] = { false };
+  uint32_t below[1001], k, lo, hi;
+  int sum;
+  uint64_t r = 88172645463325252ULL;
+  void *val;
+
+  for (int i = 0; i <= 1000; i++) keys[i] = i;
+  for (int i = 0; i < 40000; i++) {
+    r ^= r << 13; r ^= r >> 7; r ^= r << 17;   /* xorshift */
+    k = (uint32_t)(r >> 32) % 1000;
+    if (r % 5 < 3) {
+      splay_put(s, &keys[k], &keys[k]);
+      in[k] = true;
+    } else if (r % 5 == 3) {
+      splay_remove(s, &keys[k]);
+      in[k] = false;
+    } else if (splay_cursor_seek(s, &c, &keys[k])) {
+      if (r & 256) {
+        splay_cursor_next(&c);
+      } else {
+        splay_cursor_prev(&c);
+      }
+    }
+    if (i % 400) continue;
+    below[0] = 0;
+    for (int j = 0; j < 1000; j++) below[j + 1] = below[j] + in[j];
+    /* In random order: sweeping up from 0 would mend a wrong size on the
+       left spine before anything read it. */
+    for (int t = 0; t < 2000; t++) {
+      r ^= r << 13; r ^= r >> 7; r ^= r << 17;
+      k = (uint32_t)(r >> 32) % 1001;
+      if (splay_rank(s, &keys[k]) != below[k]) result = false;
+      if (k == 1000 || !in[k]) continue;
+      got = splay_select(s, below[k], &val);
+      if (!got || *got != (int)k || val != got) result = false;
+    }
+    if (splay_select(s, below[1000], &val) || val) result = false;
+    lo = (uint32_t)(r >> 20) % 1001;
+    hi = (uint32_t)(r >> 40) % 1001;
+    if (splay_count_range(s, &keys[lo], &keys[hi]) !=
+        (hi > lo ? below[hi] - below[lo] : 0)) result = false;
+    if (splay_count_range(s, NULL, &keys[hi]) != below[hi] ||
+        splay_count_range(s, &keys[lo], NULL) != below[1000] - below[lo]) {
+      result = false;
+    }
+    sum = 0;
+    splay_range(s, &keys[lo], NULL, _sum_keys, &sum);
+  }
+  if (splay_count_range(s, NULL, NULL) != splay_count(s)) result = false;
+  if (!result && !quiet) printf("ERR: Splay Tree order statistics failed.\n");
+  splay_free(s);
+  return result;
+}
+
+/* Into an empty tree, then above and below it, each a balanced build from
+   a slab; then keys among the tree's own and keys out of order, which go
+   in by put. Slab keys and put keys alike are found, removed and
+   released. */
+#define BUILD_N 100000
+static bool
+_test_build_sorted(bool quiet)
+{
+  bool result = true;
+  splay *s = splay_create(&_int_compare, &_fake_free);
+  int *keys = malloc(4 * BUILD_N * sizeof(int));
+  void **kp = malloc(4 * BUILD_N * sizeof(void*));
+  uint32_t want;
+
+  for (int i = 0; i < 4 * BUILD_N; i++) {
+    keys[i] = i - BUILD_N;
+    kp[i] = &keys[i];
+  }
+  /* keys[i] is i - BUILD_N: the middle two quarters first, values
+     NULL for the bottom eighth. */
+  splay_build_sorted(s, kp + BUILD_N, kp + BUILD_N, 2 * BUILD_N);
+  if (splay_count(s) != 2 * BUILD_N) result = false;
+  if (splay_rank(s, &keys[2 * BUILD_N]) != BUILD_N) result = false;
+  splay_build_sorted(s, kp + 3 * BUILD_N, kp + 3 * BUILD_N, BUILD_N / 2);
+  splay_build_sorted(s, kp, NULL, BUILD_N / 2);
+  /* Among the tree's keys, and out of order. */
+  splay_build_sorted(s, kp + BUILD_N / 4, kp + BUILD_N / 4, BUILD_N / 2);
+  splay_build_sorted(s, kp + 4 * BUILD_N - 2, kp, 2);
+  kp[0] = &keys[4 * BUILD_N - 1];
+  splay_build_sorted(s, kp, kp, 2);
+  kp[0] = &keys[0];
+  want = 3 * BUILD_N + BUILD_N / 4 + 2;
+  if (splay_count(s) != want) result = false;
+  for (int i = 0; i < 4 * BUILD_N; i++) {
+    bool in = i < 3 * BUILD_N / 4 || (i >= BUILD_N && i < 7 * BUILD_N / 2) ||
+              i >= 4 * BUILD_N - 2;
+    if (in != (splay_lower_bound(s, &keys[i], NULL) == &keys[i])) {
+      result = false;
+    }
+  }
+  order_last = INT32_MIN;
+  order_ok = true;
+  splay_iter(s, _check_order);
+  if (!order_ok) result = false;
+  free_ctr = 0;
+  for (int i = 0; i < 4 * BUILD_N; i += 3) splay_remove(s, &keys[i]);
+  want -= (uint32_t)free_ctr;
+  if (splay_count(s) != want) result = false;
+  free_ctr = 0;
+  splay_free(s);
+  if ((uint32_t)free_ctr != want) result = false;
+  if (!result && !quiet) printf("ERR: Splay Tree sorted build failed.\n");
+  free(keys);
+  free(kp);
+  return result;
+}
+
+/* Merges with the other tree above and below, a refused overlap, a
+   filtered tree taking in keys it never saw put, and the emptied tree
+   used again. */
+static bool
+_test_merge(bool quiet)
+{
+  bool result = true;
+  splay *a = splay_create(&_int_compare, &_fake_free);
+  splay *b = splay_create(&_int_compare, &_fake_free);
+  splay *c = splay_create(&_compare, NULL);
+  oc_filter *f = oc_filter_create(OC_FILTER_CUCKOO, 4000, 0.01);
+  int keys[3000];
+  void *kp[3000];
+
+  for (int i = 0; i < 3000; i++) {
+    keys[i] = i;
+    kp[i] = &keys[i];
+  }
+  for (int i = 1000; i < 2000; i++) splay_put(a, &keys[i], &keys[i]);
+  splay_attach_filter(a, f, &_int_hash);
+  splay_build_sorted(b, kp + 2000, kp + 2000, 1000);
+  if (!splay_merge(a, b) || splay_count(b) != 0) result = false;
+  for (int i = 0; i < 1000; i++) splay_put(b, &keys[i], &keys[i]);
+  splay_put(b, &keys[1500], &keys[1500]);
+  if (splay_merge(a, b) || splay_merge(a, c) || splay_merge(a, a)) {
+    result = false;
+  }
+  splay_remove(b, &keys[1500]);
+  if (!splay_merge(a, b)) result = false;
+  if (splay_count(a) != 3000 || splay_count(b) != 0) result = false;
+  for (int i = 0; i < 3000; i++) {
+    if (splay_get(a, &keys[i]) != &keys[i]) result = false;
+  }
+  if (splay_rank(a, &keys[2500]) != 2500) result = false;
+  splay_put(b, &keys[0], NULL);
+  free_ctr = 0;
+  splay_free(a);
+  splay_free(b);
+  if (free_ctr != 3001) result = false;
+  if (!result && !quiet) printf("ERR: Splay Tree merge failed.\n");
+  splay_free(c);
+  oc_filter_free(f);
+  return result;
+}
+
+/* A tree half from a slab, half put, split in three, the parts split off
+   without its filter, joined back in a different order; then split at
+   random keys and joined again many times, the counts checked each time.
+   The first tree is freed while the split halves still hold nodes of its
+   slab. */
+#define SPLIT_N 10000
+static bool
+_test_split_join(bool quiet)
+{
+  bool result = true;
+  splay *s = splay_create(&_int_compare, &_fake_free), *t, *u, *e;
+  oc_filter *f = oc_filter_create(OC_FILTER_CUCKOO, SPLIT_N, 0.01);
+  int *keys = malloc((SPLIT_N + 2) * sizeof(int)), below = -1;
+  void **kp = malloc(SPLIT_N * sizeof(void*));
+  uint64_t r = 88172645463325252ULL;
+  uint32_t k;
+
+  for (int i = 0; i <= SPLIT_N + 1; i++) keys[i] = i;
+  for (int i = 0; i < SPLIT_N; i++) kp[i] = &keys[i];
+  splay_build_sorted(s, kp, kp, SPLIT_N / 2);
+  for (int i = SPLIT_N / 2; i < SPLIT_N; i++) splay_put(s, kp[i], kp[i]);
+  splay_attach_filter(s, f, &_int_hash);
+  t = splay_split(s, &keys[3000]);
+  u = splay_split(t, &keys[7000]);
+  if (splay_count(s) != 3000 || splay_count(t) != 4000 ||
+      splay_count(u) != SPLIT_N - 7000) result = false;
+  /* A key put in a split-off part stays out of s's filter. */
+  if (!oc_filter_may_contain(f, _int_hash(&keys[SPLIT_N + 1]))) {
+    splay_put(u, &keys[SPLIT_N + 1], NULL);
+    if (oc_filter_may_contain(f, _int_hash(&keys[SPLIT_N + 1]))) {
+      result = false;
+    }
+    splay_remove(u, &keys[SPLIT_N + 1]);
+  }
+  for (int i = 0; i < SPLIT_N; i++) {
+    splay *in = i < 3000 ? s : i < 7000 ? t : u;
+    if (splay_get(in, &keys[i]) != &keys[i] ||
+        splay_get(in == s ? t : s, &keys[i])) result = false;
+  }
+  /* s is then 0 .. 2999 and 7000 .. 9999, around t. */
+  if (splay_join(u, s) || !splay_join(s, u) || splay_join(s, t)) {
+    result = false;
+  }
+  splay_remove(s, &keys[8000]);
+  splay_remove(s, &keys[1000]);
+  splay_free(u);
+  u = splay_split(s, &keys[7000]);
+  if (!splay_join(t, u) || !splay_join(s, t)) result = false;
+  if (splay_count(s) != SPLIT_N - 2 || splay_count(t) || splay_count(u)) {
+    result = false;
+  }
+  splay_free(u);
+  e = splay_split(s, &keys[SPLIT_N]);
+  if (splay_count(e) != 0) result = false;
+  splay_free(e);
+  e = splay_split(s, &below);
+  if (splay_count(e) != SPLIT_N - 2 || splay_count(s) != 0) result = false;
+
+  for (int i = 0; i < 2000; i++) {
+    r ^= r << 13; r ^= r >> 7; r ^= r << 17;   /* xorshift */
+    k = (uint32_t)(r >> 32) % SPLIT_N;
+    u = splay_split(e, &keys[k]);
+    if (splay_count(e) != k - (k > 1000) - (k > 8000) ||
+        splay_count(e) + splay_count(u) != SPLIT_N - 2) result = false;
+    if (i % 2) {
+      if (!splay_join(e, u)) result = false;
+      splay_free(u);
+    } else {
+      if (!splay_merge(u, e)) result = false;
+      splay_free(e);
+      e = u;
+    }
+  }
+  if (splay_count(e) != SPLIT_N - 2) result = false;
+  free_ctr = 0;
+  splay_free(s);
+  splay_free(t);
+  for (int i = 0; i < SPLIT_N; i += 2) splay_remove(e, &keys[i]);
+  splay_free(e);
+  if (free_ctr != SPLIT_N - 2) result = false;
+  if (!result && !quiet) printf("ERR: Splay Tree split and join failed.\n");
+  free(keys);
+  free(kp);
+  oc_filter_free(f);
+  return result;
+}
+
 /* ------------------------------------------------------------------------- *\
    Public Interface
 \* ------------------------------------------------------------------------- */
@@ -267,6 +772,15 @@ int test_splay_tree( bool quiet )
   if (_test_put_get(quiet) != true) errs++;
   if (_test_remove(quiet) != true) errs++;
   if (_test_rich_use(quiet) != true) errs++;
+  if (_test_sorted(quiet) != true) errs++;
+  if (_test_random_ops(quiet) != true) errs++;
+  if (_test_bounds(quiet) != true) errs++;
+  if (_test_range(quiet) != true) errs++;
+  if (_test_cursor(quiet) != true) errs++;
+  if (_test_order_stats(quiet) != true) errs++;
+  if (_test_build_sorted(quiet) != true) errs++;
+  if (_test_merge(quiet) != true) errs++;
+  if (_test_split_join(quiet) != true) errs++;
 
   if (!quiet) {
     if (errs)
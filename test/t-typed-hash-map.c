@@ -0,0 +1,162 @@
+/* ------------------------------------------------------------------------- *\
+   unit tests for typed hash map
+   -------------------------------------------------------------------------
+   LICENSE: This program is free software. You can modify it and/or re-
+   distribute it under the terms of the Apache 2.0 License. You should have
+   received a copy of the Apache 2.0 License along with this program. If
+   not, please see: http://www.apache.org/licenses/LICENSE-2.0.txt
+
+   DISCLAIMER: This program is distributed in the hope that it will be
+   useful, but without any warrantee; without even the implied warantee
+   of fitness for any particular purpose. See the License for more details.
+\* ------------------------------------------------------------------------- */
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "typed-hash-map.h"
+
+/* public entry point */
+int test_typed_hash_map(bool);
+
+/* instantiations: integers inline, and string keys with a struct value. */
+typedef struct point { int x, y; } point;
+
+#define _U64_EQ(a, b) ((a) == (b))
+static inline uint64_t _str_hash(const char *s)
+{
+  return hmap_hash_wy(s, strlen(s), 0);
+}
+static inline bool _str_eq(const char *a, const char *b)
+{
+  return strcmp(a, b) == 0;
+}
+
+OC_HMAP_DEFINE(u64map, uint64_t, uint64_t, oc_hash_u64, _U64_EQ)
+OC_HMAP_DEFINE(strmap, const char*, point, _str_hash, _str_eq)
+
+/* test declarations */
+static bool _test_u64(bool);
+static bool _test_strings(bool);
+static bool _test_against_reference(bool);
+
+/* test implementations */
+static bool _test_u64(bool quiet)
+{
+  bool result = true;
+  u64map *h = u64map_create();
+  uint64_t *v, k, sum = 0, ksum = 0;
+  uint32_t pos = 0, n = 0;
+
+  for (uint64_t i = 0; i < 50000; i++) u64map_put(h, i * 3, i);
+  u64map_put(h, 3, 100);
+  if (u64map_count(h) != 50000) result = false;
+  for (uint64_t i = 0; i < 50000 && result; i++) {
+    v = u64map_get(h, i * 3);
+    if (!v || *v != (i == 1 ? 100 : i) || u64map_get(h, i * 3 + 1)) {
+      result = false;
+    }
+  }
+  if (!result && !quiet) printf("ERR: Typed Hash Map lost a u64 key.\n");
+  /* The value is held in the map: writes through get's pointer stick. */
+  *u64map_get(h, 0) = 7;
+  if (*u64map_get(h, 0) != 7) result = false;
+  while (u64map_next(h, &pos, &k, NULL)) {
+    ksum += k;
+    n++;
+  }
+  for (uint64_t i = 0; i < 50000; i++) sum += i * 3;
+  if (n != 50000 || ksum != sum) {
+    if (!quiet) printf("ERR: Typed Hash Map walk saw %u keys.\n", n);
+    result = false;
+  }
+  u64map_free(h);
+  return result;
+}
+
+static bool _test_strings(bool quiet)
+{
+  bool result = true;
+  strmap *h = strmap_create();
+  static char key[1000][12];
+  char seek[12];
+  point p, *q;
+
+  for (int i = 0; i < 1000; i++) {
+    snprintf(key[i], 12, "skey%d", i);
+    p.x = i;
+    p.y = -i;
+    strmap_put(h, key[i], p);
+  }
+  /* Equal strings at other addresses are the same key. */
+  for (int i = 0; i < 1000; i++) {
+    snprintf(seek, 12, "skey%d", i);
+    q = strmap_get(h, seek);
+    if (!q || q->x != i || q->y != -i) {
+      if (!quiet) printf("ERR: Typed Hash Map lost %s.\n", seek);
+      result = false;
+      break;
+    }
+  }
+  if (!strmap_remove(h, "skey5") || strmap_remove(h, "skey5") ||
+      strmap_get(h, "skey5") || strmap_count(h) != 999) {
+    if (!quiet) printf("ERR: Typed Hash Map remove failed.\n");
+    result = false;
+  }
+  strmap_free(h);
+  return result;
+}
+
+/* Random puts and removes over a small key range, checked against a plain
+   array: every removal shifts a run back. */
+static bool _test_against_reference(bool quiet)
+{
+  bool result = true;
+  u64map *h = u64map_create();
+  static uint64_t ref[4096];
+  uint64_t r = 88172645463325252ULL, k, *v;
+  uint32_t live = 0;
+
+  for (uint64_t i = 1; i <= 400000; i++) {
+    r ^= r << 13; r ^= r >> 7; r ^= r << 17;   /* xorshift */
+    k = r % 4096;
+    if ((r >> 20) % 3) {
+      if (!ref[k]) live++;
+      ref[k] = i;
+      u64map_put(h, k << 40, i);
+    } else {
+      if (u64map_remove(h, k << 40) != (ref[k] != 0)) result = false;
+      if (ref[k]) live--;
+      ref[k] = 0;
+    }
+  }
+  for (k = 0; k < 4096 && result; k++) {
+    v = u64map_get(h, k << 40);
+    if (ref[k] ? (!v || *v != ref[k]) : v != NULL) result = false;
+  }
+  if (!result || u64map_count(h) != live) {
+    if (!quiet) printf("ERR: Typed Hash Map diverged from reference.\n");
+    result = false;
+  }
+  u64map_free(h);
+  return result;
+}
+
+int test_typed_hash_map(bool quiet)
+{
+  uint32_t errs = 0;
+
+  if (_test_u64(quiet) != true) errs++;
+  if (_test_strings(quiet) != true) errs++;
+  if (_test_against_reference(quiet) != true) errs++;
+
+  if (!quiet) {
+    if (errs)
+      printf("[FAIL] : Typed Hash Map\n");
+    else
+      printf("[OK]   : Typed Hash Map\n");
+  }
+
+  return errs;
+}
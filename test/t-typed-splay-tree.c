@@ -0,0 +1,138 @@
+/* ------------------------------------------------------------------------- *\
+   unit tests for typed splay tree
+   -------------------------------------------------------------------------
+   LICENSE: This program is free software. You can modify it and/or re-
+   distribute it under the terms of the Apache 2.0 License. You should have
+   received a copy of the Apache 2.0 License along with this program. If
+   not, please see: http://www.apache.org/licenses/LICENSE-2.0.txt
+
+   DISCLAIMER: This program is distributed in the hope that it will be
+   useful, but without any warrantee; without even the implied warantee
+   of fitness for any particular purpose. See the License for more details.
+\* ------------------------------------------------------------------------- */
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "typed-splay-tree.h"
+
+/* public entry point */
+int test_typed_splay_tree(bool);
+
+#define _INT_CMP(a, b) (((a) > (b)) - ((a) < (b)))
+OC_SPLAY_DEFINE(itree, int, double, _INT_CMP)
+
+/* helper declarations */
+typedef struct walk { int last; uint32_t n; bool ordered; } walk;
+static void _visit(int, double*, void*);
+
+/* test declarations */
+static bool _test_basic(bool);
+static bool _test_sequential(bool);
+static bool _test_against_reference(bool);
+
+/* helper functions */
+static void _visit(int key, double *val, void *ctx)
+{
+  walk *w = ctx;
+  if (w->n && key <= w->last) w->ordered = false;
+  if (*val != key * 0.5) w->ordered = false;
+  w->last = key;
+  w->n++;
+}
+
+/* test implementations */
+static bool _test_basic(bool quiet)
+{
+  bool result = true;
+  itree *t = itree_create();
+  double *v;
+
+  for (int i = 0; i < 1000; i++) itree_put(t, (i * 7919) % 1000, 0);
+  for (int i = 0; i < 1000; i++) itree_put(t, i, i * 0.5);
+  if (itree_count(t) != 1000) result = false;
+  for (int i = 0; i < 1000 && result; i++) {
+    v = itree_get(t, i);
+    if (!v || *v != i * 0.5) result = false;
+  }
+  if (itree_get(t, -1) || itree_get(t, 1000)) result = false;
+  if (!itree_remove(t, 500) || itree_remove(t, 500) || itree_get(t, 500) ||
+      itree_count(t) != 999) {
+    result = false;
+  }
+  if (!result && !quiet) printf("ERR: Typed Splay Tree put/get failed.\n");
+  itree_free(t);
+  return result;
+}
+
+/* Sequential inserts build a path; walking and freeing it must not
+   recurse. */
+static bool _test_sequential(bool quiet)
+{
+  bool result = true;
+  itree *t = itree_create();
+  walk w = { 0, 0, true };
+
+  for (int i = 0; i < 1000000; i++) itree_put(t, i, i * 0.5);
+  itree_each(t, _visit, &w);
+  if (w.n != 1000000 || !w.ordered) {
+    if (!quiet) printf("ERR: Typed Splay Tree walk saw %u in order: %d.\n",
+                       w.n, w.ordered);
+    result = false;
+  }
+  itree_free(t);
+  return result;
+}
+
+static bool _test_against_reference(bool quiet)
+{
+  bool result = true;
+  itree *t = itree_create();
+  static bool ref[4096];
+  uint64_t r = 88172645463325252ULL;
+  uint32_t live = 0;
+  walk w = { 0, 0, true };
+  int k;
+
+  for (int i = 0; i < 200000; i++) {
+    r ^= r << 13; r ^= r >> 7; r ^= r << 17;   /* xorshift */
+    k = (int)(r % 4096);
+    if ((r >> 20) % 3) {
+      if (!ref[k]) live++;
+      ref[k] = true;
+      itree_put(t, k, k * 0.5);
+    } else {
+      if (itree_remove(t, k) != ref[k]) result = false;
+      if (ref[k]) live--;
+      ref[k] = false;
+    }
+  }
+  for (k = 0; k < 4096 && result; k++) {
+    if ((itree_get(t, k) != NULL) != ref[k]) result = false;
+  }
+  itree_each(t, _visit, &w);
+  if (!result || itree_count(t) != live || w.n != live || !w.ordered) {
+    if (!quiet) printf("ERR: Typed Splay Tree diverged from reference.\n");
+    result = false;
+  }
+  itree_free(t);
+  return result;
+}
+
+int test_typed_splay_tree(bool quiet)
+{
+  uint32_t errs = 0;
+
+  if (_test_basic(quiet) != true) errs++;
+  if (_test_sequential(quiet) != true) errs++;
+  if (_test_against_reference(quiet) != true) errs++;
+
+  if (!quiet) {
+    if (errs)
+      printf("[FAIL] : Typed Splay Tree\n");
+    else
+      printf("[OK]   : Typed Splay Tree\n");
+  }
+
+  return errs;
+}